@@ -0,0 +1,143 @@
+//***************************************************************************************
+// Benchmarks.h
+//
+// Console benchmarks for the CPU side of the demos.  Each benchmark prints its own
+// table to stdout.
+//***************************************************************************************
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <Windows.h>
+
+//---------------------------------------------------------------------------------------
+// Wall clock timer on top of the performance counter.
+//---------------------------------------------------------------------------------------
+
+class Stopwatch
+{
+public:
+	Stopwatch()
+	{
+		__int64 countsPerSec;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+		mSecondsPerCount = 1.0 / (double)countsPerSec;
+		Restart();
+	}
+
+	void Restart()
+	{
+		QueryPerformanceCounter((LARGE_INTEGER*)&mStart);
+	}
+
+	// Milliseconds since construction or the last Restart().
+	double ElapsedMs()const
+	{
+		__int64 now;
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+		return (now - mStart) * mSecondsPerCount * 1000.0;
+	}
+
+private:
+	double mSecondsPerCount;
+	__int64 mStart;
+};
+
+//---------------------------------------------------------------------------------------
+// Benchmarks.
+//---------------------------------------------------------------------------------------
+
+// Waves::Update time per step against the number of worker threads.
+void BenchmarkWavesScaling();
+
+// Copying the solution into Vertex::Basic32 vertices: the old per-vertex loop against
+// Waves::EmitVertices().
+void BenchmarkWavesEmit();
+
+// Stepping only the active tiles of a mostly calm grid against stepping all of it.
+void BenchmarkWavesSparse();
+
+// Applying many disturbances one Disturb() call at a time against one DisturbBatch(),
+// each followed by a step, with and without the thread pool: the time of the calls
+// and the total with the step.  Also checks both leave the same heights.
+void BenchmarkWavesImpulses();
+
+// Emitting Vertex::Basic32 vertices against the compact half-float stream, with the
+// error the compact encoding introduces.
+void BenchmarkWavesCompact();
+
+// Wall clock time per simulated second of the explicit and the implicit integrator at
+// several time steps, with the difference from the explicit solution at a small one.
+void BenchmarkWavesImplicit();
+
+// Batched height and normal sampling at scattered positions, scalar against SIMD.
+void BenchmarkWavesSample();
+
+// Frame thread time per frame with Waves::Update run inline against picking up the
+// snapshots of a WavesThread, at 60 frames per second.
+void BenchmarkWavesAsync();
+
+// A geosphere subdivided with the old per-triangle Subdivide, with the shared-midpoint
+// one and built by CreateGeosphere: vertex count, build time and post-transform cache
+// miss ratio.
+void BenchmarkGeosphere();
+
+// Regenerating GeometryGenerator meshes into a new MeshData each time, into the same
+// one, and into arrays sized once from the *Counts functions.
+void BenchmarkGeometryRegenerate();
+
+// The sphere and cylinder rings with sine and cosine per vertex, as they were, against
+// CreateSphere and CreateCylinder: time and largest difference in any vertex attribute.
+// Spheres are also built on the thread pool and checked against the serial ones.
+void BenchmarkGeometryTrig();
+
+// CreateGrid on one thread and on the thread pool, and CreateGridChunks on grids too
+// large to hold whole: time and memory held.  Also checks that the chunks put back
+// together are the grid.
+void BenchmarkGeometryGrid();
+
+// Meshes that fit 16-bit indices generated with 32-bit and with 16-bit ones: index
+// memory and time.
+void BenchmarkGeometryIndex16();
+
+// MeshOptimizer on the skull and on generated meshes: ACMR, ATVR and overdraw before
+// and after, and the time the passes take.
+void BenchmarkMeshOptimize();
+
+// MeshletBuilder on the skull and on generated meshes: meshlets and how full they are,
+// build time, and the triangles culled by the meshlet bounds from views around the mesh
+// against those a per-triangle test culls.  Also checks that no visible triangle is
+// culled.
+void BenchmarkMeshMeshlets();
+
+// MeshSimplifier on the skull and on generated meshes at a few ratios, on one thread
+// and on the thread pool: triangles per second and the error reached.  Also checks
+// that the triangles left are valid.
+void BenchmarkMeshSimplify();
+
+// Progressive meshes built with MeshSimplifier: stream and base sizes, the stream read
+// back in packets, splits applied a frame at a time and the parent steps the vertex
+// shader takes to resolve each index.  Also checks the full mesh comes back and the base
+// after it.
+void BenchmarkMeshProgressive();
+
+// MeshWelder on the skull, a sphere whose seam must survive and a noisy triangle soup
+// of a grid, on one thread and on the thread pool: vertices merged and memory saved.
+// Also checks both give the same mesh and the soup welds back into the grid.
+void BenchmarkMeshWeld();
+
+// TangentGenerator on the skull and generated meshes, on one thread and on the thread
+// pool: how far the normals and tangents land from the ones the mesh came with and how
+// many vertices mirrored texture coordinates split.  Also checks both give the same bits.
+void BenchmarkMeshTangents();
+
+// OceanFFT::Update against Waves::Update on grids of the same size, on one thread and
+// on all of them.
+void BenchmarkOceanFFT();
+
+// A WaveOcean of LOD tiles around the camera against one grid of the same area at the
+// finest resolution: points held and stepped and time per step.  Also checks that the
+// stitched tiles cover the ocean without gaps or seams.
+void BenchmarkOceanTiles();
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,660 @@
+//***************************************************************************************
+// GeometryBenchmark.cpp
+//***************************************************************************************
+
+#include "Benchmarks.h"
+
+#include <GeometryGenerator.h>
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Average cache miss ratio, vertices transformed per triangle, of a FIFO
+	// post-transform cache of the given size.
+	double ComputeAcmr(const std::vector<UINT>& indices, UINT vertexCount, UINT cacheSize)
+	{
+		// Time stamp at which each vertex entered the cache; it is still in the cache
+		// while fewer than cacheSize misses happened since.
+		std::vector<UINT> entered(vertexCount, 0);
+		UINT misses = 0;
+
+		for (size_t k = 0; k < indices.size(); ++k)
+		{
+			UINT v = indices[k];
+			if (entered[v] == 0 || misses - entered[v] >= cacheSize)
+			{
+				++misses;
+				entered[v] = misses;
+			}
+		}
+
+		return indices.size() > 0 ? 3.0 * misses / indices.size() : 0.0;
+	}
+
+	// Subdivide as it was, with six fresh vertices per input triangle.
+	void SubdivideUnshared(GeometryGenerator::MeshData& meshData)
+	{
+		GeometryGenerator::MeshData inputCopy = meshData;
+
+		meshData.Vertices.resize(0);
+		meshData.Indices.resize(0);
+
+		UINT numTris = inputCopy.Indices.size() / 3;
+		for (UINT i = 0; i < numTris; ++i)
+		{
+			GeometryGenerator::Vertex v0 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 0]];
+			GeometryGenerator::Vertex v1 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 1]];
+			GeometryGenerator::Vertex v2 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 2]];
+
+			GeometryGenerator::Vertex m0, m1, m2;
+			m0.Position = XMFLOAT3(0.5f*(v0.Position.x + v1.Position.x), 0.5f*(v0.Position.y + v1.Position.y), 0.5f*(v0.Position.z + v1.Position.z));
+			m1.Position = XMFLOAT3(0.5f*(v1.Position.x + v2.Position.x), 0.5f*(v1.Position.y + v2.Position.y), 0.5f*(v1.Position.z + v2.Position.z));
+			m2.Position = XMFLOAT3(0.5f*(v0.Position.x + v2.Position.x), 0.5f*(v0.Position.y + v2.Position.y), 0.5f*(v0.Position.z + v2.Position.z));
+
+			meshData.Vertices.push_back(v0);
+			meshData.Vertices.push_back(v1);
+			meshData.Vertices.push_back(v2);
+			meshData.Vertices.push_back(m0);
+			meshData.Vertices.push_back(m1);
+			meshData.Vertices.push_back(m2);
+
+			const UINT k[12] = { 0, 3, 5, 3, 4, 5, 5, 4, 2, 3, 1, 4 };
+			for (UINT j = 0; j < 12; ++j)
+				meshData.Indices.push_back(i * 6 + k[j]);
+		}
+	}
+
+	// A geosphere built the way CreateGeosphere used to, by subdividing an icosahedron
+	// numSubdivisions times, with the old Subdivide or the current one.
+	void SubdivideGeosphere(UINT numSubdivisions, bool shareMidpoints, GeometryGenerator::MeshData& meshData)
+	{
+		GeometryGenerator geoGen;
+		geoGen.CreateGeosphere(1.0f, 0, meshData);
+
+		for (UINT i = 0; i < numSubdivisions; ++i)
+		{
+			if (shareMidpoints)
+				geoGen.Subdivide(meshData);
+			else
+				SubdivideUnshared(meshData);
+		}
+
+		for (UINT i = 0; i < meshData.Vertices.size(); ++i)
+		{
+			GeometryGenerator::Vertex& v = meshData.Vertices[i];
+
+			XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&v.Position));
+			XMStoreFloat3(&v.Position, n);
+			XMStoreFloat3(&v.Normal, n);
+
+			float theta = MathHelper::AngleFromXY(v.Position.x, v.Position.z);
+			float phi = acosf(v.Position.y);
+			v.TexC = XMFLOAT2(theta / XM_2PI, phi / XM_PI);
+
+			XMVECTOR T = XMVectorSet(-sinf(phi)*sinf(theta), 0.0f, sinf(phi)*cosf(theta), 0.0f);
+			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+		}
+	}
+
+	// Largest distance between a vertex of b and the nearest vertex of a, by brute
+	// force over a coarse spatial grid of a.
+	float MaxVertexDistance(const GeometryGenerator::MeshData& a, const GeometryGenerator::MeshData& b)
+	{
+		const int cells = 32;
+		std::vector<std::vector<UINT>> grid(cells * cells * cells);
+
+		auto cellOf = [cells](float x) -> int
+		{
+			return std::min(std::max(static_cast<int>((x + 1.01f) * 0.5f / 1.01f * cells), 0), cells - 1);
+		};
+
+		for (UINT i = 0; i < a.Vertices.size(); ++i)
+		{
+			const XMFLOAT3& p = a.Vertices[i].Position;
+			grid[(cellOf(p.x) * cells + cellOf(p.y)) * cells + cellOf(p.z)].push_back(i);
+		}
+
+		float maxDistSq = 0.0f;
+		for (UINT i = 0; i < b.Vertices.size(); ++i)
+		{
+			const XMFLOAT3& p = b.Vertices[i].Position;
+			float best = 1.0e30f;
+			for (int x = std::max(cellOf(p.x) - 1, 0); x <= std::min(cellOf(p.x) + 1, cells - 1); ++x)
+			{
+				for (int y = std::max(cellOf(p.y) - 1, 0); y <= std::min(cellOf(p.y) + 1, cells - 1); ++y)
+				{
+					for (int z = std::max(cellOf(p.z) - 1, 0); z <= std::min(cellOf(p.z) + 1, cells - 1); ++z)
+					{
+						const std::vector<UINT>& cell = grid[(x * cells + y) * cells + z];
+						for (size_t k = 0; k < cell.size(); ++k)
+						{
+							const XMFLOAT3& q = a.Vertices[cell[k]].Position;
+							float d = (p.x - q.x) * (p.x - q.x) + (p.y - q.y) * (p.y - q.y) + (p.z - q.z) * (p.z - q.z);
+							best = std::min(best, d);
+						}
+					}
+				}
+			}
+
+			maxDistSq = std::max(maxDistSq, best);
+		}
+
+		return sqrtf(maxDistSq);
+	}
+}
+
+void BenchmarkGeosphere()
+{
+	const UINT cacheSize = 32;
+
+	printf("ACMR with a %u entry FIFO cache; old and sub subdivide an icosahedron with\n", cacheSize);
+	printf("the old and the current Subdivide, geo is CreateGeosphere\n");
+	printf("%5s %10s %10s %10s %9s %9s %9s %7s %7s %7s %9s\n", "level", "triangles",
+		"unshared", "vertices", "old ms", "sub ms", "geo ms", "old", "sub", "geo", "geo-sub");
+
+	for (UINT level = 0; level <= 8; ++level)
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData unshared, geosphere, icosphere;
+
+		// Small levels build in microseconds, so repeat them for a stable time.
+		UINT repeat = std::max(1u, 4096u >> (2 * level));
+
+		double unsharedMs = 0.0;
+		if (level <= 7)
+		{
+			Stopwatch timer;
+			for (UINT r = 0; r < repeat; ++r)
+				SubdivideGeosphere(level, false, unshared);
+			unsharedMs = timer.ElapsedMs() / repeat;
+		}
+
+		Stopwatch timer;
+		for (UINT r = 0; r < repeat; ++r)
+			SubdivideGeosphere(level, true, geosphere);
+		double geosphereMs = timer.ElapsedMs() / repeat;
+
+		timer.Restart();
+		for (UINT r = 0; r < repeat; ++r)
+			geoGen.CreateGeosphere(1.0f, level, icosphere);
+		double icosphereMs = timer.ElapsedMs() / repeat;
+
+		// Both must put the same points on the sphere.
+		float distance = std::max(MaxVertexDistance(geosphere, icosphere), MaxVertexDistance(icosphere, geosphere));
+
+		UINT triangleCount = static_cast<UINT>(geosphere.Indices.size() / 3);
+		if (level <= 7)
+		{
+			printf("%5u %10u %10u %10u %9.3f %9.3f %9.3f %7.3f %7.3f %7.3f %9.2e\n", level, triangleCount,
+				static_cast<UINT>(unshared.Vertices.size()), static_cast<UINT>(geosphere.Vertices.size()),
+				unsharedMs, geosphereMs, icosphereMs,
+				ComputeAcmr(unshared.Indices, static_cast<UINT>(unshared.Vertices.size()), cacheSize),
+				ComputeAcmr(geosphere.Indices, static_cast<UINT>(geosphere.Vertices.size()), cacheSize),
+				ComputeAcmr(icosphere.Indices, static_cast<UINT>(icosphere.Vertices.size()), cacheSize),
+				distance);
+		}
+		else
+		{
+			// The old Subdivide needs 24 bytes of index and 264 of vertex per triangle
+			// here, about 350 MB, so it is skipped.
+			printf("%5u %10u %10s %10u %9s %9.3f %9.3f %7s %7.3f %7.3f %9.2e\n", level, triangleCount,
+				"-", static_cast<UINT>(geosphere.Vertices.size()), "-", geosphereMs, icosphereMs, "-",
+				ComputeAcmr(geosphere.Indices, static_cast<UINT>(geosphere.Vertices.size()), cacheSize),
+				ComputeAcmr(icosphere.Indices, static_cast<UINT>(icosphere.Vertices.size()), cacheSize),
+				distance);
+		}
+	}
+}
+
+namespace
+{
+	// One mesh to regenerate, the same way through each of the three paths.
+	struct RegenerateCase
+	{
+		const char* Name;
+		GeometryGenerator::MeshCounts (*Counts)();
+		void (*CreateMesh)(GeometryGenerator& geoGen, GeometryGenerator::MeshData& meshData);
+		void (*CreateArrays)(GeometryGenerator& geoGen, GeometryGenerator::Vertex* vertices, UINT* indices);
+	};
+
+	GeometryGenerator::MeshCounts GridCounts() { return GeometryGenerator::GridCounts(1024, 1024); }
+	void GridMesh(GeometryGenerator& g, GeometryGenerator::MeshData& m) { g.CreateGrid(100.0f, 100.0f, 1024, 1024, m); }
+	void GridArrays(GeometryGenerator& g, GeometryGenerator::Vertex* v, UINT* i) { g.CreateGrid(100.0f, 100.0f, 1024, 1024, v, i); }
+
+	GeometryGenerator::MeshCounts SphereCounts() { return GeometryGenerator::SphereCounts(512, 256); }
+	void SphereMesh(GeometryGenerator& g, GeometryGenerator::MeshData& m) { g.CreateSphere(1.0f, 512, 256, m); }
+	void SphereArrays(GeometryGenerator& g, GeometryGenerator::Vertex* v, UINT* i) { g.CreateSphere(1.0f, 512, 256, v, i); }
+
+	GeometryGenerator::MeshCounts GeosphereCounts() { return GeometryGenerator::GeosphereCounts(6); }
+	void GeosphereMesh(GeometryGenerator& g, GeometryGenerator::MeshData& m) { g.CreateGeosphere(1.0f, 6, m); }
+	void GeosphereArrays(GeometryGenerator& g, GeometryGenerator::Vertex* v, UINT* i) { g.CreateGeosphere(1.0f, 6, v, i); }
+
+	GeometryGenerator::MeshCounts CylinderCounts() { return GeometryGenerator::CylinderCounts(256, 256); }
+	void CylinderMesh(GeometryGenerator& g, GeometryGenerator::MeshData& m) { g.CreateCylinder(0.5f, 0.3f, 3.0f, 256, 256, m); }
+	void CylinderArrays(GeometryGenerator& g, GeometryGenerator::Vertex* v, UINT* i) { g.CreateCylinder(0.5f, 0.3f, 3.0f, 256, 256, v, i); }
+
+	GeometryGenerator::MeshCounts BoxCounts() { return GeometryGenerator::BoxCounts(); }
+	void BoxMesh(GeometryGenerator& g, GeometryGenerator::MeshData& m) { g.CreateBox(1.0f, 1.0f, 1.0f, m); }
+	void BoxArrays(GeometryGenerator& g, GeometryGenerator::Vertex* v, UINT* i) { g.CreateBox(1.0f, 1.0f, 1.0f, v, i); }
+}
+
+void BenchmarkGeometryRegenerate()
+{
+	const RegenerateCase cases[] =
+	{
+		{ "grid 1024^2", GridCounts, GridMesh, GridArrays },
+		{ "sphere 512x256", SphereCounts, SphereMesh, SphereArrays },
+		{ "geosphere 6", GeosphereCounts, GeosphereMesh, GeosphereArrays },
+		{ "cylinder 256^2", CylinderCounts, CylinderMesh, CylinderArrays },
+		{ "box", BoxCounts, BoxMesh, BoxArrays },
+	};
+
+	printf("%16s %10s %10s %11s %11s %11s %8s\n", "mesh", "vertices", "indices",
+		"fresh ms", "reused ms", "arrays ms", "reallocs");
+
+	GeometryGenerator geoGen;
+	for (UINT c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+	{
+		const RegenerateCase& test = cases[c];
+		GeometryGenerator::MeshCounts counts = test.Counts();
+
+		// Repeat small meshes for a stable time.
+		UINT repeat = std::max(4u, 4000000u / std::max(counts.VertexCount, 1u));
+
+		// A new MeshData every time, which allocates both vectors.
+		Stopwatch timer;
+		for (UINT r = 0; r < repeat; ++r)
+		{
+			GeometryGenerator::MeshData meshData;
+			test.CreateMesh(geoGen, meshData);
+		}
+		double freshMs = timer.ElapsedMs() / repeat;
+
+		// The same MeshData every time; only the first call may allocate.
+		GeometryGenerator::MeshData meshData;
+		test.CreateMesh(geoGen, meshData);
+		const GeometryGenerator::Vertex* vertexData = &meshData.Vertices[0];
+		const UINT* indexData = &meshData.Indices[0];
+		UINT reallocs = 0;
+
+		timer.Restart();
+		for (UINT r = 0; r < repeat; ++r)
+		{
+			test.CreateMesh(geoGen, meshData);
+			if (&meshData.Vertices[0] != vertexData || &meshData.Indices[0] != indexData)
+			{
+				++reallocs;
+				vertexData = &meshData.Vertices[0];
+				indexData = &meshData.Indices[0];
+			}
+		}
+		double reusedMs = timer.ElapsedMs() / repeat;
+
+		// Arrays sized once from the counts.
+		std::vector<GeometryGenerator::Vertex> vertices(counts.VertexCount);
+		std::vector<UINT> indices(counts.IndexCount);
+
+		timer.Restart();
+		for (UINT r = 0; r < repeat; ++r)
+			test.CreateArrays(geoGen, &vertices[0], &indices[0]);
+		double arraysMs = timer.ElapsedMs() / repeat;
+
+		if (meshData.Vertices.size() != counts.VertexCount || meshData.Indices.size() != counts.IndexCount)
+			printf("%16s count mismatch\n", test.Name);
+
+		printf("%16s %10u %10u %11.3f %11.3f %11.3f %8u\n", test.Name, counts.VertexCount, counts.IndexCount,
+			freshMs, reusedMs, arraysMs, reallocs);
+	}
+}
+
+namespace
+{
+	// The rings of CreateSphere as they were, with sine and cosine per vertex.
+	void LegacySphereRings(float radius, UINT sliceCount, UINT stackCount, GeometryGenerator::Vertex* vertices)
+	{
+		float phiStep = XM_PI / stackCount;
+		float thetaStep = 2.0f*XM_PI / sliceCount;
+
+		for (UINT i = 1; i <= stackCount - 1; ++i)
+		{
+			float phi = i*phiStep;
+
+			for (UINT j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j*thetaStep;
+
+				GeometryGenerator::Vertex& v = *vertices++;
+				v.Position.x = radius*sinf(phi)*cosf(theta);
+				v.Position.y = radius*cosf(phi);
+				v.Position.z = radius*sinf(phi)*sinf(theta);
+
+				v.TangentU.x = -radius*sinf(phi)*sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+
+				XMVECTOR T = XMLoadFloat3(&v.TangentU);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+
+				XMVECTOR p = XMLoadFloat3(&v.Position);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+
+				v.TexC.x = theta / XM_2PI;
+				v.TexC.y = phi / XM_PI;
+			}
+		}
+	}
+
+	// The rings of CreateCylinder as they were, with sine, cosine and a normal per vertex.
+	void LegacyCylinderRings(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+		GeometryGenerator::Vertex* vertices)
+	{
+		float stackHeight = height / stackCount;
+		float radiusStep = (topRadius - bottomRadius) / stackCount;
+		UINT ringCount = stackCount + 1;
+
+		for (UINT i = 0; i < ringCount; i++)
+		{
+			float y = -0.5f*height + i*stackHeight;
+			float r = bottomRadius + i*radiusStep;
+
+			float dTheta = 2.0f*XM_PI / sliceCount;
+			for (UINT j = 0; j <= sliceCount; j++)
+			{
+				GeometryGenerator::Vertex& vertex = *vertices++;
+
+				float c = cosf(j*dTheta);
+				float s = sinf(j*dTheta);
+
+				vertex.Position = XMFLOAT3(r*c, y, r*s);
+				vertex.TexC.x = float(j) / sliceCount;
+				vertex.TexC.y = 1.0f - float(i) / stackCount;
+				vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+
+				float dr = bottomRadius - topRadius;
+				XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+				XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
+				XMVECTOR B = XMLoadFloat3(&bitangent);
+				XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+				XMStoreFloat3(&vertex.Normal, N);
+			}
+		}
+	}
+
+	// Largest difference of any position, normal, tangent or texture coordinate.
+	float MaxVertexDifference(const GeometryGenerator::Vertex* a, const GeometryGenerator::Vertex* b, UINT count)
+	{
+		float maxDiff = 0.0f;
+		for (UINT i = 0; i < count; ++i)
+		{
+			const float* fa = &a[i].Position.x;
+			const float* fb = &b[i].Position.x;
+			for (UINT k = 0; k < sizeof(GeometryGenerator::Vertex) / sizeof(float); ++k)
+				maxDiff = std::max(maxDiff, std::fabs(fa[k] - fb[k]));
+		}
+		return maxDiff;
+	}
+}
+
+void BenchmarkGeometryTrig()
+{
+	struct TrigCase
+	{
+		const char* Name;
+		bool Sphere;
+		UINT SliceCount;
+		UINT StackCount;
+	};
+
+	const TrigCase cases[] =
+	{
+		{ "sphere 64x32", true, 64, 32 },
+		{ "sphere 512x256", true, 512, 256 },
+		{ "sphere 4096x2048", true, 4096, 2048 },
+		{ "cylinder 64^2", false, 64, 64 },
+		{ "cylinder 1024^2", false, 1024, 1024 },
+	};
+
+	ThreadPool pool;
+	printf("The old ring loops against CreateSphere and CreateCylinder; the new times include\n"
+		"the indices and caps, the old ones only the ring vertices.  Spheres also on %u threads\n",
+		pool.ThreadCount());
+	printf("%18s %10s %10s %10s %8s %10s %10s\n", "mesh", "vertices", "old ms", "new ms", "speedup", "max diff",
+		"pool ms");
+
+	GeometryGenerator geoGen;
+	GeometryGenerator pooledGen;
+	pooledGen.SetThreadPool(&pool);
+	for (UINT c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+	{
+		const TrigCase& test = cases[c];
+		GeometryGenerator::MeshCounts counts = test.Sphere ?
+			GeometryGenerator::SphereCounts(test.SliceCount, test.StackCount) :
+			GeometryGenerator::CylinderCounts(test.SliceCount, test.StackCount);
+
+		std::vector<GeometryGenerator::Vertex> vertices(counts.VertexCount);
+		std::vector<GeometryGenerator::Vertex> legacy(counts.VertexCount);
+		std::vector<UINT> indices(counts.IndexCount);
+
+		UINT repeat = std::max(2u, 4000000u / counts.VertexCount);
+
+		// The rings start after the top pole of a sphere and at the front of a cylinder.
+		UINT ringStart = test.Sphere ? 1 : 0;
+		UINT ringVertexCount = test.Sphere ?
+			(test.StackCount - 1)*(test.SliceCount + 1) :
+			(test.StackCount + 1)*(test.SliceCount + 1);
+
+		// One untimed run each first, so the first touch of the fresh buffers is not
+		// timed; at 4096x2048 it costs as much as the run itself.
+		if (test.Sphere)
+		{
+			LegacySphereRings(1.0f, test.SliceCount, test.StackCount, &legacy[ringStart]);
+			geoGen.CreateSphere(1.0f, test.SliceCount, test.StackCount, &vertices[0], &indices[0]);
+		}
+		else
+		{
+			LegacyCylinderRings(0.5f, 0.3f, 3.0f, test.SliceCount, test.StackCount, &legacy[ringStart]);
+			geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, test.SliceCount, test.StackCount, &vertices[0], &indices[0]);
+		}
+
+		Stopwatch timer;
+		for (UINT r = 0; r < repeat; ++r)
+		{
+			if (test.Sphere)
+				LegacySphereRings(1.0f, test.SliceCount, test.StackCount, &legacy[ringStart]);
+			else
+				LegacyCylinderRings(0.5f, 0.3f, 3.0f, test.SliceCount, test.StackCount, &legacy[ringStart]);
+		}
+		double oldMs = timer.ElapsedMs() / repeat;
+
+		timer.Restart();
+		for (UINT r = 0; r < repeat; ++r)
+		{
+			if (test.Sphere)
+				geoGen.CreateSphere(1.0f, test.SliceCount, test.StackCount, &vertices[0], &indices[0]);
+			else
+				geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, test.SliceCount, test.StackCount, &vertices[0], &indices[0]);
+		}
+		double newMs = timer.ElapsedMs() / repeat;
+
+		float maxDiff = MaxVertexDifference(&vertices[ringStart], &legacy[ringStart], ringVertexCount);
+
+		printf("%18s %10u %10.3f %10.3f %7.2fx %10.2e", test.Name, counts.VertexCount,
+			oldMs, newMs, oldMs / newMs, maxDiff);
+
+		if (test.Sphere)
+		{
+			std::vector<GeometryGenerator::Vertex> pooledVertices(counts.VertexCount);
+			std::vector<UINT> pooledIndices(counts.IndexCount);
+
+			pooledGen.CreateSphere(1.0f, test.SliceCount, test.StackCount, &pooledVertices[0], &pooledIndices[0]);
+
+			timer.Restart();
+			for (UINT r = 0; r < repeat; ++r)
+				pooledGen.CreateSphere(1.0f, test.SliceCount, test.StackCount, &pooledVertices[0], &pooledIndices[0]);
+			double poolMs = timer.ElapsedMs() / repeat;
+
+			// The blocks must put together the same sphere.
+			bool identical = pooledIndices == indices &&
+				memcmp(&pooledVertices[0], &vertices[0], sizeof(GeometryGenerator::Vertex)*counts.VertexCount) == 0;
+			printf(" %10.3f%s", poolMs, identical ? "" : "  mismatch");
+		}
+		printf("\n");
+	}
+}
+
+void BenchmarkGeometryGrid()
+{
+	ThreadPool pool;
+	GeometryGenerator geoGen;
+
+	// Chunks put back together must give exactly the grid CreateGrid builds.
+	{
+		const UINT m = 777;
+		const UINT n = 1000;
+		GeometryGenerator::MeshData grid;
+		geoGen.CreateGrid(100.0f, 80.0f, m, n, grid);
+
+		GeometryGenerator::MeshData pooled;
+		geoGen.SetThreadPool(&pool);
+		geoGen.CreateGrid(100.0f, 80.0f, m, n, pooled);
+
+		GeometryGenerator::MeshData assembled;
+		assembled.Vertices.resize(grid.Vertices.size());
+		assembled.Indices.resize(grid.Indices.size());
+		geoGen.CreateGridChunks(100.0f, 80.0f, m, n, 64, [&](const GeometryGenerator::GridChunk& chunk)
+		{
+			memcpy(&assembled.Vertices[chunk.FirstVertex], chunk.Vertices,
+				sizeof(GeometryGenerator::Vertex)*chunk.OwnedVertexCount);
+			for (UINT i = 0; i < chunk.IndexCount; ++i)
+				assembled.Indices[chunk.FirstIndex + i] = chunk.FirstVertex + chunk.Indices[i];
+		});
+		geoGen.SetThreadPool(nullptr);
+
+		bool pooledMatches = memcmp(&grid.Vertices[0], &pooled.Vertices[0], sizeof(GeometryGenerator::Vertex)*grid.Vertices.size()) == 0 &&
+			grid.Indices == pooled.Indices;
+		bool chunksMatch = memcmp(&grid.Vertices[0], &assembled.Vertices[0], sizeof(GeometryGenerator::Vertex)*grid.Vertices.size()) == 0 &&
+			grid.Indices == assembled.Indices;
+
+		printf("%ux%u grid: pooled %s, chunks %s\n", m, n,
+			pooledMatches ? "match" : "DIFFER", chunksMatch ? "match" : "DIFFER");
+	}
+
+	printf("threads: %u\n", pool.ThreadCount());
+	printf("%12s %12s %12s %12s %12s %12s\n", "grid", "whole MB", "serial ms", "pooled ms", "chunk MB", "chunks ms");
+
+	const UINT sizes[] = { 1024, 4096, 16384 };
+	for (UINT s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		const UINT size = sizes[s];
+		const UINT chunkRows = 64;
+		GeometryGenerator::MeshCounts counts = GeometryGenerator::GridCounts(size, size);
+		double wholeMb = (sizeof(GeometryGenerator::Vertex)*(double)counts.VertexCount +
+			sizeof(UINT)*(double)counts.IndexCount) / (1024.0*1024.0);
+
+		// The whole grid only while it fits comfortably; the chunks never need it.
+		double serialMs = 0.0;
+		double pooledMs = 0.0;
+		if (size <= 4096)
+		{
+			std::vector<GeometryGenerator::Vertex> vertices(counts.VertexCount);
+			std::vector<UINT> indices(counts.IndexCount);
+
+			// Touch the pages first so neither time includes faulting them in.
+			geoGen.SetThreadPool(nullptr);
+			geoGen.CreateGrid(1000.0f, 1000.0f, size, size, &vertices[0], &indices[0]);
+
+			Stopwatch timer;
+			geoGen.CreateGrid(1000.0f, 1000.0f, size, size, &vertices[0], &indices[0]);
+			serialMs = timer.ElapsedMs();
+
+			geoGen.SetThreadPool(&pool);
+			timer.Restart();
+			geoGen.CreateGrid(1000.0f, 1000.0f, size, size, &vertices[0], &indices[0]);
+			pooledMs = timer.ElapsedMs();
+		}
+
+		// Consume each chunk by summing its heights, as a stand-in for writing it out.
+		std::atomic<UINT> chunkCount(0);
+		geoGen.SetThreadPool(&pool);
+		Stopwatch timer;
+		geoGen.CreateGridChunks(1000.0f, 1000.0f, size, size, chunkRows, [&](const GeometryGenerator::GridChunk& chunk)
+		{
+			float sum = 0.0f;
+			for (UINT i = 0; i < chunk.VertexCount; ++i)
+				sum += chunk.Vertices[i].Position.y;
+			if (sum == 0.0f)
+				++chunkCount;
+		});
+		double chunksMs = timer.ElapsedMs();
+
+		double chunkMb = pool.ThreadCount()*(sizeof(GeometryGenerator::Vertex)*(double)(chunkRows + 1)*size +
+			sizeof(UINT)*(double)chunkRows*(size - 1)*6) / (1024.0*1024.0);
+
+		if (size <= 4096)
+			printf("%7u^2 %12.1f %12.3f %12.3f %12.1f %12.3f\n", size, wholeMb, serialMs, pooledMs, chunkMb, chunksMs);
+		else
+			printf("%7u^2 %12.1f %12s %12s %12.1f %12.3f\n", size, wholeMb, "-", "-", chunkMb, chunksMs);
+
+		if (chunkCount != (size - 1 + chunkRows - 1) / chunkRows)
+			printf("%7u^2 chunk count mismatch\n", size);
+	}
+}
+
+namespace
+{
+	const char* const Index16CaseNames[] = { "sphere 255x255", "geosphere 6", "cylinder 128^2", "grid 255^2" };
+
+	// Average time to regenerate one of the meshes into the same MeshData, which after
+	// the first time does not allocate.
+	template <typename IndexT>
+	double TimeIndex16Case(GeometryGenerator& geoGen, UINT c, GeometryGenerator::BasicMeshData<IndexT>& meshData)
+	{
+		const UINT repeat = 20;
+		Stopwatch timer;
+		for (UINT r = 0; r <= repeat; ++r)
+		{
+			if (r == 1)
+				timer.Restart();
+
+			switch (c)
+			{
+			case 0: geoGen.CreateSphere(1.0f, 255, 255, meshData); break;
+			case 1: geoGen.CreateGeosphere(1.0f, 6, meshData); break;
+			case 2: geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 128, 128, meshData); break;
+			default: geoGen.CreateGrid(100.0f, 100.0f, 255, 255, meshData); break;
+			}
+		}
+		return timer.ElapsedMs() / repeat;
+	}
+}
+
+void BenchmarkGeometryIndex16()
+{
+	printf("%16s %10s %10s %10s %10s %10s\n", "mesh", "vertices", "32-bit KB", "16-bit KB", "32-bit ms", "16-bit ms");
+
+	GeometryGenerator geoGen;
+	for (UINT c = 0; c < sizeof(Index16CaseNames) / sizeof(Index16CaseNames[0]); ++c)
+	{
+		GeometryGenerator::MeshData mesh32;
+		GeometryGenerator::MeshData16 mesh16;
+		double ms32 = TimeIndex16Case(geoGen, c, mesh32);
+		double ms16 = TimeIndex16Case(geoGen, c, mesh16);
+
+		bool same = mesh32.Indices.size() == mesh16.Indices.size() &&
+			std::equal(mesh32.Indices.begin(), mesh32.Indices.end(), mesh16.Indices.begin());
+
+		printf("%16s %10u %10.1f %10.1f %10.3f %10.3f%s\n", Index16CaseNames[c], (UINT)mesh16.Vertices.size(),
+			sizeof(UINT)*mesh32.Indices.size() / 1024.0, sizeof(USHORT)*mesh16.Indices.size() / 1024.0,
+			ms32, ms16, same ? "" : "  indices differ");
+	}
+}
@@ -0,0 +1,690 @@
+//***************************************************************************************
+// MeshBenchmark.cpp
+//***************************************************************************************
+
+#include "Benchmarks.h"
+
+#include <GeometryGenerator.h>
+#include <MeshOptimizer.h>
+#include <MeshletBuilder.h>
+#include <MeshSimplifier.h>
+#include <MeshWelder.h>
+#include <ProgressiveMesh.h>
+#include <TangentGenerator.h>
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Reads Models/skull.txt from the demos, run from the solution or a project
+	// directory.  Positions and normals only.
+	bool LoadSkull(GeometryGenerator::MeshData& meshData)
+	{
+		const char* paths[] =
+		{
+			"Models/skull.txt",
+			"SkullDemo/Models/skull.txt",
+			"../SkullDemo/Models/skull.txt",
+			"../../SkullDemo/Models/skull.txt",
+		};
+
+		for (UINT p = 0; p < sizeof(paths) / sizeof(paths[0]); ++p)
+		{
+			std::ifstream fin(paths[p]);
+			if (!fin)
+				continue;
+
+			UINT vcount = 0;
+			UINT tcount = 0;
+			std::string ignore;
+
+			fin >> ignore >> vcount;
+			fin >> ignore >> tcount;
+			fin >> ignore >> ignore >> ignore >> ignore;
+
+			meshData.Vertices.resize(vcount);
+			for (UINT i = 0; i < vcount; i++)
+			{
+				GeometryGenerator::Vertex& v = meshData.Vertices[i];
+				fin >> v.Position.x >> v.Position.y >> v.Position.z;
+				fin >> v.Normal.x >> v.Normal.y >> v.Normal.z;
+				v.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				v.TexC = XMFLOAT2(0.0f, 0.0f);
+			}
+
+			fin >> ignore;
+			fin >> ignore;
+			fin >> ignore;
+
+			meshData.Indices.resize(3 * tcount);
+			for (UINT i = 0; i < 3 * tcount; i++)
+				fin >> meshData.Indices[i];
+
+			return !fin.fail();
+		}
+
+		return false;
+	}
+
+	// MeshOptimizer::AnalyzeOverdraw() of a whole mesh.
+	float EstimateOverdraw(const GeometryGenerator::MeshData& meshData)
+	{
+		return MeshOptimizer::AnalyzeOverdraw(&meshData.Indices[0], static_cast<UINT>(meshData.Indices.size()),
+			&meshData.Vertices[0], static_cast<UINT>(meshData.Vertices.size()), sizeof(GeometryGenerator::Vertex),
+			offsetof(GeometryGenerator::Vertex, Position));
+	}
+
+	// Whether the meshes draw the same triangles with the same winding, in any order and
+	// with any numbering of the vertices.
+	bool SameTriangles(const GeometryGenerator::MeshData& a, const GeometryGenerator::MeshData& b)
+	{
+		if (a.Indices.size() != b.Indices.size())
+			return false;
+
+		// Each triangle as the bytes of its vertices, rotated to start at the smallest.
+		auto triangles = [](const GeometryGenerator::MeshData& meshData) -> std::vector<std::string>
+		{
+			std::vector<std::string> result;
+			for (size_t t = 0; t + 2 < meshData.Indices.size(); t += 3)
+			{
+				std::string corner[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					const char* bytes = reinterpret_cast<const char*>(&meshData.Vertices[meshData.Indices[t + c]]);
+					corner[c].assign(bytes, sizeof(GeometryGenerator::Vertex));
+				}
+
+				int first = 0;
+				for (int c = 1; c < 3; ++c)
+				{
+					if (corner[c] < corner[first])
+						first = c;
+				}
+				result.push_back(corner[first] + corner[(first + 1) % 3] + corner[(first + 2) % 3]);
+			}
+			std::sort(result.begin(), result.end());
+			return result;
+		};
+
+		return triangles(a) == triangles(b);
+	}
+
+	// Meshes for the mesh benchmarks: the skull, when it can be found, and generated
+	// meshes of a few kinds.
+	struct MeshCase
+	{
+		std::string Name;
+		GeometryGenerator::MeshData Mesh;
+	};
+
+	std::vector<MeshCase> MeshCases()
+	{
+		std::vector<MeshCase> cases;
+		GeometryGenerator geoGen;
+
+		MeshCase skull;
+		skull.Name = "skull";
+		if (LoadSkull(skull.Mesh))
+			cases.push_back(skull);
+		else
+			printf("Models/skull.txt not found, skipping the skull\n");
+
+		MeshCase grid;
+		grid.Name = "grid 256^2";
+		geoGen.CreateGrid(100.0f, 100.0f, 256, 256, grid.Mesh);
+		cases.push_back(grid);
+
+		MeshCase sphere;
+		sphere.Name = "sphere 128x64";
+		geoGen.CreateSphere(1.0f, 128, 64, sphere.Mesh);
+		cases.push_back(sphere);
+
+		MeshCase geosphere;
+		geosphere.Name = "geosphere 5";
+		geoGen.CreateGeosphere(1.0f, 5, geosphere.Mesh);
+		cases.push_back(geosphere);
+
+		MeshCase cylinder;
+		cylinder.Name = "cylinder 64^2";
+		geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 64, 64, cylinder.Mesh);
+		cases.push_back(cylinder);
+
+		return cases;
+	}
+}
+
+void BenchmarkMeshOptimize()
+{
+	std::vector<MeshCase> cases = MeshCases();
+
+	printf("ACMR and ATVR on a %u entry FIFO cache, overdraw from six axis views; in the\n"
+		"order the mesh came in, after the vertex cache pass and after all three passes\n",
+		MeshOptimizer::DefaultCacheSize);
+	printf("%14s %9s %20s %20s %20s %9s %9s\n", "mesh", "tris", "ACMR in/cache/all", "ATVR in/cache/all",
+		"overdraw in/cache/all", "cache ms", "all ms");
+
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		const GeometryGenerator::MeshData& input = cases[c].Mesh;
+		UINT vertexCount = static_cast<UINT>(input.Vertices.size());
+		UINT indexCount = static_cast<UINT>(input.Indices.size());
+
+		GeometryGenerator::MeshData cacheOnly = input;
+		Stopwatch timer;
+		MeshOptimizer::OptimizeVertexCache(&cacheOnly.Indices[0], indexCount, vertexCount);
+		double cacheMs = timer.ElapsedMs();
+
+		GeometryGenerator::MeshData optimized = input;
+		timer.Restart();
+		MeshOptimizer::Optimize(optimized);
+		double allMs = timer.ElapsedMs();
+
+		MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&input.Indices[0], indexCount, vertexCount);
+		MeshOptimizer::VertexCacheStats middle = MeshOptimizer::AnalyzeVertexCache(&cacheOnly.Indices[0], indexCount, vertexCount);
+		MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&optimized.Indices[0], indexCount,
+			static_cast<UINT>(optimized.Vertices.size()));
+
+		printf("%14s %9u %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f %9.2f %9.2f%s\n",
+			cases[c].Name.c_str(), indexCount / 3,
+			before.Acmr, middle.Acmr, after.Acmr,
+			before.Atvr, middle.Atvr, after.Atvr,
+			EstimateOverdraw(input), EstimateOverdraw(cacheOnly), EstimateOverdraw(optimized),
+			cacheMs, allMs, SameTriangles(input, optimized) ? "" : "  triangles differ");
+	}
+}
+
+void BenchmarkMeshMeshlets()
+{
+	std::vector<MeshCase> cases = MeshCases();
+
+	// Views on two orbits around the mesh, one that sees all of it and one close
+	// enough that some of it is off screen.
+	const UINT viewCount = 24;
+	const float orbits[2] = { 3.0f, 1.3f };
+
+	printf("Meshlets of at most %u vertices and %u triangles, after MeshOptimizer; triangles\n"
+		"culled from %u views at %.1f and at %.1f times the bounding radius, by meshlet and by\n"
+		"triangle\n", MeshletBuilder::MaxVertices, MeshletBuilder::MaxTriangles, viewCount, orbits[0], orbits[1]);
+	printf("%14s %8s %8s %8s %8s %9s %15s %15s %8s %8s %7s\n", "mesh", "tris", "meshlets", "verts", "tris",
+		"build ms", "far culled", "near culled", "cull us", "ranges", "missed");
+
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		GeometryGenerator::MeshData mesh = cases[c].Mesh;
+		MeshOptimizer::Optimize(mesh);
+		GeometryGenerator::MeshData optimized = mesh;
+
+		std::vector<MeshletBuilder::Meshlet> meshlets;
+		Stopwatch timer;
+		MeshletBuilder::Build(mesh, meshlets);
+		double buildMs = timer.ElapsedMs();
+
+		UINT triangleCount = static_cast<UINT>(mesh.Indices.size() / 3);
+		double meshletVertices = 0.0;
+		for (size_t m = 0; m < meshlets.size(); ++m)
+			meshletVertices += meshlets[m].VertexCount;
+
+		XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+		XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+		for (size_t v = 0; v < mesh.Vertices.size(); ++v)
+		{
+			lo = XMVectorMin(lo, XMLoadFloat3(&mesh.Vertices[v].Position));
+			hi = XMVectorMax(hi, XMLoadFloat3(&mesh.Vertices[v].Position));
+		}
+		XMVECTOR center = 0.5f*(lo + hi);
+		float radius = 0.5f*XMVectorGetX(XMVector3Length(hi - lo));
+
+		std::vector<MeshletBuilder::DrawRange> ranges;
+		std::vector<bool> drawn(triangleCount);
+		double culledByMeshlet[2] = { 0.0, 0.0 };
+		double culledByTriangle[2] = { 0.0, 0.0 };
+		double cullUs = 0.0;
+		double rangeCount = 0.0;
+		UINT missed = 0;
+
+		for (UINT orbit = 0; orbit < 2; ++orbit)
+		{
+			for (UINT view = 0; view < viewCount; ++view)
+			{
+				float theta = XM_2PI*view / viewCount;
+				float phi = (view % 2 == 0) ? 0.35f*XM_PI : 0.65f*XM_PI;
+				XMVECTOR offset = XMVectorSet(sinf(phi)*cosf(theta), cosf(phi), sinf(phi)*sinf(theta), 0.0f);
+				XMVECTOR eye = center + orbits[orbit]*radius*offset;
+
+				XMMATRIX viewMatrix = XMMatrixLookAtLH(eye, center, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+				XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 1.0f, 0.01f*radius, 10.0f*radius);
+				XMFLOAT4X4 viewProj;
+				XMStoreFloat4x4(&viewProj, viewMatrix*proj);
+				XMFLOAT3 eyePos;
+				XMStoreFloat3(&eyePos, eye);
+
+				timer.Restart();
+				MeshletBuilder::Cull(meshlets, viewProj, eyePos, ranges);
+				cullUs += 1000.0*timer.ElapsedMs();
+				rangeCount += ranges.size();
+
+				std::fill(drawn.begin(), drawn.end(), false);
+				for (size_t r = 0; r < ranges.size(); ++r)
+				{
+					for (UINT t = ranges[r].FirstIndex / 3; t < (ranges[r].FirstIndex + ranges[r].IndexCount) / 3; ++t)
+						drawn[t] = true;
+				}
+
+				// The same tests per triangle: back facing, or all corners outside one
+				// clip plane.
+				XMMATRIX columns = XMMatrixTranspose(XMLoadFloat4x4(&viewProj));
+				XMVECTOR planes[6] =
+				{
+					columns.r[3] + columns.r[0], columns.r[3] - columns.r[0],
+					columns.r[3] + columns.r[1], columns.r[3] - columns.r[1],
+					columns.r[2], columns.r[3] - columns.r[2],
+				};
+
+				for (UINT t = 0; t < triangleCount; ++t)
+				{
+					XMVECTOR p[3];
+					for (UINT k = 0; k < 3; ++k)
+						p[k] = XMLoadFloat3(&mesh.Vertices[mesh.Indices[t * 3 + k]].Position);
+
+					XMVECTOR normal = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+					bool culled = XMVectorGetX(XMVector3Dot(normal, p[0] - eye)) >= 0.0f;
+					for (UINT k = 0; k < 6 && !culled; ++k)
+					{
+						culled = XMVectorGetX(XMPlaneDotCoord(planes[k], p[0])) < 0.0f &&
+							XMVectorGetX(XMPlaneDotCoord(planes[k], p[1])) < 0.0f &&
+							XMVectorGetX(XMPlaneDotCoord(planes[k], p[2])) < 0.0f;
+					}
+
+					culledByMeshlet[orbit] += drawn[t] ? 0.0 : 1.0;
+					culledByTriangle[orbit] += culled ? 1.0 : 0.0;
+					missed += (!culled && !drawn[t]) ? 1 : 0;
+				}
+			}
+		}
+
+		double testedTriangles = double(triangleCount)*viewCount;
+		printf("%14s %8u %8u %8.1f %8.1f %9.2f %6.1f%% %6.1f%% %6.1f%% %6.1f%% %8.1f %8.1f %7u%s\n",
+			cases[c].Name.c_str(), triangleCount, static_cast<UINT>(meshlets.size()),
+			meshletVertices / meshlets.size(), double(triangleCount) / meshlets.size(), buildMs,
+			100.0*culledByMeshlet[0] / testedTriangles, 100.0*culledByTriangle[0] / testedTriangles,
+			100.0*culledByMeshlet[1] / testedTriangles, 100.0*culledByTriangle[1] / testedTriangles,
+			cullUs / (2 * viewCount), rangeCount / (2 * viewCount), missed,
+			SameTriangles(optimized, mesh) ? "" : "  triangles differ");
+	}
+}
+
+void BenchmarkMeshSimplify()
+{
+	std::vector<MeshCase> cases = MeshCases();
+
+	// A larger sphere to give the pool something to split.
+	GeometryGenerator geoGen;
+	MeshCase bigSphere;
+	bigSphere.Name = "sphere 512x256";
+	geoGen.CreateSphere(1.0f, 512, 256, bigSphere.Mesh);
+	cases.push_back(bigSphere);
+
+	const float ratios[] = { 0.5f, 0.25f, 0.1f };
+	const UINT ratioCount = sizeof(ratios) / sizeof(ratios[0]);
+
+	ThreadPool pool;
+	MeshSimplifier serial;
+	MeshSimplifier parallel;
+	parallel.SetThreadPool(&pool);
+
+	printf("Simplified from the full mesh on one thread and on %u threads; error as a fraction\n"
+		"of the mesh size, speed in input triangles per second\n", pool.ThreadCount());
+	printf("%16s %6s %9s %9s %10s %10s %9s %10s %10s\n", "mesh", "ratio", "tris", "error", "ms", "Mtris/s",
+		"pool tris", "pool error", "pool ms");
+
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		const GeometryGenerator::MeshData& mesh = cases[c].Mesh;
+		UINT vertexCount = static_cast<UINT>(mesh.Vertices.size());
+		UINT indexCount = static_cast<UINT>(mesh.Indices.size());
+		std::vector<UINT> result(indexCount);
+		std::vector<UINT> poolResult(indexCount);
+
+		for (UINT r = 0; r < ratioCount; ++r)
+		{
+			UINT target = static_cast<UINT>(ratios[r] * (indexCount / 3)) * 3;
+
+			float error = 0.0f;
+			Stopwatch timer;
+			UINT count = serial.Simplify(&result[0], &mesh.Indices[0], indexCount, &mesh.Vertices[0], vertexCount,
+				sizeof(GeometryGenerator::Vertex), offsetof(GeometryGenerator::Vertex, Position), target, FLT_MAX, &error);
+			double ms = timer.ElapsedMs();
+
+			float poolError = 0.0f;
+			timer.Restart();
+			UINT poolCount = parallel.Simplify(&poolResult[0], &mesh.Indices[0], indexCount, &mesh.Vertices[0], vertexCount,
+				sizeof(GeometryGenerator::Vertex), offsetof(GeometryGenerator::Vertex, Position), target, FLT_MAX, &poolError);
+			double poolMs = timer.ElapsedMs();
+
+			// Every triangle left must use three different positions.
+			bool valid = true;
+			for (UINT i = 0; i + 2 < count; i += 3)
+			{
+				const XMFLOAT3& p0 = mesh.Vertices[result[i]].Position;
+				const XMFLOAT3& p1 = mesh.Vertices[result[i + 1]].Position;
+				const XMFLOAT3& p2 = mesh.Vertices[result[i + 2]].Position;
+				valid = valid && memcmp(&p0, &p1, sizeof(p0)) != 0 && memcmp(&p1, &p2, sizeof(p1)) != 0 &&
+					memcmp(&p2, &p0, sizeof(p2)) != 0;
+			}
+
+			printf("%16s %6.2f %9u %9.5f %10.2f %10.2f %9u %10.5f %10.2f%s\n", cases[c].Name.c_str(), ratios[r],
+				count / 3, error, ms, indexCount / 3 / ms / 1000.0, poolCount / 3, poolError, poolMs,
+				valid ? "" : "  degenerate triangles");
+		}
+	}
+
+	// A chain of levels, each from the one before, on the first mesh.
+	GeometryGenerator::MeshData chainMesh = cases[0].Mesh;
+	const float chainRatios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+	std::vector<MeshSimplifier::Lod> lods;
+	Stopwatch timer;
+	serial.BuildLodChain(chainMesh, chainRatios, sizeof(chainRatios) / sizeof(chainRatios[0]), lods);
+	double chainMs = timer.ElapsedMs();
+
+	printf("\nLOD chain of %s in %.2f ms:", cases[0].Name.c_str(), chainMs);
+	for (size_t i = 0; i < lods.size(); ++i)
+		printf(" %u (%.4f)", lods[i].IndexCount / 3, lods[i].Error);
+	printf("\n");
+}
+
+void BenchmarkMeshProgressive()
+{
+	std::vector<MeshCase> cases = MeshCases();
+
+	// Splits applied per frame while refining, and the packets the stream arrives in.
+	const UINT splitsPerFrame = 1000;
+	const UINT packetSize = 16 * 1024;
+
+	MeshSimplifier simplifier;
+
+	printf("Progressive meshes refined %u splits a frame; stream and base sizes in KB, and the\n"
+		"parent steps the vertex shader takes per index, on average over the frames and at most\n", splitsPerFrame);
+	printf("%16s %9s %9s %9s %10s %9s %9s %9s %9s %10s %9s %9s\n", "mesh", "tris", "base tris", "splits", "build ms",
+		"plain KB", "stream KB", "base KB", "packets", "ns/split", "steps", "max steps");
+
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		const GeometryGenerator::MeshData& mesh = cases[c].Mesh;
+
+		Stopwatch timer;
+		ProgressiveMesh built;
+		simplifier.BuildProgressiveMesh(mesh, 0, built);
+		double buildMs = timer.ElapsedMs();
+
+		std::vector<BYTE> stream;
+		built.Write(stream);
+
+		// Take the stream in packet by packet, as it would come off a disk or network,
+		// noting the size of the base.
+		ProgressiveMesh pm;
+		bool valid = true;
+		UINT packets = 0;
+		size_t baseBytes = 0;
+		for (size_t offset = 0; offset < stream.size(); offset += packetSize)
+		{
+			UINT size = static_cast<UINT>(MathHelper::Min<size_t>(packetSize, stream.size() - offset));
+			valid = valid && pm.Read(&stream[offset], size);
+			++packets;
+
+			if (baseBytes == 0 && pm.HasBase())
+				baseBytes = offset + size;
+		}
+		valid = valid && pm.IsComplete();
+
+		std::vector<UINT> baseIndices;
+		pm.ResolveIndices(baseIndices);
+
+		// Refine frame by frame; nothing but the vertex count changes.
+		timer.Restart();
+		for (UINT applied = 0; applied < pm.SplitCount();)
+		{
+			applied = MathHelper::Min(applied + splitsPerFrame, pm.SplitCount());
+			pm.SetAppliedSplitCount(applied);
+		}
+		double refineMs = timer.ElapsedMs();
+
+		// The walk each drawn index takes down the parents, at each of those frames.
+		UINT64 steps = 0;
+		UINT64 walks = 0;
+		UINT maxSteps = 0;
+		for (UINT applied = 0; applied < pm.SplitCount();)
+		{
+			applied = MathHelper::Min(applied + splitsPerFrame, pm.SplitCount());
+			pm.SetAppliedSplitCount(applied);
+			for (UINT i = 0; i < pm.IndexCount(); ++i)
+			{
+				UINT walk = 0;
+				for (UINT v = pm.Indices()[i]; v >= pm.VertexCount(); v = pm.Parents()[v])
+					++walk;
+				steps += walk;
+				maxSteps = MathHelper::Max(maxSteps, walk);
+			}
+			walks += pm.IndexCount();
+		}
+
+		// Fully refined, it must draw every triangle of the mesh that has an area.
+		GeometryGenerator::MeshData full;
+		full.Vertices.assign(reinterpret_cast<const GeometryGenerator::Vertex*>(pm.Vertices()),
+			reinterpret_cast<const GeometryGenerator::Vertex*>(pm.Vertices()) + pm.VertexCount());
+		pm.ResolveIndices(full.Indices);
+
+		GeometryGenerator::MeshData original;
+		original.Vertices = mesh.Vertices;
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+		{
+			const XMFLOAT3& p0 = mesh.Vertices[mesh.Indices[i]].Position;
+			const XMFLOAT3& p1 = mesh.Vertices[mesh.Indices[i + 1]].Position;
+			const XMFLOAT3& p2 = mesh.Vertices[mesh.Indices[i + 2]].Position;
+			if (memcmp(&p0, &p1, sizeof(p0)) != 0 && memcmp(&p1, &p2, sizeof(p1)) != 0 && memcmp(&p2, &p0, sizeof(p2)) != 0)
+				original.Indices.insert(original.Indices.end(), &mesh.Indices[i], &mesh.Indices[i] + 3);
+		}
+		valid = valid && pm.VertexCount() == pm.FullVertexCount() && SameTriangles(full, original);
+
+		// And coarsened all the way, it must be back to its base.
+		std::vector<UINT> coarsened;
+		pm.SetAppliedSplitCount(0);
+		pm.ResolveIndices(coarsened);
+		valid = valid && coarsened == baseIndices;
+
+		size_t plainBytes = mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex) + mesh.Indices.size()*sizeof(UINT);
+		printf("%16s %9u %9u %9u %10.2f %9.1f %9.1f %9.1f %9u %10.1f %9.2f %9u%s\n", cases[c].Name.c_str(),
+			static_cast<UINT>(mesh.Indices.size() / 3), static_cast<UINT>(baseIndices.size() / 3), pm.SplitCount(), buildMs,
+			plainBytes / 1024.0, stream.size() / 1024.0, baseBytes / 1024.0, packets,
+			pm.SplitCount() > 0 ? refineMs * 1e6 / pm.SplitCount() : 0.0, walks > 0 ? double(steps) / walks : 0.0,
+			maxSteps,
+			valid ? "" : "  mismatch");
+	}
+}
+
+void BenchmarkMeshWeld()
+{
+	struct WeldCase
+	{
+		std::string Name;
+		GeometryGenerator::MeshData Mesh;
+		MeshWelder::Tolerance Tolerance;
+
+		// Vertices the weld should leave, or 0 when not known up front.
+		UINT Expected;
+	};
+
+	std::vector<WeldCase> cases;
+	GeometryGenerator geoGen;
+
+	WeldCase skull;
+	skull.Name = "skull";
+	skull.Expected = 0;
+	if (LoadSkull(skull.Mesh))
+	{
+		cases.push_back(skull);
+
+		// The skull demo draws positions only, so normals may differ.
+		skull.Name = "skull, any normal";
+		skull.Tolerance.Normal = 2.0f;
+		cases.push_back(skull);
+	}
+	else
+	{
+		printf("Models/skull.txt not found, skipping the skull\n");
+	}
+
+	// The seam of the sphere has its vertices twice, with different texture coordinates,
+	// and must stay that way.
+	WeldCase sphere;
+	sphere.Name = "sphere 128x64";
+	geoGen.CreateSphere(1.0f, 128, 64, sphere.Mesh);
+	sphere.Expected = static_cast<UINT>(sphere.Mesh.Vertices.size());
+	cases.push_back(sphere);
+
+	// A grid as a triangle soup, every corner its own vertex and a little off, which
+	// should weld back into the grid.
+	WeldCase soup;
+	soup.Name = "grid soup 600^2";
+	GeometryGenerator::MeshData grid;
+	geoGen.CreateGrid(100.0f, 100.0f, 600, 600, grid);
+	soup.Expected = static_cast<UINT>(grid.Vertices.size());
+	soup.Tolerance = MeshWelder::Tolerance(1e-3f, 1e-3f, 1e-3f);
+	soup.Mesh.Vertices.resize(grid.Indices.size());
+	soup.Mesh.Indices.resize(grid.Indices.size());
+	for (size_t i = 0; i < grid.Indices.size(); ++i)
+	{
+		GeometryGenerator::Vertex v = grid.Vertices[grid.Indices[i]];
+		v.Position.x += MathHelper::RandF(-5e-5f, 5e-5f);
+		v.Position.y += MathHelper::RandF(-5e-5f, 5e-5f);
+		v.Position.z += MathHelper::RandF(-5e-5f, 5e-5f);
+		v.Normal.x += MathHelper::RandF(-5e-5f, 5e-5f);
+		v.TexC.x += MathHelper::RandF(-5e-5f, 5e-5f);
+
+		soup.Mesh.Vertices[i] = v;
+		soup.Mesh.Indices[i] = static_cast<UINT>(i);
+	}
+	cases.push_back(soup);
+
+	ThreadPool pool;
+	MeshWelder serial;
+	MeshWelder parallel;
+	parallel.SetThreadPool(&pool);
+
+	printf("Welded on one thread and on %u threads\n", pool.ThreadCount());
+	printf("%20s %10s %10s %8s %10s %10s %10s %10s\n", "mesh", "vertices", "welded", "removed", "KB saved", "ms",
+		"pool ms", "Mverts/s");
+
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		GeometryGenerator::MeshData mesh = cases[c].Mesh;
+		GeometryGenerator::MeshData poolMesh = cases[c].Mesh;
+
+		Stopwatch timer;
+		MeshWelder::WeldStats stats = serial.Weld(mesh, cases[c].Tolerance);
+		double ms = timer.ElapsedMs();
+
+		timer.Restart();
+		MeshWelder::WeldStats poolStats = parallel.Weld(poolMesh, cases[c].Tolerance);
+		double poolMs = timer.ElapsedMs();
+
+		// Both must come out the same, vertex for vertex.
+		bool valid = poolStats.VertexCountAfter == stats.VertexCountAfter && poolMesh.Indices == mesh.Indices &&
+			memcmp(&poolMesh.Vertices[0], &mesh.Vertices[0], mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex)) == 0;
+		valid = valid && (cases[c].Expected == 0 || stats.VertexCountAfter == cases[c].Expected);
+
+		printf("%20s %10u %10u %8u %10.1f %10.2f %10.2f %10.2f%s\n", cases[c].Name.c_str(), stats.VertexCountBefore,
+			stats.VertexCountAfter, stats.TrianglesRemoved, stats.BytesSaved / 1024.0, ms, poolMs,
+			stats.VertexCountBefore / poolMs / 1000.0, valid ? "" : "  mismatch");
+	}
+}
+
+void BenchmarkMeshTangents()
+{
+	std::vector<MeshCase> cases = MeshCases();
+
+	GeometryGenerator geoGen;
+	MeshCase bigSphere;
+	bigSphere.Name = "sphere 512x256";
+	geoGen.CreateSphere(1.0f, 512, 256, bigSphere.Mesh);
+	cases.push_back(bigSphere);
+
+	ThreadPool pool;
+	TangentGenerator serial;
+	TangentGenerator parallel;
+	parallel.SetThreadPool(&pool);
+
+	printf("Normals and tangents regenerated on one thread and on %u threads, against the ones\n"
+		"the mesh came with; mean and largest angle off in degrees\n", pool.ThreadCount());
+	printf("%16s %9s %8s %8s %8s %8s %7s %10s %10s\n", "mesh", "vertices", "normal", "max", "tangent", "max",
+		"splits", "ms", "pool ms");
+
+	for (size_t c = 0; c < cases.size(); ++c)
+	{
+		const GeometryGenerator::MeshData& original = cases[c].Mesh;
+		GeometryGenerator::MeshData mesh = original;
+		GeometryGenerator::MeshData poolMesh = original;
+		std::vector<float> signs;
+		std::vector<float> poolSigns;
+
+		Stopwatch timer;
+		serial.GenerateNormals(mesh);
+		serial.GenerateTangents(mesh, &signs);
+		double ms = timer.ElapsedMs();
+
+		timer.Restart();
+		parallel.GenerateNormals(poolMesh);
+		parallel.GenerateTangents(poolMesh, &poolSigns);
+		double poolMs = timer.ElapsedMs();
+
+		// The same bits whichever way the work was split.
+		bool valid = poolMesh.Vertices.size() == mesh.Vertices.size() && poolMesh.Indices == mesh.Indices &&
+			poolSigns == signs && memcmp(&poolMesh.Vertices[0], &mesh.Vertices[0],
+			mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex)) == 0;
+
+		// Only meshes with texture coordinates have tangents to compare with.  The poles of
+		// the spheres have arbitrary tangents and the geosphere's triangles across its seam
+		// wrap around in u, so the largest errors there are expected.
+		bool textured = false;
+		for (size_t i = 0; i < original.Vertices.size() && !textured; ++i)
+			textured = original.Vertices[i].TexC.x != 0.0f || original.Vertices[i].TexC.y != 0.0f;
+
+		double normalSum = 0.0;
+		double tangentSum = 0.0;
+		float normalMax = 0.0f;
+		float tangentMax = 0.0f;
+		UINT vertexCount = static_cast<UINT>(original.Vertices.size());
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			XMVECTOR n0 = XMVector3Normalize(XMLoadFloat3(&original.Vertices[v].Normal));
+			XMVECTOR n1 = XMLoadFloat3(&mesh.Vertices[v].Normal);
+			float normalAngle = XMConvertToDegrees(acosf(MathHelper::Clamp(XMVectorGetX(XMVector3Dot(n0, n1)), -1.0f, 1.0f)));
+			normalSum += normalAngle;
+			normalMax = MathHelper::Max(normalMax, normalAngle);
+
+			XMVECTOR t0 = XMVector3Normalize(XMLoadFloat3(&original.Vertices[v].TangentU));
+			XMVECTOR t1 = XMLoadFloat3(&mesh.Vertices[v].TangentU);
+			float tangentAngle = XMConvertToDegrees(acosf(MathHelper::Clamp(XMVectorGetX(XMVector3Dot(t0, t1)), -1.0f, 1.0f)));
+			tangentSum += tangentAngle;
+			tangentMax = MathHelper::Max(tangentMax, tangentAngle);
+		}
+
+		printf("%16s %9u %8.3f %8.2f ", cases[c].Name.c_str(), vertexCount, normalSum / vertexCount, normalMax);
+		if (textured)
+			printf("%8.3f %8.2f ", tangentSum / vertexCount, tangentMax);
+		else
+			printf("%8s %8s ", "-", "-");
+		printf("%7u %10.2f %10.2f%s\n", static_cast<UINT>(mesh.Vertices.size()) - vertexCount, ms, poolMs,
+			valid ? "" : "  mismatch");
+	}
+}
@@ -0,0 +1,212 @@
+//***************************************************************************************
+// OceanBenchmark.cpp
+//***************************************************************************************
+
+#include "Benchmarks.h"
+
+#include <OceanFFT.h>
+#include <ThreadPool.h>
+#include <Vertex.h>
+#include <WaveOcean.h>
+#include <Waves.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+void BenchmarkOceanFFT()
+{
+	const UINT sizes[] = { 128, 256, 512, 1024 };
+	const UINT updateCount = 20;
+
+	ThreadPool pool;
+
+	printf("kernels: %s, threads: %u\n", SelectWaveKernels().Name, pool.ThreadCount());
+	printf("%8s %8s %12s %12s\n", "grid", "threads", "waves ms", "ocean ms");
+
+	for (UINT s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		UINT size = sizes[s];
+
+		for (UINT t = 0; t < 2; ++t)
+		{
+			ThreadPool* threads = (t == 0) ? nullptr : &pool;
+
+			// Both grids have size + 1 points a side; Waves takes one step per update.
+			Waves waves;
+			waves.Init(size + 1, size + 1, 1.0f, 0.03f, 5.0f, 0.3f);
+			waves.SetThreadPool(threads);
+			for (UINT k = 0; k < 64; ++k)
+				waves.Disturb(5 + (k * 97) % (size - 10), 5 + (k * 61) % (size - 10), 1.0f);
+
+			Stopwatch timer;
+			for (UINT i = 0; i < updateCount; ++i)
+				waves.Update(0.03f);
+			double wavesMs = timer.ElapsedMs() / updateCount;
+
+			OceanDesc desc;
+			desc.Size = size;
+			desc.PatchSize = 1000.0f;
+			desc.WindSpeed = 15.0f;
+			desc.WindDirection = XMFLOAT2(1.0f, 0.5f);
+			desc.Fetch = 100000.0f;
+			desc.Amplitude = 1.0f;
+			desc.Choppiness = 1.0f;
+			desc.Spectrum = OceanSpectrumPhillips;
+			desc.Seed = 1;
+
+			OceanFFT ocean;
+			ocean.SetThreadPool(threads);
+			ocean.Init(desc);
+
+			timer.Restart();
+			for (UINT i = 0; i < updateCount; ++i)
+				ocean.Update(0.03f);
+			double oceanMs = timer.ElapsedMs() / updateCount;
+
+			printf("%8u %8u %12.3f %12.3f\n", size + 1, threads ? threads->ThreadCount() : 1, wavesMs, oceanMs);
+		}
+	}
+}
+
+void BenchmarkOceanTiles()
+{
+	const UINT stepCount = 20;
+
+	WaveOceanDesc desc;
+	desc.TileCountX = 16;
+	desc.TileCountZ = 16;
+	desc.TileSize = 64.0f;
+	desc.TileCells = 128;
+	desc.LevelCount = 4;
+	desc.LevelDistance = 64.0f;
+	desc.FreezeDistance = 384.0f;
+	desc.TimeStep = 0.03f;
+	desc.Speed = 5.0f;
+	desc.Damping = 0.3f;
+
+	ThreadPool pool;
+
+	printf("kernels: %s, threads: %u\n", SelectWaveKernels().Name, pool.ThreadCount());
+	printf("%u x %u tiles of %.0f m, %u cells at level 0\n", desc.TileCountX, desc.TileCountZ,
+		desc.TileSize, desc.TileCells);
+
+	WaveOcean ocean;
+	ocean.SetThreadPool(&pool);
+	ocean.Init(desc);
+
+	// Camera over the middle of the north-west quarter.
+	XMFLOAT3 eyePos(-256.0f, 20.0f, 256.0f);
+	ocean.Update(0.0f, eyePos);
+	for (UINT k = 0; k < 64; ++k)
+	{
+		float x = eyePos.x + static_cast<float>((k * 97) % 256) - 128.0f;
+		float z = eyePos.z + static_cast<float>((k * 61) % 256) - 128.0f;
+		ocean.Disturb(x, z, 0.5f, 2.0f, WaveFootprintGaussian);
+	}
+
+	UINT levelTiles[8] = { 0 };
+	UINT frozenTiles = 0;
+	for (UINT t = 0; t < ocean.TileCount(); ++t)
+	{
+		++levelTiles[ocean.TileLevel(t)];
+		frozenTiles += ocean.IsTileFrozen(t) ? 1 : 0;
+	}
+
+	printf("%8s %8s\n", "level", "tiles");
+	for (UINT l = 0; l < desc.LevelCount; ++l)
+		printf("%8u %8u\n", l, levelTiles[l]);
+	printf("%8s %8u\n", "frozen", frozenTiles);
+
+	// Every tile's triangles must cover it exactly once, and every vertex on a shared
+	// edge must match the vertex of the other tile at the same spot.
+	double area = 0.0;
+	UINT flipped = 0;
+	UINT seamMismatches = 0;
+	std::vector<UINT> indices;
+	std::vector<std::vector<Vertex::WaveGrid>> grids(ocean.TileCount());
+	std::vector<std::vector<Vertex::WaveCompact>> vertices(ocean.TileCount());
+	for (UINT t = 0; t < ocean.TileCount(); ++t)
+	{
+		grids[t].resize(ocean.TileVertexCount(t));
+		vertices[t].resize(ocean.TileVertexCount(t));
+		ocean.EmitTileGridVertices(t, &grids[t][0]);
+
+		ocean.GetTileIndices(ocean.TileLevel(t), ocean.TileStitchMask(t), indices);
+		for (size_t k = 0; k < indices.size(); k += 3)
+		{
+			XMFLOAT2 a = grids[t][indices[k]].PosXZ;
+			XMFLOAT2 b = grids[t][indices[k + 1]].PosXZ;
+			XMFLOAT2 c = grids[t][indices[k + 2]].PosXZ;
+
+			// Clockwise seen from above, like the rest of the demo's grids.
+			double cross = (double)(b.x - a.x) * (c.y - a.y) - (double)(b.y - a.y) * (c.x - a.x);
+			area -= 0.5 * cross;
+			flipped += cross > 0.0 ? 1 : 0;
+		}
+	}
+
+	for (UINT step = 0; step < 10; ++step)
+		ocean.Update(desc.TimeStep, eyePos);
+
+	for (UINT t = 0; t < ocean.TileCount(); ++t)
+		ocean.EmitTileVertices(t, &vertices[t][0]);
+
+	for (UINT t = 0; t < ocean.TileCount(); ++t)
+	{
+		// Compare the east and south edges with the tiles there.
+		UINT tx = t % desc.TileCountX;
+		UINT tz = t / desc.TileCountX;
+		UINT n = static_cast<UINT>(sqrt(static_cast<double>(grids[t].size())) + 0.5);
+		for (UINT side = 0; side < 2; ++side)
+		{
+			if ((side == 0 && tx + 1 == desc.TileCountX) || (side == 1 && tz + 1 == desc.TileCountZ))
+				continue;
+
+			UINT nb = side == 0 ? t + 1 : t + desc.TileCountX;
+			UINT nbN = static_cast<UINT>(sqrt(static_cast<double>(grids[nb].size())) + 0.5);
+			for (UINT p = 0; p < n; ++p)
+			{
+				UINT k = side == 0 ? p * n + n - 1 : (n - 1) * n + p;
+				for (UINT q = 0; q < nbN; ++q)
+				{
+					UINT nbK = side == 0 ? q * nbN : q;
+					if (grids[t][k].PosXZ.x == grids[nb][nbK].PosXZ.x && grids[t][k].PosXZ.y == grids[nb][nbK].PosXZ.y &&
+						memcmp(&vertices[t][k], &vertices[nb][nbK], sizeof(Vertex::WaveCompact)) != 0)
+					{
+						++seamMismatches;
+					}
+				}
+			}
+		}
+	}
+
+	double oceanArea = (double)desc.TileCountX * desc.TileCountZ * desc.TileSize * desc.TileSize;
+	printf("covered area: %.6f of the ocean, flipped triangles: %u, seam mismatches: %u\n",
+		area / oceanArea, flipped, seamMismatches);
+
+	// The same ocean as a single grid at the finest resolution.
+	UINT size = desc.TileCountX * desc.TileCells + 1;
+	Waves waves;
+	waves.SetThreadPool(&pool);
+	waves.Init(size, size, desc.TileSize / desc.TileCells, desc.TimeStep, desc.Speed, desc.Damping);
+	for (UINT k = 0; k < 64; ++k)
+		waves.Disturb(5 + (k * 97) % (size - 10), 5 + (k * 61) % (size - 10), 0.5f);
+
+	Stopwatch timer;
+	for (UINT i = 0; i < stepCount; ++i)
+		ocean.Update(desc.TimeStep, eyePos);
+	double oceanMs = timer.ElapsedMs() / stepCount;
+
+	timer.Restart();
+	for (UINT i = 0; i < stepCount; ++i)
+		waves.Update(desc.TimeStep);
+	double wavesMs = timer.ElapsedMs() / stepCount;
+
+	printf("%10s %12s %12s %10s\n", "", "allocated", "simulated", "ms/step");
+	printf("%10s %12u %12u %10.3f\n", "tiled", ocean.AllocatedPointCount(), ocean.SimulatedPointCount(), oceanMs);
+	printf("%10s %12u %12u %10.3f\n", "single", waves.VertexCount(), waves.VertexCount(), wavesMs);
+}
@@ -0,0 +1,523 @@
+//***************************************************************************************
+// WavesBenchmark.cpp
+//***************************************************************************************
+
+#include "Benchmarks.h"
+
+#include <ThreadPool.h>
+#include <Vertex.h>
+#include <Waves.h>
+#include <WavesThread.h>
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Average milliseconds per simulation step over stepCount steps.
+	double TimeSteps(Waves& waves, UINT stepCount)
+	{
+		// One step per Update() call.
+		float dt = 0.03f;
+
+		Stopwatch timer;
+		for (UINT i = 0; i < stepCount; ++i)
+			waves.Update(dt);
+
+		return timer.ElapsedMs() / stepCount;
+	}
+
+	void InitBenchmarkWaves(Waves& waves, UINT size)
+	{
+		waves.Init(size, size, 1.0f, 0.03f, 5.0f, 0.3f);
+
+		for (UINT k = 0; k < 64; ++k)
+			waves.Disturb(5 + (k * 97) % (size - 10), 5 + (k * 61) % (size - 10), 1.0f);
+	}
+}
+
+void BenchmarkWavesScaling()
+{
+	const UINT sizes[] = { 512, 2048 };
+	const UINT stepCount = 50;
+
+	UINT maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads == 0)
+		maxThreads = 1;
+
+	printf("kernels: %s\n", SelectWaveKernels().Name);
+	printf("%8s %8s %12s %10s %10s\n", "grid", "threads", "ms/step", "speedup", "identical");
+
+	for (UINT s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		UINT size = sizes[s];
+
+		// Single threaded reference solution to compare every run against.
+		Waves reference;
+		InitBenchmarkWaves(reference, size);
+		double baseMs = TimeSteps(reference, stepCount);
+
+		for (UINT threads = 1; threads <= maxThreads; ++threads)
+		{
+			ThreadPool pool(threads);
+
+			Waves waves;
+			InitBenchmarkWaves(waves, size);
+			waves.SetThreadPool(&pool);
+			double ms = TimeSteps(waves, stepCount);
+
+			bool identical = memcmp(waves.Heights(), reference.Heights(),
+				sizeof(float) * waves.VertexCount()) == 0;
+
+			printf("%8u %8u %12.3f %9.2fx %10s\n", size, threads, ms, baseMs / ms, identical ? "yes" : "NO");
+		}
+	}
+}
+
+void BenchmarkWavesEmit()
+{
+	const UINT sizes[] = { 160, 512, 2048 };
+	const UINT repeatCount = 20;
+
+	printf("kernels: %s\n", SelectWaveKernels().Name);
+	printf("%8s %12s %12s %10s %10s\n", "grid", "loop ms", "emit ms", "speedup", "identical");
+
+	for (UINT s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		UINT size = sizes[s];
+
+		Waves waves;
+		InitBenchmarkWaves(waves, size);
+		TimeSteps(waves, 10);
+
+		std::vector<Vertex::Basic32> loopVertices(waves.VertexCount());
+		std::vector<Vertex::Basic32> emitVertices(waves.VertexCount());
+
+		// The per-vertex copy HillsApp used to do.
+		Stopwatch timer;
+		for (UINT r = 0; r < repeatCount; ++r)
+		{
+			Vertex::Basic32* v = &loopVertices[0];
+			for (UINT i = 0; i < waves.VertexCount(); i++)
+			{
+				v[i].Pos = waves[i];
+				v[i].Normal = waves.Normal(i);
+				v[i].Tex.x = 0.5f + waves[i].x / waves.Width();
+				v[i].Tex.y = 0.5f - waves[i].z / waves.Depth();
+			}
+		}
+		double loopMs = timer.ElapsedMs() / repeatCount;
+
+		timer.Restart();
+		for (UINT r = 0; r < repeatCount; ++r)
+			waves.EmitVertices(&emitVertices[0]);
+		double emitMs = timer.ElapsedMs() / repeatCount;
+
+		bool identical = memcmp(&loopVertices[0], &emitVertices[0],
+			sizeof(Vertex::Basic32) * waves.VertexCount()) == 0;
+
+		printf("%8u %12.3f %12.3f %9.2fx %10s\n", size, loopMs, emitMs, loopMs / emitMs, identical ? "yes" : "NO");
+	}
+}
+
+void BenchmarkWavesSparse()
+{
+	const UINT size = 512;
+	const UINT stepCount = 400;
+
+	// A few waves in one corner of an otherwise calm grid.
+	Waves dense;
+	Waves sparse;
+	dense.Init(size, size, 1.0f, 0.03f, 5.0f, 0.3f);
+	sparse.Init(size, size, 1.0f, 0.03f, 5.0f, 0.3f);
+	sparse.SetActivityTracking(true);
+
+	for (UINT k = 0; k < 4; ++k)
+	{
+		dense.Disturb(40 + 20 * k, 60, 1.0f);
+		sparse.Disturb(40 + 20 * k, 60, 1.0f);
+	}
+
+	printf("%8s %12s %12s %10s %14s %12s\n", "steps", "dense ms", "sparse ms", "speedup", "active tiles", "max diff");
+
+	for (UINT done = 0; done < stepCount; done += 100)
+	{
+		Stopwatch timer;
+		for (UINT s = 0; s < 100; ++s)
+			dense.Step(1);
+		double denseMs = timer.ElapsedMs() / 100;
+
+		timer.Restart();
+		for (UINT s = 0; s < 100; ++s)
+			sparse.Step(1);
+		double sparseMs = timer.ElapsedMs() / 100;
+
+		float maxDiff = 0.0f;
+		for (UINT i = 0; i < dense.VertexCount(); ++i)
+			maxDiff = std::max(maxDiff, fabsf(dense.Heights()[i] - sparse.Heights()[i]));
+
+		printf("%8u %12.3f %12.3f %9.2fx %7u/%-6u %12g\n", done + 100, denseMs, sparseMs, denseMs / sparseMs,
+			sparse.ActiveTileCount(), sparse.TileRowCount() * sparse.TileColumnCount(), maxDiff);
+	}
+}
+
+void BenchmarkWavesImpulses()
+{
+	const UINT size = 512;
+	const UINT impulseCount = 8192;
+	const UINT repeatCount = 10;
+
+	std::vector<WaveImpulse> impulses(impulseCount);
+	for (UINT k = 0; k < impulseCount; ++k)
+	{
+		impulses[k].Row = static_cast<float>(5 + (k * 97) % (size - 10));
+		impulses[k].Col = static_cast<float>(5 + (k * 61) % (size - 10));
+		impulses[k].Magnitude = 0.01f;
+		impulses[k].Radius = 0.0f;
+		impulses[k].Footprint = WaveFootprintPoint5;
+	}
+
+	// The calls are what the threads making the impulses pay; the totals add the step
+	// that applies them.
+	ThreadPool pool;
+	printf("threads: %u; best of %u rounds, each the impulses and one step\n", pool.ThreadCount(), repeatCount);
+	printf("%10s %6s %9s %12s %12s %12s %12s %10s\n", "impulses", "pool", "step ms", "Disturb ms", "total ms",
+		"batch ms", "total ms", "identical");
+
+	for (UINT usePool = 0; usePool < 2; ++usePool)
+	{
+		double stepMs = 1e9;
+		double directCallMs = 1e9;
+		double directMs = 1e9;
+		double batchCallMs = 1e9;
+		double batchMs = 1e9;
+
+		Waves plain;
+		Waves direct;
+		Waves batched;
+		InitBenchmarkWaves(plain, size);
+		InitBenchmarkWaves(direct, size);
+		InitBenchmarkWaves(batched, size);
+		if (usePool)
+		{
+			plain.SetThreadPool(&pool);
+			direct.SetThreadPool(&pool);
+			batched.SetThreadPool(&pool);
+		}
+
+		for (UINT r = 0; r < repeatCount; ++r)
+		{
+			Stopwatch timer;
+			plain.Step(1);
+			stepMs = std::min(stepMs, timer.ElapsedMs());
+
+			timer.Restart();
+			for (UINT k = 0; k < impulseCount; ++k)
+				direct.Disturb(static_cast<UINT>(impulses[k].Row), static_cast<UINT>(impulses[k].Col), impulses[k].Magnitude);
+			directCallMs = std::min(directCallMs, timer.ElapsedMs());
+			direct.Step(1);
+			directMs = std::min(directMs, timer.ElapsedMs());
+
+			timer.Restart();
+			batched.DisturbBatch(&impulses[0], impulseCount);
+			batchCallMs = std::min(batchCallMs, timer.ElapsedMs());
+			batched.Step(1);
+			batchMs = std::min(batchMs, timer.ElapsedMs());
+		}
+
+		// The batch adds the same stencil in the same order as the Disturb() calls.
+		bool identical = memcmp(direct.Heights(), batched.Heights(), sizeof(float) * direct.VertexCount()) == 0;
+
+		printf("%10u %6s %9.3f %12.3f %12.3f %12.3f %12.3f %10s\n", impulseCount, usePool ? "yes" : "no", stepMs,
+			directCallMs, directMs, batchCallMs, batchMs, identical ? "yes" : "NO");
+	}
+}
+
+void BenchmarkWavesCompact()
+{
+	using namespace DirectX::PackedVector;
+
+	const UINT sizes[] = { 160, 512, 2048 };
+	const UINT repeatCount = 20;
+
+	printf("kernels: %s\n", SelectWaveKernels().Name);
+	printf("%8s %12s %12s %12s %12s %12s %12s\n", "grid", "basic ms", "compact ms", "basic MB", "compact MB",
+		"height err", "normal err");
+
+	for (UINT s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		UINT size = sizes[s];
+
+		Waves waves;
+		InitBenchmarkWaves(waves, size);
+		TimeSteps(waves, 10);
+
+		UINT n = waves.ColumnCount();
+		std::vector<Vertex::Basic32> basicVertices(waves.VertexCount());
+		std::vector<Vertex::WaveCompact> compactVertices(waves.VertexCount());
+
+		Stopwatch timer;
+		for (UINT r = 0; r < repeatCount; ++r)
+			waves.EmitVertices(&basicVertices[0]);
+		double basicMs = timer.ElapsedMs() / repeatCount;
+
+		timer.Restart();
+		for (UINT r = 0; r < repeatCount; ++r)
+			waves.EmitCompactVertices(&compactVertices[0], 0, waves.RowCount());
+		double compactMs = timer.ElapsedMs() / repeatCount;
+
+		// Decode the compact stream the way the input assembler does.
+		float heightErr = 0.0f;
+		float normalErr = 0.0f;
+		for (UINT i = 0; i < waves.VertexCount(); ++i)
+		{
+			const Vertex::WaveCompact& c = compactVertices[i];
+			heightErr = std::max(heightErr, fabsf(XMConvertHalfToFloat(c.Height) - basicVertices[i].Pos.y));
+
+			float nx = (c.Normal & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+			float ny = ((c.Normal >> 10) & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+			float nz = ((c.Normal >> 20) & 0x3ff) / 1023.0f * 2.0f - 1.0f;
+			normalErr = std::max(normalErr, fabsf(nx - basicVertices[i].Normal.x));
+			normalErr = std::max(normalErr, fabsf(ny - basicVertices[i].Normal.y));
+			normalErr = std::max(normalErr, fabsf(nz - basicVertices[i].Normal.z));
+		}
+
+		double basicMB = sizeof(Vertex::Basic32) * waves.VertexCount() / (1024.0 * 1024.0);
+		double compactMB = sizeof(Vertex::WaveCompact) * waves.VertexCount() / (1024.0 * 1024.0);
+
+		printf("%8u %12.3f %12.3f %12.2f %12.2f %12g %12g\n", n, basicMs, compactMs, basicMB, compactMB,
+			heightErr, normalErr);
+	}
+}
+
+void BenchmarkWavesImplicit()
+{
+	struct Run
+	{
+		WaveIntegrator Integrator;
+		float TimeStep;
+	};
+
+	// The first run, the explicit scheme at the time step of the demo, is the reference
+	// the others are compared against.  At 0.15 s the explicit scheme is past its
+	// stability limit.
+	const Run runs[] =
+	{
+		{ WaveIntegratorExplicit, 0.03f },
+		{ WaveIntegratorExplicit, 0.12f },
+		{ WaveIntegratorExplicit, 0.15f },
+		{ WaveIntegratorImplicit, 0.03f },
+		{ WaveIntegratorImplicit, 0.15f },
+		{ WaveIntegratorImplicit, 0.30f },
+	};
+
+	const UINT size = 512;
+	const float dx = 1.0f;
+	const float speed = 5.0f;
+	const float damping = 0.3f;
+	const float duration = 3.0f;
+
+	ThreadPool pool;
+
+	printf("kernels: %s, threads: %u, grid: %u, simulated: %.1f s\n", SelectWaveKernels().Name,
+		pool.ThreadCount(), size, duration);
+	printf("%10s %8s %8s %14s %12s\n", "scheme", "dt", "c*dt/dx", "ms/sim second", "rel error");
+
+	std::vector<float> reference;
+
+	for (UINT r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r)
+	{
+		Waves waves;
+		waves.Init(size, size, dx, runs[r].TimeStep, speed, damping);
+		waves.SetIntegrator(runs[r].Integrator);
+		waves.SetThreadPool(&pool);
+
+		// A smooth bump; a single point would be mostly waves shorter than any time
+		// step can follow.  The impulse only raises the current solution, so it starts
+		// the surface moving at magnitude / dt from one step before the first.  Scaling
+		// it with dt gives every run the same initial velocity.
+		WaveImpulse impulse = { 0.5f * size, 0.5f * size, 10.0f * runs[r].TimeStep, 40.0f, WaveFootprintGaussian };
+		waves.DisturbBatch(&impulse, 1);
+
+		UINT stepCount = static_cast<UINT>(duration / runs[r].TimeStep + 0.5f) - 1;
+
+		Stopwatch timer;
+		for (UINT k = 0; k < stepCount; ++k)
+			waves.Step(1);
+		double ms = timer.ElapsedMs() / duration;
+
+		const float* h = waves.Heights();
+		if (reference.empty())
+			reference.assign(h, h + waves.VertexCount());
+
+		double errorSq = 0.0;
+		double referenceSq = 0.0;
+		for (UINT i = 0; i < waves.VertexCount(); ++i)
+		{
+			errorSq += (h[i] - reference[i]) * (h[i] - reference[i]);
+			referenceSq += reference[i] * reference[i];
+		}
+
+		double error = sqrt(errorSq / referenceSq);
+		const char* scheme = runs[r].Integrator == WaveIntegratorImplicit ? "implicit" : "explicit";
+		float courant = speed * runs[r].TimeStep / dx;
+
+		if (error < 1.0)
+			printf("%10s %8.2f %8.2f %14.3f %12.4f\n", scheme, runs[r].TimeStep, courant, ms, error);
+		else
+			printf("%10s %8.2f %8.2f %14.3f %12s\n", scheme, runs[r].TimeStep, courant, ms, "unstable");
+	}
+}
+
+void BenchmarkWavesSample()
+{
+	const UINT size = 512;
+	const UINT probeCounts[] = { 1024, 4096, 16384 };
+	const UINT repeatCount = 20;
+
+	Waves waves;
+	InitBenchmarkWaves(waves, size);
+	TimeSteps(waves, 20);
+
+	printf("kernels: %s, grid: %u\n", SelectWaveKernels().Name, size);
+	printf("%8s %12s %12s %12s %10s\n", "probes", "scalar us", "simd us", "heights us", "identical");
+
+	for (UINT c = 0; c < sizeof(probeCounts) / sizeof(probeCounts[0]); ++c)
+	{
+		UINT count = probeCounts[c];
+
+		// Scattered over the grid and a little beyond it.
+		std::vector<float> x(count);
+		std::vector<float> z(count);
+		for (UINT k = 0; k < count; ++k)
+		{
+			x[k] = (((k * 7919) % 1024) / 1023.0f - 0.5f) * 1.1f * waves.Width();
+			z[k] = (((k * 104729) % 1021) / 1020.0f - 0.5f) * 1.1f * waves.Depth();
+		}
+
+		std::vector<float> out[2][4];
+		double bestMs[3] = { 1e30, 1e30, 1e30 };
+		for (UINT pass = 0; pass < 3; ++pass)
+		{
+			const WaveKernels& kernels = (pass == 0) ? ScalarWaveKernels() : SelectWaveKernels();
+			std::vector<float>* streams = out[std::min(pass, 1u)];
+			for (UINT i = 0; i < 4; ++i)
+				streams[i].resize(count);
+
+			// The last pass samples heights only.
+			WaveProbes probes = { &x[0], &z[0], count, &streams[0][0], nullptr, nullptr, nullptr };
+			if (pass < 2)
+			{
+				probes.NormalX = &streams[1][0];
+				probes.NormalY = &streams[2][0];
+				probes.NormalZ = &streams[3][0];
+			}
+
+			for (UINT r = 0; r < repeatCount; ++r)
+			{
+				Stopwatch timer;
+				kernels.SampleSurface(waves.Surface(), probes);
+				bestMs[pass] = std::min(bestMs[pass], timer.ElapsedMs());
+			}
+		}
+
+		bool identical = true;
+		for (UINT i = 0; i < 4; ++i)
+			identical = identical && memcmp(&out[0][i][0], &out[1][i][0], count * sizeof(float)) == 0;
+
+		printf("%8u %12.2f %12.2f %12.2f %10s\n", count, bestMs[0] * 1000.0, bestMs[1] * 1000.0,
+			bestMs[2] * 1000.0, identical ? "yes" : "NO");
+	}
+}
+
+void BenchmarkWavesAsync()
+{
+	const UINT sizes[] = { 512, 1024 };
+	const UINT frameCount = 60;
+	const double frameMs = 1000.0 / 60.0;
+
+	ThreadPool pool;
+
+	printf("kernels: %s, threads: %u\n", SelectWaveKernels().Name, pool.ThreadCount());
+	printf("%8s %8s %12s %12s %10s\n", "grid", "mode", "mean ms", "max ms", "uploads");
+
+	for (UINT s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		UINT size = sizes[s];
+
+		for (UINT async = 0; async < 2; ++async)
+		{
+			Waves waves;
+			InitBenchmarkWaves(waves, size);
+			waves.SetThreadPool(&pool);
+
+			// Stands in for the vertex buffer.
+			UINT n = waves.ColumnCount();
+			std::vector<Vertex::WaveCompact> vertices(waves.VertexCount());
+			UINT revision = waves.Revision();
+
+			WavesThread thread;
+			if (async)
+				thread.Start(waves);
+
+			double totalMs = 0.0;
+			double maxMs = 0.0;
+			UINT uploadCount = 0;
+
+			Stopwatch timer;
+			for (UINT frame = 0; frame < frameCount; ++frame)
+			{
+				timer.Restart();
+
+				// One disturbance per frame, like the demo.
+				WaveImpulse impulse = { static_cast<float>(5 + (frame * 97) % (size - 10)),
+					static_cast<float>(5 + (frame * 61) % (size - 10)), 1.0f, 0.0f, WaveFootprintPoint5 };
+				waves.DisturbBatch(&impulse, 1);
+
+				UINT row0, row1;
+				if (async)
+				{
+					thread.AcquireSnapshot();
+					const WaveSnapshot& snapshot = thread.Snapshot();
+					if (snapshot.GetRowsChangedSince(revision, row0, row1))
+					{
+						memcpy(&vertices[row0 * n], &snapshot.Vertices[row0 * n],
+							(row1 - row0) * n * sizeof(Vertex::WaveCompact));
+						++uploadCount;
+					}
+					revision = snapshot.Revision;
+				}
+				else
+				{
+					waves.Update(static_cast<float>(frameMs / 1000.0));
+					if (waves.GetRowsChangedSince(revision, row0, row1))
+					{
+						waves.EmitCompactVertices(&vertices[0], row0, row1);
+						++uploadCount;
+					}
+					revision = waves.Revision();
+				}
+
+				double ms = timer.ElapsedMs();
+				totalMs += ms;
+				maxMs = std::max(maxMs, ms);
+
+				// The rest of the frame goes to rendering, which leaves the waves alone.
+				if (ms < frameMs)
+					std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>((frameMs - ms) * 1000.0)));
+			}
+
+			thread.Stop();
+
+			printf("%8u %8s %12.3f %12.3f %10u\n", size, async ? "thread" : "inline", totalMs / frameCount,
+				maxMs, uploadCount);
+		}
+	}
+}
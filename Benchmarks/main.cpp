@@ -0,0 +1,65 @@
+//***************************************************************************************
+// main.cpp
+//
+// Runs every benchmark, or only those whose name is given on the command line.
+//***************************************************************************************
+
+#include "Benchmarks.h"
+
+#include <cstdio>
+#include <cstring>
+
+struct BenchmarkEntry
+{
+	const char* Name;
+	void (*Run)();
+};
+
+static const BenchmarkEntry gBenchmarks[] =
+{
+	{ "waves-scaling", BenchmarkWavesScaling },
+	{ "waves-emit", BenchmarkWavesEmit },
+	{ "waves-sparse", BenchmarkWavesSparse },
+	{ "waves-impulses", BenchmarkWavesImpulses },
+	{ "waves-compact", BenchmarkWavesCompact },
+	{ "waves-implicit", BenchmarkWavesImplicit },
+	{ "waves-sample", BenchmarkWavesSample },
+	{ "waves-async", BenchmarkWavesAsync },
+	{ "geometry-geosphere", BenchmarkGeosphere },
+	{ "geometry-regenerate", BenchmarkGeometryRegenerate },
+	{ "geometry-trig", BenchmarkGeometryTrig },
+	{ "geometry-grid", BenchmarkGeometryGrid },
+	{ "geometry-index16", BenchmarkGeometryIndex16 },
+	{ "mesh-optimize", BenchmarkMeshOptimize },
+	{ "mesh-meshlets", BenchmarkMeshMeshlets },
+	{ "mesh-simplify", BenchmarkMeshSimplify },
+	{ "mesh-progressive", BenchmarkMeshProgressive },
+	{ "mesh-weld", BenchmarkMeshWeld },
+	{ "mesh-tangents", BenchmarkMeshTangents },
+	{ "ocean-fft", BenchmarkOceanFFT },
+	{ "ocean-tiles", BenchmarkOceanTiles },
+};
+
+int main(int argc, char* argv[])
+{
+	const UINT count = sizeof(gBenchmarks) / sizeof(gBenchmarks[0]);
+
+	for (UINT i = 0; i < count; ++i)
+	{
+		bool selected = (argc < 2);
+		for (int a = 1; a < argc; ++a)
+		{
+			if (strcmp(argv[a], gBenchmarks[i].Name) == 0)
+				selected = true;
+		}
+
+		if (!selected)
+			continue;
+
+		printf("== %s ==\n", gBenchmarks[i].Name);
+		gBenchmarks[i].Run();
+		printf("\n");
+	}
+
+	return 0;
+}
@@ -191,7 +191,7 @@ void BoxApp::DrawScene()
 	UINT stride = sizeof(Vertex::Basic32);
     UINT offset = 0;
     md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R16_UINT, 0);
 
 	// Set constants
 	XMMATRIX view  = XMLoadFloat4x4(&mView);
@@ -258,7 +258,7 @@ void BoxApp::OnMouseMove(WPARAM btnState, int x, int y)
 
 void BoxApp::BuildGeometryBuffers()
 {
-	GeometryGenerator::MeshData box;
+	GeometryGenerator::MeshData16 box;
 
 	GeometryGenerator geoGen;
 	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
@@ -305,12 +305,12 @@ void BoxApp::BuildGeometryBuffers()
 	// Pack the indices of all the meshes into one index buffer.
 	//
 
-	std::vector<UINT> indices;
+	std::vector<USHORT> indices;
 	indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
 
 	D3D11_BUFFER_DESC ibd;
     ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * totalIndexCount;
+	ibd.ByteWidth = sizeof(USHORT) * totalIndexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
     ibd.CPUAccessFlags = 0;
     ibd.MiscFlags = 0;
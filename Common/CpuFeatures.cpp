@@ -0,0 +1,112 @@
+//***************************************************************************************
+// CpuFeatures.cpp
+//***************************************************************************************
+
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	struct CpuInfo
+	{
+		bool SSE2;
+		bool SSE41;
+		bool AVX;
+		bool AVX2;
+		bool FMA;
+		bool F16C;
+		bool NEON;
+	};
+
+	CpuInfo DetectCpu()
+	{
+		CpuInfo info = { false, false, false, false, false, false, false };
+
+#if defined(_M_IX86) || defined(_M_X64)
+		int regs[4];
+		__cpuid(regs, 0);
+		int maxLeaf = regs[0];
+
+		__cpuid(regs, 1);
+		info.SSE2 = (regs[3] & (1 << 26)) != 0;
+		info.SSE41 = (regs[2] & (1 << 19)) != 0;
+
+		// AVX state must also be enabled by the OS (OSXSAVE and XCR0 bits 1 and 2).
+		bool osxsave = (regs[2] & (1 << 27)) != 0;
+		bool avxState = osxsave && ((_xgetbv(0) & 0x6) == 0x6);
+
+		info.AVX = avxState && (regs[2] & (1 << 28)) != 0;
+		info.FMA = info.AVX && (regs[2] & (1 << 12)) != 0;
+		info.F16C = info.AVX && (regs[2] & (1 << 29)) != 0;
+
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(regs, 7, 0);
+			info.AVX2 = info.AVX && (regs[1] & (1 << 5)) != 0;
+		}
+#elif defined(_M_ARM) || defined(_M_ARM64)
+		// NEON is mandatory on every Windows ARM target.
+		info.NEON = true;
+#endif
+
+		return info;
+	}
+
+	const CpuInfo gCpuInfo = DetectCpu();
+}
+
+bool CpuFeatures::HasSSE2()
+{
+	return gCpuInfo.SSE2;
+}
+
+bool CpuFeatures::HasSSE41()
+{
+	return gCpuInfo.SSE41;
+}
+
+bool CpuFeatures::HasAVX()
+{
+	return gCpuInfo.AVX;
+}
+
+bool CpuFeatures::HasAVX2()
+{
+	return gCpuInfo.AVX2;
+}
+
+bool CpuFeatures::HasFMA()
+{
+	return gCpuInfo.FMA;
+}
+
+bool CpuFeatures::HasF16C()
+{
+	return gCpuInfo.F16C;
+}
+
+bool CpuFeatures::HasNEON()
+{
+	return gCpuInfo.NEON;
+}
+
+ScopedFlushDenormals::ScopedFlushDenormals()
+	: mSavedState(0)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	// MXCSR flush-to-zero (bit 15) and denormals-are-zero (bit 6).
+	mSavedState = _mm_getcsr();
+	_mm_setcsr(mSavedState | 0x8040);
+#endif
+}
+
+ScopedFlushDenormals::~ScopedFlushDenormals()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	_mm_setcsr(mSavedState);
+#endif
+}
@@ -0,0 +1,40 @@
+//***************************************************************************************
+// CpuFeatures.h
+//
+// Queries the instruction set extensions of the host CPU so that code with several
+// SIMD implementations can pick the widest one at run time.
+//***************************************************************************************
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+class CpuFeatures
+{
+public:
+	static bool HasSSE2();
+	static bool HasSSE41();
+	static bool HasAVX();
+	static bool HasAVX2();
+	static bool HasFMA();
+	static bool HasF16C();
+	static bool HasNEON();
+};
+
+// Makes floating point operations on the calling thread flush denormal inputs and
+// results to zero for as long as it lives.  Denormals take tens of times longer on
+// x86, and a solution that decays smoothly towards zero is soon full of them.  On ARM
+// NEON flushes them anyway and this does nothing.
+class ScopedFlushDenormals
+{
+public:
+	ScopedFlushDenormals();
+	~ScopedFlushDenormals();
+
+private:
+	ScopedFlushDenormals(const ScopedFlushDenormals& rhs);
+	ScopedFlushDenormals& operator=(const ScopedFlushDenormals& rhs);
+
+	unsigned int mSavedState;
+};
+
+#endif // CPUFEATURES_H
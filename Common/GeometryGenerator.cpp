@@ -3,10 +3,41 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "ThreadPool.h"
+
+#include <climits>
 
 using namespace DirectX;
 
+// x = 1
+// y = phi = golden ratio = 1.61803398
+// r = sqrt((phi)^2 + 1^2)) = 1.90211303
+
+static const float IcosahedronX = 0.525731f; // = 1 / r
+static const float IcosahedronZ = 0.850651f; // = phi / r
+
+const UINT GeometryGenerator::MaxGeosphereSubdivisions;
+
+const XMFLOAT3 GeometryGenerator::IcosahedronPositions[12] =
+{
+	XMFLOAT3(-IcosahedronX, 0.0f, IcosahedronZ), XMFLOAT3(IcosahedronX, 0.0f, IcosahedronZ),
+	XMFLOAT3(-IcosahedronX, 0.0f, -IcosahedronZ), XMFLOAT3(IcosahedronX, 0.0f, -IcosahedronZ),
+	XMFLOAT3(0.0f, IcosahedronZ, IcosahedronX), XMFLOAT3(0.0f, IcosahedronZ, -IcosahedronX),
+	XMFLOAT3(0.0f, -IcosahedronZ, IcosahedronX), XMFLOAT3(0.0f, -IcosahedronZ, -IcosahedronX),
+	XMFLOAT3(IcosahedronZ, IcosahedronX, 0.0f), XMFLOAT3(-IcosahedronZ, IcosahedronX, 0.0f),
+	XMFLOAT3(IcosahedronZ, -IcosahedronX, 0.0f), XMFLOAT3(-IcosahedronZ, -IcosahedronX, 0.0f)
+};
+
+const UINT GeometryGenerator::IcosahedronIndices[60] =
+{
+	1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
+	1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
+	3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+	10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
+};
+
 GeometryGenerator::GeometryGenerator()
+	: mThreadPool(nullptr)
 {
 }
 
@@ -15,13 +46,33 @@ GeometryGenerator::~GeometryGenerator()
 {
 }
 
-void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
+GeometryGenerator::MeshCounts GeometryGenerator::BoxCounts()
+{
+	MeshCounts counts = { 24, 36 };
+	return counts;
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateBox(float width, float height, float depth, BasicMeshData<IndexT>& meshData)
 {
+	MeshCounts counts = BoxCounts();
+	meshData.Vertices.resize(counts.VertexCount);
+	meshData.Indices.resize(counts.IndexCount);
+
+	CreateBox(width, height, depth, meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0],
+		meshData.Indices.empty() ? nullptr : &meshData.Indices[0]);
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateBox(float width, float height, float depth, Vertex* vertices, IndexT* indices)
+{
+	assert(IndicesFit<IndexT>(BoxCounts().VertexCount));
+
 	//
 	// Create the vertices.
 	//
 
-	Vertex v[24];
+	Vertex* v = vertices;
 
 	float w2 = 0.5f*width;
 	float h2 = 0.5f*height;
@@ -63,13 +114,11 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
 
-	meshData.Vertices.assign(&v[0], &v[24]);
-
 	//
 	// Create the indices.
 	//
 
-	UINT i[36];
+	IndexT* i = indices;
 
 	// Fill in the front face index data
 	i[0] = 0; i[1] = 1; i[2] = 2;
@@ -94,14 +143,31 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 	// Fill in the right face index data
 	i[30] = 20; i[31] = 21; i[32] = 22;
 	i[33] = 20; i[34] = 22; i[35] = 23;
+}
+
+GeometryGenerator::MeshCounts GeometryGenerator::SphereCounts(UINT sliceCount, UINT stackCount)
+{
+	// Two poles and stackCount - 1 rings; a fan at each pole and two triangles per
+	// slice of each inner stack.
+	MeshCounts counts = { 2 + (stackCount - 1)*(sliceCount + 1), 6*sliceCount + 6*sliceCount*(stackCount - 2) };
+	return counts;
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData)
+{
+	MeshCounts counts = SphereCounts(sliceCount, stackCount);
+	meshData.Vertices.resize(counts.VertexCount);
+	meshData.Indices.resize(counts.IndexCount);
 
-	meshData.Indices.assign(&i[0], &i[36]);
+	CreateSphere(radius, sliceCount, stackCount, meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0],
+		meshData.Indices.empty() ? nullptr : &meshData.Indices[0]);
 }
 
-void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
+template <typename IndexT>
+void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, Vertex* vertices, IndexT* indices)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	assert(IndicesFit<IndexT>(SphereCounts(sliceCount, stackCount).VertexCount));
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -113,80 +179,101 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back(topVertex);
-
 	float phiStep = XM_PI / stackCount;
 	float thetaStep = 2.0f*XM_PI / sliceCount;
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for (UINT i = 1; i <= stackCount - 1; ++i)
-	{
-		float phi = i*phiStep;
-
-		// Vertices of ring.
-		for (UINT j = 0; j <= sliceCount; ++j)
-		{
-			float theta = j*thetaStep;
+	// The rings (the poles are not rings) follow the top pole, and the triangles of the
+	// stacks between them follow the top fan.
+	UINT ringCount = stackCount - 1;
+	UINT ringVertexCount = sliceCount + 1;
+	Vertex* firstRing = vertices + 1;
+	UINT southPoleIndex = 1 + ringCount*ringVertexCount;
 
-			Vertex v;
+	vertices[0] = topVertex;
+	vertices[southPoleIndex] = bottomVertex;
 
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+	// The sine and cosine of phi are taken once per ring.  Those of theta are taken
+	// once per slice, for the first ring; its tangents (-sin(theta), 0, cos(theta)) and
+	// texture u hold them for every other ring.
+	for (UINT j = 0; j <= sliceCount; ++j)
+	{
+		float theta = j*thetaStep;
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+		float sinTheta, cosTheta;
+		XMScalarSinCos(&sinTheta, &cosTheta, theta);
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+		// Partial derivative of P with respect to theta, divided by its length
+		// radius*sin(phi).
+		firstRing[j].TangentU = XMFLOAT3(-sinTheta, 0.0f, cosTheta);
+		firstRing[j].TexC.x = theta / XM_2PI;
+	}
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+	// With the first ring's table in place each ring, and the stack below it, depends
+	// on nothing else, so they are built in blocks of rings like the rows of a grid.
+	const UINT blockRings = MathHelper::Max(1u, 65536u / ringVertexCount);
+	UINT blockCount = (ringCount + blockRings - 1) / blockRings;
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
+	ThreadPool::Run(mThreadPool, blockCount, [&](UINT block, UINT)
+	{
+		UINT firstRingIndex = block*blockRings;
+		UINT endRingIndex = MathHelper::Min(firstRingIndex + blockRings, ringCount);
 
-			meshData.Vertices.push_back(v);
+		for (UINT r = firstRingIndex; r < endRingIndex; ++r)
+		{
+			float phi = (r + 1)*phiStep;
+
+			float sinPhi, cosPhi;
+			XMScalarSinCos(&sinPhi, &cosPhi, phi);
+
+			// Vertices of ring; the first ring's tangents were written above.
+			Vertex* ring = firstRing + r*ringVertexCount;
+			for (UINT j = 0; j <= sliceCount; ++j)
+			{
+				Vertex& v = ring[j];
+				if (r > 0)
+				{
+					v.TangentU = firstRing[j].TangentU;
+					v.TexC.x = firstRing[j].TexC.x;
+				}
+
+				// spherical to cartesian; the normal is the unit position.
+				XMVECTOR n = XMVectorSet(sinPhi*v.TangentU.z, cosPhi, -sinPhi*v.TangentU.x, 0.0f);
+				XMStoreFloat3(&v.Normal, n);
+				XMStoreFloat3(&v.Position, radius*n);
+
+				v.TexC.y = phi / XM_PI;
+			}
+
+			// Indices of the inner stack below the ring, not connected to the poles.
+			if (r + 1 < ringCount)
+			{
+				UINT ringStart = 1 + r*ringVertexCount;
+				IndexT* quad = indices + 3*sliceCount + r*6*sliceCount;
+				for (UINT j = 0; j < sliceCount; ++j)
+				{
+					*quad++ = ringStart + j;
+					*quad++ = ringStart + j + 1;
+					*quad++ = ringStart + ringVertexCount + j;
+
+					*quad++ = ringStart + ringVertexCount + j;
+					*quad++ = ringStart + j + 1;
+					*quad++ = ringStart + ringVertexCount + j + 1;
+				}
+			}
 		}
-	}
-
-	meshData.Vertices.push_back(bottomVertex);
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	UINT indexCount = 0;
 	for (UINT i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices.push_back(0);
-		meshData.Indices.push_back(i + 1);
-		meshData.Indices.push_back(i);
-	}
-
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
-
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-	UINT baseIndex = 1;
-	UINT ringVertexCount = sliceCount + 1;
-	for (UINT i = 0; i < stackCount - 2; ++i)
-	{
-		for (UINT j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j + 1);
-			meshData.Indices.push_back(baseIndex + (i + 1)*ringVertexCount + j);
-
-			meshData.Indices.push_back(baseIndex + (i + 1)*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j + 1);
-			meshData.Indices.push_back(baseIndex + (i + 1)*ringVertexCount + j + 1);
-		}
+		indices[indexCount++] = 0;
+		indices[indexCount++] = i + 1;
+		indices[indexCount++] = i;
 	}
 
 	//
@@ -194,28 +281,26 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	// and connects the bottom pole to the bottom ring.
 	//
 
-	// South pole vertex was added last.
-	UINT southPoleIndex = meshData.Vertices.size() - 1;
-
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
+	// Skip the inner stacks, and offset the indices to the index of the first vertex in
+	// the last ring.
+	indexCount += 6*sliceCount*(ringCount - 1);
+	UINT baseIndex = southPoleIndex - ringVertexCount;
 
 	for (UINT i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices.push_back(southPoleIndex);
-		meshData.Indices.push_back(baseIndex + i);
-		meshData.Indices.push_back(baseIndex + i + 1);
+		indices[indexCount++] = southPoleIndex;
+		indices[indexCount++] = baseIndex + i;
+		indices[indexCount++] = baseIndex + i + 1;
 	}
 }
 
-void GeometryGenerator::Subdivide(MeshData& meshData)
+template <typename IndexT>
+void GeometryGenerator::Subdivide(BasicMeshData<IndexT>& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices.resize(0);
+	// Save a copy of the input indices.  The input vertices are kept as they are and
+	// the midpoints are appended after them.
+	std::vector<IndexT> inputIndices;
+	inputIndices.swap(meshData.Indices);
 
 	//       v1
 	//       *
@@ -227,146 +312,340 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	UINT numTris = inputCopy.Indices.size() / 3;
+	// Every edge inside a closed mesh is shared by two triangles, so it gets its
+	// midpoint once and the second triangle looks it up.
+	UINT numTris = inputIndices.size() / 3;
+	std::unordered_map<UINT64, UINT> midpoints;
+	midpoints.reserve(numTris * 3 / 2);
+
+	meshData.Vertices.reserve(meshData.Vertices.size() + numTris * 3 / 2);
+	meshData.Indices.resize(numTris * 12);
+
 	for (UINT i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 0]];
-		Vertex v1 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 1]];
-		Vertex v2 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 2]];
+		UINT i0 = inputIndices[i * 3 + 0];
+		UINT i1 = inputIndices[i * 3 + 1];
+		UINT i2 = inputIndices[i * 3 + 2];
 
 		//
 		// Generate the midpoints.
 		//
 
-		Vertex m0, m1, m2;
-
-		// For subdivision, we just care about the position component.  We derive the other
-		// vertex components in CreateGeosphere.
-
-		m0.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v1.Position.x),
-			0.5f*(v0.Position.y + v1.Position.y),
-			0.5f*(v0.Position.z + v1.Position.z));
-
-		m1.Position = XMFLOAT3(
-			0.5f*(v1.Position.x + v2.Position.x),
-			0.5f*(v1.Position.y + v2.Position.y),
-			0.5f*(v1.Position.z + v2.Position.z));
-
-		m2.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v2.Position.x),
-			0.5f*(v0.Position.y + v2.Position.y),
-			0.5f*(v0.Position.z + v2.Position.z));
+		UINT m0 = GetMidpoint(i0, i1, midpoints, meshData.Vertices);
+		UINT m1 = GetMidpoint(i1, i2, midpoints, meshData.Vertices);
+		UINT m2 = GetMidpoint(i0, i2, midpoints, meshData.Vertices);
 
 		//
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
+		IndexT* k = &meshData.Indices[i * 12];
 
-		meshData.Indices.push_back(i * 6 + 0);
-		meshData.Indices.push_back(i * 6 + 3);
-		meshData.Indices.push_back(i * 6 + 5);
+		k[0] = i0;
+		k[1] = m0;
+		k[2] = m2;
 
-		meshData.Indices.push_back(i * 6 + 3);
-		meshData.Indices.push_back(i * 6 + 4);
-		meshData.Indices.push_back(i * 6 + 5);
+		k[3] = m0;
+		k[4] = m1;
+		k[5] = m2;
 
-		meshData.Indices.push_back(i * 6 + 5);
-		meshData.Indices.push_back(i * 6 + 4);
-		meshData.Indices.push_back(i * 6 + 2);
+		k[6] = m2;
+		k[7] = m1;
+		k[8] = i2;
 
-		meshData.Indices.push_back(i * 6 + 3);
-		meshData.Indices.push_back(i * 6 + 1);
-		meshData.Indices.push_back(i * 6 + 4);
+		k[9] = m0;
+		k[10] = i1;
+		k[11] = m1;
 	}
+
+	assert(IndicesFit<IndexT>(meshData.Vertices.size()));
 }
 
-void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
+UINT GeometryGenerator::GetMidpoint(UINT i0, UINT i1, std::unordered_map<UINT64, UINT>& midpoints, std::vector<Vertex>& vertices)
 {
+	// The key does not depend on the direction the edge is walked in.
+	UINT64 key = (static_cast<UINT64>(MathHelper::Min(i0, i1)) << 32) | MathHelper::Max(i0, i1);
+
+	std::unordered_map<UINT64, UINT>::iterator it = midpoints.find(key);
+	if (it != midpoints.end())
+		return it->second;
+
+	// For subdivision, we just care about the position component.  The caller derives
+	// the other vertex components.
+	const XMFLOAT3& p0 = vertices[i0].Position;
+	const XMFLOAT3& p1 = vertices[i1].Position;
+
+	Vertex m;
+	m.Position = XMFLOAT3(
+		0.5f*(p0.x + p1.x),
+		0.5f*(p0.y + p1.y),
+		0.5f*(p0.z + p1.z));
+
+	UINT index = vertices.size();
+	vertices.push_back(m);
+	midpoints.insert(std::make_pair(key, index));
+
+	return index;
+}
+
+GeometryGenerator::MeshCounts GeometryGenerator::GeosphereCounts(UINT numSubdivisions)
+{
+	// Every subdivision splits each triangle in four.
+	UINT n = 1u << MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
+	MeshCounts counts = { 10 * n * n + 2, 60 * n * n };
+	return counts;
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, BasicMeshData<IndexT>& meshData)
+{
+	MeshCounts counts = GeosphereCounts(numSubdivisions);
+	meshData.Vertices.resize(counts.VertexCount);
+	meshData.Indices.resize(counts.IndexCount);
+
+	CreateGeosphere(radius, numSubdivisions, meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0],
+		meshData.Indices.empty() ? nullptr : &meshData.Indices[0]);
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Vertex* vertices, IndexT* indices)
+{
+	assert(IndicesFit<IndexT>(GeosphereCounts(numSubdivisions).VertexCount));
+
 	// Put a cap on the number of subdivisions.
-	numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+	numSubdivisions = MathHelper::Min(numSubdivisions, MaxGeosphereSubdivisions);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
-	// x = 1
-	// y = phi = golden ratio = 1.61803398
-	// r = sqrt((phi)^2 + 1^2)) = 1.90211303
+	// Each face of the icosahedron is cut into n^2 triangles along a triangular grid of
+	// n + 1 points a side, which is where numSubdivisions midpoint subdivisions put
+	// their points too.  The vertices are numbered corners first, then the n - 1 inner
+	// points of every edge, then the inner points of every face.
+	UINT n = 1u << numSubdivisions;
+	UINT innerEdgeCount = n - 1;
+	UINT innerFaceCount = (n - 1) * (n - 2) / 2;
 
-	const float X = 0.525731f; // = 1 / r
-	const float Z = 0.850651f; // = phi / r
+	for (UINT i = 0; i < 12; ++i)
+		vertices[i].Position = IcosahedronPositions[i];
 
-	XMFLOAT3 pos[12] =
+	// Number the 30 edges in the order the faces first use them; the points of an
+	// edge run from its lower to its higher corner.
+	UINT edgeCount = 0;
+	UINT edgeIndex[12][12];
+	for (UINT i = 0; i < 12; ++i)
 	{
-		XMFLOAT3(-X, 0.0f, Z), XMFLOAT3(X, 0.0f, Z),
-		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
-		XMFLOAT3(0.0f, Z, X), XMFLOAT3(0.0f, Z, -X),
-		XMFLOAT3(0.0f, -Z, X), XMFLOAT3(0.0f, -Z, -X),
-		XMFLOAT3(Z, X, 0.0f), XMFLOAT3(-Z, X, 0.0f),
-		XMFLOAT3(Z, -X, 0.0f), XMFLOAT3(-Z, -X, 0.0f)
-	};
-
-	DWORD k[60] =
+		for (UINT j = 0; j < 12; ++j)
+			edgeIndex[i][j] = UINT_MAX;
+	}
+
+	UINT edgeBase = 12;
+	for (UINT f = 0; f < 20; ++f)
 	{
-		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,    
-		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,    
-		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 
-		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
-	};
+		for (UINT e = 0; e < 3; ++e)
+		{
+			UINT a = IcosahedronIndices[f * 3 + e];
+			UINT b = IcosahedronIndices[f * 3 + (e + 1) % 3];
+			if (edgeIndex[a][b] != UINT_MAX)
+				continue;
+
+			edgeIndex[a][b] = edgeIndex[b][a] = edgeCount++;
+
+			XMVECTOR p0 = XMLoadFloat3(&IcosahedronPositions[MathHelper::Min(a, b)]);
+			XMVECTOR p1 = XMLoadFloat3(&IcosahedronPositions[MathHelper::Max(a, b)]);
+			UINT base = edgeBase + edgeIndex[a][b] * innerEdgeCount;
+			for (UINT k = 1; k < n; ++k)
+				XMStoreFloat3(&vertices[base + k - 1].Position, (p0*float(n - k) + p1*float(k))*(1.0f / n));
+		}
+	}
 
-	meshData.Vertices.resize(12);
-	meshData.Indices.resize(60);
+	UINT faceBase = edgeBase + 30 * innerEdgeCount;
+	IndexT* k = indices;
 
-	for (UINT i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
+	for (UINT f = 0; f < 20; ++f)
+	{
+		UINT a = IcosahedronIndices[f * 3 + 0];
+		UINT b = IcosahedronIndices[f * 3 + 1];
+		UINT c = IcosahedronIndices[f * 3 + 2];
 
-	for (UINT i = 0; i < 60; ++i)
-		meshData.Indices[i] = k[i];
+		XMVECTOR pa = XMLoadFloat3(&IcosahedronPositions[a]);
+		XMVECTOR pb = XMLoadFloat3(&IcosahedronPositions[b]);
+		XMVECTOR pc = XMLoadFloat3(&IcosahedronPositions[c]);
 
-	for (UINT i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+		// Index of grid point (i, j) = a + i/n (b - a) + j/n (c - a), i + j <= n.
+		UINT innerBase = faceBase + f * innerFaceCount;
+		auto index = [&](UINT i, UINT j) -> UINT
+		{
+			if (i == 0 && j == 0)
+				return a;
+			if (i == n)
+				return b;
+			if (j == n)
+				return c;
+			if (j == 0)
+				return EdgePoint(a, b, i, n, edgeIndex[a][b], edgeBase);
+			if (i == 0)
+				return EdgePoint(a, c, j, n, edgeIndex[a][c], edgeBase);
+			if (i + j == n)
+				return EdgePoint(b, c, j, n, edgeIndex[b][c], edgeBase);
+
+			// Inner points row by row, i - 1 inner points before row i.
+			return innerBase + (i - 1) * (2 * n - i - 2) / 2 + j - 1;
+		};
+
+		for (UINT i = 1; i < n; ++i)
+		{
+			for (UINT j = 1; i + j < n; ++j)
+			{
+				XMVECTOR p = (pa*float(n - i - j) + pb*float(i) + pc*float(j))*(1.0f / n);
+				XMStoreFloat3(&vertices[index(i, j)].Position, p);
+			}
+		}
 
-	// Project vertices onto sphere and scale.
-	for (UINT i = 0; i < meshData.Vertices.size(); ++i)
-	{
-		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
+		// The triangles go in the order numSubdivisions calls of Subdivide would leave
+		// them in, depth first down the midpoint subdivision, which keeps neighboring
+		// triangles close together in the index buffer at every scale.  Each entry on
+		// the stack is a triangle as the grid coordinates of its corners and its size.
+		UINT stack[3 * MaxGeosphereSubdivisions + 1][7];
+		UINT top = 0;
+		const UINT root[7] = { 0, 0, n, 0, 0, n, n };
+		std::copy(root, root + 7, stack[top++]);
 
-		// Project onto sphere.
-		XMVECTOR p = radius*n;
+		while (top > 0)
+		{
+			UINT t[7];
+			--top;
+			std::copy(stack[top], stack[top] + 7, t);
+
+			if (t[6] == 1)
+			{
+				k[0] = index(t[0], t[1]);
+				k[1] = index(t[2], t[3]);
+				k[2] = index(t[4], t[5]);
+				k += 3;
+				continue;
+			}
+
+			// Midpoints m0 = (v0 + v1)/2, m1 = (v1 + v2)/2 and m2 = (v0 + v2)/2, and the
+			// children in the order Subdivide emits them, pushed in reverse.
+			UINT m0i = (t[0] + t[2]) / 2, m0j = (t[1] + t[3]) / 2;
+			UINT m1i = (t[2] + t[4]) / 2, m1j = (t[3] + t[5]) / 2;
+			UINT m2i = (t[0] + t[4]) / 2, m2j = (t[1] + t[5]) / 2;
+			UINT size = t[6] / 2;
+
+			const UINT children[4][7] =
+			{
+				{ t[0], t[1], m0i, m0j, m2i, m2j, size },
+				{ m0i, m0j, m1i, m1j, m2i, m2j, size },
+				{ m2i, m2j, m1i, m1j, t[4], t[5], size },
+				{ m0i, m0j, t[2], t[3], m1i, m1j, size }
+			};
+
+			for (UINT c = 4; c-- > 0;)
+				std::copy(children[c], children[c] + 7, stack[top++]);
+		}
+	}
 
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+	ProjectOntoSphere(radius, vertices, 10 * n * n + 2);
+}
 
-		// Derive texture coordinates from spherical coordinates.
-		float theta = MathHelper::AngleFromXY(
-			meshData.Vertices[i].Position.x,
-			meshData.Vertices[i].Position.z);
+UINT GeometryGenerator::EdgePoint(UINT from, UINT to, UINT step, UINT n, UINT edge, UINT edgeBase)
+{
+	// Points are stored from the lower corner of the edge to the higher one.
+	UINT k = from < to ? step : n - step;
+	return edgeBase + edge * (n - 1) + k - 1;
+}
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+void GeometryGenerator::ProjectOntoSphere(float radius, Vertex* vertices, UINT vertexCount)
+{
+	// Four vertices at a time, so that the angles for the texture coordinates are
+	// taken on whole vectors rather than with atan and acos per vertex.
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR twoPi = XMVectorReplicate(XM_2PI);
 
-		meshData.Vertices[i].TexC.x = theta / XM_2PI;
-		meshData.Vertices[i].TexC.y = phi / XM_PI;
+	for (UINT i = 0; i < vertexCount; i += 4)
+	{
+		UINT count = MathHelper::Min(vertexCount - i, 4u);
+
+		// Project onto unit sphere, and transpose to one vector per coordinate.  Lanes
+		// past the end repeat the last vertex.
+		XMFLOAT4 nx, ny, nz;
+		float* lanes[3] = { &nx.x, &ny.x, &nz.x };
+		for (UINT k = 0; k < 4; ++k)
+		{
+			Vertex& v = vertices[i + MathHelper::Min(k, count - 1)];
+			XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&v.Position));
+
+			lanes[0][k] = XMVectorGetX(n);
+			lanes[1][k] = XMVectorGetY(n);
+			lanes[2][k] = XMVectorGetZ(n);
+		}
 
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+		XMVECTOR x = XMLoadFloat4(&nx);
+		XMVECTOR y = XMLoadFloat4(&ny);
+		XMVECTOR z = XMLoadFloat4(&nz);
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
+		// Derive texture coordinates from spherical coordinates: theta in [0, 2*pi)
+		// around the y-axis from the x-axis, phi down from the y-axis.
+		XMVECTOR theta = XMVectorATan2(z, x);
+		theta = XMVectorSelect(theta, theta + twoPi, XMVectorLess(theta, zero));
+		XMVECTOR phi = XMVectorACos(XMVectorClamp(y, -XMVectorSplatOne(), XMVectorSplatOne()));
+
+		XMFLOAT4 u, w;
+		XMStoreFloat4(&u, theta*(1.0f / XM_2PI));
+		XMStoreFloat4(&w, phi*(1.0f / XM_PI));
+		const float* uLanes = &u.x;
+		const float* vLanes = &w.x;
+
+		for (UINT k = 0; k < count; ++k)
+		{
+			Vertex& v = vertices[i + k];
+			XMVECTOR n = XMVectorSet(lanes[0][k], lanes[1][k], lanes[2][k], 0.0f);
+
+			// Project onto sphere.
+			XMStoreFloat3(&v.Position, radius*n);
+			XMStoreFloat3(&v.Normal, n);
+
+			v.TexC.x = uLanes[k];
+			v.TexC.y = vLanes[k];
+
+			// Partial derivative of P with respect to theta, (-z, 0, x) up to scale.
+			// It vanishes at the poles, where any direction in the xz-plane will do.
+			XMVECTOR T = XMVectorSet(-lanes[2][k], 0.0f, lanes[0][k], 0.0f);
+			if (XMVectorGetX(XMVector3LengthSq(T)) > 0.0f)
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+			else
+				v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		}
 	}
 }
 
-void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
+GeometryGenerator::MeshCounts GeometryGenerator::CylinderCounts(UINT sliceCount, UINT stackCount)
+{
+	// stackCount + 1 rings, then a ring and a center vertex for each cap.
+	MeshCounts counts = { (stackCount + 1)*(sliceCount + 1) + 2*(sliceCount + 2), 6*sliceCount*stackCount + 6*sliceCount };
+	return counts;
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData)
+{
+	MeshCounts counts = CylinderCounts(sliceCount, stackCount);
+	meshData.Vertices.resize(counts.VertexCount);
+	meshData.Indices.resize(counts.IndexCount);
+
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount,
+		meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0],
+		meshData.Indices.empty() ? nullptr : &meshData.Indices[0]);
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+									   Vertex* vertices, IndexT* indices)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	assert(IndicesFit<IndexT>(CylinderCounts(sliceCount, stackCount).VertexCount));
+
+	UINT vertexCount = 0;
+	UINT indexCount = 0;
 
 	//
 	// Build Stacks.
@@ -379,7 +658,10 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 
 	UINT ringCount = stackCount + 1;
 
-	// Compute vertices for each stack ring starting at the bottom and moving up.
+	// Compute vertices for each stack ring starting at the bottom and moving up.  Only
+	// the first ring evaluates sine and cosine and the normals; those do not change
+	// from ring to ring, so the others copy them.
+	Vertex* firstRing = vertices + vertexCount;
 	for (UINT i = 0; i < ringCount; i++)
 	{
 		float y = -0.5f*height + i*stackHeight;
@@ -389,7 +671,16 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 		float dTheta = 2.0f*XM_PI / sliceCount;
 		for (UINT j = 0; j <= sliceCount; j++)
 		{
-			Vertex vertex;
+			Vertex& vertex = vertices[vertexCount++];
+
+			if (i > 0)
+			{
+				// The tangent is (-sin(t), 0, cos(t)).
+				vertex = firstRing[j];
+				vertex.Position = XMFLOAT3(r*vertex.TangentU.z, y, -r*vertex.TangentU.x);
+				vertex.TexC.y = 1.0f - float(i) / stackCount;
+				continue;
+			}
 
 			float c = cosf(j*dTheta);
 			float s = sinf(j*dTheta);
@@ -428,8 +719,6 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 			XMVECTOR B = XMLoadFloat3(&bitangent);
 			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
 			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
 		}
 	}
 
@@ -442,24 +731,44 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 	{
 		for (UINT j = 0; j < sliceCount; j++)
 		{
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i + 1)*ringVertexCount + j);
-			meshData.Indices.push_back((i + 1)*ringVertexCount + j + 1);
+			indices[indexCount++] = i*ringVertexCount + j;
+			indices[indexCount++] = (i + 1)*ringVertexCount + j;
+			indices[indexCount++] = (i + 1)*ringVertexCount + j + 1;
 
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i + 1)*ringVertexCount + j + 1);
-			meshData.Indices.push_back(i*ringVertexCount + j + 1);
+			indices[indexCount++] = i*ringVertexCount + j;
+			indices[indexCount++] = (i + 1)*ringVertexCount + j + 1;
+			indices[indexCount++] = i*ringVertexCount + j + 1;
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		vertexCount, vertices + vertexCount, indices + indexCount);
+	vertexCount += sliceCount + 2;
+	indexCount += 3*sliceCount;
+
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		vertexCount, vertices + vertexCount, indices + indexCount);
 }
 
+template <typename IndexT>
 void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, 
-											UINT sliceCount, UINT stackCount, MeshData& meshData)
+											UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData)
 {
 	UINT baseIndex = meshData.Vertices.size();
+	UINT firstIndex = meshData.Indices.size();
+	meshData.Vertices.resize(baseIndex + sliceCount + 2);
+	meshData.Indices.resize(firstIndex + 3*sliceCount);
+
+	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		baseIndex, &meshData.Vertices[baseIndex], &meshData.Indices[firstIndex]);
+}
+
+template <typename IndexT>
+void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
+											UINT sliceCount, UINT stackCount, UINT baseIndex, Vertex* vertices, IndexT* indices)
+{
+	UINT vertexCount = 0;
+	UINT indexCount = 0;
 
 	float y = 0.5f*height;
 	float dTheta = 2.0f*XM_PI / sliceCount;
@@ -476,35 +785,48 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x / height + 0.5f;
 		float v = z / height + 0.5f;
 
-		meshData.Vertices.push_back(
-			Vertex(x, y, z,
+		vertices[vertexCount++] = Vertex(x, y, z,
 				0.0f, 1.0f, 0.0f,
 				1.0f, 0.0f, 0.0f,
-				u, v));
+				u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back(
-		Vertex(0.0f, y, 0.0f,
+	vertices[vertexCount++] = Vertex(0.0f, y, 0.0f,
 			0.0f, 1.0f, 0.0f,
 			1.0f, 0.0f, 0.0f,
-			0.5f, 0.5f));
+			0.5f, 0.5f);
 
 	// Index of center vertex.
-	UINT centerIndex = meshData.Vertices.size() - 1;
+	UINT centerIndex = baseIndex + vertexCount - 1;
 
 	for (UINT i = 0; i < sliceCount; i++)
 	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i + 1);
-		meshData.Indices.push_back(baseIndex + i);
+		indices[indexCount++] = centerIndex;
+		indices[indexCount++] = baseIndex + i + 1;
+		indices[indexCount++] = baseIndex + i;
 	}
 }
 
+template <typename IndexT>
 void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, 
-											   UINT sliceCount, UINT stackCount, MeshData& meshData)
+											   UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData)
 {
 	UINT baseIndex = meshData.Vertices.size();
+	UINT firstIndex = meshData.Indices.size();
+	meshData.Vertices.resize(baseIndex + sliceCount + 2);
+	meshData.Indices.resize(firstIndex + 3*sliceCount);
+
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		baseIndex, &meshData.Vertices[baseIndex], &meshData.Indices[firstIndex]);
+}
+
+template <typename IndexT>
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
+											   UINT sliceCount, UINT stackCount, UINT baseIndex, Vertex* vertices, IndexT* indices)
+{
+	UINT vertexCount = 0;
+	UINT indexCount = 0;
 
 	// negative offset for bottom
 	float y = -0.5f*height;
@@ -525,37 +847,113 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float v = z / height + 0.5f;
 
 		// Negative offset for bottom
-		meshData.Vertices.push_back(
-			Vertex(x, y, z,
+		vertices[vertexCount++] = Vertex(x, y, z,
 			0.0f, -1.0f, 0.0f,
 			1.0f, 0.0f, 0.0f,
-			u, v));
+			u, v);
 	}
 
 	// Cap center vertex. Negative offset for bottom
-	meshData.Vertices.push_back(
-		Vertex(0.0f, y, 0.0f,
+	vertices[vertexCount++] = Vertex(0.0f, y, 0.0f,
 		0.0f, -1.0f, 0.0f,
 		1.0f, 0.0f, 0.0f,
-		0.5f, 0.5f));
+		0.5f, 0.5f);
 
 	// Index of center vertex.
-	UINT centerIndex = meshData.Vertices.size() - 1;
+	UINT centerIndex = baseIndex + vertexCount - 1;
 
 	for (UINT i = 0; i < sliceCount; i++)
 	{
 		// Opposite triangle order for flipping back-face
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i);
-		meshData.Indices.push_back(baseIndex + i + 1);
+		indices[indexCount++] = centerIndex;
+		indices[indexCount++] = baseIndex + i;
+		indices[indexCount++] = baseIndex + i + 1;
 	}
 }
 
-void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData)
+GeometryGenerator::MeshCounts GeometryGenerator::GridCounts(UINT m, UINT n)
 {
-	UINT vertexCount = m*n;
-	UINT faceCount = (m - 1)*(n - 1) * 2;
+	MeshCounts counts = { m*n, (m - 1)*(n - 1) * 6 };
+	return counts;
+}
+
+template <typename IndexT>
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, BasicMeshData<IndexT>& meshData)
+{
+	MeshCounts counts = GridCounts(m, n);
+	meshData.Vertices.resize(counts.VertexCount);
+	meshData.Indices.resize(counts.IndexCount);
+
+	CreateGrid(width, depth, m, n, meshData.Vertices.empty() ? nullptr : &meshData.Vertices[0],
+		meshData.Indices.empty() ? nullptr : &meshData.Indices[0]);
+}
 
+template <typename IndexT>
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Vertex* vertices, IndexT* indices)
+{
+	assert(IndicesFit<IndexT>(m*n));
+
+	// Blocks of rows small enough to balance across threads, large enough that a task
+	// is much more than the overhead of handing it out.
+	const UINT blockRows = MathHelper::Max(1u, 65536u / n);
+	UINT blockCount = (m + blockRows - 1) / blockRows;
+
+	ThreadPool::Run(mThreadPool, blockCount, [&](UINT block, UINT)
+	{
+		UINT firstRow = block*blockRows;
+		UINT rowCount = MathHelper::Min(blockRows, m - firstRow);
+
+		GridRows(width, depth, m, n, firstRow, rowCount, vertices + firstRow*n);
+
+		// The last row has no quads below it.
+		UINT quadRowCount = MathHelper::Min(rowCount, m - 1 - firstRow);
+		GridQuads(n, firstRow, quadRowCount, 0, indices + firstRow*(n - 1)*6);
+	});
+}
+
+void GeometryGenerator::CreateGridChunks(float width, float depth, UINT m, UINT n, UINT chunkRows,
+	const std::function<void(const GridChunk&)>& callback)
+{
+	chunkRows = MathHelper::Max(chunkRows, 1u);
+	UINT chunkCount = (m - 1 + chunkRows - 1) / chunkRows;
+
+	// One chunk per thread, sized for a whole one the first time it is used.
+	UINT threadCount = mThreadPool != nullptr ? mThreadPool->ThreadCount() : 1;
+	std::vector<MeshData> chunks(threadCount);
+
+	ThreadPool::Run(mThreadPool, chunkCount, [&](UINT c, UINT thread)
+	{
+		MeshData& chunkData = chunks[thread];
+		if (chunkData.Vertices.empty())
+		{
+			chunkData.Vertices.resize((chunkRows + 1)*n);
+			chunkData.Indices.resize(chunkRows*(n - 1)*6);
+		}
+
+		GridChunk chunk;
+		chunk.FirstRow = c*chunkRows;
+		UINT quadRowCount = MathHelper::Min(chunkRows, m - 1 - chunk.FirstRow);
+		chunk.RowCount = quadRowCount + 1;
+
+		GridRows(width, depth, m, n, chunk.FirstRow, chunk.RowCount, &chunkData.Vertices[0]);
+		GridQuads(n, chunk.FirstRow, quadRowCount, chunk.FirstRow, &chunkData.Indices[0]);
+
+		bool lastChunk = (c == chunkCount - 1);
+		chunk.Vertices = &chunkData.Vertices[0];
+		chunk.VertexCount = chunk.RowCount*n;
+		chunk.OwnedVertexCount = lastChunk ? chunk.VertexCount : quadRowCount*n;
+		chunk.FirstVertex = chunk.FirstRow*n;
+
+		chunk.Indices = &chunkData.Indices[0];
+		chunk.IndexCount = quadRowCount*(n - 1)*6;
+		chunk.FirstIndex = chunk.FirstRow*(n - 1)*6;
+
+		callback(chunk);
+	});
+}
+
+void GeometryGenerator::GridRows(float width, float depth, UINT m, UINT n, UINT firstRow, UINT rowCount, Vertex* vertices)
+{
 	//
 	// Create the vertices.
 	//
@@ -569,40 +967,67 @@ void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Mes
 	float du = 1.0f / (n - 1);
 	float dv = 1.0f / (m - 1);
 
-	meshData.Vertices.resize(vertexCount);
-	for (UINT i = 0; i < m; i++)
+	for (UINT i = firstRow; i < firstRow + rowCount; i++)
 	{
 		float z = halfDepth - i*dz;
 		for (UINT j = 0; j < n; j++)
 		{
 			float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n + j].Position = XMFLOAT3(x, 0.0f, z);
+			vertices->Position = XMFLOAT3(x, 0.0f, z);
+
+			vertices->Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertices->TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
-			meshData.Vertices[i*n + j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			vertices->TexC.x = j*du;
+			vertices->TexC.y = i*dv;
 
-			meshData.Vertices[i*n + j].TexC.x = j*du;
-			meshData.Vertices[i*n + j].TexC.y = i*dv;
+			++vertices;
 		}
 	}
+}
 
-	meshData.Indices.resize(faceCount * 3);	// 3 indices per face
-
+template <typename IndexT>
+void GeometryGenerator::GridQuads(UINT n, UINT firstRow, UINT quadRowCount, UINT baseRow, IndexT* indices)
+{
 	// Iterate over each quad and compute indices.
 	UINT k = 0;
-	for (UINT i = 0; i < m - 1; i++)
+	for (UINT i = firstRow - baseRow; i < firstRow - baseRow + quadRowCount; i++)
 	{
 		for (UINT j = 0; j < n - 1; j++)
 		{
-			meshData.Indices[k] = i*n + j;
-			meshData.Indices[k + 1] = i*n + j + 1;
-			meshData.Indices[k + 2] = (i + 1)*n + j;
-			meshData.Indices[k + 3] = (i + 1)*n + j;
-			meshData.Indices[k + 4] = i*n + j + 1;
-			meshData.Indices[k + 5] = (i + 1)*n + j + 1;
+			indices[k] = i*n + j;
+			indices[k + 1] = i*n + j + 1;
+			indices[k + 2] = (i + 1)*n + j;
+			indices[k + 3] = (i + 1)*n + j;
+			indices[k + 4] = i*n + j + 1;
+			indices[k + 5] = (i + 1)*n + j + 1;
 
 			k += 6;
 		}
 	}
 }
+
+//
+// The generators for both index widths.
+//
+
+#define INSTANTIATE_GEOMETRY_GENERATOR(IndexT) \
+	template void GeometryGenerator::CreateBox(float, float, float, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::CreateBox(float, float, float, Vertex*, IndexT*); \
+	template void GeometryGenerator::CreateSphere(float, UINT, UINT, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::CreateSphere(float, UINT, UINT, Vertex*, IndexT*); \
+	template void GeometryGenerator::Subdivide(BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::CreateGeosphere(float, UINT, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::CreateGeosphere(float, UINT, Vertex*, IndexT*); \
+	template void GeometryGenerator::CreateCylinder(float, float, float, UINT, UINT, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::CreateCylinder(float, float, float, UINT, UINT, Vertex*, IndexT*); \
+	template void GeometryGenerator::BuildCylinderTopCap(float, float, float, UINT, UINT, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::BuildCylinderTopCap(float, float, float, UINT, UINT, UINT, Vertex*, IndexT*); \
+	template void GeometryGenerator::BuildCylinderBottomCap(float, float, float, UINT, UINT, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::BuildCylinderBottomCap(float, float, float, UINT, UINT, UINT, Vertex*, IndexT*); \
+	template void GeometryGenerator::CreateGrid(float, float, UINT, UINT, BasicMeshData<IndexT>&); \
+	template void GeometryGenerator::CreateGrid(float, float, UINT, UINT, Vertex*, IndexT*);
+
+INSTANTIATE_GEOMETRY_GENERATOR(UINT)
+INSTANTIATE_GEOMETRY_GENERATOR(USHORT)
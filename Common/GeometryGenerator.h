@@ -2,6 +2,11 @@
 
 #include "d3dUtil.h"
 
+#include <functional>
+#include <unordered_map>
+
+class ThreadPool;
+
 class GeometryGenerator
 {
 public:
@@ -27,21 +32,145 @@ class GeometryGenerator
 		DirectX::XMFLOAT2 TexC;
 	};
 
-	struct MeshData
+	template <typename IndexT>
+	struct BasicMeshData
 	{
 		std::vector<Vertex> Vertices;
-		std::vector<UINT> Indices;
+		std::vector<IndexT> Indices;
+	};
+
+	// Every generator comes for 32-bit and 16-bit indices.  16-bit indices take half
+	// the memory and bandwidth, and fit meshes of up to 65536 vertices, which covers
+	// most of the primitives; bind them as DXGI_FORMAT_R16_UINT.
+	typedef BasicMeshData<UINT> MeshData;
+	typedef BasicMeshData<USHORT> MeshData16;
+
+	// Whether every vertex of a mesh of vertexCount vertices can be indexed with IndexT.
+	template <typename IndexT>
+	static bool IndicesFit(UINT vertexCount) { return vertexCount <= static_cast<UINT64>(static_cast<IndexT>(-1)) + 1; }
+
+	// Vertex and index counts of a mesh.  The Create* overloads that take arrays write
+	// exactly the counts the matching *Counts function returns.
+	struct MeshCounts
+	{
+		UINT VertexCount;
+		UINT IndexCount;
+	};
+
+	// One block of grid rows handed out by CreateGridChunks().  The chunk is a mesh of
+	// its own: the indices number its vertices from zero.  Vertex i of the chunk is
+	// vertex FirstVertex + i of the whole grid, and its indices belong at FirstIndex
+	// of the whole index list once FirstVertex is added to them.
+	struct GridChunk
+	{
+		// Grid rows [FirstRow, FirstRow + RowCount) of vertices.  The last row is also
+		// the first row of the next chunk; the first OwnedVertexCount vertices are the
+		// ones no other chunk has.
+		UINT FirstRow;
+		UINT RowCount;
+
+		const Vertex* Vertices;
+		UINT VertexCount;
+		UINT OwnedVertexCount;
+		UINT FirstVertex;
+
+		const UINT* Indices;
+		UINT IndexCount;
+		UINT FirstIndex;
 	};
 
 	GeometryGenerator();
 	~GeometryGenerator();
-	void CreateBox(float width, float height, float depth, MeshData& meshData);
-	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void Subdivide(MeshData& meshData);
-	void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
-	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData);
+
+	// Runs CreateGrid() and CreateGridChunks() in blocks of rows, and CreateSphere() in
+	// blocks of rings, on the given pool; null runs them on the calling thread.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+	// Every mesh can be generated into caller-provided arrays, e.g. mapped buffers or
+	// memory reused across regenerations, without allocating.  The MeshData overloads
+	// resize the vectors and fill them the same way, so regenerating into a MeshData
+	// that is already large enough does not allocate either.  The vertex count must fit
+	// the index type; see IndicesFit().
+	static MeshCounts BoxCounts();
+	template <typename IndexT>
+	void CreateBox(float width, float height, float depth, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void CreateBox(float width, float height, float depth, Vertex* vertices, IndexT* indices);
+
+	static MeshCounts SphereCounts(UINT sliceCount, UINT stackCount);
+	template <typename IndexT>
+	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, Vertex* vertices, IndexT* indices);
+
+	// Splits every triangle in four, sharing the midpoints of shared edges.  Only sets
+	// the positions of the new vertices.
+	template <typename IndexT>
+	void Subdivide(BasicMeshData<IndexT>& meshData);
+
+	// The triangles are in the order numSubdivisions calls of Subdivide on an
+	// icosahedron would leave them in, but built in one pass.
+	static const UINT MaxGeosphereSubdivisions = 8;
+	static MeshCounts GeosphereCounts(UINT numSubdivisions);
+	template <typename IndexT>
+	void CreateGeosphere(float radius, UINT numSubdivisions, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void CreateGeosphere(float radius, UINT numSubdivisions, Vertex* vertices, IndexT* indices);
+
+	static MeshCounts CylinderCounts(UINT sliceCount, UINT stackCount);
+	template <typename IndexT>
+	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, Vertex* vertices, IndexT* indices);
+
+	// Append sliceCount + 2 vertices and 3 * sliceCount indices; the array overloads
+	// number the vertices from baseIndex.
+	template <typename IndexT>
+	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, UINT baseIndex, Vertex* vertices, IndexT* indices);
+	template <typename IndexT>
+	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, UINT baseIndex, Vertex* vertices, IndexT* indices);
+
+	static MeshCounts GridCounts(UINT m, UINT n);
+	template <typename IndexT>
+	void CreateGrid(float width, float depth, UINT m, UINT n, BasicMeshData<IndexT>& meshData);
+	template <typename IndexT>
+	void CreateGrid(float width, float depth, UINT m, UINT n, Vertex* vertices, IndexT* indices);
+
+	// The same grid as CreateGrid(), handed to the callback chunkRows quad rows at a
+	// time instead of being built whole, so memory is bounded by the chunk size and not
+	// by the grid.  With a thread pool the callback runs on the pool threads, for
+	// different chunks at the same time and in no particular order; each thread has
+	// its own chunk, valid until the callback returns.
+	void CreateGridChunks(float width, float depth, UINT m, UINT n, UINT chunkRows,
+		const std::function<void(const GridChunk&)>& callback);
+
+private:
+	// Vertices of grid rows [firstRow, firstRow + rowCount), and the indices of the quads
+	// below rows [firstRow, firstRow + quadRowCount) numbered from vertex baseRow * n.
+	static void GridRows(float width, float depth, UINT m, UINT n, UINT firstRow, UINT rowCount, Vertex* vertices);
+	template <typename IndexT>
+	static void GridQuads(UINT n, UINT firstRow, UINT quadRowCount, UINT baseRow, IndexT* indices);
+
+
+	// Index of the midpoint of edge (i0, i1), appended to the vertices the first time
+	// the edge comes up.
+	static UINT GetMidpoint(UINT i0, UINT i1, std::unordered_map<UINT64, UINT>& midpoints, std::vector<Vertex>& vertices);
+
+	// Index of the point step / n of the way from corner from to corner to along the
+	// given icosahedron edge, for CreateGeosphere.
+	static UINT EdgePoint(UINT from, UINT to, UINT step, UINT n, UINT edge, UINT edgeBase);
+
+	// Moves the vertices onto the sphere and derives normals, texture coordinates and
+	// tangents from their positions.
+	void ProjectOntoSphere(float radius, Vertex* vertices, UINT vertexCount);
+
+	static const DirectX::XMFLOAT3 IcosahedronPositions[12];
+	static const UINT IcosahedronIndices[60];
+
+	ThreadPool* mThreadPool;
 };
 
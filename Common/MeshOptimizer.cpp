@@ -0,0 +1,604 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include "MathHelper.h"
+
+#include <algorithm>
+#include <climits>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+const UINT MeshOptimizer::DefaultCacheSize;
+const UINT MeshOptimizer::DefaultOverdrawViewSize;
+
+namespace
+{
+	// Forsyth's vertex scores.  The three vertices of the last triangle score the same,
+	// so the order they went in does not matter; after them the score decays through
+	// the rest of an LRU cache.  Vertices with few triangles left get a boost, so they
+	// are finished off rather than leaving lone triangles behind.
+	const UINT ForsythCacheSize = 32;
+	const UINT ForsythMaxValence = 32;
+	const float ForsythCacheDecayPower = 1.5f;
+	const float ForsythLastTriangleScore = 0.75f;
+	const float ForsythValenceBoostScale = 2.0f;
+	const float ForsythValenceBoostPower = 0.5f;
+
+	// Clusters shorter than this are not cut from the triangles around them.
+	const UINT MinClusterTriangles = 8;
+
+	// Width and height of the views OptimizeOverdraw() compares orders in, and the
+	// share the overdraw must drop by there to keep the new order.  Orders of a convex
+	// mesh only differ by which of two triangles meeting at a pixel shades it.
+	const UINT OverdrawCheckViewSize = 64;
+	const float MinOverdrawGain = 0.01f;
+
+	// Cuts OptimizeOverdraw() tries, each at half the excess over the cache order of
+	// the last, before keeping the cache order.
+	const UINT ClusterAttempts = 4;
+
+	// FIFO cache simulation on time stamps: a vertex is in the cache while fewer than
+	// cacheSize misses happened since it went in.  Starting over only needs the clock
+	// to move on by the cache size.
+	class FifoCache
+	{
+	public:
+		FifoCache(UINT vertexCount, UINT cacheSize)
+			: mEntered(vertexCount, 0), mTime(cacheSize), mCacheSize(cacheSize)
+		{
+		}
+
+		// Whether the vertex missed the cache; it is in the cache afterwards.
+		bool Miss(UINT v)
+		{
+			if (mTime - mEntered[v] < mCacheSize)
+				return false;
+
+			++mTime;
+			mEntered[v] = mTime;
+			return true;
+		}
+
+		void Flush() { mTime += mCacheSize; }
+
+	private:
+		std::vector<UINT> mEntered;
+		UINT mTime;
+		UINT mCacheSize;
+	};
+
+	const XMFLOAT3& PositionAt(const void* vertices, UINT vertexStride, UINT positionOffset, UINT v)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(static_cast<const BYTE*>(vertices) + v*vertexStride + positionOffset);
+	}
+
+	// Cuts soft boundaries into the hard clusters, where a cluster so far got its misses
+	// down to clusterThreshold times the average of the hard cluster it is cut from,
+	// and writes the clusters to output by how far out of the mesh they face.
+	template <typename IndexT>
+	void OrderClusters(const IndexT* indices, UINT triangleCount, const void* vertices, UINT vertexCount,
+		UINT vertexStride, UINT positionOffset, const std::vector<UINT>& hardStarts, const std::vector<UINT>& hardMisses,
+		float clusterThreshold, std::vector<IndexT>& output)
+	{
+		std::vector<UINT> clusterStarts;
+		{
+			FifoCache cache(vertexCount, MeshOptimizer::DefaultCacheSize);
+			for (size_t h = 0; h + 1 < hardStarts.size(); ++h)
+			{
+				UINT begin = hardStarts[h];
+				UINT end = hardStarts[h + 1];
+				float acmrLimit = clusterThreshold * hardMisses[h] / (end - begin);
+
+				cache.Flush();
+				clusterStarts.push_back(begin);
+
+				UINT start = begin;
+				UINT misses = 0;
+				for (UINT t = begin; t < end; ++t)
+				{
+					for (UINT c = 0; c < 3; ++c)
+						misses += cache.Miss(indices[t * 3 + c]) ? 1 : 0;
+
+					UINT count = t + 1 - start;
+					if (t + 1 < end && count >= MinClusterTriangles && misses <= acmrLimit * count)
+					{
+						start = t + 1;
+						misses = 0;
+						cache.Flush();
+						clusterStarts.push_back(start);
+					}
+				}
+			}
+		}
+		UINT clusterCount = static_cast<UINT>(clusterStarts.size());
+		clusterStarts.push_back(triangleCount);
+
+		//
+		// Sort the clusters by how far out of the mesh they face: the dot product of the
+		// cluster normal with the offset of the cluster from the center of the mesh.  The
+		// centers are weighted by triangle area.
+		//
+
+		std::vector<XMFLOAT3> clusterCenter(clusterCount);
+		std::vector<XMFLOAT3> clusterNormal(clusterCount);
+		XMVECTOR meshCenter = XMVectorZero();
+		float meshArea = 0.0f;
+
+		for (UINT c = 0; c < clusterCount; ++c)
+		{
+			XMVECTOR center = XMVectorZero();
+			XMVECTOR normal = XMVectorZero();
+			XMVECTOR cornerSum = XMVectorZero();
+			float area = 0.0f;
+
+			for (UINT t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+			{
+				XMVECTOR p0 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, indices[t * 3]));
+				XMVECTOR p1 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, indices[t * 3 + 1]));
+				XMVECTOR p2 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, indices[t * 3 + 2]));
+
+				// Twice the area times the unit normal.
+				XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+				float a = XMVectorGetX(XMVector3Length(n));
+
+				center += (a / 3.0f)*(p0 + p1 + p2);
+				cornerSum += p0 + p1 + p2;
+				normal += n;
+				area += a;
+			}
+
+			meshCenter += center;
+			meshArea += area;
+
+			// A cluster of degenerate triangles has no area to weight by.
+			UINT cornerCount = (clusterStarts[c + 1] - clusterStarts[c]) * 3;
+			center = area > 0.0f ? center / area : cornerSum / float(cornerCount);
+
+			XMStoreFloat3(&clusterCenter[c], center);
+			XMStoreFloat3(&clusterNormal[c], XMVector3Normalize(normal));
+		}
+
+		if (meshArea > 0.0f)
+			meshCenter /= meshArea;
+
+		std::vector<float> sortKey(clusterCount);
+		for (UINT c = 0; c < clusterCount; ++c)
+		{
+			XMVECTOR offset = XMLoadFloat3(&clusterCenter[c]) - meshCenter;
+			XMVECTOR normal = XMLoadFloat3(&clusterNormal[c]);
+			float key = XMVectorGetX(XMVector3Dot(offset, normal));
+
+			// Normalizing a zero normal gives NaN; such clusters face nowhere.
+			sortKey[c] = key == key ? key : 0.0f;
+		}
+
+		std::vector<UINT> order(clusterCount);
+		for (UINT c = 0; c < clusterCount; ++c)
+			order[c] = c;
+
+		std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b) { return sortKey[a] > sortKey[b]; });
+
+		output.clear();
+		output.reserve(triangleCount * 3);
+		for (UINT i = 0; i < clusterCount; ++i)
+		{
+			UINT c = order[i];
+			output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+		}
+	}
+}
+
+template <typename IndexT>
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const IndexT* indices, UINT indexCount, UINT vertexCount,
+	UINT cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	UINT usedCount = 0;
+
+	VertexCacheStats stats;
+	stats.TransformCount = 0;
+
+	for (UINT k = 0; k < indexCount; ++k)
+	{
+		UINT v = indices[k];
+		if (cache.Miss(v))
+			++stats.TransformCount;
+
+		if (!used[v])
+		{
+			used[v] = true;
+			++usedCount;
+		}
+	}
+
+	UINT triangleCount = indexCount / 3;
+	stats.Acmr = triangleCount > 0 ? float(stats.TransformCount) / triangleCount : 0.0f;
+	stats.Atvr = usedCount > 0 ? float(stats.TransformCount) / usedCount : 0.0f;
+
+	return stats;
+}
+
+template <typename IndexT>
+float MeshOptimizer::AnalyzeOverdraw(const IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+	UINT vertexStride, UINT positionOffset, UINT viewSize)
+{
+	int size = static_cast<int>(viewSize);
+
+	XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (UINT v = 0; v < vertexCount; ++v)
+	{
+		const XMFLOAT3& p = PositionAt(vertices, vertexStride, positionOffset, v);
+		lo = XMFLOAT3(MathHelper::Min(lo.x, p.x), MathHelper::Min(lo.y, p.y), MathHelper::Min(lo.z, p.z));
+		hi = XMFLOAT3(MathHelper::Max(hi.x, p.x), MathHelper::Max(hi.y, p.y), MathHelper::Max(hi.z, p.z));
+	}
+
+	std::vector<float> depth(size*size);
+	UINT shaded = 0;
+	UINT covered = 0;
+
+	for (int view = 0; view < 6; ++view)
+	{
+		// Screen axes u and w and the depth axis d, looking down +d or -d.
+		int d = view / 2;
+		int u = (d + 1) % 3;
+		int w = (d + 2) % 3;
+		float sign = (view % 2 == 0) ? 1.0f : -1.0f;
+
+		const float* los = &lo.x;
+		const float* his = &hi.x;
+		float scaleU = (size - 1) / MathHelper::Max(his[u] - los[u], 1e-6f);
+		float scaleW = (size - 1) / MathHelper::Max(his[w] - los[w], 1e-6f);
+
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+		for (UINT t = 0; t + 2 < indexCount; t += 3)
+		{
+			float x[3], y[3], z[3];
+			const float* p[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				p[c] = &PositionAt(vertices, vertexStride, positionOffset, indices[t + c]).x;
+				x[c] = (p[c][u] - los[u]) * scaleU;
+				y[c] = (p[c][w] - los[w]) * scaleW;
+				z[c] = sign * p[c][d];
+			}
+
+			// (p1 - p0) x (p2 - p0) points out of the front face; only its d component
+			// matters here.
+			float normalD = (p[1][u] - p[0][u]) * (p[2][w] - p[0][w]) - (p[1][w] - p[0][w]) * (p[2][u] - p[0][u]);
+			if (sign * normalD >= 0.0f)
+				continue;
+
+			float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if (area == 0.0f)
+				continue;
+
+			int x0 = MathHelper::Max(0, (int)floorf(MathHelper::Min(x[0], MathHelper::Min(x[1], x[2]))));
+			int x1 = MathHelper::Min(size - 1, (int)ceilf(MathHelper::Max(x[0], MathHelper::Max(x[1], x[2]))));
+			int y0 = MathHelper::Max(0, (int)floorf(MathHelper::Min(y[0], MathHelper::Min(y[1], y[2]))));
+			int y1 = MathHelper::Min(size - 1, (int)ceilf(MathHelper::Max(y[0], MathHelper::Max(y[1], y[2]))));
+
+			for (int py = y0; py <= y1; ++py)
+			{
+				for (int px = x0; px <= x1; ++px)
+				{
+					float sx = px + 0.5f;
+					float sy = py + 0.5f;
+
+					// Barycentric coordinates, of either winding.
+					float b0 = ((x[1] - sx) * (y[2] - sy) - (x[2] - sx) * (y[1] - sy)) / area;
+					float b1 = ((x[2] - sx) * (y[0] - sy) - (x[0] - sx) * (y[2] - sy)) / area;
+					float b2 = 1.0f - b0 - b1;
+					if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+						continue;
+
+					float pz = b0 * z[0] + b1 * z[1] + b2 * z[2];
+					float& stored = depth[py*size + px];
+					if (pz < stored)
+					{
+						stored = pz;
+						++shaded;
+					}
+				}
+			}
+		}
+
+		for (int i = 0; i < size*size; ++i)
+			covered += depth[i] < FLT_MAX ? 1 : 0;
+	}
+
+	return covered > 0 ? float(shaded) / covered : 0.0f;
+}
+
+template <typename IndexT>
+void MeshOptimizer::OptimizeVertexCache(IndexT* indices, UINT indexCount, UINT vertexCount)
+{
+	UINT triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Score tables.
+	float cacheScore[ForsythCacheSize];
+	for (UINT p = 0; p < ForsythCacheSize; ++p)
+	{
+		if (p < 3)
+			cacheScore[p] = ForsythLastTriangleScore;
+		else
+			cacheScore[p] = powf(1.0f - float(p - 3) / (ForsythCacheSize - 3), ForsythCacheDecayPower);
+	}
+
+	float valenceScore[ForsythMaxValence + 1];
+	valenceScore[0] = 0.0f;
+	for (UINT r = 1; r <= ForsythMaxValence; ++r)
+		valenceScore[r] = ForsythValenceBoostScale * powf(float(r), -ForsythValenceBoostPower);
+
+	auto score = [&](int cachePosition, UINT remaining) -> float
+	{
+		if (remaining == 0)
+			return -1.0f;
+
+		float s = cachePosition >= 0 ? cacheScore[cachePosition] : 0.0f;
+		return s + valenceScore[MathHelper::Min(remaining, ForsythMaxValence)];
+	};
+
+	// Triangles of each vertex.  The first remaining[v] of them are the ones not drawn
+	// yet.
+	std::vector<UINT> remaining(vertexCount, 0);
+	for (UINT k = 0; k < indexCount; ++k)
+		++remaining[indices[k]];
+
+	std::vector<UINT> firstTriangle(vertexCount + 1, 0);
+	for (UINT v = 0; v < vertexCount; ++v)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+	std::vector<UINT> triangles(indexCount);
+	std::vector<UINT> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (UINT k = 0; k < indexCount; ++k)
+		triangles[fill[indices[k]]++] = k / 3;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (UINT v = 0; v < vertexCount; ++v)
+		vertexScore[v] = score(-1, remaining[v]);
+
+	auto triangleScore = [&](UINT t) -> float
+	{
+		return vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	};
+
+	std::vector<bool> drawn(triangleCount, false);
+
+	int best = 0;
+	float bestScore = triangleScore(0);
+	for (UINT t = 1; t < triangleCount; ++t)
+	{
+		float s = triangleScore(t);
+		if (s > bestScore)
+		{
+			bestScore = s;
+			best = t;
+		}
+	}
+
+	// LRU cache, most recent first, with room for the three vertices pushed in before
+	// the ones falling out are dropped.
+	UINT cache[ForsythCacheSize + 3];
+	UINT cacheCount = 0;
+
+	std::vector<IndexT> output(triangleCount * 3);
+	UINT nextUndrawn = 0;
+
+	for (UINT out = 0; out < triangleCount; ++out)
+	{
+		// Nothing left around the cache: carry on with the next triangle in input order.
+		if (best < 0)
+		{
+			while (drawn[nextUndrawn])
+				++nextUndrawn;
+			best = nextUndrawn;
+		}
+
+		UINT t = best;
+		drawn[t] = true;
+		UINT corners[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+		output[out * 3] = static_cast<IndexT>(corners[0]);
+		output[out * 3 + 1] = static_cast<IndexT>(corners[1]);
+		output[out * 3 + 2] = static_cast<IndexT>(corners[2]);
+
+		// Take the triangle off its vertices' lists.
+		for (UINT c = 0; c < 3; ++c)
+		{
+			UINT v = corners[c];
+			UINT* list = &triangles[firstTriangle[v]];
+			UINT* end = list + remaining[v];
+			UINT* it = std::find(list, end, t);
+			std::swap(*it, *(end - 1));
+			--remaining[v];
+		}
+
+		// Push the corners to the front of the cache.
+		UINT newCache[ForsythCacheSize + 3];
+		UINT newCount = 0;
+		for (UINT c = 0; c < 3; ++c)
+		{
+			if (std::find(newCache, newCache + newCount, corners[c]) == newCache + newCount)
+				newCache[newCount++] = corners[c];
+		}
+		UINT cornerCount = newCount;
+		for (UINT i = 0; i < cacheCount; ++i)
+		{
+			if (std::find(newCache, newCache + cornerCount, cache[i]) == newCache + cornerCount)
+				newCache[newCount++] = cache[i];
+		}
+
+		// Rescore the vertices in the cache and those that just fell out of it.
+		for (UINT i = 0; i < newCount; ++i)
+		{
+			UINT v = newCache[i];
+			cachePosition[v] = i < ForsythCacheSize ? int(i) : -1;
+			vertexScore[v] = score(cachePosition[v], remaining[v]);
+		}
+
+		// The next triangle is the best one touching them.
+		best = -1;
+		bestScore = -1.0f;
+		for (UINT i = 0; i < newCount; ++i)
+		{
+			UINT v = newCache[i];
+			for (UINT a = firstTriangle[v]; a < firstTriangle[v] + remaining[v]; ++a)
+			{
+				UINT u = triangles[a];
+				float s = triangleScore(u);
+				if (s > bestScore)
+				{
+					bestScore = s;
+					best = u;
+				}
+			}
+		}
+
+		cacheCount = MathHelper::Min(newCount, ForsythCacheSize);
+		memcpy(cache, newCache, sizeof(UINT) * cacheCount);
+	}
+
+	// Meshes exported already optimized can come out worse, so they keep their order.
+	if (AnalyzeVertexCache(&output[0], indexCount, vertexCount).TransformCount <
+		AnalyzeVertexCache(indices, indexCount, vertexCount).TransformCount)
+		std::copy(output.begin(), output.end(), indices);
+}
+
+template <typename IndexT>
+void MeshOptimizer::OptimizeOverdraw(IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+	UINT vertexStride, UINT positionOffset, float threshold)
+{
+	UINT triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	//
+	// Cut the triangles into clusters.  Hard boundaries are where all three vertices
+	// of a triangle miss the cache, so starting a cluster there costs nothing; the soft
+	// boundaries inside those are left to OrderClusters().
+	//
+
+	std::vector<UINT> hardStarts;
+	std::vector<UINT> hardMisses;
+	{
+		FifoCache cache(vertexCount, DefaultCacheSize);
+		for (UINT t = 0; t < triangleCount; ++t)
+		{
+			UINT misses = 0;
+			for (UINT c = 0; c < 3; ++c)
+				misses += cache.Miss(indices[t * 3 + c]) ? 1 : 0;
+
+			if (t == 0 || misses == 3)
+			{
+				hardStarts.push_back(t);
+				hardMisses.push_back(0);
+			}
+			hardMisses.back() += misses;
+		}
+	}
+	hardStarts.push_back(triangleCount);
+
+	//
+	// Try the cuts at threshold first, and closer to the cache order each time the
+	// whole mesh comes out over it: the cuts only bound each cluster against the
+	// triangles it came from, and the seams between reordered clusters cost misses of
+	// their own.  Keep the new order only if it also draws with less overdraw; convex
+	// meshes have none to lose.
+	//
+
+	UINT transformLimit = static_cast<UINT>(threshold * AnalyzeVertexCache(indices, triangleCount * 3,
+		vertexCount).TransformCount);
+	std::vector<IndexT> output;
+	for (UINT attempt = 0; attempt < ClusterAttempts; ++attempt)
+	{
+		float clusterThreshold = 1.0f + (threshold - 1.0f) / static_cast<float>(1 << attempt);
+		OrderClusters(indices, triangleCount, vertices, vertexCount, vertexStride, positionOffset, hardStarts,
+			hardMisses, clusterThreshold, output);
+		if (AnalyzeVertexCache(&output[0], triangleCount * 3, vertexCount).TransformCount > transformLimit)
+			continue;
+
+		float overdraw = AnalyzeOverdraw(indices, triangleCount * 3, vertices, vertexCount, vertexStride,
+			positionOffset, OverdrawCheckViewSize);
+		if (AnalyzeOverdraw(&output[0], triangleCount * 3, vertices, vertexCount, vertexStride, positionOffset,
+			OverdrawCheckViewSize) < (1.0f - MinOverdrawGain) * overdraw)
+			std::copy(output.begin(), output.end(), indices);
+		return;
+	}
+}
+
+template <typename IndexT>
+UINT MeshOptimizer::OptimizeVertexFetch(void* vertices, UINT vertexCount, UINT vertexStride, IndexT* indices, UINT indexCount)
+{
+	std::vector<UINT> remap(vertexCount, UINT_MAX);
+	UINT newCount = 0;
+
+	for (UINT k = 0; k < indexCount; ++k)
+	{
+		UINT v = indices[k];
+		if (remap[v] == UINT_MAX)
+			remap[v] = newCount++;
+
+		indices[k] = static_cast<IndexT>(remap[v]);
+	}
+
+	BYTE* data = static_cast<BYTE*>(vertices);
+	std::vector<BYTE> source(data, data + vertexCount*vertexStride);
+
+	for (UINT v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] != UINT_MAX)
+			memcpy(data + remap[v] * vertexStride, &source[v*vertexStride], vertexStride);
+	}
+
+	return newCount;
+}
+
+template <typename IndexT>
+UINT MeshOptimizer::Optimize(void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset,
+	IndexT* indices, UINT indexCount)
+{
+	OptimizeVertexCache(indices, indexCount, vertexCount);
+	OptimizeOverdraw(indices, indexCount, vertices, vertexCount, vertexStride, positionOffset);
+	return OptimizeVertexFetch(vertices, vertexCount, vertexStride, indices, indexCount);
+}
+
+template <typename IndexT>
+void MeshOptimizer::Optimize(GeometryGenerator::BasicMeshData<IndexT>& meshData)
+{
+	if (meshData.Indices.empty())
+		return;
+
+	UINT vertexCount = Optimize(&meshData.Vertices[0], static_cast<UINT>(meshData.Vertices.size()),
+		sizeof(GeometryGenerator::Vertex), offsetof(GeometryGenerator::Vertex, Position),
+		&meshData.Indices[0], static_cast<UINT>(meshData.Indices.size()));
+
+	meshData.Vertices.resize(vertexCount);
+}
+
+//
+// The passes for both index widths.
+//
+
+#define INSTANTIATE_MESH_OPTIMIZER(IndexT) \
+	template MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const IndexT*, UINT, UINT, UINT); \
+	template float MeshOptimizer::AnalyzeOverdraw(const IndexT*, UINT, const void*, UINT, UINT, UINT, UINT); \
+	template void MeshOptimizer::OptimizeVertexCache(IndexT*, UINT, UINT); \
+	template void MeshOptimizer::OptimizeOverdraw(IndexT*, UINT, const void*, UINT, UINT, UINT, float); \
+	template UINT MeshOptimizer::OptimizeVertexFetch(void*, UINT, UINT, IndexT*, UINT); \
+	template UINT MeshOptimizer::Optimize(void*, UINT, UINT, UINT, IndexT*, UINT); \
+	template void MeshOptimizer::Optimize(GeometryGenerator::BasicMeshData<IndexT>&);
+
+INSTANTIATE_MESH_OPTIMIZER(UINT)
+INSTANTIATE_MESH_OPTIMIZER(USHORT)
@@ -0,0 +1,86 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders the triangles and vertices of indexed triangle lists for drawing.  First the
+// triangles, for the post-transform vertex cache (Forsyth's linear-speed algorithm);
+// then clusters of those triangles, so the ones facing out of the mesh draw first and
+// hide what lies behind them (Sander, Nehab and Barczak's fast triangle reordering);
+// last the vertices, in the order the triangles first use them, so vertex fetch reads
+// memory front to back.  Every pass takes time linear in the triangles, apart from
+// sorting the far fewer clusters, so meshes can be optimized as they are loaded.
+//***************************************************************************************
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <Windows.h>
+
+#include "GeometryGenerator.h"
+
+class MeshOptimizer
+{
+public:
+	// Behavior of an index list on a FIFO post-transform cache.
+	struct VertexCacheStats
+	{
+		// Vertices transformed per triangle: 3 at worst, close to 0.5 at best on large
+		// closed meshes.
+		float Acmr;
+
+		// Vertices transformed per vertex used, 1 at best.
+		float Atvr;
+
+		UINT TransformCount;
+	};
+
+	// Cache size the statistics default to, a common size for the FIFO caches of
+	// current GPUs.
+	static const UINT DefaultCacheSize = 16;
+
+	template <typename IndexT>
+	static VertexCacheStats AnalyzeVertexCache(const IndexT* indices, UINT indexCount, UINT vertexCount,
+		UINT cacheSize = DefaultCacheSize);
+
+	// Width and height in pixels of the views overdraw is measured in by default.
+	static const UINT DefaultOverdrawViewSize = 256;
+
+	// Pixels shaded per pixel covered, averaged over orthographic views of the mesh
+	// bounds along the six axis directions, with a depth test and back faces culled.
+	// A stand-in for the overdraw of a real view, to compare triangle orders by.  The
+	// positions are as for OptimizeOverdraw().
+	template <typename IndexT>
+	static float AnalyzeOverdraw(const IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+		UINT vertexStride, UINT positionOffset, UINT viewSize = DefaultOverdrawViewSize);
+
+	// Reorders the triangles for the vertex cache, unless their order already has fewer
+	// cache misses.  Triangles keep their winding.
+	template <typename IndexT>
+	static void OptimizeVertexCache(IndexT* indices, UINT indexCount, UINT vertexCount);
+
+	// Reorders clusters of triangles that were already ordered for the vertex cache, so
+	// clusters facing away from the center of the mesh come first.  A cluster ends
+	// where the cache starts over anyway, or where ending it costs no more than
+	// threshold times the cache misses of the triangles it was cut from, tightened
+	// until the whole mesh misses the cache no more than threshold times as often as
+	// before.  The triangles keep their order unless that also leaves AnalyzeOverdraw()
+	// finding less overdraw.  The positions are the XMFLOAT3 at positionOffset bytes
+	// into each vertex of vertexStride bytes.
+	template <typename IndexT>
+	static void OptimizeOverdraw(IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+		UINT vertexStride, UINT positionOffset, float threshold = 1.05f);
+
+	// Moves the vertices into the order the triangles first use them, drops the ones
+	// no triangle uses and renumbers the indices to match.  Returns the new vertex
+	// count.
+	template <typename IndexT>
+	static UINT OptimizeVertexFetch(void* vertices, UINT vertexCount, UINT vertexStride, IndexT* indices, UINT indexCount);
+
+	// All three passes, in the order above.  Returns the new vertex count.
+	template <typename IndexT>
+	static UINT Optimize(void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset,
+		IndexT* indices, UINT indexCount);
+	template <typename IndexT>
+	static void Optimize(GeometryGenerator::BasicMeshData<IndexT>& meshData);
+};
+
+#endif // MESHOPTIMIZER_H
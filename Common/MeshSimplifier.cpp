@@ -0,0 +1,1029 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "ProgressiveMesh.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <queue>
+
+using namespace DirectX;
+
+namespace
+{
+	// How much more it costs to move a border or seam off the line of its edges than
+	// to move a surface off its plane.
+	const float EdgeWeight = 10.0f;
+
+	// The fewest triangles worth a region of their own when simplifying in parallel,
+	// and the most regions a mesh is cut into.  Neither depends on the threads, so the
+	// result is the same on any pool that cuts the mesh at all.
+	const UINT MinRegionTriangles = 4096;
+	const UINT MaxRegions = 16;
+
+	// Sum of planes, each weighted by the area it came from, as the symmetric matrix
+	// A, vector B and constant C of the squared distance p.A.p + 2 B.p + C.
+	struct Quadric
+	{
+		float A00, A01, A02, A11, A12, A22;
+		float B0, B1, B2;
+		float C;
+		float Weight;
+	};
+
+	void AddPlane(Quadric& q, const XMFLOAT3& n, float d, float weight)
+	{
+		q.A00 += weight*n.x*n.x;
+		q.A01 += weight*n.x*n.y;
+		q.A02 += weight*n.x*n.z;
+		q.A11 += weight*n.y*n.y;
+		q.A12 += weight*n.y*n.z;
+		q.A22 += weight*n.z*n.z;
+		q.B0 += weight*n.x*d;
+		q.B1 += weight*n.y*d;
+		q.B2 += weight*n.z*d;
+		q.C += weight*d*d;
+		q.Weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& r)
+	{
+		q.A00 += r.A00;
+		q.A01 += r.A01;
+		q.A02 += r.A02;
+		q.A11 += r.A11;
+		q.A12 += r.A12;
+		q.A22 += r.A22;
+		q.B0 += r.B0;
+		q.B1 += r.B1;
+		q.B2 += r.B2;
+		q.C += r.C;
+		q.Weight += r.Weight;
+	}
+
+	// Mean squared distance from p to the planes, weighted by their areas.
+	float QuadricError(const Quadric& q, const XMFLOAT3& p)
+	{
+		float rx = q.A00*p.x + q.A01*p.y + q.A02*p.z;
+		float ry = q.A01*p.x + q.A11*p.y + q.A12*p.z;
+		float rz = q.A02*p.x + q.A12*p.y + q.A22*p.z;
+		float e = rx*p.x + ry*p.y + rz*p.z + 2.0f*(q.B0*p.x + q.B1*p.y + q.B2*p.z) + q.C;
+
+		return q.Weight > 0.0f ? fabsf(e) / q.Weight : 0.0f;
+	}
+
+	enum VertexKind
+	{
+		// Inside the surface, with one set of attributes.
+		Manifold,
+		// On one open border.
+		Border,
+		// Split in two along one attribute seam.
+		Seam,
+		// Anything else, corners of seams and borders included; never moved.
+		Locked
+	};
+
+	// Positions shared by every collapser working on one vertex buffer.
+	struct VertexInfo
+	{
+		// Scaled into the unit cube, so errors are fractions of the mesh size.
+		std::vector<XMFLOAT3> Positions;
+
+		// Lowest vertex at the same position, which stands for all of them.
+		std::vector<UINT> Remap;
+
+		// Next vertex at the same position, around a ring through all of them.
+		std::vector<UINT> Wedge;
+	};
+
+	void BuildVertexInfo(const void* vertices, UINT vertexCount, UINT vertexStride, UINT positionOffset, VertexInfo& info)
+	{
+		info.Positions.resize(vertexCount);
+		for (UINT v = 0; v < vertexCount; ++v)
+			info.Positions[v] = *reinterpret_cast<const XMFLOAT3*>(static_cast<const BYTE*>(vertices) + v*vertexStride + positionOffset);
+
+		XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			const XMFLOAT3& p = info.Positions[v];
+			lo = XMFLOAT3(MathHelper::Min(lo.x, p.x), MathHelper::Min(lo.y, p.y), MathHelper::Min(lo.z, p.z));
+			hi = XMFLOAT3(MathHelper::Max(hi.x, p.x), MathHelper::Max(hi.y, p.y), MathHelper::Max(hi.z, p.z));
+		}
+
+		float extent = MathHelper::Max(hi.x - lo.x, MathHelper::Max(hi.y - lo.y, hi.z - lo.z));
+		float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+		// Sorting by position puts the vertices that share one next to each other.
+		std::vector<UINT> order(vertexCount);
+		for (UINT v = 0; v < vertexCount; ++v)
+			order[v] = v;
+
+		const std::vector<XMFLOAT3>& positions = info.Positions;
+		std::sort(order.begin(), order.end(), [&](UINT a, UINT b)
+		{
+			const XMFLOAT3& pa = positions[a];
+			const XMFLOAT3& pb = positions[b];
+			if (pa.x != pb.x)
+				return pa.x < pb.x;
+			if (pa.y != pb.y)
+				return pa.y < pb.y;
+			if (pa.z != pb.z)
+				return pa.z < pb.z;
+			return a < b;
+		});
+
+		info.Remap.resize(vertexCount);
+		info.Wedge.resize(vertexCount);
+		for (UINT i = 0; i < vertexCount;)
+		{
+			const XMFLOAT3& p = positions[order[i]];
+			UINT end = i + 1;
+			while (end < vertexCount && positions[order[end]].x == p.x && positions[order[end]].y == p.y &&
+				positions[order[end]].z == p.z)
+			{
+				++end;
+			}
+
+			for (UINT k = i; k < end; ++k)
+			{
+				info.Remap[order[k]] = order[i];
+				info.Wedge[order[k]] = order[k + 1 < end ? k + 1 : i];
+			}
+			i = end;
+		}
+
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			XMFLOAT3& p = info.Positions[v];
+			p = XMFLOAT3((p.x - lo.x)*scale, (p.y - lo.y)*scale, (p.z - lo.z)*scale);
+		}
+	}
+
+	// One edge collapse waiting in the queue.  The versions tell whether the quadrics
+	// it was priced with have changed since.
+	struct Collapse
+	{
+		float Error;
+		float LengthSq;
+		UINT From;
+		UINT To;
+		UINT FromVersion;
+		UINT ToVersion;
+
+		// Smallest error first out of std::priority_queue, and of equal errors, as on flat
+		// parts of a mesh, the shortest edge, so one vertex does not swallow all of them.
+		bool operator<(const Collapse& rhs)const
+		{
+			return Error != rhs.Error ? Error > rhs.Error : LengthSq > rhs.LengthSq;
+		}
+	};
+
+	// What each collapse changed, so it can be undone as a vertex split.
+	struct CollapseLog
+	{
+		// By collapse: the vertex that went away and the one it moved onto, then the same
+		// across a seam, or UINT_MAX.
+		std::vector<UINT> Vertices;
+
+		// By collapse: where its entries below start.
+		std::vector<UINT> FirstMove;
+		std::vector<UINT> FirstRemoved;
+
+		// Corners of the triangles that survived and moved, as triangle*3 + corner, and
+		// the vertex they held before.
+		std::vector<UINT> MovedCorners;
+		std::vector<UINT> MovedFrom;
+
+		// Triangles the collapse removed, and their corners from before it.
+		std::vector<UINT> Removed;
+		std::vector<UINT> RemovedCorners;
+	};
+
+	// Collapses the edges of one triangle list.  Vertices are tracked by the lowest
+	// vertex at their position; triangles keep the vertices they use, so attributes
+	// stay apart across seams.
+	class EdgeCollapser
+	{
+	public:
+		// locked, when given, holds positions that must not move, by their lowest vertex.
+		template <typename IndexT>
+		EdgeCollapser(const VertexInfo& info, const IndexT* indices, UINT indexCount, const std::vector<bool>* locked);
+
+		// Collapses edges until at most targetIndexCount indices are left or the next
+		// collapse costs more than targetError, a squared distance.  Returns the largest
+		// cost paid.
+		float Run(UINT targetIndexCount, float targetError);
+
+		// Writes the triangles left, in their original order, and returns the index count.
+		template <typename IndexT>
+		UINT Write(IndexT* destination)const;
+
+		// Records every collapse from here on in log.
+		void SetLog(CollapseLog* log) { mLog = log; }
+
+		bool IsRemoved(UINT triangle)const { return mDead[triangle]; }
+		bool IsUsed(UINT vertex)const { return mUsed[vertex]; }
+
+	private:
+		bool IsOpenEdge(UINT a, UINT b)const;
+		UINT OtherWedge(UINT v)const;
+		float CollapseError(UINT from, UINT to)const;
+		bool FlipsTriangle(UINT from, UINT to)const;
+		bool CanCollapse(UINT from, UINT to)const;
+		void PushEdge(UINT a, UINT b);
+		void Perform(UINT from, UINT to);
+
+	private:
+		const VertexInfo& mInfo;
+
+		// Vertices of each triangle, and whether it has collapsed to nothing.
+		std::vector<UINT> mCorners;
+		std::vector<bool> mDead;
+		UINT mTriangleCount;
+
+		// By vertex: whether a live triangle uses it.
+		std::vector<bool> mUsed;
+
+		// By position, under its lowest vertex.
+		std::vector<VertexKind> mKind;
+		std::vector<Quadric> mQuadrics;
+		std::vector<UINT> mVersion;
+		std::vector<bool> mCollapsed;
+		std::vector<std::vector<UINT> > mTriangles;
+
+		// By vertex: the neighbours already queued after the last collapse.
+		std::vector<UINT> mMarks;
+		UINT mMark;
+
+		std::priority_queue<Collapse> mQueue;
+
+		CollapseLog* mLog;
+	};
+
+	template <typename IndexT>
+	EdgeCollapser::EdgeCollapser(const VertexInfo& info, const IndexT* indices, UINT indexCount, const std::vector<bool>* locked)
+		: mInfo(info),
+		mCorners(indices, indices + indexCount - indexCount % 3),
+		mDead(indexCount / 3, false),
+		mTriangleCount(indexCount / 3),
+		mMark(0),
+		mLog(nullptr)
+	{
+		const std::vector<UINT>& remap = info.Remap;
+		UINT vertexCount = static_cast<UINT>(info.Positions.size());
+		indexCount = mTriangleCount * 3;
+
+		mUsed.assign(vertexCount, false);
+		mKind.assign(vertexCount, Locked);
+		Quadric zero = {};
+		mQuadrics.assign(vertexCount, zero);
+		mVersion.assign(vertexCount, 0);
+		mCollapsed.assign(vertexCount, false);
+		mTriangles.resize(vertexCount);
+		mMarks.assign(vertexCount, 0);
+
+		// Triangles drop out as soon as two corners share a position.
+		for (UINT t = 0; t < mTriangleCount; ++t)
+		{
+			UINT r0 = remap[mCorners[t * 3]];
+			UINT r1 = remap[mCorners[t * 3 + 1]];
+			UINT r2 = remap[mCorners[t * 3 + 2]];
+			if (r0 == r1 || r1 == r2 || r2 == r0)
+			{
+				mDead[t] = true;
+				--mTriangleCount;
+				continue;
+			}
+
+			for (UINT c = 0; c < 3; ++c)
+			{
+				mUsed[mCorners[t * 3 + c]] = true;
+				mTriangles[remap[mCorners[t * 3 + c]]].push_back(t);
+			}
+		}
+
+		//
+		// Classify the positions by their open edges: edges of one triangle with no
+		// triangle running the other way between the same two vertices.
+		//
+
+		const UINT none = UINT_MAX;
+		std::vector<UINT> openOut(vertexCount, none);
+		std::vector<UINT> openIn(vertexCount, none);
+
+		for (UINT t = 0; t < mDead.size(); ++t)
+		{
+			if (mDead[t])
+				continue;
+
+			for (UINT c = 0; c < 3; ++c)
+			{
+				UINT a = mCorners[t * 3 + c];
+				UINT b = mCorners[t * 3 + (c + 1) % 3];
+				if (!IsOpenEdge(a, b))
+					continue;
+
+				// The vertex itself stands for more than one open edge.
+				openOut[a] = (openOut[a] == none) ? b : a;
+				openIn[b] = (openIn[b] == none) ? a : b;
+			}
+		}
+
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			if (remap[v] != v || (locked != nullptr && (*locked)[v]))
+				continue;
+
+			UINT wedges[2];
+			UINT wedgeCount = 0;
+			UINT w = v;
+			do
+			{
+				if (mUsed[w])
+				{
+					if (wedgeCount < 2)
+						wedges[wedgeCount] = w;
+					++wedgeCount;
+				}
+				w = info.Wedge[w];
+			} while (w != v);
+
+			if (wedgeCount == 1)
+			{
+				UINT a = wedges[0];
+				if (openOut[a] == none && openIn[a] == none)
+				{
+					mKind[v] = Manifold;
+				}
+				else if (openOut[a] != none && openOut[a] != a && openIn[a] != none && openIn[a] != a)
+				{
+					// A border if nothing at all runs back along its open edges; where a
+					// seam ends at an unsplit vertex it stays locked.
+					bool back = false;
+					const std::vector<UINT>& around = mTriangles[v];
+					for (size_t i = 0; i < around.size() && !back; ++i)
+					{
+						const UINT* corners = &mCorners[around[i] * 3];
+						for (UINT c = 0; c < 3; ++c)
+						{
+							UINT from = remap[corners[c]];
+							UINT to = remap[corners[(c + 1) % 3]];
+							back = back || (from == v && to == remap[openIn[a]]) || (from == remap[openOut[a]] && to == v);
+						}
+					}
+
+					if (!back)
+						mKind[v] = Border;
+				}
+			}
+			else if (wedgeCount == 2)
+			{
+				// A seam if each side has one open edge each way and they pair up with
+				// the other side's.
+				UINT a = wedges[0];
+				UINT b = wedges[1];
+				bool single = openOut[a] != none && openOut[a] != a && openIn[a] != none && openIn[a] != a &&
+					openOut[b] != none && openOut[b] != b && openIn[b] != none && openIn[b] != b;
+
+				if (single && remap[openOut[a]] == remap[openIn[b]] && remap[openIn[a]] == remap[openOut[b]])
+					mKind[v] = Seam;
+			}
+		}
+
+		//
+		// Quadrics: the planes of the triangles, and planes through the open edges at
+		// right angles to their triangles.
+		//
+
+		for (UINT t = 0; t < mDead.size(); ++t)
+		{
+			if (mDead[t])
+				continue;
+
+			UINT r[3];
+			XMVECTOR p[3];
+			for (UINT c = 0; c < 3; ++c)
+			{
+				r[c] = remap[mCorners[t * 3 + c]];
+				p[c] = XMLoadFloat3(&info.Positions[r[c]]);
+			}
+
+			XMVECTOR n = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+			float doubleArea = XMVectorGetX(XMVector3Length(n));
+			if (doubleArea == 0.0f)
+				continue;
+
+			n /= doubleArea;
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, n);
+			float d = -XMVectorGetX(XMVector3Dot(n, p[0]));
+			for (UINT c = 0; c < 3; ++c)
+				AddPlane(mQuadrics[r[c]], normal, d, 0.5f*doubleArea);
+
+			for (UINT c = 0; c < 3; ++c)
+			{
+				UINT next = (c + 1) % 3;
+				if (!IsOpenEdge(mCorners[t * 3 + c], mCorners[t * 3 + next]))
+					continue;
+
+				XMVECTOR edge = p[next] - p[c];
+				float lengthSq = XMVectorGetX(XMVector3LengthSq(edge));
+				XMVECTOR m = XMVector3Normalize(XMVector3Cross(edge, n));
+				XMFLOAT3 edgeNormal;
+				XMStoreFloat3(&edgeNormal, m);
+				float edgeD = -XMVectorGetX(XMVector3Dot(m, p[c]));
+
+				AddPlane(mQuadrics[r[c]], edgeNormal, edgeD, EdgeWeight*lengthSq);
+				AddPlane(mQuadrics[r[next]], edgeNormal, edgeD, EdgeWeight*lengthSq);
+			}
+		}
+
+		for (UINT t = 0; t < mDead.size(); ++t)
+		{
+			if (mDead[t])
+				continue;
+
+			for (UINT c = 0; c < 3; ++c)
+			{
+				// Edges inside the mesh come up once each way; take the one from the lower vertex.
+				UINT a = mCorners[t * 3 + c];
+				UINT b = mCorners[t * 3 + (c + 1) % 3];
+				if (a < b || IsOpenEdge(a, b))
+				{
+					PushEdge(a, b);
+				}
+			}
+		}
+	}
+
+	float EdgeCollapser::Run(UINT targetIndexCount, float targetError)
+	{
+		float maxError = 0.0f;
+
+		while (mTriangleCount * 3 > targetIndexCount && !mQueue.empty())
+		{
+			Collapse collapse = mQueue.top();
+			if (collapse.Error > targetError)
+				break;
+			mQueue.pop();
+
+			UINT from = mInfo.Remap[collapse.From];
+			UINT to = mInfo.Remap[collapse.To];
+			if (mCollapsed[from] || mCollapsed[to] || !mUsed[collapse.From] || !mUsed[collapse.To])
+				continue;
+
+			// Priced before one of the ends took in a collapse; the edges around it were
+			// queued again at their new price then.
+			if (collapse.FromVersion != mVersion[from] || collapse.ToVersion != mVersion[to])
+				continue;
+
+			if (FlipsTriangle(from, to))
+				continue;
+
+			Perform(collapse.From, collapse.To);
+			maxError = MathHelper::Max(maxError, collapse.Error);
+		}
+
+		return maxError;
+	}
+
+	template <typename IndexT>
+	UINT EdgeCollapser::Write(IndexT* destination)const
+	{
+		UINT count = 0;
+		for (UINT t = 0; t < mDead.size(); ++t)
+		{
+			if (mDead[t])
+				continue;
+
+			for (UINT c = 0; c < 3; ++c)
+				destination[count++] = static_cast<IndexT>(mCorners[t * 3 + c]);
+		}
+		return count;
+	}
+
+	// Whether a live triangle runs from vertex a to vertex b and none from b to a.
+	bool EdgeCollapser::IsOpenEdge(UINT a, UINT b)const
+	{
+		bool forward = false;
+		const std::vector<UINT>& around = mTriangles[mInfo.Remap[a]];
+		for (size_t i = 0; i < around.size(); ++i)
+		{
+			if (mDead[around[i]])
+				continue;
+
+			const UINT* corners = &mCorners[around[i] * 3];
+			for (UINT c = 0; c < 3; ++c)
+			{
+				UINT next = corners[(c + 1) % 3];
+				if (corners[c] == b && next == a)
+					return false;
+				forward = forward || (corners[c] == a && next == b);
+			}
+		}
+		return forward;
+	}
+
+	// The other vertex in use at the position of v, on a seam.
+	UINT EdgeCollapser::OtherWedge(UINT v)const
+	{
+		for (UINT w = mInfo.Wedge[v]; w != v; w = mInfo.Wedge[w])
+		{
+			if (mUsed[w])
+				return w;
+		}
+		return v;
+	}
+
+	float EdgeCollapser::CollapseError(UINT from, UINT to)const
+	{
+		Quadric q = mQuadrics[from];
+		AddQuadric(q, mQuadrics[to]);
+		return QuadricError(q, mInfo.Positions[to]);
+	}
+
+	// Whether moving position from onto position to turns a triangle that survives the
+	// collapse over.
+	bool EdgeCollapser::FlipsTriangle(UINT from, UINT to)const
+	{
+		XMVECTOR target = XMLoadFloat3(&mInfo.Positions[to]);
+
+		const std::vector<UINT>& around = mTriangles[from];
+		for (size_t i = 0; i < around.size(); ++i)
+		{
+			if (mDead[around[i]])
+				continue;
+
+			UINT r[3];
+			const UINT* corners = &mCorners[around[i] * 3];
+			for (UINT c = 0; c < 3; ++c)
+				r[c] = mInfo.Remap[corners[c]];
+			if (r[0] == to || r[1] == to || r[2] == to)
+				continue;
+
+			XMVECTOR p[3];
+			XMVECTOR moved[3];
+			for (UINT c = 0; c < 3; ++c)
+			{
+				p[c] = XMLoadFloat3(&mInfo.Positions[r[c]]);
+				moved[c] = (r[c] == from) ? target : p[c];
+			}
+
+			XMVECTOR before = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+			XMVECTOR after = XMVector3Cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (XMVectorGetX(XMVector3Dot(before, after)) <= 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	// Whether vertex from may move onto vertex to, by the kinds of their positions.
+	bool EdgeCollapser::CanCollapse(UINT from, UINT to)const
+	{
+		VertexKind kind = mKind[mInfo.Remap[from]];
+		if (kind == Locked)
+			return false;
+		if (kind == Manifold)
+			return true;
+
+		// Borders and seams only move along themselves.
+		return mKind[mInfo.Remap[to]] == kind && (IsOpenEdge(from, to) || IsOpenEdge(to, from));
+	}
+
+	// Queues the cheaper way to collapse the edge between vertices a and b, if there is one.
+	void EdgeCollapser::PushEdge(UINT a, UINT b)
+	{
+		UINT ra = mInfo.Remap[a];
+		UINT rb = mInfo.Remap[b];
+		if (ra == rb)
+			return;
+
+		float forward = CanCollapse(a, b) ? CollapseError(ra, rb) : FLT_MAX;
+		float backward = CanCollapse(b, a) ? CollapseError(rb, ra) : FLT_MAX;
+		if (forward == FLT_MAX && backward == FLT_MAX)
+			return;
+
+		Collapse collapse;
+		collapse.Error = MathHelper::Min(forward, backward);
+		collapse.LengthSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&mInfo.Positions[rb]) - XMLoadFloat3(&mInfo.Positions[ra])));
+		collapse.From = forward <= backward ? a : b;
+		collapse.To = forward <= backward ? b : a;
+		collapse.FromVersion = mVersion[mInfo.Remap[collapse.From]];
+		collapse.ToVersion = mVersion[mInfo.Remap[collapse.To]];
+		mQueue.push(collapse);
+	}
+
+	void EdgeCollapser::Perform(UINT from, UINT to)
+	{
+		UINT rf = mInfo.Remap[from];
+		UINT rt = mInfo.Remap[to];
+
+		// Across a seam the vertices on the other side move onto each other too.
+		UINT otherFrom = UINT_MAX;
+		UINT otherTo = UINT_MAX;
+		if (mKind[rf] == Seam)
+		{
+			otherFrom = OtherWedge(from);
+			otherTo = OtherWedge(to);
+		}
+
+		if (mLog != nullptr)
+		{
+			UINT vertices[] = { from, to, otherFrom, otherTo };
+			mLog->Vertices.insert(mLog->Vertices.end(), vertices, vertices + 4);
+			mLog->FirstMove.push_back(static_cast<UINT>(mLog->MovedCorners.size()));
+			mLog->FirstRemoved.push_back(static_cast<UINT>(mLog->Removed.size()));
+		}
+
+		std::vector<UINT>& fromTriangles = mTriangles[rf];
+		std::vector<UINT>& toTriangles = mTriangles[rt];
+		for (size_t i = 0; i < fromTriangles.size(); ++i)
+		{
+			UINT t = fromTriangles[i];
+			if (mDead[t])
+				continue;
+
+			UINT* corners = &mCorners[t * 3];
+			UINT before[3] = { corners[0], corners[1], corners[2] };
+			bool touchesTo = false;
+			for (UINT c = 0; c < 3; ++c)
+			{
+				if (corners[c] == from)
+					corners[c] = to;
+				else if (corners[c] == otherFrom)
+					corners[c] = otherTo;
+				else
+					touchesTo = touchesTo || mInfo.Remap[corners[c]] == rt;
+			}
+
+			if (touchesTo)
+			{
+				mDead[t] = true;
+				--mTriangleCount;
+
+				if (mLog != nullptr)
+				{
+					mLog->Removed.push_back(t);
+					mLog->RemovedCorners.insert(mLog->RemovedCorners.end(), before, before + 3);
+				}
+			}
+			else
+			{
+				toTriangles.push_back(t);
+
+				for (UINT c = 0; c < 3 && mLog != nullptr; ++c)
+				{
+					if (corners[c] != before[c])
+					{
+						mLog->MovedCorners.push_back(t * 3 + c);
+						mLog->MovedFrom.push_back(before[c]);
+					}
+				}
+			}
+		}
+		std::vector<UINT>().swap(fromTriangles);
+
+		mUsed[from] = false;
+		if (otherFrom != UINT_MAX)
+			mUsed[otherFrom] = false;
+
+		AddQuadric(mQuadrics[rt], mQuadrics[rf]);
+		mCollapsed[rf] = true;
+		++mVersion[rt];
+
+		// Drop the triangles that died and queue the edges now around the position.
+		size_t kept = 0;
+		for (size_t i = 0; i < toTriangles.size(); ++i)
+		{
+			if (!mDead[toTriangles[i]])
+				toTriangles[kept++] = toTriangles[i];
+		}
+		toTriangles.resize(kept);
+
+		++mMark;
+		for (size_t i = 0; i < toTriangles.size(); ++i)
+		{
+			const UINT* corners = &mCorners[toTriangles[i] * 3];
+			UINT c = (mInfo.Remap[corners[0]] == rt) ? 0 : (mInfo.Remap[corners[1]] == rt ? 1 : 2);
+			for (UINT k = 1; k < 3; ++k)
+			{
+				UINT neighbour = corners[(c + k) % 3];
+				if (mMarks[neighbour] == mMark)
+					continue;
+
+				mMarks[neighbour] = mMark;
+				PushEdge(corners[c], neighbour);
+			}
+		}
+	}
+}
+
+MeshSimplifier::MeshSimplifier()
+	: mThreadPool(nullptr)
+{
+}
+
+template <typename IndexT>
+UINT MeshSimplifier::Simplify(IndexT* destination, const IndexT* indices, UINT indexCount, const void* vertices,
+	UINT vertexCount, UINT vertexStride, UINT positionOffset, UINT targetIndexCount, float targetError, float* resultError)
+{
+	VertexInfo info;
+	BuildVertexInfo(vertices, vertexCount, vertexStride, positionOffset, info);
+
+	float errorSq = (targetError < sqrtf(FLT_MAX)) ? targetError*targetError : FLT_MAX;
+	float maxError = 0.0f;
+
+	UINT triangleCount = indexCount / 3;
+	UINT regionCount = MathHelper::Min(MaxRegions, triangleCount / MinRegionTriangles);
+
+	std::vector<IndexT> regionIndices;
+	if (mThreadPool != nullptr && mThreadPool->ThreadCount() > 1 && regionCount > 1 && targetIndexCount < indexCount)
+	{
+		//
+		// Cut the mesh into slabs along its longest side, simplify each with the
+		// positions they share held in place, and put them back together for the
+		// pass below.
+		//
+
+		XMFLOAT3 extent(0.0f, 0.0f, 0.0f);
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			const XMFLOAT3& p = info.Positions[v];
+			extent = XMFLOAT3(MathHelper::Max(extent.x, p.x), MathHelper::Max(extent.y, p.y), MathHelper::Max(extent.z, p.z));
+		}
+		UINT axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+		std::vector<std::pair<float, UINT> > order(triangleCount);
+		for (UINT t = 0; t < triangleCount; ++t)
+		{
+			const float* p0 = &info.Positions[indices[t * 3]].x;
+			const float* p1 = &info.Positions[indices[t * 3 + 1]].x;
+			const float* p2 = &info.Positions[indices[t * 3 + 2]].x;
+			order[t] = std::make_pair(p0[axis] + p1[axis] + p2[axis], t);
+		}
+		std::sort(order.begin(), order.end());
+
+		std::vector<UINT> triangleRegion(triangleCount);
+		for (UINT i = 0; i < triangleCount; ++i)
+			triangleRegion[order[i].second] = static_cast<UINT>(static_cast<UINT64>(i)*regionCount / triangleCount);
+
+		const UINT none = UINT_MAX;
+		std::vector<UINT> positionRegion(vertexCount, none);
+		std::vector<bool> shared(vertexCount, false);
+		std::vector<std::vector<IndexT> > regions(regionCount);
+		for (UINT t = 0; t < triangleCount; ++t)
+		{
+			UINT region = triangleRegion[t];
+			for (UINT c = 0; c < 3; ++c)
+			{
+				UINT r = info.Remap[indices[t * 3 + c]];
+				if (positionRegion[r] == none)
+					positionRegion[r] = region;
+				else if (positionRegion[r] != region)
+					shared[r] = true;
+
+				regions[region].push_back(indices[t * 3 + c]);
+			}
+		}
+
+		std::vector<float> regionErrors(regionCount, 0.0f);
+		mThreadPool->ParallelFor(regionCount, [&](UINT region, UINT)
+		{
+			std::vector<IndexT>& regionList = regions[region];
+			UINT listCount = static_cast<UINT>(regionList.size());
+			UINT regionTarget = static_cast<UINT>(static_cast<UINT64>(listCount / 3)*targetIndexCount / indexCount) * 3;
+
+			EdgeCollapser collapser(info, &regionList[0], listCount, &shared);
+			regionErrors[region] = collapser.Run(regionTarget, errorSq);
+			regionList.resize(collapser.Write(&regionList[0]));
+		});
+
+		for (UINT region = 0; region < regionCount; ++region)
+		{
+			regionIndices.insert(regionIndices.end(), regions[region].begin(), regions[region].end());
+			maxError = MathHelper::Max(maxError, regionErrors[region]);
+		}
+
+		indices = regionIndices.empty() ? indices : &regionIndices[0];
+		indexCount = static_cast<UINT>(regionIndices.size());
+	}
+
+	EdgeCollapser collapser(info, indices, indexCount, nullptr);
+	maxError = MathHelper::Max(maxError, collapser.Run(targetIndexCount, errorSq));
+
+	if (resultError != nullptr)
+		*resultError = sqrtf(maxError);
+
+	return collapser.Write(destination);
+}
+
+template <typename IndexT>
+void MeshSimplifier::BuildLodChain(std::vector<IndexT>& indices, const void* vertices, UINT vertexCount,
+	UINT vertexStride, UINT positionOffset, const float* ratios, UINT ratioCount, std::vector<Lod>& lods)
+{
+	lods.clear();
+
+	UINT triangleCount = static_cast<UINT>(indices.size()) / 3;
+	Lod full = { 0, triangleCount * 3, 0.0f };
+	lods.push_back(full);
+
+	for (UINT i = 0; i < ratioCount; ++i)
+	{
+		Lod last = lods.back();
+		UINT target = static_cast<UINT>(ratios[i] * triangleCount) * 3;
+
+		Lod lod;
+		lod.FirstIndex = static_cast<UINT>(indices.size());
+		indices.resize(lod.FirstIndex + last.IndexCount);
+
+		float error = 0.0f;
+		lod.IndexCount = Simplify(&indices[lod.FirstIndex], &indices[last.FirstIndex], last.IndexCount, vertices,
+			vertexCount, vertexStride, positionOffset, target, FLT_MAX, &error);
+		lod.Error = last.Error + error;
+
+		indices.resize(lod.FirstIndex + lod.IndexCount);
+		lods.push_back(lod);
+	}
+}
+
+template <typename IndexT>
+void MeshSimplifier::BuildLodChain(GeometryGenerator::BasicMeshData<IndexT>& meshData, const float* ratios,
+	UINT ratioCount, std::vector<Lod>& lods)
+{
+	if (meshData.Vertices.empty())
+	{
+		lods.clear();
+		return;
+	}
+
+	BuildLodChain(meshData.Indices, &meshData.Vertices[0], static_cast<UINT>(meshData.Vertices.size()),
+		sizeof(GeometryGenerator::Vertex), offsetof(GeometryGenerator::Vertex, Position), ratios, ratioCount, lods);
+}
+
+template <typename IndexT>
+void MeshSimplifier::BuildProgressiveMesh(const IndexT* indices, UINT indexCount, const void* vertices,
+	UINT vertexCount, UINT vertexStride, UINT positionOffset, UINT baseIndexCount, ProgressiveMesh& mesh)
+{
+	VertexInfo info;
+	BuildVertexInfo(vertices, vertexCount, vertexStride, positionOffset, info);
+
+	CollapseLog log;
+	EdgeCollapser collapser(info, indices, indexCount, nullptr);
+	collapser.SetLog(&log);
+	collapser.Run(baseIndexCount, FLT_MAX);
+
+	std::vector<UINT> base(indexCount - indexCount % 3);
+	base.resize(base.empty() ? 0 : collapser.Write(&base[0]));
+
+	//
+	// Number the vertices and triangles in the order the splits bring them back: the
+	// base first, then each collapse's, the last collapse first.
+	//
+
+	const UINT none = UINT_MAX;
+	UINT triangleCount = indexCount / 3;
+	UINT collapseCount = static_cast<UINT>(log.FirstMove.size());
+	std::vector<UINT> newVertex(vertexCount, none);
+	std::vector<UINT> order;
+	std::vector<UINT> slot(triangleCount, none);
+	UINT slotCount = 0;
+
+	for (size_t i = 0; i < base.size(); ++i)
+	{
+		if (newVertex[base[i]] == none)
+		{
+			newVertex[base[i]] = static_cast<UINT>(order.size());
+			order.push_back(base[i]);
+		}
+		base[i] = newVertex[base[i]];
+	}
+
+	// Vertices whose triangles all went with a collapse elsewhere are still there for
+	// the splits to come back to.
+	for (UINT v = 0; v < vertexCount; ++v)
+	{
+		if (collapser.IsUsed(v) && newVertex[v] == none)
+		{
+			newVertex[v] = static_cast<UINT>(order.size());
+			order.push_back(v);
+		}
+	}
+
+	for (UINT t = 0; t < triangleCount; ++t)
+	{
+		if (!collapser.IsRemoved(t))
+			slot[t] = slotCount++;
+	}
+	UINT baseVertexCount = static_cast<UINT>(order.size());
+
+	for (UINT k = collapseCount; k > 0; --k)
+	{
+		UINT end = (k < collapseCount) ? log.FirstRemoved[k] : static_cast<UINT>(log.Removed.size());
+		for (UINT i = log.FirstRemoved[k - 1]; i < end; ++i)
+			slot[log.Removed[i]] = slotCount++;
+
+		for (UINT i = 0; i < 4; i += 2)
+		{
+			UINT v = log.Vertices[(k - 1) * 4 + i];
+			if (v != none)
+			{
+				newVertex[v] = static_cast<UINT>(order.size());
+				order.push_back(v);
+			}
+		}
+	}
+
+	std::vector<BYTE> vertexBytes(order.size()*vertexStride);
+	for (size_t i = 0; i < order.size(); ++i)
+		memcpy(&vertexBytes[i*vertexStride], static_cast<const BYTE*>(vertices) + order[i] * vertexStride, vertexStride);
+
+	//
+	// Each split puts back the vertices its collapse took away, each off the vertex it
+	// was collapsed onto, and the triangles it removed.  The corners it moved are left
+	// to the parents: the index list ends up as the corners stand with every split in,
+	// so each moved corner is written with the last vertex it moves onto.
+	//
+
+	std::vector<UINT> parents(order.size() - baseVertexCount);
+	std::vector<UINT> splitIndices(base);
+	splitIndices.resize(slotCount * 3);
+	for (UINT k = collapseCount; k > 0; --k)
+	{
+		const UINT* vertices4 = &log.Vertices[(k - 1) * 4];
+		for (UINT i = 0; i < 4; i += 2)
+		{
+			if (vertices4[i] != none)
+				parents[newVertex[vertices4[i]] - baseVertexCount] = newVertex[vertices4[i + 1]];
+		}
+
+		UINT removedEnd = (k < collapseCount) ? log.FirstRemoved[k] : static_cast<UINT>(log.Removed.size());
+		for (UINT i = log.FirstRemoved[k - 1]; i < removedEnd; ++i)
+		{
+			for (UINT c = 0; c < 3; ++c)
+				splitIndices[slot[log.Removed[i]] * 3 + c] = newVertex[log.RemovedCorners[i * 3 + c]];
+		}
+
+		UINT moveEnd = (k < collapseCount) ? log.FirstMove[k] : static_cast<UINT>(log.MovedCorners.size());
+		for (UINT i = log.FirstMove[k - 1]; i < moveEnd; ++i)
+		{
+			UINT corner = log.MovedCorners[i];
+			splitIndices[slot[corner / 3] * 3 + corner % 3] = newVertex[log.MovedFrom[i]];
+		}
+	}
+
+	mesh.Clear();
+	mesh.SetBase(vertexStride, vertexBytes.empty() ? nullptr : &vertexBytes[0], baseVertexCount,
+		splitIndices.empty() ? nullptr : &splitIndices[0], static_cast<UINT>(base.size()) / 3,
+		parents.empty() ? nullptr : &parents[0], collapseCount, static_cast<UINT>(order.size()), slotCount);
+
+	UINT nextVertex = baseVertexCount;
+	UINT nextTriangle = static_cast<UINT>(base.size()) / 3;
+	for (UINT k = collapseCount; k > 0; --k)
+	{
+		UINT splitVertexCount = (log.Vertices[(k - 1) * 4 + 2] != none) ? 2 : 1;
+		UINT removedEnd = (k < collapseCount) ? log.FirstRemoved[k] : static_cast<UINT>(log.Removed.size());
+		UINT splitTriangleCount = removedEnd - log.FirstRemoved[k - 1];
+
+		mesh.AddSplit(&vertexBytes[nextVertex*vertexStride], splitVertexCount,
+			splitTriangleCount > 0 ? &splitIndices[nextTriangle * 3] : nullptr, splitTriangleCount);
+		nextVertex += splitVertexCount;
+		nextTriangle += splitTriangleCount;
+	}
+}
+
+template <typename IndexT>
+void MeshSimplifier::BuildProgressiveMesh(const GeometryGenerator::BasicMeshData<IndexT>& meshData,
+	UINT baseIndexCount, ProgressiveMesh& mesh)
+{
+	if (meshData.Vertices.empty() || meshData.Indices.empty())
+	{
+		mesh.Clear();
+		return;
+	}
+
+	BuildProgressiveMesh(&meshData.Indices[0], static_cast<UINT>(meshData.Indices.size()), &meshData.Vertices[0],
+		static_cast<UINT>(meshData.Vertices.size()), sizeof(GeometryGenerator::Vertex),
+		offsetof(GeometryGenerator::Vertex, Position), baseIndexCount, mesh);
+}
+
+//
+// The simplifier for both index widths.
+//
+
+#define INSTANTIATE_MESH_SIMPLIFIER(IndexT) \
+	template UINT MeshSimplifier::Simplify(IndexT*, const IndexT*, UINT, const void*, UINT, UINT, UINT, UINT, float, float*); \
+	template void MeshSimplifier::BuildLodChain(std::vector<IndexT>&, const void*, UINT, UINT, UINT, const float*, UINT, std::vector<Lod>&); \
+	template void MeshSimplifier::BuildLodChain(GeometryGenerator::BasicMeshData<IndexT>&, const float*, UINT, std::vector<Lod>&); \
+	template void MeshSimplifier::BuildProgressiveMesh(const IndexT*, UINT, const void*, UINT, UINT, UINT, UINT, ProgressiveMesh&); \
+	template void MeshSimplifier::BuildProgressiveMesh(const GeometryGenerator::BasicMeshData<IndexT>&, UINT, ProgressiveMesh&);
+
+INSTANTIATE_MESH_SIMPLIFIER(UINT)
+INSTANTIATE_MESH_SIMPLIFIER(USHORT)
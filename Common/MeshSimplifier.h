@@ -0,0 +1,89 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Reduces indexed triangle lists by collapsing edges, cheapest first by the quadric
+// error metric of Garland and Heckbert: each vertex sums the planes of the triangles
+// around it, weighted by area, and moving it costs the squared distance to them.
+// Collapses move a vertex onto a neighbour rather than to a new position, so the
+// simplified triangles use a subset of the original vertices and every level of detail
+// can share one vertex buffer.
+//
+// Vertices at the same position with different attributes, along the seams of normals
+// and texture coordinates, only collapse along the seam and all together, so the seam
+// stays sharp; open borders only collapse along themselves.  Both are also held to
+// their lines by extra planes through the edges.  Collapses that would flip a triangle
+// are skipped.
+//***************************************************************************************
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <Windows.h>
+
+#include <cfloat>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+class ProgressiveMesh;
+class ThreadPool;
+
+class MeshSimplifier
+{
+public:
+	// One level of detail in the index list BuildLodChain() fills in.
+	struct Lod
+	{
+		UINT FirstIndex;
+		UINT IndexCount;
+
+		// Distance the level may be off the full mesh, as a fraction of its largest
+		// extent; the errors of the levels it was simplified through are added up.
+		float Error;
+	};
+
+	MeshSimplifier();
+
+	// With a pool of more than one thread, large meshes are first split into regions
+	// that are simplified at the same time, the vertices between them held in place,
+	// and then finished in one pass over the whole mesh.  The regions depend only on
+	// the mesh, so every such pool gives the same result.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+	// Writes the triangles left after collapsing edges until at most targetIndexCount
+	// indices are left, or until the next collapse would move the surface further than
+	// targetError, to destination, which has room for indexCount indices and may be
+	// indices itself.  Returns the number written.  The positions are the XMFLOAT3 at
+	// positionOffset bytes into each vertex of vertexStride bytes.  resultError gets
+	// the error reached, as a fraction of the largest extent of the mesh.
+	template <typename IndexT>
+	UINT Simplify(IndexT* destination, const IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+		UINT vertexStride, UINT positionOffset, UINT targetIndexCount, float targetError = FLT_MAX,
+		float* resultError = nullptr);
+
+	// Appends a level of detail to indices for each of the ratioCount ratios of the
+	// triangles of the full mesh, each simplified from the level before it, and fills
+	// in lods with the full mesh followed by the new levels.
+	template <typename IndexT>
+	void BuildLodChain(std::vector<IndexT>& indices, const void* vertices, UINT vertexCount, UINT vertexStride,
+		UINT positionOffset, const float* ratios, UINT ratioCount, std::vector<Lod>& lods);
+	template <typename IndexT>
+	void BuildLodChain(GeometryGenerator::BasicMeshData<IndexT>& meshData, const float* ratios, UINT ratioCount,
+		std::vector<Lod>& lods);
+
+	// Collapses edges until at most baseIndexCount indices are left, or no more can go,
+	// and fills in mesh with what is left as its base and a split to undo each collapse,
+	// the last first.  Always on one thread, as the collapses have to come in one order.
+	// Triangles with two corners at one position are left out.
+	template <typename IndexT>
+	void BuildProgressiveMesh(const IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+		UINT vertexStride, UINT positionOffset, UINT baseIndexCount, ProgressiveMesh& mesh);
+	template <typename IndexT>
+	void BuildProgressiveMesh(const GeometryGenerator::BasicMeshData<IndexT>& meshData, UINT baseIndexCount,
+		ProgressiveMesh& mesh);
+
+private:
+	ThreadPool* mThreadPool;
+};
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,268 @@
+//***************************************************************************************
+// MeshWelder.cpp
+//***************************************************************************************
+
+#include "MeshWelder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertices or indices per task.
+	const UINT BlockSize = 16384;
+
+	// The hash table is sorted in this many partitions at the same time.
+	const UINT PartitionBits = 8;
+	const UINT PartitionCount = 1 << PartitionBits;
+
+	// Cell coordinates stay within this, well clear of overflowing an int.
+	const float MaxCell = 1073741824.0f;
+
+	// Spatial hash of Teschner et al., "Optimized Spatial Hashing for Collision
+	// Detection of Deformable Objects"; its high bits pick the bucket.
+	UINT HashCell(int x, int y, int z)
+	{
+		return (static_cast<UINT>(x) * 73856093u) ^ (static_cast<UINT>(y) * 19349663u) ^ (static_cast<UINT>(z) * 83492791u);
+	}
+
+	// The tolerances squared where they are compared with squared distances.
+	struct Limits
+	{
+		float PositionSq;
+		float NormalSq;
+		float TexC;
+	};
+
+	bool Matches(const GeometryGenerator::Vertex& a, const GeometryGenerator::Vertex& b, const Limits& limits)
+	{
+		XMVECTOR d = XMLoadFloat3(&a.Position) - XMLoadFloat3(&b.Position);
+		if (XMVectorGetX(XMVector3LengthSq(d)) > limits.PositionSq)
+			return false;
+
+		d = XMLoadFloat3(&a.Normal) - XMLoadFloat3(&b.Normal);
+		if (XMVectorGetX(XMVector3LengthSq(d)) > limits.NormalSq)
+			return false;
+
+		d = XMLoadFloat3(&a.TangentU) - XMLoadFloat3(&b.TangentU);
+		if (XMVectorGetX(XMVector3LengthSq(d)) > limits.NormalSq)
+			return false;
+
+		return fabsf(a.TexC.x - b.TexC.x) <= limits.TexC && fabsf(a.TexC.y - b.TexC.y) <= limits.TexC;
+	}
+}
+
+MeshWelder::MeshWelder()
+	: mThreadPool(nullptr)
+{
+}
+
+UINT MeshWelder::BuildRemap(const GeometryGenerator::Vertex* vertices, UINT vertexCount, const Tolerance& tolerance,
+	std::vector<UINT>& remap)
+{
+	remap.resize(vertexCount);
+	if (vertexCount == 0)
+		return 0;
+
+	Limits limits;
+	limits.PositionSq = tolerance.Position*tolerance.Position;
+	limits.NormalSq = tolerance.Normal*tolerance.Normal;
+	limits.TexC = tolerance.TexC;
+
+	// At least a bucket per vertex, so buckets hold one cell each on average.
+	UINT bucketBits = PartitionBits;
+	while (bucketBits < 30 && (1u << bucketBits) < vertexCount)
+		++bucketBits;
+	UINT bucketCount = 1u << bucketBits;
+	UINT bucketShift = 32 - bucketBits;
+	UINT partitionShift = 32 - PartitionBits;
+	UINT blockCount = (vertexCount + BlockSize - 1) / BlockSize;
+
+	//
+	// The cell of each vertex, which half of it the vertex is in along each axis, and
+	// how many vertices of each block hash into each partition.
+	//
+
+	XMVECTOR invCell = XMVectorReplicate(0.5f / tolerance.Position);
+	XMVECTOR maxCell = XMVectorReplicate(MaxCell);
+
+	std::vector<XMINT3> cells(vertexCount);
+	std::vector<BYTE> sides(vertexCount);
+	std::vector<UINT> hashes(vertexCount);
+	std::vector<UINT> blockCounts(blockCount*PartitionCount, 0);
+
+	ThreadPool::Run(mThreadPool, blockCount, [&](UINT block, UINT)
+	{
+		UINT* counts = &blockCounts[block*PartitionCount];
+		UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+		for (UINT v = block*BlockSize; v < end; ++v)
+		{
+			XMVECTOR scaled = XMVectorClamp(XMLoadFloat3(&vertices[v].Position)*invCell, -maxCell, maxCell);
+			XMVECTOR lower = XMVectorFloor(scaled);
+			XMStoreSInt3(&cells[v], XMConvertVectorFloatToInt(lower, 0));
+
+			XMFLOAT3 fraction;
+			XMStoreFloat3(&fraction, scaled - lower);
+			sides[v] = (fraction.x >= 0.5f ? 1 : 0) | (fraction.y >= 0.5f ? 2 : 0) | (fraction.z >= 0.5f ? 4 : 0);
+
+			hashes[v] = HashCell(cells[v].x, cells[v].y, cells[v].z);
+			++counts[hashes[v] >> partitionShift];
+		}
+	});
+
+	//
+	// Sort the vertices by bucket: scatter them into their partitions, each block to
+	// its own place so they stay in vertex order, then sort the partitions side by side.
+	//
+
+	std::vector<UINT> partitionStart(PartitionCount + 1);
+	UINT total = 0;
+	for (UINT p = 0; p < PartitionCount; ++p)
+	{
+		partitionStart[p] = total;
+		for (UINT block = 0; block < blockCount; ++block)
+		{
+			UINT count = blockCounts[block*PartitionCount + p];
+			blockCounts[block*PartitionCount + p] = total;
+			total += count;
+		}
+	}
+	partitionStart[PartitionCount] = total;
+
+	// Each entry is a bucket in the high half and a vertex in the low half.
+	std::vector<UINT64> entries(vertexCount);
+	ThreadPool::Run(mThreadPool, blockCount, [&](UINT block, UINT)
+	{
+		UINT* offsets = &blockCounts[block*PartitionCount];
+		UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+		for (UINT v = block*BlockSize; v < end; ++v)
+			entries[offsets[hashes[v] >> partitionShift]++] = (static_cast<UINT64>(hashes[v] >> bucketShift) << 32) | v;
+	});
+
+	std::vector<UINT> bucketStart(bucketCount + 1);
+	bucketStart[bucketCount] = vertexCount;
+	ThreadPool::Run(mThreadPool, PartitionCount, [&](UINT p, UINT)
+	{
+		std::sort(entries.begin() + partitionStart[p], entries.begin() + partitionStart[p + 1]);
+
+		UINT bucketsPerPartition = 1u << (bucketBits - PartitionBits);
+		UINT i = partitionStart[p];
+		for (UINT bucket = p*bucketsPerPartition; bucket < (p + 1)*bucketsPerPartition; ++bucket)
+		{
+			bucketStart[bucket] = i;
+			while (i < partitionStart[p + 1] && static_cast<UINT>(entries[i] >> 32) == bucket)
+				++i;
+		}
+	});
+
+	//
+	// Find the lowest vertex each vertex matches in the eight cells around it.  Buckets
+	// list their vertices in order, so the search of each stops at the first match or
+	// at the best match so far.
+	//
+
+	std::vector<UINT> lowest(vertexCount);
+	ThreadPool::Run(mThreadPool, blockCount, [&](UINT block, UINT)
+	{
+		UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+		for (UINT v = block*BlockSize; v < end; ++v)
+		{
+			const XMINT3& cell = cells[v];
+			int step[3] = { (sides[v] & 1) ? 1 : -1, (sides[v] & 2) ? 1 : -1, (sides[v] & 4) ? 1 : -1 };
+
+			UINT match = v;
+			for (UINT k = 0; k < 8; ++k)
+			{
+				UINT bucket = HashCell(cell.x + ((k & 1) ? step[0] : 0), cell.y + ((k & 2) ? step[1] : 0),
+					cell.z + ((k & 4) ? step[2] : 0)) >> bucketShift;
+
+				for (UINT i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i)
+				{
+					UINT u = static_cast<UINT>(entries[i]);
+					if (u >= match)
+						break;
+
+					if (Matches(vertices[u], vertices[v], limits))
+					{
+						match = u;
+						break;
+					}
+				}
+			}
+			lowest[v] = match;
+		}
+	});
+
+	// Lower vertices are numbered first, so each vertex can take the number of the one
+	// it matched.
+	UINT keptCount = 0;
+	for (UINT v = 0; v < vertexCount; ++v)
+		remap[v] = (lowest[v] == v) ? keptCount++ : remap[lowest[v]];
+
+	return keptCount;
+}
+
+template <typename IndexT>
+MeshWelder::WeldStats MeshWelder::Weld(GeometryGenerator::BasicMeshData<IndexT>& meshData, const Tolerance& tolerance)
+{
+	std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	std::vector<IndexT>& indices = meshData.Indices;
+
+	WeldStats stats;
+	stats.VertexCountBefore = static_cast<UINT>(vertices.size());
+
+	std::vector<UINT> remap;
+	UINT keptCount = BuildRemap(vertices.empty() ? nullptr : &vertices[0], stats.VertexCountBefore, tolerance, remap);
+
+	// The vertices kept only ever move down.
+	UINT next = 0;
+	for (UINT v = 0; v < stats.VertexCountBefore; ++v)
+	{
+		if (remap[v] == next)
+			vertices[next++] = vertices[v];
+	}
+	vertices.resize(keptCount);
+
+	UINT triangleCount = static_cast<UINT>(indices.size()) / 3;
+	UINT blockCount = (triangleCount + BlockSize - 1) / BlockSize;
+	ThreadPool::Run(mThreadPool, blockCount, [&](UINT block, UINT)
+	{
+		UINT end = MathHelper::Min(triangleCount, (block + 1)*BlockSize) * 3;
+		for (UINT i = block*BlockSize * 3; i < end; ++i)
+			indices[i] = static_cast<IndexT>(remap[indices[i]]);
+	});
+
+	UINT kept = 0;
+	for (UINT t = 0; t < triangleCount; ++t)
+	{
+		IndexT i0 = indices[t * 3];
+		IndexT i1 = indices[t * 3 + 1];
+		IndexT i2 = indices[t * 3 + 2];
+		if (i0 == i1 || i1 == i2 || i2 == i0)
+			continue;
+
+		indices[kept * 3] = i0;
+		indices[kept * 3 + 1] = i1;
+		indices[kept * 3 + 2] = i2;
+		++kept;
+	}
+	indices.resize(kept * 3);
+
+	stats.VertexCountAfter = keptCount;
+	stats.TrianglesRemoved = triangleCount - kept;
+	stats.BytesSaved = (stats.VertexCountBefore - keptCount) * sizeof(GeometryGenerator::Vertex);
+	return stats;
+}
+
+//
+// The welder for both index widths.
+//
+
+#define INSTANTIATE_MESH_WELDER(IndexT) \
+	template MeshWelder::WeldStats MeshWelder::Weld(GeometryGenerator::BasicMeshData<IndexT>&, const Tolerance&);
+
+INSTANTIATE_MESH_WELDER(UINT)
+INSTANTIATE_MESH_WELDER(USHORT)
@@ -0,0 +1,73 @@
+//***************************************************************************************
+// MeshWelder.h
+//
+// Merges the vertices of a mesh that differ only by float noise, and renumbers the
+// indices to match.  Positions are hashed into a grid of cells twice the position
+// tolerance across, so any vertex close enough to another lies in one of the eight
+// cells around the nearer corner of its own cell, and each vertex is only compared
+// with the vertices there.  A vertex merges into the lowest numbered vertex it
+// matches, which keeps its attributes, so the result is the same however the work is
+// split between threads.
+//***************************************************************************************
+
+#ifndef MESHWELDER_H
+#define MESHWELDER_H
+
+#include <Windows.h>
+
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+class ThreadPool;
+
+class MeshWelder
+{
+public:
+	// Largest difference in each attribute for two vertices to merge: the distance
+	// between their positions, between their normals and between their tangents, and
+	// the difference in each texture coordinate.  Position must be above zero.
+	struct Tolerance
+	{
+		Tolerance() : Position(1e-5f), Normal(1e-3f), TexC(1e-5f) {}
+		Tolerance(float position, float normal, float texC) : Position(position), Normal(normal), TexC(texC) {}
+
+		float Position;
+		float Normal;
+		float TexC;
+	};
+
+	struct WeldStats
+	{
+		UINT VertexCountBefore;
+		UINT VertexCountAfter;
+
+		// Triangles dropped for having two corners merged into one vertex.
+		UINT TrianglesRemoved;
+
+		// Vertex memory saved, in bytes.
+		UINT BytesSaved;
+	};
+
+	MeshWelder();
+
+	// Runs every pass over the vertices and indices in blocks on the given pool, null
+	// runs them on the calling thread.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+	// Fills remap with the vertex each vertex becomes, numbering the vertices kept in
+	// their original order, and returns how many are kept.
+	UINT BuildRemap(const GeometryGenerator::Vertex* vertices, UINT vertexCount, const Tolerance& tolerance,
+		std::vector<UINT>& remap);
+
+	// Merges the vertices of meshData and drops the triangles that merged to nothing.
+	template <typename IndexT>
+	WeldStats Weld(GeometryGenerator::BasicMeshData<IndexT>& meshData, const Tolerance& tolerance = Tolerance());
+
+private:
+
+private:
+	ThreadPool* mThreadPool;
+};
+
+#endif // MESHWELDER_H
@@ -0,0 +1,321 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+
+using namespace DirectX;
+
+const UINT MeshletBuilder::MaxVertices;
+const UINT MeshletBuilder::MaxTriangles;
+
+namespace
+{
+	// How much a triangle turned away from the meshlet counts against it, in vertices:
+	// at 0.5 a triangle at right angles to the meshlet loses to one in its direction
+	// that adds half a vertex more.
+	const float ConeWeight = 0.5f;
+
+	// Below this cosine between a triangle normal and the cone axis the cone is too
+	// wide to be worth testing.
+	const float MinConeCosine = 0.1f;
+
+	const XMFLOAT3& PositionAt(const void* vertices, UINT vertexStride, UINT positionOffset, UINT v)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(static_cast<const BYTE*>(vertices) + v*vertexStride + positionOffset);
+	}
+}
+
+template <typename IndexT>
+void MeshletBuilder::Build(IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+	UINT vertexStride, UINT positionOffset, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+
+	UINT triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Unit normals of the triangles, zero for degenerate ones.
+	std::vector<XMFLOAT3> normals(triangleCount);
+	for (UINT t = 0; t < triangleCount; ++t)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, indices[t * 3]));
+		XMVECTOR p1 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, indices[t * 3 + 1]));
+		XMVECTOR p2 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, indices[t * 3 + 2]));
+
+		XMStoreFloat3(&normals[t], XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0)));
+	}
+
+	// Triangles of each vertex.
+	std::vector<UINT> firstTriangle(vertexCount + 1, 0);
+	for (UINT k = 0; k < indexCount; ++k)
+		++firstTriangle[indices[k] + 1];
+	for (UINT v = 0; v < vertexCount; ++v)
+		firstTriangle[v + 1] += firstTriangle[v];
+
+	std::vector<UINT> triangles(indexCount);
+	std::vector<UINT> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (UINT k = 0; k < indexCount; ++k)
+		triangles[fill[indices[k]]++] = k / 3;
+
+	std::vector<bool> used(triangleCount, false);
+	UINT usedCount = 0;
+	UINT nextSeed = 0;
+
+	// Triangles of each vertex not yet in a meshlet.
+	std::vector<UINT> liveTriangles(vertexCount);
+	for (UINT v = 0; v < vertexCount; ++v)
+		liveTriangles[v] = firstTriangle[v + 1] - firstTriangle[v];
+
+	// The meshlet each vertex was last added to.
+	std::vector<UINT> vertexMeshlet(vertexCount, UINT_MAX);
+
+	// Triangles around the vertices of the meshlet being built; some may have been
+	// used since they were added.
+	std::vector<UINT> candidates;
+
+	std::vector<IndexT> output;
+	output.reserve(triangleCount * 3);
+
+	while (usedCount < triangleCount)
+	{
+		// Seed from the border of the last meshlet, with the triangle that has the fewest
+		// neighbours left, so meshlets close up behind each other instead of leaving
+		// scraps of triangles; when the border is all used, from the next triangle in
+		// index order.
+		int seed = -1;
+		UINT seedLive = UINT_MAX;
+		for (size_t i = 0; i < candidates.size(); ++i)
+		{
+			UINT u = candidates[i];
+			if (used[u])
+				continue;
+
+			UINT live = liveTriangles[indices[u * 3]] + liveTriangles[indices[u * 3 + 1]] + liveTriangles[indices[u * 3 + 2]];
+			if (live < seedLive)
+			{
+				seedLive = live;
+				seed = u;
+			}
+		}
+
+		if (seed < 0)
+		{
+			while (used[nextSeed])
+				++nextSeed;
+			seed = nextSeed;
+		}
+
+		UINT id = static_cast<UINT>(meshlets.size());
+		Meshlet meshlet;
+		meshlet.FirstIndex = static_cast<UINT>(output.size());
+		meshlet.VertexCount = 0;
+
+		UINT meshletTriangles = 0;
+		XMVECTOR normalSum = XMVectorZero();
+		candidates.clear();
+
+		int next = seed;
+		while (next >= 0)
+		{
+			UINT t = next;
+			used[t] = true;
+			++usedCount;
+			++meshletTriangles;
+			normalSum += XMLoadFloat3(&normals[t]);
+
+			for (UINT c = 0; c < 3; ++c)
+			{
+				UINT v = indices[t * 3 + c];
+				output.push_back(static_cast<IndexT>(v));
+				--liveTriangles[v];
+
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					++meshlet.VertexCount;
+
+					for (UINT a = firstTriangle[v]; a < firstTriangle[v + 1]; ++a)
+					{
+						if (!used[triangles[a]])
+							candidates.push_back(triangles[a]);
+					}
+				}
+			}
+
+			if (meshletTriangles == MaxTriangles)
+				break;
+
+			// The candidate that adds the fewest vertices, and among those the one
+			// facing most like the meshlet.  Used candidates are dropped on the way.
+			XMVECTOR axis = XMVector3Normalize(normalSum);
+			next = -1;
+			float bestScore = FLT_MAX;
+			size_t kept = 0;
+			for (size_t i = 0; i < candidates.size(); ++i)
+			{
+				UINT u = candidates[i];
+				if (used[u])
+					continue;
+				candidates[kept++] = u;
+
+				UINT u0 = indices[u * 3];
+				UINT u1 = indices[u * 3 + 1];
+				UINT u2 = indices[u * 3 + 2];
+				UINT newVertices = (vertexMeshlet[u0] != id ? 1 : 0) +
+					(vertexMeshlet[u1] != id && u1 != u0 ? 1 : 0) +
+					(vertexMeshlet[u2] != id && u2 != u0 && u2 != u1 ? 1 : 0);
+				if (meshlet.VertexCount + newVertices > MaxVertices)
+					continue;
+
+				float turn = 1.0f - XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[u]), axis));
+				float score = newVertices + ConeWeight*turn;
+				if (score < bestScore)
+				{
+					bestScore = score;
+					next = u;
+				}
+			}
+			candidates.resize(kept);
+		}
+
+		meshlet.IndexCount = static_cast<UINT>(output.size()) - meshlet.FirstIndex;
+
+		//
+		// Bounding sphere around the center of the bounding box.
+		//
+
+		XMVECTOR lo = XMVectorReplicate(FLT_MAX);
+		XMVECTOR hi = XMVectorReplicate(-FLT_MAX);
+		for (UINT k = meshlet.FirstIndex; k < meshlet.FirstIndex + meshlet.IndexCount; ++k)
+		{
+			XMVECTOR p = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, output[k]));
+			lo = XMVectorMin(lo, p);
+			hi = XMVectorMax(hi, p);
+		}
+
+		XMVECTOR center = 0.5f*(lo + hi);
+		float radiusSq = 0.0f;
+		for (UINT k = meshlet.FirstIndex; k < meshlet.FirstIndex + meshlet.IndexCount; ++k)
+		{
+			XMVECTOR p = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, output[k]));
+			radiusSq = MathHelper::Max(radiusSq, XMVectorGetX(XMVector3LengthSq(p - center)));
+		}
+
+		XMStoreFloat3(&meshlet.Center, center);
+		meshlet.Radius = sqrtf(radiusSq);
+
+		//
+		// Normal cone around the average normal.  Every triangle is back facing for a
+		// view direction within 90 degrees minus the cone half angle of the axis.
+		//
+
+		XMVECTOR axis = XMVector3Normalize(normalSum);
+		float minCosine = 1.0f;
+		for (UINT k = meshlet.FirstIndex; k < meshlet.FirstIndex + meshlet.IndexCount; k += 3)
+		{
+			// Triangles were emitted in the order they were used; find each normal again
+			// from its corners.
+			XMVECTOR p0 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, output[k]));
+			XMVECTOR p1 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, output[k + 1]));
+			XMVECTOR p2 = XMLoadFloat3(&PositionAt(vertices, vertexStride, positionOffset, output[k + 2]));
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+			if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+				minCosine = MathHelper::Min(minCosine, XMVectorGetX(XMVector3Dot(XMVector3Normalize(n), axis)));
+		}
+
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+		if (XMVectorGetX(XMVector3LengthSq(normalSum)) > 0.0f && minCosine > MinConeCosine)
+			meshlet.ConeCutoff = sqrtf(1.0f - minCosine*minCosine);
+		else
+			meshlet.ConeCutoff = 1.0f;
+
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+template <typename IndexT>
+void MeshletBuilder::Build(GeometryGenerator::BasicMeshData<IndexT>& meshData, std::vector<Meshlet>& meshlets)
+{
+	if (meshData.Indices.empty())
+	{
+		meshlets.clear();
+		return;
+	}
+
+	Build(&meshData.Indices[0], static_cast<UINT>(meshData.Indices.size()), &meshData.Vertices[0],
+		static_cast<UINT>(meshData.Vertices.size()), sizeof(GeometryGenerator::Vertex),
+		offsetof(GeometryGenerator::Vertex, Position), meshlets);
+}
+
+void MeshletBuilder::Cull(const std::vector<Meshlet>& meshlets, const XMFLOAT4X4& worldViewProj,
+	const XMFLOAT3& eyePos, std::vector<DrawRange>& ranges)
+{
+	ranges.clear();
+
+	// Frustum planes in the space of the mesh, pointing inwards.  With row vectors,
+	// clip = p * M, so the planes come from the columns of M.
+	XMMATRIX columns = XMMatrixTranspose(XMLoadFloat4x4(&worldViewProj));
+	XMVECTOR planes[6] =
+	{
+		XMPlaneNormalize(columns.r[3] + columns.r[0]),	// left
+		XMPlaneNormalize(columns.r[3] - columns.r[0]),	// right
+		XMPlaneNormalize(columns.r[3] + columns.r[1]),	// bottom
+		XMPlaneNormalize(columns.r[3] - columns.r[1]),	// top
+		XMPlaneNormalize(columns.r[2]),					// near
+		XMPlaneNormalize(columns.r[3] - columns.r[2]),	// far
+	};
+
+	XMVECTOR eye = XMLoadFloat3(&eyePos);
+
+	for (size_t i = 0; i < meshlets.size(); ++i)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		XMVECTOR center = XMLoadFloat3(&meshlet.Center);
+
+		bool outside = false;
+		for (UINT p = 0; p < 6 && !outside; ++p)
+			outside = XMVectorGetX(XMPlaneDotCoord(planes[p], center)) < -meshlet.Radius;
+		if (outside)
+			continue;
+
+		// Back facing if every direction from the eye into the sphere is within
+		// 90 degrees minus the cone half angle of the axis.
+		XMVECTOR toCenter = center - eye;
+		float along = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&meshlet.ConeAxis)));
+		float distance = XMVectorGetX(XMVector3Length(toCenter));
+		if (along >= meshlet.ConeCutoff*distance + meshlet.Radius)
+			continue;
+
+		if (!ranges.empty() && ranges.back().FirstIndex + ranges.back().IndexCount == meshlet.FirstIndex)
+		{
+			ranges.back().IndexCount += meshlet.IndexCount;
+		}
+		else
+		{
+			DrawRange range = { meshlet.FirstIndex, meshlet.IndexCount };
+			ranges.push_back(range);
+		}
+	}
+}
+
+//
+// The builder for both index widths.
+//
+
+#define INSTANTIATE_MESHLET_BUILDER(IndexT) \
+	template void MeshletBuilder::Build(IndexT*, UINT, const void*, UINT, UINT, UINT, std::vector<Meshlet>&); \
+	template void MeshletBuilder::Build(GeometryGenerator::BasicMeshData<IndexT>&, std::vector<Meshlet>&);
+
+INSTANTIATE_MESHLET_BUILDER(UINT)
+INSTANTIATE_MESHLET_BUILDER(USHORT)
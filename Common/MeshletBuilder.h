@@ -0,0 +1,76 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits a triangle list into meshlets, clusters of at most MaxVertices vertices and
+// MaxTriangles triangles, whose triangles are made contiguous in the index list so each
+// meshlet is a range DrawIndexed() can draw.  Every meshlet carries a bounding sphere
+// and a cone around its triangle normals, so whole meshlets outside the view frustum
+// or facing away from the camera can be skipped on the CPU, a few hundred tests
+// instead of clipping and culling every triangle on the GPU.
+//
+// Meshlets grow from a seed triangle over shared vertices, always taking the triangle
+// that adds the fewest new vertices and, among those, the one closest in direction to
+// the meshlet so far, which keeps the normal cones narrow.  Seeds are taken in index
+// order, so meshes already ordered by MeshOptimizer keep most of that order.
+//***************************************************************************************
+
+#ifndef MESHLETBUILDER_H
+#define MESHLETBUILDER_H
+
+#include <Windows.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+class MeshletBuilder
+{
+public:
+	static const UINT MaxVertices = 64;
+	static const UINT MaxTriangles = 124;
+
+	struct Meshlet
+	{
+		// Indices [FirstIndex, FirstIndex + IndexCount) of the reordered index list.
+		UINT FirstIndex;
+		UINT IndexCount;
+		UINT VertexCount;
+
+		// Bounding sphere.
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+
+		// Every triangle normal is within the cone around ConeAxis; ConeCutoff is the
+		// sine of its half angle, or 1 when the cone is too wide for any view to see
+		// only back faces.
+		DirectX::XMFLOAT3 ConeAxis;
+		float ConeCutoff;
+	};
+
+	// Indices to draw with one DrawIndexed() call.
+	struct DrawRange
+	{
+		UINT FirstIndex;
+		UINT IndexCount;
+	};
+
+	// Reorders the triangles of the index list meshlet by meshlet and fills in the
+	// meshlets.  The positions are the XMFLOAT3 at positionOffset bytes into each vertex
+	// of vertexStride bytes.  Front faces are the ones (p1 - p0) x (p2 - p0) points out
+	// of, as for the GeometryGenerator meshes.
+	template <typename IndexT>
+	static void Build(IndexT* indices, UINT indexCount, const void* vertices, UINT vertexCount,
+		UINT vertexStride, UINT positionOffset, std::vector<Meshlet>& meshlets);
+	template <typename IndexT>
+	static void Build(GeometryGenerator::BasicMeshData<IndexT>& meshData, std::vector<Meshlet>& meshlets);
+
+	// Replaces ranges with the meshlets that are at least partly inside the frustum of
+	// worldViewProj and that have a triangle facing eyePos, the camera position in the
+	// space of the mesh.  Consecutive visible meshlets are merged into one range.  The
+	// world transform must not scale unevenly, or the cones no longer hold.
+	static void Cull(const std::vector<Meshlet>& meshlets, const DirectX::XMFLOAT4X4& worldViewProj,
+		const DirectX::XMFLOAT3& eyePos, std::vector<DrawRange>& ranges);
+};
+
+#endif // MESHLETBUILDER_H
@@ -0,0 +1,150 @@
+//***************************************************************************************
+// MpscQueue.h
+//
+// A bounded lock-free queue for any number of producer threads and one consumer.
+// Every slot carries a sequence number that tells whether it is free for the producer
+// that claimed its position or holds a value for the consumer; producers claim
+// positions with a compare-and-swap, so neither side ever blocks or takes a lock.
+//***************************************************************************************
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <Windows.h>
+#include <atomic>
+#include <cassert>
+
+template<typename T>
+class MpscQueue
+{
+public:
+	// capacity must be a power of two.
+	explicit MpscQueue(UINT capacity)
+		: mCells(new Cell[capacity]),
+		  mMask(capacity - 1),
+		  mEnqueuePos(0),
+		  mDequeuePos(0)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+		for (UINT i = 0; i < capacity; ++i)
+			mCells[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~MpscQueue()
+	{
+		delete[] mCells;
+	}
+
+	UINT Capacity()const { return mMask + 1; }
+
+	// Safe from any thread.  Returns false, and drops value, when the queue is full.
+	bool TryPush(const T& value)
+	{
+		UINT pos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = mCells[pos & mMask];
+			UINT seq = cell.Sequence.load(std::memory_order_acquire);
+			int diff = static_cast<int>(seq - pos);
+
+			if (diff == 0)
+			{
+				// The slot is free; claim its position.  On failure pos is reloaded.
+				if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.Value = value;
+					cell.Sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// The consumer has not emptied this slot yet.
+				return false;
+			}
+			else
+			{
+				// Another producer got here first.
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Safe from any thread.  Pushes as many of the count values, from the first, as
+	// there is room for, claiming all their positions with one compare-and-swap so
+	// they stay together, and returns how many.
+	UINT TryPushRange(const T* values, UINT count)
+	{
+		if (count == 0)
+			return 0;
+
+		UINT pos = mEnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			int diff = static_cast<int>(mCells[pos & mMask].Sequence.load(std::memory_order_acquire) - pos);
+			if (diff < 0)
+				return 0;
+
+			if (diff > 0)
+			{
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			// The consumer frees slots in order, so a run of positions is free when its
+			// last one is.
+			UINT n = (count < mMask + 1) ? count : mMask + 1;
+			while (n > 1 && mCells[(pos + n - 1) & mMask].Sequence.load(std::memory_order_acquire) != pos + n - 1)
+				n /= 2;
+
+			if (mEnqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+			{
+				for (UINT k = 0; k < n; ++k)
+				{
+					Cell& cell = mCells[(pos + k) & mMask];
+					cell.Value = values[k];
+					cell.Sequence.store(pos + k + 1, std::memory_order_release);
+				}
+				return n;
+			}
+		}
+	}
+
+	// Only from the consumer thread.  Returns false when there is nothing to pop, which
+	// includes a value whose producer is still writing it.
+	bool TryPop(T& value)
+	{
+		Cell& cell = mCells[mDequeuePos & mMask];
+		UINT seq = cell.Sequence.load(std::memory_order_acquire);
+
+		if (seq != mDequeuePos + 1)
+			return false;
+
+		value = cell.Value;
+		cell.Sequence.store(mDequeuePos + mMask + 1, std::memory_order_release);
+		++mDequeuePos;
+		return true;
+	}
+
+private:
+	MpscQueue(const MpscQueue& rhs);
+	MpscQueue& operator=(const MpscQueue& rhs);
+
+	struct Cell
+	{
+		std::atomic<UINT> Sequence;
+		T Value;
+	};
+
+	Cell* mCells;
+	UINT mMask;
+
+	// Producers and the consumer each get their own cache line.
+	char mPad0[64];
+	std::atomic<UINT> mEnqueuePos;
+	char mPad1[64];
+	UINT mDequeuePos;
+};
+
+#endif // MPSCQUEUE_H
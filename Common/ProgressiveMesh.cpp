@@ -0,0 +1,249 @@
+//***************************************************************************************
+// ProgressiveMesh.cpp
+//***************************************************************************************
+
+#include "ProgressiveMesh.h"
+
+#include <cstring>
+
+namespace
+{
+	const UINT HeaderWords = 8;
+	const UINT SplitHeaderWords = 2;
+
+	void AppendBytes(std::vector<BYTE>& stream, const void* data, size_t size)
+	{
+		const BYTE* bytes = static_cast<const BYTE*>(data);
+		stream.insert(stream.end(), bytes, bytes + size);
+	}
+}
+
+ProgressiveMesh::ProgressiveMesh()
+{
+	Clear();
+}
+
+void ProgressiveMesh::Clear()
+{
+	mHasBase = false;
+	mVertexStride = 0;
+	mTotalSplitCount = 0;
+	mFullVertexCount = 0;
+	mFullTriangleCount = 0;
+	mBaseVertexCount = 0;
+	mBaseTriangleCount = 0;
+
+	mVertices.clear();
+	mIndices.clear();
+	mParents.clear();
+	mSplits.clear();
+
+	mAppliedSplitCount = 0;
+	mVertexCount = 0;
+	mIndexCount = 0;
+
+	mPending.clear();
+}
+
+void ProgressiveMesh::SetBase(UINT vertexStride, const void* vertices, UINT vertexCount, const UINT* indices,
+	UINT triangleCount, const UINT* parents, UINT splitCount, UINT fullVertexCount, UINT fullTriangleCount)
+{
+	mHasBase = true;
+	mVertexStride = vertexStride;
+	mTotalSplitCount = splitCount;
+	mFullVertexCount = fullVertexCount;
+	mFullTriangleCount = fullTriangleCount;
+	mBaseVertexCount = vertexCount;
+	mBaseTriangleCount = triangleCount;
+
+	const BYTE* bytes = static_cast<const BYTE*>(vertices);
+	mVertices.assign(bytes, bytes + vertexCount*vertexStride);
+	mIndices.assign(indices, indices + triangleCount * 3);
+	mSplits.clear();
+
+	mParents.resize(fullVertexCount);
+	for (UINT v = 0; v < vertexCount; ++v)
+		mParents[v] = v;
+	for (UINT v = vertexCount; v < fullVertexCount; ++v)
+		mParents[v] = parents[v - vertexCount];
+
+	mAppliedSplitCount = 0;
+	mVertexCount = vertexCount;
+	mIndexCount = triangleCount * 3;
+}
+
+void ProgressiveMesh::AddSplit(const void* vertices, UINT vertexCount, const UINT* indices, UINT triangleCount)
+{
+	VertexSplit split;
+	split.VertexCount = vertexCount;
+	split.TriangleCount = triangleCount;
+	mSplits.push_back(split);
+
+	AppendBytes(mVertices, vertices, vertexCount*mVertexStride);
+	mIndices.insert(mIndices.end(), indices, indices + triangleCount * 3);
+}
+
+void ProgressiveMesh::Write(std::vector<BYTE>& stream)const
+{
+	if (!mHasBase)
+		return;
+
+	UINT header[HeaderWords] =
+	{
+		Magic, Version, mVertexStride, mBaseVertexCount, mBaseTriangleCount,
+		static_cast<UINT>(mSplits.size()), mFullVertexCount, mFullTriangleCount
+	};
+	AppendBytes(stream, header, sizeof(header));
+
+	if (mFullVertexCount > mBaseVertexCount)
+		AppendBytes(stream, &mParents[mBaseVertexCount], (mFullVertexCount - mBaseVertexCount)*sizeof(UINT));
+	if (mBaseVertexCount > 0)
+		AppendBytes(stream, &mVertices[0], mBaseVertexCount*mVertexStride);
+	if (mBaseTriangleCount > 0)
+		AppendBytes(stream, &mIndices[0], mBaseTriangleCount * 3 * sizeof(UINT));
+
+	UINT vertexCount = mBaseVertexCount;
+	size_t indexOffset = mBaseTriangleCount * 3;
+	for (size_t s = 0; s < mSplits.size(); ++s)
+	{
+		const VertexSplit& split = mSplits[s];
+		UINT counts[SplitHeaderWords] = { split.VertexCount, split.TriangleCount };
+		AppendBytes(stream, counts, sizeof(counts));
+
+		AppendBytes(stream, &mVertices[vertexCount*mVertexStride], split.VertexCount*mVertexStride);
+		if (split.TriangleCount > 0)
+			AppendBytes(stream, &mIndices[indexOffset], split.TriangleCount * 3 * sizeof(UINT));
+
+		vertexCount += split.VertexCount;
+		indexOffset += split.TriangleCount * 3;
+	}
+}
+
+bool ProgressiveMesh::Read(const BYTE* data, UINT size)
+{
+	mPending.insert(mPending.end(), data, data + size);
+
+	size_t offset = 0;
+	std::vector<UINT> indices;
+	std::vector<UINT> parents;
+	for (;;)
+	{
+		size_t left = mPending.size() - offset;
+		if (left == 0)
+			break;
+		const BYTE* p = &mPending[0] + offset;
+
+		if (!mHasBase)
+		{
+			UINT header[HeaderWords];
+			if (left < sizeof(header))
+				break;
+			memcpy(header, p, sizeof(header));
+
+			UINT stride = header[2];
+			UINT vertexCount = header[3];
+			UINT triangleCount = header[4];
+			UINT fullVertexCount = header[6];
+			if (header[0] != Magic || header[1] != Version || stride == 0 ||
+				vertexCount > fullVertexCount || triangleCount > header[7])
+			{
+				return false;
+			}
+
+			UINT parentCount = fullVertexCount - vertexCount;
+			UINT64 length = sizeof(header) + static_cast<UINT64>(parentCount)*sizeof(UINT) +
+				static_cast<UINT64>(vertexCount)*stride + static_cast<UINT64>(triangleCount) * 3 * sizeof(UINT);
+			if (left < length)
+				break;
+
+			// Each parent comes before its vertex, so every index resolves.
+			const BYTE* parentBytes = p + sizeof(header);
+			parents.resize(parentCount);
+			if (parentCount > 0)
+				memcpy(&parents[0], parentBytes, parentCount*sizeof(UINT));
+			for (UINT i = 0; i < parentCount; ++i)
+			{
+				if (parents[i] >= vertexCount + i)
+					return false;
+			}
+
+			const BYTE* vertices = parentBytes + parentCount*sizeof(UINT);
+			indices.resize(triangleCount * 3);
+			if (triangleCount > 0)
+				memcpy(&indices[0], vertices + vertexCount*stride, indices.size()*sizeof(UINT));
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				if (indices[i] >= fullVertexCount)
+					return false;
+			}
+
+			SetBase(stride, vertices, vertexCount, indices.empty() ? nullptr : &indices[0], triangleCount,
+				parents.empty() ? nullptr : &parents[0], header[5], fullVertexCount, header[7]);
+			offset += static_cast<size_t>(length);
+		}
+		else
+		{
+			// Anything after the last split is not part of the mesh.
+			if (mSplits.size() == mTotalSplitCount)
+				return false;
+
+			UINT counts[SplitHeaderWords];
+			if (left < sizeof(counts))
+				break;
+			memcpy(counts, p, sizeof(counts));
+
+			UINT vertexCount = counts[0];
+			UINT triangleCount = counts[1];
+			if (vertexCount == 0 || vertexCount > mFullVertexCount - LoadedVertexCount() ||
+				triangleCount > mFullTriangleCount - LoadedIndexCount() / 3)
+			{
+				return false;
+			}
+
+			UINT64 length = sizeof(counts) + static_cast<UINT64>(vertexCount)*mVertexStride +
+				static_cast<UINT64>(triangleCount) * 3 * sizeof(UINT);
+			if (left < length)
+				break;
+
+			const BYTE* vertices = p + sizeof(counts);
+			indices.resize(triangleCount * 3);
+			if (triangleCount > 0)
+				memcpy(&indices[0], vertices + vertexCount*mVertexStride, indices.size()*sizeof(UINT));
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				if (indices[i] >= mFullVertexCount)
+					return false;
+			}
+
+			AddSplit(vertices, vertexCount, indices.empty() ? nullptr : &indices[0], triangleCount);
+			offset += static_cast<size_t>(length);
+		}
+	}
+
+	mPending.erase(mPending.begin(), mPending.begin() + offset);
+	return true;
+}
+
+void ProgressiveMesh::SetAppliedSplitCount(UINT count)
+{
+	if (count > mSplits.size())
+		count = static_cast<UINT>(mSplits.size());
+
+	for (; mAppliedSplitCount < count; ++mAppliedSplitCount)
+	{
+		mVertexCount += mSplits[mAppliedSplitCount].VertexCount;
+		mIndexCount += mSplits[mAppliedSplitCount].TriangleCount * 3;
+	}
+	for (; mAppliedSplitCount > count; --mAppliedSplitCount)
+	{
+		mVertexCount -= mSplits[mAppliedSplitCount - 1].VertexCount;
+		mIndexCount -= mSplits[mAppliedSplitCount - 1].TriangleCount * 3;
+	}
+}
+
+void ProgressiveMesh::ResolveIndices(std::vector<UINT>& indices)const
+{
+	indices.resize(mIndexCount);
+	for (UINT i = 0; i < mIndexCount; ++i)
+		indices[i] = Resolve(mIndices[i]);
+}
@@ -0,0 +1,135 @@
+//***************************************************************************************
+// ProgressiveMesh.h
+//
+// A progressive mesh in the manner of Hoppe: a coarse base mesh followed by vertex
+// splits, each undoing one of the edge collapses MeshSimplifier made to reach the base,
+// so a mesh can be drawn from the first few kilobytes of its stream and refined as the
+// rest arrives or as it grows on screen.
+//
+// Vertices and triangles are numbered in the order the splits bring them in, so a split
+// only appends to the vertex buffer and the index list, and a level is the first
+// VertexCount() vertices and IndexCount() indices.  The indices never change: they name
+// the vertices of the full mesh, and each vertex a split brings in keeps the vertex it
+// splits off, which always comes before it.  A corner stands for the first vertex down
+// that chain that the level has, so the vertex shader resolves each index with
+//
+//     while (index >= gVertexCount) index = gParents[index];
+//
+// against a buffer of Parents().  The vertex, index and parent buffers are only ever
+// appended to as the stream arrives, and refining or coarsening uploads nothing but the
+// vertex count.
+//
+// The stream is 32-bit words: a header of the magic number, version, vertex stride,
+// base vertex and triangle counts, split count and full vertex and triangle counts,
+// then the parent of each vertex past the base, the base vertices and indices, then
+// each split as its vertex and triangle counts, its new vertices and indices.
+//***************************************************************************************
+
+#ifndef PROGRESSIVEMESH_H
+#define PROGRESSIVEMESH_H
+
+#include <Windows.h>
+
+#include <vector>
+
+class ProgressiveMesh
+{
+public:
+	static const UINT Magic = 0x48534D50; // "PMSH"
+	static const UINT Version = 2;
+
+	struct VertexSplit
+	{
+		// Vertices and triangles appended by the split.
+		UINT VertexCount;
+		UINT TriangleCount;
+	};
+
+	ProgressiveMesh();
+
+	// Forgets the mesh and any stream read so far.
+	void Clear();
+
+	// Starts the mesh from its base, of triangleCount triangles, before any splits are
+	// added.  The full counts are those with every split applied, for sizing buffers;
+	// parents holds the vertex each of the fullVertexCount - vertexCount vertices the
+	// splits bring in splits off, and must come before it.  The indices may name any
+	// vertex of the full mesh.
+	void SetBase(UINT vertexStride, const void* vertices, UINT vertexCount, const UINT* indices, UINT triangleCount,
+		const UINT* parents, UINT splitCount, UINT fullVertexCount, UINT fullTriangleCount);
+
+	// Appends the next split.
+	void AddSplit(const void* vertices, UINT vertexCount, const UINT* indices, UINT triangleCount);
+
+	// Appends the stream of the mesh to stream.
+	void Write(std::vector<BYTE>& stream)const;
+
+	// Takes in the next size bytes of a stream, after Clear(), and adds the base and the
+	// splits they complete; the rest is kept for the next call.  Returns false if the
+	// stream is not a valid progressive mesh, after which the mesh must be cleared.
+	bool Read(const BYTE* data, UINT size);
+
+	bool HasBase()const { return mHasBase; }
+	bool IsComplete()const { return mHasBase && mSplits.size() == mTotalSplitCount; }
+
+	UINT VertexStride()const { return mVertexStride; }
+	UINT FullVertexCount()const { return mFullVertexCount; }
+	UINT FullIndexCount()const { return mFullTriangleCount * 3; }
+
+	// Splits, vertices and indices taken in so far, in their final order, so buffers of
+	// the full counts only ever need the new ones written.
+	UINT SplitCount()const { return static_cast<UINT>(mSplits.size()); }
+	UINT LoadedVertexCount()const { return mVertexStride > 0 ? static_cast<UINT>(mVertices.size()) / mVertexStride : 0; }
+	UINT LoadedIndexCount()const { return static_cast<UINT>(mIndices.size()); }
+	const BYTE* Vertices()const { return mVertices.empty() ? nullptr : &mVertices[0]; }
+	const UINT* Indices()const { return mIndices.empty() ? nullptr : &mIndices[0]; }
+
+	// The vertex each vertex splits off, FullVertexCount() of them; the base vertices
+	// are their own.
+	const UINT* Parents()const { return mParents.empty() ? nullptr : &mParents[0]; }
+
+	// Refines or coarsens to the base with the first count splits applied, no further
+	// than the splits taken in.
+	void SetAppliedSplitCount(UINT count);
+	UINT AppliedSplitCount()const { return mAppliedSplitCount; }
+
+	// Vertices and indices to draw at the current level, the first of Vertices() and
+	// Indices().
+	UINT VertexCount()const { return mVertexCount; }
+	UINT IndexCount()const { return mIndexCount; }
+
+	// The vertex of the current level an index stands for, as the vertex shader finds it.
+	UINT Resolve(UINT index)const
+	{
+		while (index >= mVertexCount)
+			index = mParents[index];
+		return index;
+	}
+
+	// Replaces indices with the IndexCount() indices of the current level resolved, for
+	// drawing without the parent buffer.
+	void ResolveIndices(std::vector<UINT>& indices)const;
+
+private:
+	bool mHasBase;
+	UINT mVertexStride;
+	UINT mTotalSplitCount;
+	UINT mFullVertexCount;
+	UINT mFullTriangleCount;
+	UINT mBaseVertexCount;
+	UINT mBaseTriangleCount;
+
+	std::vector<BYTE> mVertices;
+	std::vector<UINT> mIndices;
+	std::vector<UINT> mParents;
+	std::vector<VertexSplit> mSplits;
+
+	UINT mAppliedSplitCount;
+	UINT mVertexCount;
+	UINT mIndexCount;
+
+	// Stream bytes not yet making up a whole record.
+	std::vector<BYTE> mPending;
+};
+
+#endif // PROGRESSIVEMESH_H
@@ -0,0 +1,414 @@
+//***************************************************************************************
+// TangentGenerator.cpp
+//***************************************************************************************
+
+#include "TangentGenerator.h"
+#include "MeshWelder.h"
+#include "ThreadPool.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertices, triangles or indices per task.
+	const UINT BlockSize = 16384;
+
+	// Positions this close, as a fraction of the size of the mesh, are the same one.
+	const float SamePosition = 1e-6f;
+
+	UINT BlockCount(UINT count)
+	{
+		return (count + BlockSize - 1) / BlockSize;
+	}
+
+	// v with its component along the unit vector n taken out, normalized; zero if
+	// nothing is left.
+	XMVECTOR ProjectOntoPlane(FXMVECTOR v, FXMVECTOR n)
+	{
+		XMVECTOR p = v - n*XMVectorGetX(XMVector3Dot(n, v));
+		float lengthSq = XMVectorGetX(XMVector3LengthSq(p));
+		return lengthSq > FLT_MIN ? p*(1.0f / sqrtf(lengthSq)) : XMVectorZero();
+	}
+
+	// Angle between two unit vectors.
+	float AngleBetween(FXMVECTOR a, FXMVECTOR b)
+	{
+		return acosf(MathHelper::Clamp(XMVectorGetX(XMVector3Dot(a, b)), -1.0f, 1.0f));
+	}
+
+	// Some unit vector at right angles to the unit vector n.
+	XMVECTOR Perpendicular(FXMVECTOR n)
+	{
+		XMVECTOR axis = fabsf(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		return XMVector3Normalize(XMVector3Cross(n, axis));
+	}
+}
+
+TangentGenerator::TangentGenerator()
+	: mThreadPool(nullptr)
+{
+}
+
+template <typename IndexT>
+void TangentGenerator::GenerateNormals(GeometryGenerator::BasicMeshData<IndexT>& meshData, NormalWeighting weighting,
+	float creaseAngle)
+{
+	std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	const std::vector<IndexT>& indices = meshData.Indices;
+	UINT vertexCount = static_cast<UINT>(vertices.size());
+	UINT triangleCount = static_cast<UINT>(indices.size()) / 3;
+	if (vertexCount == 0 || triangleCount == 0)
+		return;
+
+	//
+	// The normal of each triangle, and how much each of its corners counts.
+	//
+
+	std::vector<XMFLOAT3> faceNormals(triangleCount);
+	std::vector<float> weights(triangleCount * 3);
+	ThreadPool::Run(mThreadPool, BlockCount(triangleCount), [&](UINT block, UINT)
+	{
+		UINT end = MathHelper::Min(triangleCount, (block + 1)*BlockSize);
+		for (UINT t = block*BlockSize; t < end; ++t)
+		{
+			XMVECTOR p[3];
+			for (UINT c = 0; c < 3; ++c)
+				p[c] = XMLoadFloat3(&vertices[indices[t * 3 + c]].Position);
+
+			XMVECTOR n = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+			float doubleArea = XMVectorGetX(XMVector3Length(n));
+			XMStoreFloat3(&faceNormals[t], doubleArea > 0.0f ? n*(1.0f / doubleArea) : XMVectorZero());
+
+			for (UINT c = 0; c < 3; ++c)
+			{
+				if (weighting == AreaWeighted)
+				{
+					weights[t * 3 + c] = 0.5f*doubleArea;
+				}
+				else
+				{
+					XMVECTOR e1 = XMVector3Normalize(p[(c + 1) % 3] - p[c]);
+					XMVECTOR e2 = XMVector3Normalize(p[(c + 2) % 3] - p[c]);
+					weights[t * 3 + c] = doubleArea > 0.0f ? AngleBetween(e1, e2) : 0.0f;
+				}
+			}
+		}
+	});
+
+	std::vector<UINT> firstCorner;
+	std::vector<UINT> corners;
+	GroupBy(&indices[0], triangleCount * 3, vertexCount, firstCorner, corners);
+
+	// Each vertex's own normal, from the triangles that use it.
+	std::vector<XMFLOAT3> own(vertexCount);
+	ThreadPool::Run(mThreadPool, BlockCount(vertexCount), [&](UINT block, UINT)
+	{
+		UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+		for (UINT v = block*BlockSize; v < end; ++v)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (UINT i = firstCorner[v]; i < firstCorner[v + 1]; ++i)
+				sum += XMLoadFloat3(&faceNormals[corners[i] / 3])*weights[corners[i]];
+			XMStoreFloat3(&own[v], XMVector3Normalize(sum));
+		}
+	});
+
+	//
+	// Then the triangles of the other vertices at the same position that are close
+	// enough to it.
+	//
+
+	std::vector<UINT> firstShared;
+	std::vector<UINT> shared;
+	if (creaseAngle > 0.0f)
+	{
+		XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			const XMFLOAT3& p = vertices[v].Position;
+			lo = XMFLOAT3(MathHelper::Min(lo.x, p.x), MathHelper::Min(lo.y, p.y), MathHelper::Min(lo.z, p.z));
+			hi = XMFLOAT3(MathHelper::Max(hi.x, p.x), MathHelper::Max(hi.y, p.y), MathHelper::Max(hi.z, p.z));
+		}
+		float extent = MathHelper::Max(hi.x - lo.x, MathHelper::Max(hi.y - lo.y, hi.z - lo.z));
+
+		// Positions numbered by welding on position alone.
+		MeshWelder welder;
+		welder.SetThreadPool(mThreadPool);
+		std::vector<UINT> positionOf;
+		UINT positionCount = welder.BuildRemap(&vertices[0], vertexCount,
+			MeshWelder::Tolerance(MathHelper::Max(extent*SamePosition, FLT_MIN), FLT_MAX, FLT_MAX), positionOf);
+		GroupBy(&positionOf[0], vertexCount, positionCount, firstShared, shared);
+
+		float cosCrease = cosf(creaseAngle);
+		ThreadPool::Run(mThreadPool, BlockCount(vertexCount), [&](UINT block, UINT)
+		{
+			UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+			for (UINT v = block*BlockSize; v < end; ++v)
+			{
+				if (firstCorner[v] == firstCorner[v + 1])
+					continue;
+
+				XMVECTOR n = XMLoadFloat3(&own[v]);
+				UINT position = positionOf[v];
+				if (firstShared[position + 1] - firstShared[position] == 1)
+				{
+					XMStoreFloat3(&vertices[v].Normal, n);
+					continue;
+				}
+
+				XMVECTOR sum = XMVectorZero();
+				for (UINT s = firstShared[position]; s < firstShared[position + 1]; ++s)
+				{
+					UINT u = shared[s];
+					for (UINT i = firstCorner[u]; i < firstCorner[u + 1]; ++i)
+					{
+						XMVECTOR faceNormal = XMLoadFloat3(&faceNormals[corners[i] / 3]);
+						if (u == v || XMVectorGetX(XMVector3Dot(faceNormal, n)) >= cosCrease)
+							sum += faceNormal*weights[corners[i]];
+					}
+				}
+				XMStoreFloat3(&vertices[v].Normal, XMVector3Normalize(sum));
+			}
+		});
+	}
+	else
+	{
+		for (UINT v = 0; v < vertexCount; ++v)
+		{
+			if (firstCorner[v] != firstCorner[v + 1])
+				vertices[v].Normal = own[v];
+		}
+	}
+}
+
+template <typename IndexT>
+void TangentGenerator::GenerateTangents(GeometryGenerator::BasicMeshData<IndexT>& meshData,
+	std::vector<float>* bitangentSigns)
+{
+	std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	std::vector<IndexT>& indices = meshData.Indices;
+	UINT vertexCount = static_cast<UINT>(vertices.size());
+	UINT triangleCount = static_cast<UINT>(indices.size()) / 3;
+
+	//
+	// The direction of increasing u across each triangle, as MikkTSpace takes it: w is
+	// 1 where texture space keeps the winding, -1 where it is mirrored, and 0 where
+	// the triangle has no area in texture space or none in space.
+	//
+
+	std::vector<XMFLOAT4> faceTangents(triangleCount);
+	ThreadPool::Run(mThreadPool, BlockCount(triangleCount), [&](UINT block, UINT)
+	{
+		UINT end = MathHelper::Min(triangleCount, (block + 1)*BlockSize);
+		for (UINT t = block*BlockSize; t < end; ++t)
+		{
+			const GeometryGenerator::Vertex& v0 = vertices[indices[t * 3]];
+			const GeometryGenerator::Vertex& v1 = vertices[indices[t * 3 + 1]];
+			const GeometryGenerator::Vertex& v2 = vertices[indices[t * 3 + 2]];
+
+			XMVECTOR d1 = XMLoadFloat3(&v1.Position) - XMLoadFloat3(&v0.Position);
+			XMVECTOR d2 = XMLoadFloat3(&v2.Position) - XMLoadFloat3(&v0.Position);
+			float t21x = v1.TexC.x - v0.TexC.x;
+			float t21y = v1.TexC.y - v0.TexC.y;
+			float t31x = v2.TexC.x - v0.TexC.x;
+			float t31y = v2.TexC.y - v0.TexC.y;
+
+			float signedArea = t21x*t31y - t21y*t31x;
+			float sign = signedArea > 0.0f ? 1.0f : -1.0f;
+			XMVECTOR s = d1*t31y - d2*t21y;
+			float length = XMVectorGetX(XMVector3Length(s));
+
+			XMFLOAT4& faceTangent = faceTangents[t];
+			if (fabsf(signedArea) > FLT_MIN && length > 0.0f)
+			{
+				XMStoreFloat4(&faceTangent, s*(sign / length));
+				faceTangent.w = sign;
+			}
+			else
+			{
+				faceTangent = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+			}
+		}
+	});
+
+	std::vector<UINT> firstCorner;
+	std::vector<UINT> corners;
+	if (triangleCount > 0)
+		GroupBy(&indices[0], triangleCount * 3, vertexCount, firstCorner, corners);
+	else
+		firstCorner.assign(vertexCount + 1, 0);
+
+	//
+	// Each vertex averages its corners apart by winding, weighted by the angle of the
+	// corner in the plane of the normal.  The winding of its first corner stays with
+	// it; the other, if any, goes to a copy.
+	//
+
+	std::vector<XMFLOAT4> tangents(vertexCount);
+	std::vector<XMFLOAT4> mirrored(vertexCount);
+	UINT vertexBlocks = BlockCount(vertexCount);
+	std::vector<UINT> blockSplits(vertexBlocks + 1, 0);
+	ThreadPool::Run(mThreadPool, vertexBlocks, [&](UINT block, UINT)
+	{
+		UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+		for (UINT v = block*BlockSize; v < end; ++v)
+		{
+			XMVECTOR n = XMLoadFloat3(&vertices[v].Normal);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[v].Position);
+
+			XMVECTOR sums[2] = { XMVectorZero(), XMVectorZero() };
+			float first = 0.0f;
+			for (UINT i = firstCorner[v]; i < firstCorner[v + 1]; ++i)
+			{
+				UINT t = corners[i] / 3;
+				UINT c = corners[i] % 3;
+				const XMFLOAT4& faceTangent = faceTangents[t];
+				if (faceTangent.w == 0.0f)
+					continue;
+
+				XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + (c + 2) % 3]].Position);
+				XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + (c + 1) % 3]].Position);
+				float angle = AngleBetween(ProjectOntoPlane(p0 - p1, n), ProjectOntoPlane(p2 - p1, n));
+
+				first = (first == 0.0f) ? faceTangent.w : first;
+				sums[faceTangent.w == first ? 0 : 1] += ProjectOntoPlane(XMLoadFloat4(&faceTangent), n)*angle;
+			}
+
+			XMVECTOR fallback = Perpendicular(n);
+			for (UINT k = 0; k < 2; ++k)
+			{
+				XMFLOAT4& tangent = (k == 0) ? tangents[v] : mirrored[v];
+				float lengthSq = XMVectorGetX(XMVector3LengthSq(sums[k]));
+				XMStoreFloat4(&tangent, lengthSq > FLT_MIN ? sums[k] * (1.0f / sqrtf(lengthSq)) : fallback);
+				tangent.w = (k == 0) ? (first != 0.0f ? first : 1.0f) : -first;
+			}
+
+			// Only copies that were given a tangent of their own.
+			if (XMVectorGetX(XMVector3LengthSq(sums[1])) <= FLT_MIN)
+				mirrored[v].w = 0.0f;
+			else
+				++blockSplits[block + 1];
+		}
+	});
+
+	// Number the copies block by block, as many as the index type has room for.
+	for (UINT block = 0; block < vertexBlocks; ++block)
+		blockSplits[block + 1] += blockSplits[block];
+	UINT64 indexLimit = static_cast<UINT64>(static_cast<IndexT>(~0u)) + 1;
+	UINT64 room = indexLimit > vertexCount ? indexLimit - vertexCount : 0;
+	UINT splitCount = static_cast<UINT>(MathHelper::Min<UINT64>(blockSplits[vertexBlocks], room));
+	vertices.resize(vertexCount + splitCount);
+
+	if (bitangentSigns != nullptr)
+		bitangentSigns->resize(vertexCount + splitCount);
+
+	ThreadPool::Run(mThreadPool, vertexBlocks, [&](UINT block, UINT)
+	{
+		UINT next = vertexCount + blockSplits[block];
+		UINT end = MathHelper::Min(vertexCount, (block + 1)*BlockSize);
+		for (UINT v = block*BlockSize; v < end; ++v)
+		{
+			const XMFLOAT4& tangent = tangents[v];
+			vertices[v].TangentU = XMFLOAT3(tangent.x, tangent.y, tangent.z);
+			if (bitangentSigns != nullptr)
+				(*bitangentSigns)[v] = tangent.w;
+
+			const XMFLOAT4& copy = mirrored[v];
+			if (copy.w == 0.0f || next >= vertexCount + splitCount)
+				continue;
+
+			vertices[next] = vertices[v];
+			vertices[next].TangentU = XMFLOAT3(copy.x, copy.y, copy.z);
+			if (bitangentSigns != nullptr)
+				(*bitangentSigns)[next] = copy.w;
+
+			for (UINT i = firstCorner[v]; i < firstCorner[v + 1]; ++i)
+			{
+				if (faceTangents[corners[i] / 3].w == copy.w)
+					indices[corners[i]] = static_cast<IndexT>(next);
+			}
+			++next;
+		}
+	});
+}
+
+template <typename KeyT>
+void TangentGenerator::GroupBy(const KeyT* keys, UINT keyCount, UINT itemCount, std::vector<UINT>& first,
+	std::vector<UINT>& entries)
+{
+	// Each block of keys counts how many it has for each block of items...
+	UINT keyBlocks = BlockCount(keyCount);
+	UINT itemBlocks = MathHelper::Max(BlockCount(itemCount), 1u);
+	std::vector<UINT> offsets(keyBlocks*itemBlocks, 0);
+	ThreadPool::Run(mThreadPool, keyBlocks, [&](UINT block, UINT)
+	{
+		UINT* counts = &offsets[block*itemBlocks];
+		UINT end = MathHelper::Min(keyCount, (block + 1)*BlockSize);
+		for (UINT i = block*BlockSize; i < end; ++i)
+			++counts[keys[i] / BlockSize];
+	});
+
+	// ...so they can put them in place side by side, in order within each item block...
+	std::vector<UINT> itemBlockStart(itemBlocks + 1);
+	UINT total = 0;
+	for (UINT itemBlock = 0; itemBlock < itemBlocks; ++itemBlock)
+	{
+		itemBlockStart[itemBlock] = total;
+		for (UINT block = 0; block < keyBlocks; ++block)
+		{
+			UINT count = offsets[block*itemBlocks + itemBlock];
+			offsets[block*itemBlocks + itemBlock] = total;
+			total += count;
+		}
+	}
+	itemBlockStart[itemBlocks] = total;
+
+	std::vector<UINT> byBlock(keyCount);
+	ThreadPool::Run(mThreadPool, keyBlocks, [&](UINT block, UINT)
+	{
+		UINT* next = &offsets[block*itemBlocks];
+		UINT end = MathHelper::Min(keyCount, (block + 1)*BlockSize);
+		for (UINT i = block*BlockSize; i < end; ++i)
+			byBlock[next[keys[i] / BlockSize]++] = i;
+	});
+
+	// ...and each item block sorts its own by item, keeping that order.
+	first.resize(itemCount + 1);
+	entries.resize(keyCount);
+	first[itemCount] = keyCount;
+	ThreadPool::Run(mThreadPool, itemBlocks, [&](UINT itemBlock, UINT)
+	{
+		UINT firstItem = itemBlock*BlockSize;
+		UINT endItem = MathHelper::Min(itemCount, firstItem + BlockSize);
+		std::vector<UINT> counts(endItem - firstItem, 0);
+		for (UINT i = itemBlockStart[itemBlock]; i < itemBlockStart[itemBlock + 1]; ++i)
+			++counts[keys[byBlock[i]] - firstItem];
+
+		UINT start = itemBlockStart[itemBlock];
+		for (UINT item = firstItem; item < endItem; ++item)
+		{
+			UINT count = counts[item - firstItem];
+			first[item] = start;
+			counts[item - firstItem] = start;
+			start += count;
+		}
+
+		for (UINT i = itemBlockStart[itemBlock]; i < itemBlockStart[itemBlock + 1]; ++i)
+			entries[counts[keys[byBlock[i]] - firstItem]++] = byBlock[i];
+	});
+}
+
+//
+// The generator for both index widths.
+//
+
+#define INSTANTIATE_TANGENT_GENERATOR(IndexT) \
+	template void TangentGenerator::GenerateNormals(GeometryGenerator::BasicMeshData<IndexT>&, NormalWeighting, float); \
+	template void TangentGenerator::GenerateTangents(GeometryGenerator::BasicMeshData<IndexT>&, std::vector<float>*);
+
+INSTANTIATE_TANGENT_GENERATOR(UINT)
+INSTANTIATE_TANGENT_GENERATOR(USHORT)
@@ -0,0 +1,76 @@
+//***************************************************************************************
+// TangentGenerator.h
+//
+// Recomputes smooth normals and tangent frames for any mesh from its positions and
+// texture coordinates, for meshes loaded without them.  Tangents follow MikkTSpace:
+// each triangle's direction of increasing u, projected into the plane of the vertex
+// normal and weighted by the angle of the corner, with triangles whose texture space is
+// mirrored kept apart from the rest, so normal maps baked against MikkTSpace line up.
+//
+// Every vertex gathers from the triangles around it instead of the triangles
+// scattering into their vertices: the table of corners by vertex is built in blocks
+// that each count and place their own corners, so no thread writes where another does,
+// and each vertex sums its corners in index order, which gives the same bits however
+// many threads do the work.
+//***************************************************************************************
+
+#ifndef TANGENTGENERATOR_H
+#define TANGENTGENERATOR_H
+
+#include <Windows.h>
+
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+class ThreadPool;
+
+class TangentGenerator
+{
+public:
+	// How much each triangle around a vertex counts towards its normal: by its area,
+	// or by the angle of its corner there, which does not change when a triangle is
+	// split in two.
+	enum NormalWeighting
+	{
+		AreaWeighted,
+		AngleWeighted
+	};
+
+	TangentGenerator();
+
+	// Runs every pass over the triangles and vertices in blocks on the given pool, null
+	// runs them on the calling thread.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+	// Replaces the normals of the vertices that triangles use with the weighted average
+	// of the normals of their triangles.  Triangles around other vertices at the same
+	// position count as well when they are within creaseAngle radians of the vertex's
+	// own, so texture seams come out smooth while hard edges, which already have
+	// vertices of their own, stay hard; 0 leaves each vertex to its own triangles.
+	template <typename IndexT>
+	void GenerateNormals(GeometryGenerator::BasicMeshData<IndexT>& meshData, NormalWeighting weighting = AngleWeighted,
+		float creaseAngle = 0.25f*MathHelper::Pi);
+
+	// Replaces TangentU with MikkTSpace tangents, from the normals already in place.
+	// A vertex used by mirrored and unmirrored triangles is split in two, the copy
+	// appended to the vertices and the mirrored corners moved onto it, unless the
+	// index type has no room for it.  bitangentSigns, when given, gets the sign of the
+	// bitangent of each vertex: cross(Normal, TangentU) times the sign.  Vertices with
+	// the same attributes but different indices are treated apart, as MikkTSpace would
+	// not, so weld the mesh first.
+	template <typename IndexT>
+	void GenerateTangents(GeometryGenerator::BasicMeshData<IndexT>& meshData, std::vector<float>* bitangentSigns = nullptr);
+
+private:
+	// Fills first with where the entries of each of the itemCount items start, and
+	// entries with the places in keys that hold each item, in order.
+	template <typename KeyT>
+	void GroupBy(const KeyT* keys, UINT keyCount, UINT itemCount, std::vector<UINT>& first, std::vector<UINT>& entries);
+
+
+private:
+	ThreadPool* mThreadPool;
+};
+
+#endif // TANGENTGENERATOR_H
@@ -0,0 +1,133 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(UINT threadCount)
+	: mTask(nullptr),
+	  mTaskCount(0),
+	  mNextTask(0),
+	  mTasksDone(0),
+	  mActiveWorkers(0),
+	  mGeneration(0),
+	  mQuit(false)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+
+	// The calling thread is one of the workers.
+	for (UINT i = 1; i < threadCount; ++i)
+		mWorkers.push_back(std::thread(&ThreadPool::WorkerMain, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeCV.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+}
+
+UINT ThreadPool::ThreadCount()const
+{
+	return static_cast<UINT>(mWorkers.size()) + 1;
+}
+
+void ThreadPool::ParallelFor(UINT taskCount, const std::function<void(UINT, UINT)>& task)
+{
+	if (taskCount == 0)
+		return;
+
+	// Not worth waking anybody up for.
+	if (taskCount == 1 || mWorkers.empty())
+	{
+		for (UINT i = 0; i < taskCount; ++i)
+			task(i, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTask = &task;
+		mTaskCount = taskCount;
+		mNextTask = 0;
+		mTasksDone = 0;
+		++mGeneration;
+	}
+	mWakeCV.notify_all();
+
+	UINT done = RunTasks(task, taskCount, 0);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mTasksDone += done;
+	mDoneCV.wait(lock, [this]{ return mTasksDone == mTaskCount && mActiveWorkers == 0; });
+	mTask = nullptr;
+}
+
+void ThreadPool::Run(ThreadPool* pool, UINT taskCount, const std::function<void(UINT, UINT)>& task)
+{
+	if (pool != nullptr)
+	{
+		pool->ParallelFor(taskCount, task);
+	}
+	else
+	{
+		for (UINT i = 0; i < taskCount; ++i)
+			task(i, 0);
+	}
+}
+
+void ThreadPool::WorkerMain(UINT thread)
+{
+	UINT seenGeneration = 0;
+
+	for (;;)
+	{
+		const std::function<void(UINT, UINT)>* task = nullptr;
+		UINT taskCount = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCV.wait(lock, [&]{ return mQuit || mGeneration != seenGeneration; });
+
+			if (mQuit)
+				return;
+
+			seenGeneration = mGeneration;
+
+			// The job may already be over if we woke up late.
+			if (mTask == nullptr)
+				continue;
+
+			task = mTask;
+			taskCount = mTaskCount;
+			++mActiveWorkers;
+		}
+
+		UINT done = RunTasks(*task, taskCount, thread);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasksDone += done;
+		--mActiveWorkers;
+		if (mTasksDone == mTaskCount && mActiveWorkers == 0)
+			mDoneCV.notify_one();
+	}
+}
+
+UINT ThreadPool::RunTasks(const std::function<void(UINT, UINT)>& task, UINT taskCount, UINT thread)
+{
+	UINT done = 0;
+
+	for (UINT i = mNextTask++; i < taskCount; i = mNextTask++)
+	{
+		task(i, thread);
+		++done;
+	}
+
+	return done;
+}
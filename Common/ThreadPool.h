@@ -0,0 +1,70 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// A small fork/join pool of worker threads.  ParallelFor() hands out task indices to
+// the workers and the calling thread, and returns once every index has been run, so
+// consecutive ParallelFor() calls act as barriers.
+//***************************************************************************************
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <Windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// threadCount includes the calling thread; 0 uses one thread per hardware thread.
+	explicit ThreadPool(UINT threadCount = 0);
+	~ThreadPool();
+
+	// Number of threads that run tasks, including the thread calling ParallelFor().
+	UINT ThreadCount()const;
+
+	// Calls task(i, thread) for every i in [0, taskCount) and waits for all of them.
+	// Which thread runs which index is unspecified; thread is in [0, ThreadCount())
+	// and no two tasks running at the same time get the same one, so it can be used
+	// to pick per-thread scratch memory.  Must not be called from inside a task.
+	void ParallelFor(UINT taskCount, const std::function<void(UINT, UINT)>& task);
+
+	// ParallelFor() on pool, or every task in order on the calling thread as thread 0
+	// when pool is null, for code that takes an optional pool.
+	static void Run(ThreadPool* pool, UINT taskCount, const std::function<void(UINT, UINT)>& task);
+
+private:
+	ThreadPool(const ThreadPool& rhs);
+	ThreadPool& operator=(const ThreadPool& rhs);
+
+	void WorkerMain(UINT thread);
+	UINT RunTasks(const std::function<void(UINT, UINT)>& task, UINT taskCount, UINT thread);
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWakeCV;
+	std::condition_variable mDoneCV;
+
+	// The job currently being run.
+	const std::function<void(UINT, UINT)>* mTask;
+	UINT mTaskCount;
+	std::atomic<UINT> mNextTask;
+	UINT mTasksDone;
+
+	// Workers that joined the current job and have not left it yet.  ParallelFor()
+	// does not return before this drops to zero, so no worker can still be looking
+	// at a job that has been replaced.
+	UINT mActiveWorkers;
+
+	// Incremented for every job so sleeping workers can tell a new one was posted.
+	UINT mGeneration;
+	bool mQuit;
+};
+
+#endif // THREADPOOL_H
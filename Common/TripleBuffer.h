@@ -0,0 +1,76 @@
+//***************************************************************************************
+// TripleBuffer.h
+//
+// Hands the latest of a stream of values from one writer thread to one reader thread
+// without either of them ever waiting for the other.  The writer fills the back
+// buffer and publishes it by swapping it with the middle one; the reader swaps the
+// middle buffer with its front one when a newer value has been published.  The swaps
+// are single atomic exchanges, so both sides always own a buffer nobody else touches.
+//
+// Values the reader does not get round to taking are overwritten by newer ones.  The
+// back buffer the writer gets after publishing is whichever buffer it swapped with,
+// which may hold an older value than the one just published, so writers that update
+// their buffers incrementally must keep track of what each buffer holds.
+//***************************************************************************************
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <Windows.h>
+#include <atomic>
+
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+		: mBack(0),
+		  mMiddle(1),
+		  mFront(2)
+	{
+	}
+
+	// Buffer i in [0, 3), to set them up before the writer and reader start.
+	T& operator[](UINT i) { return mBuffers[i]; }
+
+	// Only from the writer thread.
+	T& Back() { return mBuffers[mBack]; }
+
+	// Only from the writer thread.  Makes the back buffer the newest value and hands
+	// the writer another one.
+	void Publish()
+	{
+		mBack = mMiddle.exchange(mBack | FreshBit, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// Only from the reader thread.  Makes the newest published value the front buffer;
+	// returns false, and keeps the front buffer, if nothing was published since the
+	// last call.
+	bool Acquire()
+	{
+		if ((mMiddle.load(std::memory_order_relaxed) & FreshBit) == 0)
+			return false;
+
+		mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+
+	// Only from the reader thread.
+	const T& Front()const { return mBuffers[mFront]; }
+
+private:
+	TripleBuffer(const TripleBuffer& rhs);
+	TripleBuffer& operator=(const TripleBuffer& rhs);
+
+	// mMiddle holds the index of the middle buffer and whether it has been published
+	// since the reader last took it.
+	static const UINT IndexMask = 3;
+	static const UINT FreshBit = 4;
+
+	T mBuffers[3];
+	UINT mBack;
+	std::atomic<UINT> mMiddle;
+	UINT mFront;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -158,15 +158,18 @@ void TexturedEffect::SetSampler(ID3D11DeviceContext* dc)
 
 BasicEffect* Effects::BasicFX = nullptr;
 TexturedEffect* Effects::TexturedFX = nullptr;
+TexturedEffect* Effects::WavesFX = nullptr;
 
 void Effects::InitAll(ID3D11Device* device)
 {
 	BasicFX = new BasicEffect(device, L"BasicVertexShader.cso", L"BasicPixelShader.cso");
 	TexturedFX = new TexturedEffect(device, L"TexturedVertexShader.cso", L"TexturedPixelShader.cso");
+	WavesFX = new TexturedEffect(device, L"WavesVertexShader.cso", L"TexturedPixelShader.cso");
 }
 
 void Effects::DestroyAll()
 {
 	SafeDelete(BasicFX);
 	SafeDelete(TexturedFX);
+	SafeDelete(WavesFX);
 }
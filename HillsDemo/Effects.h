@@ -105,5 +105,8 @@ class Effects
 
 	static BasicEffect* BasicFX;
 	static TexturedEffect* TexturedFX;
+
+	// TexturedFX with the vertex shader for compact wave vertices.
+	static TexturedEffect* WavesFX;
 };
 
@@ -16,18 +16,24 @@
 //      Press '2' - Texture render mode.
 //      Press '3' - Fog render mode.
 //
+//      Press 'A' - Simulate the waves on a thread of their own (default).
+//      Press 'S' - Simulate the waves in UpdateScene().
+//
 //***************************************************************************************
 
 
 #include <d3dApp.h>
 #include <MathHelper.h>
 #include <DDSTextureLoader.h>
+#include <ThreadPool.h>
 
 #include <GeometryGenerator.h>
+#include <MeshOptimizer.h>
 #include "Vertex.h"
 #include "Effects.h"
 
 #include "Waves.h"
+#include "WavesThread.h"
 #include "RenderStates.h"
 
 using namespace DirectX;
@@ -67,6 +73,7 @@ class HillsApp : public D3DApp
 	ID3D11Buffer* mLandVB;
 	ID3D11Buffer* mLandIB;
 
+	ID3D11Buffer* mWavesGridVB;
 	ID3D11Buffer* mWavesVB;
 	ID3D11Buffer* mWavesIB;
 
@@ -77,7 +84,9 @@ class HillsApp : public D3DApp
 	ID3D11ShaderResourceView* mWavesMapSRV;
 	ID3D11ShaderResourceView* mBoxMapSRV;
 
+	ThreadPool mThreadPool;
 	Waves mWaves;
+	WavesThread mWavesThread;
 
 	DirectionalLight mDirLights[3];
 	Material mLandMat;
@@ -97,6 +106,11 @@ class HillsApp : public D3DApp
 
 	UINT mLandIndexCount;
 
+	// Staging copy of mWavesVB when the waves are stepped in UpdateScene(), and the
+	// Waves::Revision() the buffer holds.
+	std::vector<Vertex::WaveCompact> mWavesVertices;
+	UINT mWavesVBRevision;
+
 	XMFLOAT2 mWaterTexOffset;
 
 	RenderOptions mRenderOptions;
@@ -131,6 +145,7 @@ HillsApp::HillsApp(HINSTANCE hInstance)
 	: D3DApp(hInstance),
 	mLandVB(nullptr),
 	mLandIB(nullptr),
+	mWavesGridVB(nullptr),
 	mWavesVB(nullptr),
 	mWavesIB(nullptr),
 	mBoxVB(nullptr),
@@ -139,6 +154,7 @@ HillsApp::HillsApp(HINSTANCE hInstance)
 	mWavesMapSRV(nullptr),
 	mBoxMapSRV(nullptr),
 	mLandIndexCount(0),
+	mWavesVBRevision(0),
 	mWaterTexOffset(0.0f, 0.0f),
 	mRenderOptions(RenderOptions::TexturesAndFog),
 	mEyePosW(0.0f, 0.0f, 0.0f),
@@ -194,9 +210,12 @@ HillsApp::HillsApp(HINSTANCE hInstance)
 
 HillsApp::~HillsApp()
 {
+	mWavesThread.Stop();
+
 	md3dImmediateContext->ClearState();
 	ReleaseCOM(mLandVB);
 	ReleaseCOM(mLandIB);
+	ReleaseCOM(mWavesGridVB);
 	ReleaseCOM(mWavesVB);
 	ReleaseCOM(mWavesIB);
 	ReleaseCOM(mBoxVB);
@@ -216,6 +235,12 @@ bool HillsApp::Init()
 		return false;
 
 	mWaves.Init(160, 160, 1.0f, 0.03f, 5.0f, 0.3f);
+	mWaves.SetThreadPool(&mThreadPool);
+
+	// Only simulate the water around the random waves, and none under the hills.
+	// Waves stay well below a meter, so that is where the land begins.
+	mWaves.SetActivityTracking(true);
+	mWaves.SetLandMask([this](float x, float z) { return GetHillHeight(x, z) > 1.0f; });
 
 	// Must init Effects first since InputLayouts depend on shader signatures.
 	Effects::InitAll(md3dDevice);
@@ -238,6 +263,8 @@ bool HillsApp::Init()
 
 	BuildGeometryBuffers();
 
+	mWavesThread.Start(mWaves);
+
 	return true;
 }
 
@@ -275,35 +302,61 @@ void HillsApp::UpdateScene(float dt)
 	{
 		t_base += 0.1f;
 
-		DWORD i = 5 + rand() % (mWaves.RowCount() - 10);
-		DWORD j = 5 + rand() % (mWaves.ColumnCount() - 10);
+		WaveImpulse impulse;
+		impulse.Row = static_cast<float>(5 + rand() % (mWaves.RowCount() - 10));
+		impulse.Col = static_cast<float>(5 + rand() % (mWaves.ColumnCount() - 10));
+		impulse.Magnitude = MathHelper::RandF(0.5f, 1.0f);
+		impulse.Radius = 0.0f;
+		impulse.Footprint = WaveFootprintPoint5;
 
-		float r = MathHelper::RandF(0.5f, 1.0f);
-
-		mWaves.Disturb(i, j, r);
+		mWaves.DisturbBatch(&impulse, 1);
 	}
 
-	mWaves.Update(dt);
-
 	//
-	// Update the wave vertex buffer with the new solution.
+	// Update the rows of the wave vertex buffer that changed since the last upload,
+	// from the newest snapshot of the simulation thread or after stepping the waves
+	// here.
 	//
 
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	const Vertex::WaveCompact* vertices;
+	UINT revision;
+	UINT row0, row1;
+	bool changed;
+	if (mWavesThread.IsRunning())
+	{
+		mWavesThread.AcquireSnapshot();
+		const WaveSnapshot& snapshot = mWavesThread.Snapshot();
 
-	Vertex::Basic32* v = reinterpret_cast<Vertex::Basic32*>(mappedData.pData);
-	for (UINT i = 0; i < mWaves.VertexCount(); i++)
+		changed = snapshot.GetRowsChangedSince(mWavesVBRevision, row0, row1);
+		vertices = &snapshot.Vertices[0];
+		revision = snapshot.Revision;
+	}
+	else
 	{
-		v[i].Pos = mWaves[i];
-		v[i].Normal = mWaves.Normal(i);
+		mWaves.Update(dt);
 
-		// Derive tex-coords in [0,1] from position.
-		v[i].Tex.x  = 0.5f + mWaves[i].x / mWaves.Width();
-		v[i].Tex.y  = 0.5f - mWaves[i].z / mWaves.Depth();
+		changed = mWaves.GetRowsChangedSince(mWavesVBRevision, row0, row1);
+		if (changed)
+			mWaves.EmitCompactVertices(&mWavesVertices[0], row0, row1);
+		vertices = &mWavesVertices[0];
+		revision = mWaves.Revision();
 	}
 
-	md3dImmediateContext->Unmap(mWavesVB, 0);
+	if (changed)
+	{
+		UINT n = mWaves.ColumnCount();
+
+		D3D11_BOX box;
+		box.left = sizeof(Vertex::WaveCompact) * row0 * n;
+		box.right = sizeof(Vertex::WaveCompact) * row1 * n;
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		md3dImmediateContext->UpdateSubresource(mWavesVB, 0, &box, &vertices[row0 * n], 0, 0);
+	}
+
+	mWavesVBRevision = revision;
 
 	//
 	// Animate water texture coordinates.
@@ -331,6 +384,12 @@ void HillsApp::UpdateScene(float dt)
 
 	if( GetAsyncKeyState('3') & 0x8000 )
 		mRenderOptions = RenderOptions::TexturesAndFog; 
+
+	if( (GetAsyncKeyState('A') & 0x8000) && !mWavesThread.IsRunning() )
+		mWavesThread.Start(mWaves);
+
+	if( (GetAsyncKeyState('S') & 0x8000) && mWavesThread.IsRunning() )
+		mWavesThread.Stop();
 }
 
 void HillsApp::DrawScene()
@@ -382,7 +441,7 @@ void HillsApp::DrawScene()
 	// Draw the box
 	//
 	md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R16_UINT, 0);
 
 	// Set per object constants.
 	XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
@@ -399,7 +458,7 @@ void HillsApp::DrawScene()
 	// Draw the hills
 	//
 	md3dImmediateContext->IASetVertexBuffers(0, 1, &mLandVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mLandIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(mLandIB, DXGI_FORMAT_R16_UINT, 0);
 
 	// Set per object constants.
 	world = XMLoadFloat4x4(&mLandWorld);
@@ -412,8 +471,17 @@ void HillsApp::DrawScene()
 	// Draw the waves.
 	//
 
-	md3dImmediateContext->IASetVertexBuffers(0, 1, &mWavesVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mWavesIB, DXGI_FORMAT_R32_UINT, 0);
+	// The waves use two streams: the static grid and the compact per-step data.
+	// The per frame pixel shader constants and the sampler set above stay bound.
+	ID3D11Buffer* wavesVBs[2] = { mWavesGridVB, mWavesVB };
+	UINT wavesStrides[2] = { sizeof(Vertex::WaveGrid), sizeof(Vertex::WaveCompact) };
+	UINT wavesOffsets[2] = { 0, 0 };
+
+	md3dImmediateContext->IASetInputLayout(InputLayouts::WaveCompact);
+	md3dImmediateContext->IASetVertexBuffers(0, 2, wavesVBs, wavesStrides, wavesOffsets);
+	md3dImmediateContext->IASetIndexBuffer(mWavesIB, DXGI_FORMAT_R16_UINT, 0);
+
+	Effects::WavesFX->SetAsEffect(md3dImmediateContext);
 
 	// Set per object constants.
 	world = XMLoadFloat4x4(&mWavesWorld);
@@ -421,8 +489,8 @@ void HillsApp::DrawScene()
 
 	md3dImmediateContext->OMSetBlendState(RenderStates::TransparentBS, blendFactor, 0xffffffff);
 
-	Effects::TexturedFX->SetConstantBufferPerObjectVertexShader(md3dImmediateContext, world*viewProj, world, worldInvTranspose, XMLoadFloat4x4(&mWaterTexTransform));
-	Effects::TexturedFX->SetConstantBufferPerObjectPixelShader(md3dImmediateContext, mWavesMat, mWavesMapSRV, useTextures, useFog);
+	Effects::WavesFX->SetConstantBufferPerObjectVertexShader(md3dImmediateContext, world*viewProj, world, worldInvTranspose, XMLoadFloat4x4(&mWaterTexTransform));
+	Effects::WavesFX->SetConstantBufferPerObjectPixelShader(md3dImmediateContext, mWavesMat, mWavesMapSRV, useTextures, useFog);
 	md3dImmediateContext->DrawIndexed(3 * mWaves.TriangleCount(), 0, 0);
 
 	// Restore default blend state
@@ -504,34 +572,50 @@ XMFLOAT3 HillsApp::GetHillNormal(float x, float z) const
 
 void HillsApp::BuildLandGeometryBuffers()
 {
-	GeometryGenerator::MeshData grid;
- 
-	GeometryGenerator geoGen;
+	const UINT m = 50;
+	const UINT n = 50;
+	GeometryGenerator::MeshCounts counts = GeometryGenerator::GridCounts(m, n);
+	assert(GeometryGenerator::IndicesFit<USHORT>(counts.VertexCount));
 
-	geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
-
-	mLandIndexCount = grid.Indices.size();
+	mLandIndexCount = counts.IndexCount;
 
 	//
 	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  
+	// each vertex.  The grid comes in chunks of rows, converted on the thread pool as
+	// they are generated, so the whole GeometryGenerator mesh is never held.
 	//
 
-	std::vector<Vertex::Basic32> vertices(grid.Vertices.size());
-	for (size_t i = 0; i < grid.Vertices.size(); i++)
+	std::vector<Vertex::Basic32> vertices(counts.VertexCount);
+	std::vector<USHORT> indices(counts.IndexCount);
+
+	GeometryGenerator geoGen;
+	geoGen.SetThreadPool(&mThreadPool);
+	geoGen.CreateGridChunks(160.0f, 160.0f, m, n, 16, [&](const GeometryGenerator::GridChunk& chunk)
 	{
-		XMFLOAT3 p = grid.Vertices[i].Position;
+		for (UINT i = 0; i < chunk.OwnedVertexCount; i++)
+		{
+			XMFLOAT3 p = chunk.Vertices[i].Position;
 
-		p.y = GetHillHeight(p.x, p.z);
+			p.y = GetHillHeight(p.x, p.z);
 
-		vertices[i].Pos = p;
-		vertices[i].Normal = GetHillNormal(p.x, p.z);
-		vertices[i].Tex    = grid.Vertices[i].TexC;
-	}
+			Vertex::Basic32& v = vertices[chunk.FirstVertex + i];
+			v.Pos = p;
+			v.Normal = GetHillNormal(p.x, p.z);
+			v.Tex    = chunk.Vertices[i].TexC;
+		}
+
+		for (UINT i = 0; i < chunk.IndexCount; i++)
+			indices[chunk.FirstIndex + i] = static_cast<USHORT>(chunk.FirstVertex + chunk.Indices[i]);
+	});
+
+	// The grid rows are longer than the vertex cache holds, so reorder the triangles for
+	// it, and the vertices to match.
+	MeshOptimizer::Optimize(&vertices[0], counts.VertexCount, sizeof(Vertex::Basic32), offsetof(Vertex::Basic32, Pos),
+		&indices[0], counts.IndexCount);
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * grid.Vertices.size();
+	vbd.ByteWidth = sizeof(Vertex::Basic32) * counts.VertexCount;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -546,33 +630,52 @@ void HillsApp::BuildLandGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * mLandIndexCount;
+	ibd.ByteWidth = sizeof(USHORT) * mLandIndexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	ibd.StructureByteStride = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &grid.Indices[0];
+	iinitData.pSysMem = &indices[0];
 	HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mLandIB));
 }
 
 void HillsApp::BuildWaveGeometryBuffers()
 {
-	// Create the vertex buffer.  Note that we allocate space only, as
-	// we will be updating the data every time step of the simulation.
+	// Create the grid vertex buffer.  The grid positions and texture
+	// coordinates never change, so it is immutable.
+
+	std::vector<Vertex::WaveGrid> gridVertices(mWaves.VertexCount());
+	mWaves.EmitGridVertices(&gridVertices[0]);
 
 	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_DYNAMIC;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * mWaves.VertexCount();
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(Vertex::WaveGrid) * mWaves.VertexCount();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
-	HR(md3dDevice->CreateBuffer(&vbd, nullptr, &mWavesVB));
+	D3D11_SUBRESOURCE_DATA vinitData;
+	vinitData.pSysMem = &gridVertices[0];
+	HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mWavesGridVB));
+
+	// Create the height and normal vertex buffer.  The simulation only
+	// changes a few rows most of the time, so those rows are copied to it
+	// with UpdateSubresource rather than mapping and rewriting the whole buffer.
+
+	mWavesVertices.resize(mWaves.VertexCount());
+	mWaves.EmitCompactVertices(&mWavesVertices[0], 0, mWaves.RowCount());
+	mWavesVBRevision = mWaves.Revision();
+
+	vbd.Usage = D3D11_USAGE_DEFAULT;
+	vbd.ByteWidth = sizeof(Vertex::WaveCompact) * mWaves.VertexCount();
+	vinitData.pSysMem = &mWavesVertices[0];
+	HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mWavesVB));
 
 	// Create the index buffer.  The index buffer is fixed, so we only 
 	// need to create and set once.
 	
-	std::vector<UINT> indices(3 * mWaves.TriangleCount()); // 3 indices per face
+	assert(GeometryGenerator::IndicesFit<USHORT>(mWaves.VertexCount()));
+	std::vector<USHORT> indices(3 * mWaves.TriangleCount()); // 3 indices per face
 
 	// Iterate over each quad.
 	UINT m = mWaves.RowCount();
@@ -582,13 +685,13 @@ void HillsApp::BuildWaveGeometryBuffers()
 	{
 		for (DWORD j = 0; j < n - 1; j++)
 		{
-			indices[k] = i*n + j;
-			indices[k + 1] = i*n + j + 1;
-			indices[k + 2] = (i + 1)*n + j;
+			indices[k] = static_cast<USHORT>(i*n + j);
+			indices[k + 1] = static_cast<USHORT>(i*n + j + 1);
+			indices[k + 2] = static_cast<USHORT>((i + 1)*n + j);
 
-			indices[k + 3] = (i + 1)*n + j;
-			indices[k + 4] = i*n + j + 1;
-			indices[k + 5] = (i + 1)*n + j + 1;
+			indices[k + 3] = static_cast<USHORT>((i + 1)*n + j);
+			indices[k + 4] = static_cast<USHORT>(i*n + j + 1);
+			indices[k + 5] = static_cast<USHORT>((i + 1)*n + j + 1);
 
 			k += 6; // next quad
 		}
@@ -596,7 +699,7 @@ void HillsApp::BuildWaveGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * indices.size();
+	ibd.ByteWidth = sizeof(USHORT) * indices.size();
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -607,7 +710,7 @@ void HillsApp::BuildWaveGeometryBuffers()
 
 void HillsApp::BuildCrateGeometryBuffers()
 {
-	GeometryGenerator::MeshData box;
+	GeometryGenerator::MeshData16 box;
 
 	GeometryGenerator geoGen;
 	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
@@ -642,7 +745,7 @@ void HillsApp::BuildCrateGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * box.Indices.size();
+	ibd.ByteWidth = sizeof(USHORT) * box.Indices.size();
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
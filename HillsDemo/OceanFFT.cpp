@@ -0,0 +1,554 @@
+//***************************************************************************************
+// OceanFFT.cpp
+//
+// Spectral ocean surface; see OceanFFT.h.
+//***************************************************************************************
+
+#include "OceanFFT.h"
+
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+const float OceanFFT::RepeatPeriod = 200.0f;
+
+namespace
+{
+	const float Gravity = 9.81f;
+
+	// Phillips' constant, the fraction of the wind's energy the spectrum holds.
+	const float PhillipsConstant = 0.0081f;
+
+	// JONSWAP peak enhancement.
+	const float JonswapGamma = 3.3f;
+
+	// Rows per task when evaluating the spectrum and resolving the output.
+	const UINT RowsPerTask = 16;
+
+	// Signed frequency of FFT index m.
+	inline int SignedIndex(UINT m, UINT size)
+	{
+		return m < size / 2 ? static_cast<int>(m) : static_cast<int>(m) - static_cast<int>(size);
+	}
+}
+
+OceanFFT::OceanFFT()
+	: mSize(0),
+	  mNumRows(0),
+	  mNumCols(0),
+	  mVertexCount(0),
+	  mTriangleCount(0),
+	  mPatchSize(0.0f),
+	  mSpatialStep(0.0f),
+	  mHalfSize(0.0f),
+	  mWindSpeed(0.0f),
+	  mWindDirection(1.0f, 0.0f),
+	  mFetch(0.0f),
+	  mChoppiness(0.0f),
+	  mSpectrum(OceanSpectrumPhillips),
+	  mTime(0.0f),
+	  mRevision(0),
+	  mH0Re(nullptr),
+	  mH0Im(nullptr),
+	  mH0NegRe(nullptr),
+	  mH0NegIm(nullptr),
+	  mOmegaIndex(nullptr),
+	  mWaveX(nullptr),
+	  mWaveZ(nullptr),
+	  mFieldPitch(0),
+	  mTwiddleRe(nullptr),
+	  mTwiddleIm(nullptr),
+	  mHeights(nullptr),
+	  mDisplacementX(nullptr),
+	  mDisplacementZ(nullptr),
+	  mNormalX(nullptr),
+	  mNormalY(nullptr),
+	  mNormalZ(nullptr),
+	  mTangentXx(nullptr),
+	  mTangentXy(nullptr),
+	  mKernels(&SelectWaveKernels()),
+	  mThreadPool(nullptr)
+{
+	for (UINT f = 0; f < FieldCount; ++f)
+	{
+		mFieldRe[f] = nullptr;
+		mFieldIm[f] = nullptr;
+	}
+}
+
+OceanFFT::~OceanFFT()
+{
+	Release();
+}
+
+void OceanFFT::Release()
+{
+	delete[] mH0Re;
+	delete[] mH0Im;
+	delete[] mH0NegRe;
+	delete[] mH0NegIm;
+	delete[] mOmegaIndex;
+	delete[] mWaveX;
+	delete[] mWaveZ;
+	delete[] mTwiddleRe;
+	delete[] mTwiddleIm;
+	delete[] mHeights;
+	delete[] mDisplacementX;
+	delete[] mDisplacementZ;
+	delete[] mNormalX;
+	delete[] mNormalY;
+	delete[] mNormalZ;
+	delete[] mTangentXx;
+	delete[] mTangentXy;
+
+	mH0Re = nullptr;
+	mH0Im = nullptr;
+	mH0NegRe = nullptr;
+	mH0NegIm = nullptr;
+	mOmegaIndex = nullptr;
+	mWaveX = nullptr;
+	mWaveZ = nullptr;
+	mTwiddleRe = nullptr;
+	mTwiddleIm = nullptr;
+	mHeights = nullptr;
+	mDisplacementX = nullptr;
+	mDisplacementZ = nullptr;
+	mNormalX = nullptr;
+	mNormalY = nullptr;
+	mNormalZ = nullptr;
+	mTangentXx = nullptr;
+	mTangentXy = nullptr;
+
+	for (UINT f = 0; f < FieldCount; ++f)
+	{
+		delete[] mFieldRe[f];
+		delete[] mFieldIm[f];
+
+		mFieldRe[f] = nullptr;
+		mFieldIm[f] = nullptr;
+	}
+}
+
+UINT OceanFFT::RowCount()const
+{
+	return mNumRows;
+}
+
+UINT OceanFFT::ColumnCount()const
+{
+	return mNumCols;
+}
+
+UINT OceanFFT::VertexCount()const
+{
+	return mVertexCount;
+}
+
+UINT OceanFFT::TriangleCount()const
+{
+	return mTriangleCount;
+}
+
+float OceanFFT::Width()const
+{
+	return mPatchSize;
+}
+
+float OceanFFT::Depth()const
+{
+	return mPatchSize;
+}
+
+void OceanFFT::Init(const OceanDesc& desc)
+{
+	UINT n = desc.Size;
+	assert(n >= 16 && (n & (n - 1)) == 0);
+
+	mSize = n;
+	mFieldPitch = n + ColumnBlock;
+	mNumRows = n + 1;
+	mNumCols = n + 1;
+
+	mVertexCount = mNumRows * mNumCols;
+	mTriangleCount = n * n * 2;
+
+	mPatchSize = desc.PatchSize;
+	mSpatialStep = desc.PatchSize / n;
+	mHalfSize = 0.5f * desc.PatchSize;
+
+	mWindSpeed = desc.WindSpeed;
+	mFetch = desc.Fetch;
+	mChoppiness = desc.Choppiness;
+	mSpectrum = desc.Spectrum;
+
+	float windLength = sqrtf(desc.WindDirection.x * desc.WindDirection.x + desc.WindDirection.y * desc.WindDirection.y);
+	mWindDirection = XMFLOAT2(desc.WindDirection.x / windLength, desc.WindDirection.y / windLength);
+
+	mTime = 0.0f;
+
+	// In case Init() called again.
+	Release();
+
+	mH0Re = new float[n * n];
+	mH0Im = new float[n * n];
+	mH0NegRe = new float[n * n];
+	mH0NegIm = new float[n * n];
+	mOmegaIndex = new UINT[n * n];
+	mWaveX = new float[n * n];
+	mWaveZ = new float[n * n];
+	mTwiddleRe = new float[n];
+	mTwiddleIm = new float[n];
+	mHeights = new float[mVertexCount];
+	mDisplacementX = new float[mVertexCount];
+	mDisplacementZ = new float[mVertexCount];
+	mNormalX = new float[mVertexCount];
+	mNormalY = new float[mVertexCount];
+	mNormalZ = new float[mVertexCount];
+	mTangentXx = new float[mVertexCount];
+	mTangentXy = new float[mVertexCount];
+
+	for (UINT f = 0; f < FieldCount; ++f)
+	{
+		mFieldRe[f] = new float[n * mFieldPitch];
+		mFieldIm[f] = new float[n * mFieldPitch];
+	}
+
+	for (UINT k = 0; k < n; ++k)
+	{
+		double angle = -2.0 * XM_PI * k / n;
+		mTwiddleRe[k] = static_cast<float>(cos(angle));
+		mTwiddleIm[k] = static_cast<float>(sin(angle));
+	}
+
+	//
+	// Draw the initial amplitudes.  Row b of the spectrum is the z frequency and
+	// column a the x frequency.  Grid rows run towards -z, hence the sign of kz.
+	//
+
+	float dk = 2.0f * XM_PI / mPatchSize;
+	float omega0 = 2.0f * XM_PI / RepeatPeriod;
+
+	UINT maxOmegaIndex = 0;
+
+	std::mt19937 random(desc.Seed);
+	std::normal_distribution<float> gauss(0.0f, 1.0f);
+
+	for (UINT b = 0; b < n; ++b)
+	{
+		for (UINT a = 0; a < n; ++a)
+		{
+			UINT k = b * n + a;
+			float kx = SignedIndex(a, n) * dk;
+			float kz = -SignedIndex(b, n) * dk;
+
+			mWaveX[k] = kx;
+			mWaveZ[k] = kz;
+
+			// Deep water dispersion, rounded down to a multiple of omega0.  Update()
+			// looks the phase up by that multiple.
+			float omega = sqrtf(Gravity * sqrtf(kx * kx + kz * kz));
+			mOmegaIndex[k] = static_cast<UINT>(omega / omega0);
+			maxOmegaIndex = std::max(maxOmegaIndex, mOmegaIndex[k]);
+
+			// Both draws are made for every wave vector so the ocean only depends
+			// on the seed.  The Nyquist frequencies have no partner of opposite
+			// sign to cancel against and are left out.
+			float xiRe = gauss(random);
+			float xiIm = gauss(random);
+			float scale = 0.0f;
+			if (a != n / 2 && b != n / 2)
+				scale = desc.Amplitude * 0.5f * dk * sqrtf(EvaluateSpectrum(kx, kz));
+
+			mH0Re[k] = xiRe * scale;
+			mH0Im[k] = xiIm * scale;
+		}
+	}
+
+	for (UINT b = 0; b < n; ++b)
+	{
+		for (UINT a = 0; a < n; ++a)
+		{
+			UINT neg = ((n - b) & (n - 1)) * n + ((n - a) & (n - 1));
+			mH0NegRe[b * n + a] = mH0Re[neg];
+			mH0NegIm[b * n + a] = -mH0Im[neg];
+		}
+	}
+
+	mPhasorRe.resize(maxOmegaIndex + 1);
+	mPhasorIm.resize(maxOmegaIndex + 1);
+
+	Update(0.0f);
+}
+
+float OceanFFT::EvaluateSpectrum(float kx, float kz)const
+{
+	float kSq = kx * kx + kz * kz;
+	if (kSq == 0.0f)
+		return 0.0f;
+
+	float k = sqrtf(kSq);
+
+	// Directional spreading, cos^2 of the angle to the wind normalized over the full
+	// circle.  Waves running against the wind are damped.
+	float cosTheta = (kx * mWindDirection.x + kz * mWindDirection.y) / k;
+	float spreading = cosTheta * cosTheta / XM_PI;
+	if (cosTheta < 0.0f)
+		spreading *= 0.07f;
+
+	if (mSpectrum == OceanSpectrumJonswap)
+	{
+		float omega = sqrtf(Gravity * k);
+		float alpha = 0.076f * powf(mWindSpeed * mWindSpeed / (mFetch * Gravity), 0.22f);
+		float omegaPeak = 22.0f * powf(Gravity * Gravity / (mWindSpeed * mFetch), 1.0f / 3.0f);
+
+		float sigma = omega <= omegaPeak ? 0.07f : 0.09f;
+		float d = (omega - omegaPeak) / (sigma * omegaPeak);
+		float peak = powf(JonswapGamma, expf(-0.5f * d * d));
+
+		float ratio = omegaPeak / omega;
+		float s = alpha * Gravity * Gravity / powf(omega, 5.0f) * expf(-1.25f * ratio * ratio * ratio * ratio) * peak;
+
+		// From frequency to wave vector: d(omega)/dk = g / (2 omega), and the
+		// circle of radius k is k long.
+		return s * (Gravity / (2.0f * omega)) / k * spreading;
+	}
+
+	// Largest wave the wind supports, and a cutoff for waves much shorter than it.
+	float maxWave = mWindSpeed * mWindSpeed / Gravity;
+	float minWave = maxWave * 0.001f;
+
+	return 0.5f * PhillipsConstant * expf(-1.0f / (kSq * maxWave * maxWave)) / (kSq * kSq) *
+		expf(-kSq * minWave * minWave) * spreading;
+}
+
+void OceanFFT::Update(float dt)
+{
+	mTime = fmodf(mTime + dt, RepeatPeriod);
+	++mRevision;
+
+	// exp(-i q omega0 t) for every frequency index q; see Init().
+	double omega0 = 2.0 * XM_PI / RepeatPeriod;
+	for (size_t q = 0; q < mPhasorRe.size(); ++q)
+	{
+		mPhasorRe[q] = static_cast<float>(cos(q * omega0 * mTime));
+		mPhasorIm[q] = static_cast<float>(-sin(q * omega0 * mTime));
+	}
+
+	mFftScratch.resize(ThreadCount());
+	for (size_t i = 0; i < mFftScratch.size(); ++i)
+		mFftScratch[i].resize(6 * ScratchArraySize());
+
+	EvaluateFields();
+
+	// Transform along z, then along x.
+	InverseFftColumns();
+	InverseFftRows();
+
+	ThreadPool::Run(mThreadPool, (mNumRows + RowsPerTask - 1) / RowsPerTask, [this](UINT t, UINT)
+	{
+		UINT row1 = std::min((t + 1) * RowsPerTask, mNumRows);
+		for (UINT i = t * RowsPerTask; i < row1; ++i)
+			ResolveRow(i);
+	});
+}
+
+void OceanFFT::EvaluateFields()
+{
+	UINT n = mSize;
+
+	ThreadPool::Run(mThreadPool, n / RowsPerTask, [this, n](UINT t, UINT)
+	{
+		for (UINT k = t * RowsPerTask * n; k < (t + 1) * RowsPerTask * n; ++k)
+		{
+			UINT f = (k / n) * mFieldPitch + k % n;
+
+			// h = h0 exp(-i omega t) + conj(h0(-k)) exp(i omega t), so every wave
+			// runs along its wave vector.
+			float pr = mPhasorRe[mOmegaIndex[k]];
+			float pi = mPhasorIm[mOmegaIndex[k]];
+			float hr = (mH0Re[k] + mH0NegRe[k]) * pr - (mH0Im[k] - mH0NegIm[k]) * pi;
+			float hi = (mH0Im[k] + mH0NegIm[k]) * pr + (mH0Re[k] - mH0NegRe[k]) * pi;
+
+			float kx = mWaveX[k];
+			float kz = mWaveZ[k];
+			float kLen = sqrtf(kx * kx + kz * kz);
+			float invK = kLen > 0.0f ? 1.0f / kLen : 0.0f;
+
+			// Each field packs two real quantities as a + ib:
+			//   0: height h and x-slope i kx h
+			//   1: displacements i (kx/k) h and i (kz/k) h
+			//   2: z-slope i kz h and x-compression -(kx^2/k) h
+			mFieldRe[0][f] = hr - kx * hr;
+			mFieldIm[0][f] = hi - kx * hi;
+
+			float fr = -kz * invK;
+			float fi = kx * invK;
+			mFieldRe[1][f] = hr * fr - hi * fi;
+			mFieldIm[1][f] = hr * fi + hi * fr;
+
+			float g = kz - kx * kx * invK;
+			mFieldRe[2][f] = -hi * g;
+			mFieldIm[2][f] = hr * g;
+		}
+	});
+}
+
+void OceanFFT::InverseFftColumns()
+{
+	UINT n = mSize;
+	UINT blocks = n / ColumnBlock;
+
+	ThreadPool::Run(mThreadPool, FieldCount * blocks, [this, n, blocks](UINT t, UINT thread)
+	{
+		UINT f = t / blocks;
+		UINT col0 = (t % blocks) * ColumnBlock;
+
+		InverseFft(mFieldRe[f] + col0, mFieldIm[f] + col0, mFieldPitch, &mFftScratch[thread][0]);
+	});
+}
+
+void OceanFFT::InverseFftRows()
+{
+	UINT n = mSize;
+	UINT blocks = n / ColumnBlock;
+
+	ThreadPool::Run(mThreadPool, FieldCount * blocks, [this, n, blocks](UINT t, UINT thread)
+	{
+		UINT f = t / blocks;
+		UINT row0 = (t % blocks) * ColumnBlock;
+
+		// Turn the rows into the columns of a block, transform and turn them back.
+		// The block is small enough to stay in cache throughout.
+		float* scratch = &mFftScratch[thread][0];
+		float* blockRe = scratch + 4 * ScratchArraySize();
+		float* blockIm = scratch + 5 * ScratchArraySize();
+
+		for (UINT r = 0; r < ColumnBlock; ++r)
+		{
+			const float* re = mFieldRe[f] + (row0 + r) * mFieldPitch;
+			const float* im = mFieldIm[f] + (row0 + r) * mFieldPitch;
+			for (UINT c = 0; c < n; ++c)
+			{
+				blockRe[c * ScratchPitch + r] = re[c];
+				blockIm[c * ScratchPitch + r] = im[c];
+			}
+		}
+
+		InverseFft(blockRe, blockIm, ScratchPitch, scratch);
+
+		for (UINT r = 0; r < ColumnBlock; ++r)
+		{
+			float* re = mFieldRe[f] + (row0 + r) * mFieldPitch;
+			float* im = mFieldIm[f] + (row0 + r) * mFieldPitch;
+			for (UINT c = 0; c < n; ++c)
+			{
+				re[c] = blockRe[c * ScratchPitch + r];
+				im[c] = blockIm[c * ScratchPitch + r];
+			}
+		}
+	});
+}
+
+void OceanFFT::InverseFft(float* re, float* im, UINT pitch, float* scratch)
+{
+	UINT n = mSize;
+
+	// Ping-pong buffers of n rows of ColumnBlock columns.
+	UINT size = ScratchArraySize();
+	float* bufRe[2] = { scratch, scratch + 2 * size };
+	float* bufIm[2] = { scratch + size, scratch + 3 * size };
+
+	// The inverse transform is the forward one with real and imaginary parts swapped
+	// on the way in and out.  The first stage reads re/im and the last writes them
+	// back; there are always at least two.
+	WaveFftStage st;
+	st.SrcRe = im;
+	st.SrcIm = re;
+	st.SrcPitch = pitch;
+	st.Count = ColumnBlock;
+	st.TwiddleRe = mTwiddleRe;
+	st.TwiddleIm = mTwiddleIm;
+
+	UINT length = n;
+	UINT stride = 1;
+	for (UINT stage = 0; length > 1; ++stage)
+	{
+		UINT radix = (length % 4 == 0) ? 4 : 2;
+
+		if (length == radix)
+		{
+			st.DstRe = im;
+			st.DstIm = re;
+			st.DstPitch = pitch;
+		}
+		else
+		{
+			st.DstRe = bufRe[stage & 1];
+			st.DstIm = bufIm[stage & 1];
+			st.DstPitch = ScratchPitch;
+		}
+
+		st.Length = length;
+		st.Stride = stride;
+		st.TwiddleStep = n / length;
+
+		if (radix == 4)
+			mKernels->FftRadix4(st);
+		else
+			mKernels->FftRadix2(st);
+
+		st.SrcRe = st.DstRe;
+		st.SrcIm = st.DstIm;
+		st.SrcPitch = st.DstPitch;
+
+		length /= radix;
+		stride *= radix;
+	}
+}
+
+void OceanFFT::ResolveRow(UINT i)
+{
+	UINT n = mSize;
+	const float* src0Re = mFieldRe[0] + (i & (n - 1)) * mFieldPitch;
+	const float* src0Im = mFieldIm[0] + (i & (n - 1)) * mFieldPitch;
+	const float* src1Re = mFieldRe[1] + (i & (n - 1)) * mFieldPitch;
+	const float* src1Im = mFieldIm[1] + (i & (n - 1)) * mFieldPitch;
+	const float* src2Re = mFieldRe[2] + (i & (n - 1)) * mFieldPitch;
+	const float* src2Im = mFieldIm[2] + (i & (n - 1)) * mFieldPitch;
+
+	for (UINT j = 0; j < mNumCols; ++j)
+	{
+		// The last column repeats the first.
+		UINT s = j & (n - 1);
+		UINT k = i * mNumCols + j;
+
+		float slopeX = src0Im[s];
+		float slopeZ = src2Re[s];
+
+		mHeights[k] = src0Re[s];
+		mDisplacementX[k] = mChoppiness * src1Re[s];
+		mDisplacementZ[k] = mChoppiness * src1Im[s];
+
+		// n = normalize(-dh/dx, 1, -dh/dz)
+		float invLen = 1.0f / sqrtf(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+		mNormalX[k] = -slopeX * invLen;
+		mNormalY[k] = invLen;
+		mNormalZ[k] = -slopeZ * invLen;
+
+		// T = normalize(1 + choppiness * dDx/dx, dh/dx, 0)
+		float tx = 1.0f + mChoppiness * src2Im[s];
+		invLen = 1.0f / sqrtf(tx * tx + slopeX * slopeX);
+		mTangentXx[k] = tx * invLen;
+		mTangentXy[k] = slopeX * invLen;
+	}
+}
+
+UINT OceanFFT::ThreadCount()const
+{
+	return mThreadPool != nullptr ? mThreadPool->ThreadCount() : 1;
+}
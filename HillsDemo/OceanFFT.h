@@ -0,0 +1,241 @@
+//***************************************************************************************
+// OceanFFT.h
+//
+// Deep water ocean surface synthesized from a wave spectrum, after Tessendorf,
+// "Simulating Ocean Water".  Where Waves integrates the wave equation on a grid a step
+// at a time, OceanFFT draws random amplitudes for every wave vector once, advances
+// their phases analytically and transforms them back to a height field with an
+// inverse FFT, so the cost does not depend on how long a frame is and the patch can
+// be kilometers across.
+//
+// The patch is periodic: it tiles seamlessly when copies are placed Width() apart.
+// The grid has one more row and column than the FFT size, the last repeating the
+// first, so every tile is a closed mesh whose edges match those of its neighbors.
+//
+// Each Update() evaluates the spectrum at the new time into three complex fields, each
+// holding two real quantities, runs three 2D inverse FFTs and then resolves heights,
+// horizontal displacements, normals and tangents.  The 2D FFT transforms down the
+// columns of blocks of columns, with the SIMD lanes running across columns (see
+// WaveKernels.h), then turns blocks of rows into such blocks of columns in cache and
+// does the same again.  The blocks are spread over the thread pool.
+//
+// The accessors match those of Waves, so the two can be swapped for rendering.
+//***************************************************************************************
+
+#ifndef OCEANFFT_H
+#define OCEANFFT_H
+
+#include <Windows.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "WaveKernels.h"
+
+class ThreadPool;
+
+enum OceanSpectrum
+{
+	// Phillips spectrum of a fully developed sea.
+	OceanSpectrumPhillips = 0,
+
+	// JONSWAP spectrum of a sea still developing over a limited fetch; its peak is
+	// narrower and sharper than the Phillips one.
+	OceanSpectrumJonswap = 1
+};
+
+struct OceanDesc
+{
+	// FFT size, a power of two of at least 16, and the side of the patch in meters.
+	UINT Size;
+	float PatchSize;
+
+	// Wind at 10 m above the surface in m/s, and its direction in the xz-plane.
+	float WindSpeed;
+	DirectX::XMFLOAT2 WindDirection;
+
+	// Distance over which the wind has been blowing in meters; JONSWAP only.
+	float Fetch;
+
+	// Scales the wave heights; 1 gives the heights of the spectrum.
+	float Amplitude;
+
+	// How far points move towards the wave crests, sharpening them; 0 keeps the
+	// surface a pure height field.  Above about 1 the surface folds over itself.
+	float Choppiness;
+
+	OceanSpectrum Spectrum;
+
+	// Seed of the random amplitudes; the same seed gives the same ocean.
+	UINT Seed;
+};
+
+class OceanFFT
+{
+public:
+	OceanFFT();
+	~OceanFFT();
+
+	UINT RowCount()const;
+	UINT ColumnCount()const;
+	UINT VertexCount()const;
+	UINT TriangleCount()const;
+	float Width()const;
+	float Depth()const;
+
+	// Returns the displaced surface point at the ith grid point.
+	DirectX::XMFLOAT3 operator[](int i)const
+	{
+		return DirectX::XMFLOAT3(GridX(i % mNumCols) + mDisplacementX[i], mHeights[i],
+			GridZ(i / mNumCols) + mDisplacementZ[i]);
+	}
+
+	// Returns the surface normal at the ith grid point.
+	DirectX::XMFLOAT3 Normal(int i)const
+	{
+		return DirectX::XMFLOAT3(mNormalX[i], mNormalY[i], mNormalZ[i]);
+	}
+
+	// Returns the unit tangent vector at the ith grid point in the local x-axis
+	// direction.  Like that of Waves it has no z component.
+	DirectX::XMFLOAT3 TangentX(int i)const
+	{
+		return DirectX::XMFLOAT3(mTangentXx[i], mTangentXy[i], 0.0f);
+	}
+
+	// Returns the x-coordinate of grid column j and the z-coordinate of grid row i,
+	// before displacement.
+	float GridX(UINT j)const { return -mHalfSize + j * mSpatialStep; }
+	float GridZ(UINT i)const { return mHalfSize - i * mSpatialStep; }
+
+	// Direct read access to the height stream (RowCount() * ColumnCount() floats).
+	const float* Heights()const { return mHeights; }
+
+	// Seconds since Init(), wrapped to RepeatPeriod.
+	float Time()const { return mTime; }
+
+	// Incremented by every Update().
+	UINT Revision()const { return mRevision; }
+
+	void Init(const OceanDesc& desc);
+
+	// Advances the surface by dt seconds.
+	void Update(float dt);
+
+	// The wave frequencies are rounded to multiples of 2 pi / RepeatPeriod, so the
+	// surface repeats exactly after this many seconds and the phases stay accurate
+	// in single precision however long the ocean runs.
+	static const float RepeatPeriod;
+
+	// Overrides the kernels picked by SelectWaveKernels(), e.g. to compare against
+	// ScalarWaveKernels().
+	void SetKernels(const WaveKernels& kernels) { mKernels = &kernels; }
+	const WaveKernels& Kernels()const { return *mKernels; }
+
+	// Runs the update on the given pool, null runs it on the calling thread.  The
+	// pool must outlive its use here.  The result does not depend on the number of
+	// threads in the pool.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+private:
+	void Release();
+
+	// Variance density of the surface elevation at wave vector (kx, kz), per unit
+	// kx and kz.
+	float EvaluateSpectrum(float kx, float kz)const;
+
+	// Writes the spectra of the three fields at the current time.
+	void EvaluateFields();
+
+	// In-place inverse FFT of every field along z (down the columns) and along x
+	// (along the rows).
+	void InverseFftColumns();
+	void InverseFftRows();
+
+	// In-place inverse FFT down ColumnBlock columns of Size rows, pitch floats apart.
+	// scratch holds 4 * Size * ColumnBlock floats.
+	void InverseFft(float* re, float* im, UINT pitch, float* scratch);
+
+	// Heights, displacements, normals and tangents of grid row i.
+	void ResolveRow(UINT i);
+
+	UINT ThreadCount()const;
+
+	// Heights and slopes, displacements, and z-slope and x-compression.
+	static const UINT FieldCount = 3;
+
+	// Columns, or rows, per FFT block.
+	static const UINT ColumnBlock = 16;
+
+	// The scratch arrays hold Size rows of ScratchPitch floats, ColumnBlock of them
+	// used, and are a cache line longer than that.  Stockham stages access rows a
+	// power of two apart, which would otherwise all map to the same cache sets.
+	static const UINT ScratchPitch = ColumnBlock + 4;
+	UINT ScratchArraySize()const { return mSize * ScratchPitch + 16; }
+
+private:
+	UINT mSize;
+	UINT mNumRows;
+	UINT mNumCols;
+
+	UINT mVertexCount;
+	UINT mTriangleCount;
+
+	float mPatchSize;
+	float mSpatialStep;
+	float mHalfSize;
+
+	float mWindSpeed;
+	DirectX::XMFLOAT2 mWindDirection;
+	float mFetch;
+	float mChoppiness;
+	OceanSpectrum mSpectrum;
+
+	float mTime;
+	UINT mRevision;
+
+	// Per wave vector, indexed [z frequency][x frequency]: the initial amplitude
+	// h0(k), conj(h0(-k)), the angular frequency as a multiple of 2 pi / RepeatPeriod
+	// and the wave vector.
+	float* mH0Re;
+	float* mH0Im;
+	float* mH0NegRe;
+	float* mH0NegIm;
+	UINT* mOmegaIndex;
+	float* mWaveX;
+	float* mWaveZ;
+
+	// exp(-i q omega0 t) at the current time for every multiple q of omega0, so the
+	// spectrum needs no sine or cosine per wave vector.
+	std::vector<float> mPhasorRe;
+	std::vector<float> mPhasorIm;
+
+	// Size x Size complex fields in frequency space, then in space.  Rows are padded
+	// to mFieldPitch floats so that rows a power of two apart do not all map to the
+	// same cache sets.
+	UINT mFieldPitch;
+	float* mFieldRe[FieldCount];
+	float* mFieldIm[FieldCount];
+
+	// exp(-2 pi i k / Size) for k < Size.
+	float* mTwiddleRe;
+	float* mTwiddleIm;
+
+	// Output streams, RowCount() x ColumnCount().
+	float* mHeights;
+	float* mDisplacementX;
+	float* mDisplacementZ;
+	float* mNormalX;
+	float* mNormalY;
+	float* mNormalZ;
+	float* mTangentXx;
+	float* mTangentXy;
+
+	const WaveKernels* mKernels;
+	ThreadPool* mThreadPool;
+
+	// Per-thread ping-pong buffers for the FFT stages and a block of rows.
+	std::vector<std::vector<float>> mFftScratch;
+};
+
+#endif // OCEANFFT_H
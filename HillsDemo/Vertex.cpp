@@ -17,8 +17,18 @@ const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::Basic32[3] =
 	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 }
 };
 
+// Slot 0 holds Vertex::WaveGrid, slot 1 Vertex::WaveCompact.
+const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::WaveCompact[4] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "HEIGHT", 0, DXGI_FORMAT_R16_FLOAT, 1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R10G10B10A2_UNORM, 1, 4, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+};
+
 ID3D11InputLayout* InputLayouts::PosNormal = nullptr;
 ID3D11InputLayout* InputLayouts::Basic32 = nullptr;
+ID3D11InputLayout* InputLayouts::WaveCompact = nullptr;
 
 void InputLayouts::InitAll(ID3D11Device* device)
 {
@@ -30,10 +40,15 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	mVSBlob = Effects::TexturedFX->mVSBlob;
 	HR(device->CreateInputLayout(InputLayoutDesc::Basic32, 3, mVSBlob->GetBufferPointer(),
 		mVSBlob->GetBufferSize(), &Basic32));
+
+	mVSBlob = Effects::WavesFX->mVSBlob;
+	HR(device->CreateInputLayout(InputLayoutDesc::WaveCompact, 4, mVSBlob->GetBufferPointer(),
+		mVSBlob->GetBufferSize(), &WaveCompact));
 }
 
 void InputLayouts::DestroyAll()
 {
 	ReleaseCOM(PosNormal);
 	ReleaseCOM(Basic32);
+	ReleaseCOM(WaveCompact);
 }
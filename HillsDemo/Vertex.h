@@ -16,6 +16,21 @@ namespace Vertex
 		DirectX::XMFLOAT3 Normal;
 		DirectX::XMFLOAT2 Tex;
 	};
+
+	// Static part of a compact wave vertex: the grid position and texture coordinates.
+	struct WaveGrid
+	{
+		DirectX::XMFLOAT2 PosXZ;
+		DirectX::XMFLOAT2 Tex;
+	};
+
+	// Dynamic part of a compact wave vertex, written by Waves::EmitCompactVertices().
+	struct WaveCompact
+	{
+		DirectX::PackedVector::HALF Height;
+		DirectX::PackedVector::HALF Pad;
+		UINT Normal;	// R10G10B10A2_UNORM, components mapped from [-1,1]
+	};
 }
 
 class InputLayoutDesc
@@ -24,6 +39,7 @@ class InputLayoutDesc
 	// Init like const int A::a[4] = {0, 1, 2, 3}; in .cpp file.
 	static const D3D11_INPUT_ELEMENT_DESC PosNormal[2];
 	static const D3D11_INPUT_ELEMENT_DESC Basic32[3];
+	static const D3D11_INPUT_ELEMENT_DESC WaveCompact[4];
 };
 
 class InputLayouts
@@ -34,4 +50,5 @@ class InputLayouts
 
 	static ID3D11InputLayout* PosNormal;
 	static ID3D11InputLayout* Basic32;
+	static ID3D11InputLayout* WaveCompact;
 };
@@ -0,0 +1,1288 @@
+//***************************************************************************************
+// WaveKernels.cpp
+//
+// Scalar, SSE2 and NEON wave kernels and the run-time dispatch.  The AVX2 kernels live
+// in WaveKernelsAVX2.cpp, which is the only file compiled with /arch:AVX2.
+//***************************************************************************************
+
+#include "WaveKernels.h"
+
+#include <CpuFeatures.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+// Defined in WaveKernelsAVX2.cpp; null when AVX2 code was not compiled in.
+const WaveKernels* AVX2WaveKernels();
+
+namespace
+{
+	// Streams advanced by k points.
+	inline WaveNormalStreams OffsetStreams(const WaveNormalStreams& out, UINT k)
+	{
+		WaveNormalStreams r = { out.NormalX + k, out.NormalY + k, out.NormalZ + k,
+			out.TangentXx + k, out.TangentXy + k, out.Pitch };
+		return r;
+	}
+
+	//
+	// Scalar reference.
+	//
+
+	void StepHeightsScalar(float* prev, const float* curr, UINT pitch,
+		UINT row0, UINT row1, UINT col0, UINT col1,
+		float k1, float k2, float k3)
+	{
+		for (UINT i = row0; i < row1; ++i)
+		{
+			float* p = prev + i * pitch;
+			const float* c = curr + i * pitch;
+			const float* above = c - pitch;
+			const float* below = c + pitch;
+
+			for (UINT j = col0; j < col1; ++j)
+			{
+				p[j] = k1 * p[j] + k2 * c[j] + k3 * (below[j] + above[j] + c[j + 1] + c[j - 1]);
+			}
+		}
+	}
+
+	void ComputeNormalsScalar(const float* heights, UINT pitch,
+		UINT rowCount, UINT colCount,
+		float spatialStep, const WaveNormalStreams& out)
+	{
+		float twoDx = 2.0f * spatialStep;
+		float twoDxSq = twoDx * twoDx;
+
+		for (UINT i = 0; i < rowCount; ++i)
+		{
+			const float* h = heights + i * pitch;
+
+			for (UINT j = 0; j < colCount; ++j)
+			{
+				UINT k = i * out.Pitch + j;
+				const float* c = h + j;
+
+				float l = c[-1];
+				float r = c[1];
+				float t = *(c - pitch);
+				float b = *(c + pitch);
+
+				// n = normalize(l - r, 2dx, b - t)
+				float nx = l - r;
+				float nz = b - t;
+				float invLen = 1.0f / sqrtf(nx * nx + twoDxSq + nz * nz);
+				out.NormalX[k] = nx * invLen;
+				out.NormalY[k] = twoDx * invLen;
+				out.NormalZ[k] = nz * invLen;
+
+				// T = normalize(2dx, r - l, 0)
+				float ty = r - l;
+				invLen = 1.0f / sqrtf(twoDxSq + ty * ty);
+				out.TangentXx[k] = twoDx * invLen;
+				out.TangentXy[k] = ty * invLen;
+			}
+		}
+	}
+
+	void PackVerticesScalar(const WaveVertexRow& row, UINT count, UINT stride, float* out)
+	{
+		for (UINT j = 0; j < count; ++j)
+		{
+			float* v = out + j * stride;
+			v[0] = row.X[j];
+			v[1] = row.Heights[j];
+			v[2] = row.Z;
+			v[3] = row.NormalX[j];
+			v[4] = row.NormalY[j];
+			v[5] = row.NormalZ[j];
+
+			if (stride == 8)
+			{
+				v[6] = row.U[j];
+				v[7] = row.V;
+			}
+		}
+	}
+
+	// Row sources advanced by j points.
+	inline WaveVertexRow OffsetRow(const WaveVertexRow& row, UINT j)
+	{
+		WaveVertexRow r = { row.X + j, row.Heights + j, row.NormalX + j, row.NormalY + j,
+			row.NormalZ + j, row.U != nullptr ? row.U + j : nullptr, row.Z, row.V };
+		return r;
+	}
+
+	// float to half, rounding to nearest even.  Values too large for a half become
+	// infinity; denormal results are rounded by letting the FPU add a magic number.
+	inline UINT FloatToHalf(float value)
+	{
+		union { float f; UINT u; } f;
+		f.f = value;
+
+		const UINT f16Max = (127 + 16) << 23;
+		const UINT denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+		UINT sign = f.u & 0x80000000u;
+		f.u ^= sign;
+
+		UINT h;
+		if (f.u >= f16Max)
+		{
+			// Inf or NaN.
+			h = (f.u > (255u << 23)) ? 0x7e00 : 0x7c00;
+		}
+		else if (f.u < (113u << 23))
+		{
+			// Denormal or zero.
+			union { float f; UINT u; } magic;
+			magic.u = denormMagic;
+			f.f += magic.f;
+			h = f.u - denormMagic;
+		}
+		else
+		{
+			UINT mantOdd = (f.u >> 13) & 1;
+			f.u += (static_cast<UINT>(15 - 127) << 23) + 0xfff;
+			f.u += mantOdd;
+			h = f.u >> 13;
+		}
+
+		return h | (sign >> 16);
+	}
+
+	// [-1, 1] to 10-bit unorm.
+	inline UINT PackUnorm10(float v)
+	{
+		v = std::min(1.0f, std::max(0.0f, v * 0.5f + 0.5f));
+		return static_cast<UINT>(v * 1023.0f + 0.5f);
+	}
+
+	void PackCompactVerticesScalar(const float* heights, const float* normalX, const float* normalY,
+		const float* normalZ, UINT count, UINT* out)
+	{
+		for (UINT j = 0; j < count; ++j)
+		{
+			out[2 * j] = FloatToHalf(heights[j]);
+			out[2 * j + 1] = PackUnorm10(normalX[j]) | (PackUnorm10(normalY[j]) << 10) | (PackUnorm10(normalZ[j]) << 20);
+		}
+	}
+
+	// Stage advanced by j columns, for finishing the columns a SIMD stage left over.
+	inline WaveFftStage OffsetStage(const WaveFftStage& st, UINT j)
+	{
+		WaveFftStage r = st;
+		r.SrcRe += j;
+		r.SrcIm += j;
+		r.DstRe += j;
+		r.DstIm += j;
+		r.Count -= j;
+		return r;
+	}
+
+	void FftRadix2Scalar(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 2;
+		UINT s = st.Stride;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			float wr = st.TwiddleRe[p * st.TwiddleStep];
+			float wi = st.TwiddleIm[p * st.TwiddleStep];
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				// Inputs are m*s rows apart, outputs s rows apart.
+				const float* aRe = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* aIm = st.SrcIm + (q + s * p) * st.SrcPitch;
+				const float* bRe = aRe + m * s * st.SrcPitch;
+				const float* bIm = aIm + m * s * st.SrcPitch;
+				float* y0Re = st.DstRe + (q + s * 2 * p) * st.DstPitch;
+				float* y0Im = st.DstIm + (q + s * 2 * p) * st.DstPitch;
+				float* y1Re = y0Re + s * st.DstPitch;
+				float* y1Im = y0Im + s * st.DstPitch;
+
+				for (UINT j = 0; j < st.Count; ++j)
+				{
+					float dr = aRe[j] - bRe[j];
+					float di = aIm[j] - bIm[j];
+					y0Re[j] = aRe[j] + bRe[j];
+					y0Im[j] = aIm[j] + bIm[j];
+					y1Re[j] = dr * wr - di * wi;
+					y1Im[j] = dr * wi + di * wr;
+				}
+			}
+		}
+	}
+
+	void FftRadix4Scalar(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 4;
+		UINT s = st.Stride;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			float w1r = st.TwiddleRe[p * st.TwiddleStep];
+			float w1i = st.TwiddleIm[p * st.TwiddleStep];
+			float w2r = st.TwiddleRe[2 * p * st.TwiddleStep];
+			float w2i = st.TwiddleIm[2 * p * st.TwiddleStep];
+			float w3r = st.TwiddleRe[3 * p * st.TwiddleStep];
+			float w3i = st.TwiddleIm[3 * p * st.TwiddleStep];
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				// Inputs are m*s rows apart, outputs s rows apart.
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 4 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 4 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < st.Count; ++j)
+				{
+					float apcR = xr[j] + xr[j + 2 * in];
+					float apcI = xi[j] + xi[j + 2 * in];
+					float amcR = xr[j] - xr[j + 2 * in];
+					float amcI = xi[j] - xi[j + 2 * in];
+					float bpdR = xr[j + in] + xr[j + 3 * in];
+					float bpdI = xi[j + in] + xi[j + 3 * in];
+					float bmdR = xr[j + in] - xr[j + 3 * in];
+					float bmdI = xi[j + in] - xi[j + 3 * in];
+
+					// y1 = w1 (amc - i bmd), y2 = w2 (apc - bpd), y3 = w3 (amc + i bmd)
+					float t1r = amcR + bmdI;
+					float t1i = amcI - bmdR;
+					float t2r = apcR - bpdR;
+					float t2i = apcI - bpdI;
+					float t3r = amcR - bmdI;
+					float t3i = amcI + bmdR;
+
+					yr[j] = apcR + bpdR;
+					yi[j] = apcI + bpdI;
+					yr[j + out] = t1r * w1r - t1i * w1i;
+					yi[j + out] = t1r * w1i + t1i * w1r;
+					yr[j + 2 * out] = t2r * w2r - t2i * w2i;
+					yi[j + 2 * out] = t2r * w2i + t2i * w2r;
+					yr[j + 3 * out] = t3r * w3r - t3i * w3i;
+					yi[j + 3 * out] = t3r * w3i + t3i * w3r;
+				}
+			}
+		}
+	}
+
+	// Systems advanced by j columns.
+	inline WaveTridiagonal OffsetSystem(const WaveTridiagonal& sys, UINT j)
+	{
+		WaveTridiagonal r = sys;
+		r.Data += j;
+		r.Count -= j;
+		return r;
+	}
+
+	void SolveTridiagonalScalar(const WaveTridiagonal& sys)
+	{
+		// Forward elimination, then back substitution, a row of the block at a time.
+		float* row = sys.Data;
+		for (UINT j = 0; j < sys.Count; ++j)
+			row[j] = row[j] * sys.Scale[0];
+
+		for (UINT r = 1; r < sys.Length; ++r)
+		{
+			const float* above = row;
+			row += sys.Pitch;
+			for (UINT j = 0; j < sys.Count; ++j)
+				row[j] = (row[j] + sys.Beta * above[j]) * sys.Scale[r];
+		}
+
+		for (UINT r = sys.Length - 1; r-- > 0; )
+		{
+			const float* below = row;
+			row -= sys.Pitch;
+			for (UINT j = 0; j < sys.Count; ++j)
+				row[j] = row[j] + sys.Coupling[r] * below[j];
+		}
+	}
+
+	// Probes advanced by k positions.
+	inline WaveProbes OffsetProbes(const WaveProbes& probes, UINT k)
+	{
+		WaveProbes r = probes;
+		r.X += k;
+		r.Z += k;
+		r.Count -= k;
+		r.Heights += k;
+		if (r.NormalX != nullptr)
+		{
+			r.NormalX += k;
+			r.NormalY += k;
+			r.NormalZ += k;
+		}
+		return r;
+	}
+
+	// f at grid coordinates (row + fv, col + fu), given the index k of (row, col).
+	inline float BilerpScalar(const float* f, UINT k, UINT pitch, float fu, float fv)
+	{
+		float top = f[k] + (f[k + 1] - f[k]) * fu;
+		float bottom = f[k + pitch] + (f[k + pitch + 1] - f[k + pitch]) * fu;
+		return top + (bottom - top) * fv;
+	}
+
+	void SampleSurfaceScalar(const WaveSurface& s, const WaveProbes& probes)
+	{
+		float invStep = 1.0f / s.SpatialStep;
+		float maxU = static_cast<float>(s.ColumnCount - 1);
+		float maxV = static_cast<float>(s.RowCount - 1);
+		float lastCol = static_cast<float>(s.ColumnCount - 2);
+		float lastRow = static_cast<float>(s.RowCount - 2);
+
+		for (UINT k = 0; k < probes.Count; ++k)
+		{
+			// Grid coordinates, clamped to the grid.  The last cell takes the far edge
+			// with a fraction of 1.  The constant goes first so that a NaN coordinate
+			// clamps to the edge as it does in the SIMD paths.
+			float u = (probes.X[k] - s.X0) * invStep;
+			float v = (s.Z0 - probes.Z[k]) * invStep;
+			u = std::min(maxU, std::max(0.0f, u));
+			v = std::min(maxV, std::max(0.0f, v));
+
+			int col = static_cast<int>(std::min(u, lastCol));
+			int row = static_cast<int>(std::min(v, lastRow));
+			float fu = u - static_cast<float>(col);
+			float fv = v - static_cast<float>(row);
+
+			UINT i = row * s.ColumnCount + col;
+			probes.Heights[k] = BilerpScalar(s.Heights, i, s.ColumnCount, fu, fv);
+
+			if (probes.NormalX != nullptr)
+			{
+				float nx = BilerpScalar(s.NormalX, i, s.ColumnCount, fu, fv);
+				float ny = BilerpScalar(s.NormalY, i, s.ColumnCount, fu, fv);
+				float nz = BilerpScalar(s.NormalZ, i, s.ColumnCount, fu, fv);
+				float invLen = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+				probes.NormalX[k] = nx * invLen;
+				probes.NormalY[k] = ny * invLen;
+				probes.NormalZ[k] = nz * invLen;
+			}
+		}
+	}
+
+	const WaveKernels gScalarKernels =
+	{
+		StepHeightsScalar,
+		ComputeNormalsScalar,
+		PackVerticesScalar,
+		PackCompactVerticesScalar,
+		FftRadix2Scalar,
+		FftRadix4Scalar,
+		SolveTridiagonalScalar,
+		SampleSurfaceScalar,
+		"Scalar"
+	};
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+	//
+	// SSE2: two 4-wide vectors per iteration.
+	//
+
+	inline __m128 StepSSE(const float* p, const float* c, const float* above, const float* below,
+		__m128 k1, __m128 k2, __m128 k3)
+	{
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(below), _mm_loadu_ps(above));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(c + 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(c - 1));
+
+		__m128 r = _mm_mul_ps(k1, _mm_loadu_ps(p));
+		r = _mm_add_ps(r, _mm_mul_ps(k2, _mm_loadu_ps(c)));
+		return _mm_add_ps(r, _mm_mul_ps(k3, sum));
+	}
+
+	void StepHeightsSSE2(float* prev, const float* curr, UINT pitch,
+		UINT row0, UINT row1, UINT col0, UINT col1,
+		float k1, float k2, float k3)
+	{
+		__m128 vk1 = _mm_set1_ps(k1);
+		__m128 vk2 = _mm_set1_ps(k2);
+		__m128 vk3 = _mm_set1_ps(k3);
+
+		for (UINT i = row0; i < row1; ++i)
+		{
+			float* p = prev + i * pitch;
+			const float* c = curr + i * pitch;
+			const float* above = c - pitch;
+			const float* below = c + pitch;
+
+			UINT j = col0;
+			for (; j + 8 <= col1; j += 8)
+			{
+				__m128 r0 = StepSSE(p + j, c + j, above + j, below + j, vk1, vk2, vk3);
+				__m128 r1 = StepSSE(p + j + 4, c + j + 4, above + j + 4, below + j + 4, vk1, vk2, vk3);
+				_mm_storeu_ps(p + j, r0);
+				_mm_storeu_ps(p + j + 4, r1);
+			}
+
+			for (; j < col1; ++j)
+			{
+				p[j] = k1 * p[j] + k2 * c[j] + k3 * (below[j] + above[j] + c[j + 1] + c[j - 1]);
+			}
+		}
+	}
+
+	// 1/sqrt(x) estimate refined by one Newton-Raphson step.
+	inline __m128 RsqrtSSE(__m128 x)
+	{
+		__m128 y = _mm_rsqrt_ps(x);
+		__m128 yyx = _mm_mul_ps(_mm_mul_ps(y, y), x);
+		return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), yyx));
+	}
+
+	// Normals of the 4 points starting at h, written to index k of the streams.
+	inline void NormalsSSE(const float* h, UINT pitch, UINT k, __m128 twoDx, __m128 twoDxSq,
+		const WaveNormalStreams& out)
+	{
+		__m128 l = _mm_loadu_ps(h - 1);
+		__m128 r = _mm_loadu_ps(h + 1);
+		__m128 t = _mm_loadu_ps(h - pitch);
+		__m128 b = _mm_loadu_ps(h + pitch);
+
+		__m128 nx = _mm_sub_ps(l, r);
+		__m128 nz = _mm_sub_ps(b, t);
+		__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), twoDxSq), _mm_mul_ps(nz, nz));
+		__m128 invLen = RsqrtSSE(lenSq);
+		_mm_storeu_ps(out.NormalX + k, _mm_mul_ps(nx, invLen));
+		_mm_storeu_ps(out.NormalY + k, _mm_mul_ps(twoDx, invLen));
+		_mm_storeu_ps(out.NormalZ + k, _mm_mul_ps(nz, invLen));
+
+		__m128 ty = _mm_sub_ps(r, l);
+		invLen = RsqrtSSE(_mm_add_ps(twoDxSq, _mm_mul_ps(ty, ty)));
+		_mm_storeu_ps(out.TangentXx + k, _mm_mul_ps(twoDx, invLen));
+		_mm_storeu_ps(out.TangentXy + k, _mm_mul_ps(ty, invLen));
+	}
+
+	void ComputeNormalsSSE2(const float* heights, UINT pitch,
+		UINT rowCount, UINT colCount,
+		float spatialStep, const WaveNormalStreams& out)
+	{
+		float twoDx = 2.0f * spatialStep;
+		__m128 vTwoDx = _mm_set1_ps(twoDx);
+		__m128 vTwoDxSq = _mm_set1_ps(twoDx * twoDx);
+
+		for (UINT i = 0; i < rowCount; ++i)
+		{
+			const float* h = heights + i * pitch;
+			UINT k = i * out.Pitch;
+
+			UINT j = 0;
+			for (; j + 8 <= colCount; j += 8)
+			{
+				NormalsSSE(h + j, pitch, k + j, vTwoDx, vTwoDxSq, out);
+				NormalsSSE(h + j + 4, pitch, k + j + 4, vTwoDx, vTwoDxSq, out);
+			}
+
+			if (j < colCount)
+				ComputeNormalsScalar(h + j, pitch, 1, colCount - j, spatialStep, OffsetStreams(out, k + j));
+		}
+	}
+
+	// Transposes 4 points of the row into 4 vertices.  Each vertex is a position and
+	// normal.x quad followed by a normal.yz and texture coordinate quad.
+	void PackVerticesSSE2(const WaveVertexRow& row, UINT count, UINT stride, float* out)
+	{
+		bool tex = (stride == 8);
+		__m128 z = _mm_set1_ps(row.Z);
+		__m128 v = _mm_set1_ps(row.V);
+
+		UINT j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			__m128 a0 = _mm_loadu_ps(row.X + j);
+			__m128 a1 = _mm_loadu_ps(row.Heights + j);
+			__m128 a2 = z;
+			__m128 a3 = _mm_loadu_ps(row.NormalX + j);
+			_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+
+			__m128 b0 = _mm_loadu_ps(row.NormalY + j);
+			__m128 b1 = _mm_loadu_ps(row.NormalZ + j);
+			__m128 b2 = tex ? _mm_loadu_ps(row.U + j) : _mm_setzero_ps();
+			__m128 b3 = v;
+			_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+			float* o = out + j * stride;
+			if (tex)
+			{
+				_mm_storeu_ps(o, a0);
+				_mm_storeu_ps(o + 4, b0);
+				_mm_storeu_ps(o + 8, a1);
+				_mm_storeu_ps(o + 12, b1);
+				_mm_storeu_ps(o + 16, a2);
+				_mm_storeu_ps(o + 20, b2);
+				_mm_storeu_ps(o + 24, a3);
+				_mm_storeu_ps(o + 28, b3);
+			}
+			else
+			{
+				_mm_storeu_ps(o, a0);
+				_mm_storel_pi(reinterpret_cast<__m64*>(o + 4), b0);
+				_mm_storeu_ps(o + 6, a1);
+				_mm_storel_pi(reinterpret_cast<__m64*>(o + 10), b1);
+				_mm_storeu_ps(o + 12, a2);
+				_mm_storel_pi(reinterpret_cast<__m64*>(o + 16), b2);
+				_mm_storeu_ps(o + 18, a3);
+				_mm_storel_pi(reinterpret_cast<__m64*>(o + 22), b3);
+			}
+		}
+
+		if (j < count)
+			PackVerticesScalar(OffsetRow(row, j), count - j, stride, out + j * stride);
+	}
+
+	// FloatToHalf() for 4 values; the result is in the low 16 bits of each lane.
+	inline __m128i FloatToHalfSSE(__m128 f)
+	{
+		const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+		const __m128i minNormal = _mm_set1_epi32(113 << 23);
+		const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+		__m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.0f));
+		__m128 absF = _mm_xor_ps(f, sign);
+		__m128i absBits = _mm_castps_si128(absF);
+
+		// Inf or NaN.
+		__m128i isNaN = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+		__m128i special = _mm_or_si128(_mm_and_si128(isNaN, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+		// Denormal or zero.
+		__m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(denormMagic))), denormMagic);
+
+		// Normal, rounded to nearest even.
+		__m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+		__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), mantOdd), 13);
+
+		__m128i isDenorm = _mm_cmpgt_epi32(minNormal, absBits);
+		__m128i isRegular = _mm_cmpgt_epi32(f16Max, absBits);
+		__m128i h = _mm_or_si128(_mm_and_si128(isDenorm, denorm), _mm_andnot_si128(isDenorm, normal));
+		h = _mm_or_si128(_mm_and_si128(isRegular, h), _mm_andnot_si128(isRegular, special));
+
+		return _mm_or_si128(h, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	// PackUnorm10() for 4 values.
+	inline __m128i PackUnorm10SSE(__m128 v)
+	{
+		v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+		v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(1023.0f)), _mm_set1_ps(0.5f)));
+	}
+
+	void PackCompactVerticesSSE2(const float* heights, const float* normalX, const float* normalY,
+		const float* normalZ, UINT count, UINT* out)
+	{
+		UINT j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			__m128i h = FloatToHalfSSE(_mm_loadu_ps(heights + j));
+			__m128i n = PackUnorm10SSE(_mm_loadu_ps(normalX + j));
+			n = _mm_or_si128(n, _mm_slli_epi32(PackUnorm10SSE(_mm_loadu_ps(normalY + j)), 10));
+			n = _mm_or_si128(n, _mm_slli_epi32(PackUnorm10SSE(_mm_loadu_ps(normalZ + j)), 20));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * j), _mm_unpacklo_epi32(h, n));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * j + 4), _mm_unpackhi_epi32(h, n));
+		}
+
+		if (j < count)
+			PackCompactVerticesScalar(heights + j, normalX + j, normalY + j, normalZ + j, count - j, out + 2 * j);
+	}
+
+	// (tr + i ti) * (wr + i wi), stored to rows yr and yi.
+	inline void StoreComplexMulSSE(float* yr, float* yi, __m128 tr, __m128 ti, __m128 wr, __m128 wi)
+	{
+		_mm_storeu_ps(yr, _mm_sub_ps(_mm_mul_ps(tr, wr), _mm_mul_ps(ti, wi)));
+		_mm_storeu_ps(yi, _mm_add_ps(_mm_mul_ps(tr, wi), _mm_mul_ps(ti, wr)));
+	}
+
+	void FftRadix2SSE2(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 2;
+		UINT s = st.Stride;
+		UINT count = st.Count & ~3u;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			__m128 wr = _mm_set1_ps(st.TwiddleRe[p * st.TwiddleStep]);
+			__m128 wi = _mm_set1_ps(st.TwiddleIm[p * st.TwiddleStep]);
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 2 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 2 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < count; j += 4)
+				{
+					__m128 ar = _mm_loadu_ps(xr + j);
+					__m128 ai = _mm_loadu_ps(xi + j);
+					__m128 br = _mm_loadu_ps(xr + j + in);
+					__m128 bi = _mm_loadu_ps(xi + j + in);
+
+					_mm_storeu_ps(yr + j, _mm_add_ps(ar, br));
+					_mm_storeu_ps(yi + j, _mm_add_ps(ai, bi));
+					StoreComplexMulSSE(yr + j + out, yi + j + out, _mm_sub_ps(ar, br), _mm_sub_ps(ai, bi), wr, wi);
+				}
+			}
+		}
+
+		// Columns are independent, so the last few can be done afterwards.
+		if (count < st.Count)
+			FftRadix2Scalar(OffsetStage(st, count));
+	}
+
+	void FftRadix4SSE2(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 4;
+		UINT s = st.Stride;
+		UINT count = st.Count & ~3u;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			__m128 w1r = _mm_set1_ps(st.TwiddleRe[p * st.TwiddleStep]);
+			__m128 w1i = _mm_set1_ps(st.TwiddleIm[p * st.TwiddleStep]);
+			__m128 w2r = _mm_set1_ps(st.TwiddleRe[2 * p * st.TwiddleStep]);
+			__m128 w2i = _mm_set1_ps(st.TwiddleIm[2 * p * st.TwiddleStep]);
+			__m128 w3r = _mm_set1_ps(st.TwiddleRe[3 * p * st.TwiddleStep]);
+			__m128 w3i = _mm_set1_ps(st.TwiddleIm[3 * p * st.TwiddleStep]);
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 4 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 4 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < count; j += 4)
+				{
+					__m128 ar = _mm_loadu_ps(xr + j);
+					__m128 ai = _mm_loadu_ps(xi + j);
+					__m128 br = _mm_loadu_ps(xr + j + in);
+					__m128 bi = _mm_loadu_ps(xi + j + in);
+					__m128 cr = _mm_loadu_ps(xr + j + 2 * in);
+					__m128 ci = _mm_loadu_ps(xi + j + 2 * in);
+					__m128 dr = _mm_loadu_ps(xr + j + 3 * in);
+					__m128 di = _mm_loadu_ps(xi + j + 3 * in);
+
+					__m128 apcR = _mm_add_ps(ar, cr);
+					__m128 apcI = _mm_add_ps(ai, ci);
+					__m128 amcR = _mm_sub_ps(ar, cr);
+					__m128 amcI = _mm_sub_ps(ai, ci);
+					__m128 bpdR = _mm_add_ps(br, dr);
+					__m128 bpdI = _mm_add_ps(bi, di);
+					__m128 bmdR = _mm_sub_ps(br, dr);
+					__m128 bmdI = _mm_sub_ps(bi, di);
+
+					_mm_storeu_ps(yr + j, _mm_add_ps(apcR, bpdR));
+					_mm_storeu_ps(yi + j, _mm_add_ps(apcI, bpdI));
+					StoreComplexMulSSE(yr + j + out, yi + j + out, _mm_add_ps(amcR, bmdI), _mm_sub_ps(amcI, bmdR), w1r, w1i);
+					StoreComplexMulSSE(yr + j + 2 * out, yi + j + 2 * out, _mm_sub_ps(apcR, bpdR), _mm_sub_ps(apcI, bpdI), w2r, w2i);
+					StoreComplexMulSSE(yr + j + 3 * out, yi + j + 3 * out, _mm_sub_ps(amcR, bmdI), _mm_add_ps(amcI, bmdR), w3r, w3i);
+				}
+			}
+		}
+
+		if (count < st.Count)
+			FftRadix4Scalar(OffsetStage(st, count));
+	}
+
+	void SolveTridiagonalSSE2(const WaveTridiagonal& sys)
+	{
+		UINT count = sys.Count & ~3u;
+		__m128 beta = _mm_set1_ps(sys.Beta);
+
+		// Same order as the scalar version: a whole row of the block at a time.
+		float* row = sys.Data;
+		__m128 scale = _mm_set1_ps(sys.Scale[0]);
+		for (UINT j = 0; j < count; j += 4)
+			_mm_storeu_ps(row + j, _mm_mul_ps(_mm_loadu_ps(row + j), scale));
+
+		for (UINT r = 1; r < sys.Length; ++r)
+		{
+			const float* above = row;
+			row += sys.Pitch;
+			scale = _mm_set1_ps(sys.Scale[r]);
+			for (UINT j = 0; j < count; j += 4)
+			{
+				__m128 d = _mm_add_ps(_mm_loadu_ps(row + j), _mm_mul_ps(beta, _mm_loadu_ps(above + j)));
+				_mm_storeu_ps(row + j, _mm_mul_ps(d, scale));
+			}
+		}
+
+		for (UINT r = sys.Length - 1; r-- > 0; )
+		{
+			const float* below = row;
+			row -= sys.Pitch;
+			__m128 coupling = _mm_set1_ps(sys.Coupling[r]);
+			for (UINT j = 0; j < count; j += 4)
+			{
+				__m128 x = _mm_mul_ps(coupling, _mm_loadu_ps(below + j));
+				_mm_storeu_ps(row + j, _mm_add_ps(_mm_loadu_ps(row + j), x));
+			}
+		}
+
+		// Systems are independent, so the last few can be done afterwards.
+		if (count < sys.Count)
+			SolveTridiagonalScalar(OffsetSystem(sys, count));
+	}
+
+	// f at four points given the index of their top left grid point; SSE2 has no
+	// gather, so the corners are loaded one lane at a time.
+	inline __m128 BilerpSSE(const float* f, const UINT* k, UINT pitch, __m128 fu, __m128 fv)
+	{
+		__m128 a = _mm_setr_ps(f[k[0]], f[k[1]], f[k[2]], f[k[3]]);
+		__m128 b = _mm_setr_ps(f[k[0] + 1], f[k[1] + 1], f[k[2] + 1], f[k[3] + 1]);
+		__m128 c = _mm_setr_ps(f[k[0] + pitch], f[k[1] + pitch], f[k[2] + pitch], f[k[3] + pitch]);
+		__m128 d = _mm_setr_ps(f[k[0] + pitch + 1], f[k[1] + pitch + 1], f[k[2] + pitch + 1], f[k[3] + pitch + 1]);
+
+		__m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fu));
+		__m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), fu));
+		return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fv));
+	}
+
+	void SampleSurfaceSSE2(const WaveSurface& s, const WaveProbes& probes)
+	{
+		UINT count = probes.Count & ~3u;
+
+		__m128 invStep = _mm_set1_ps(1.0f / s.SpatialStep);
+		__m128 x0 = _mm_set1_ps(s.X0);
+		__m128 z0 = _mm_set1_ps(s.Z0);
+		__m128 zero = _mm_setzero_ps();
+		__m128 maxU = _mm_set1_ps(static_cast<float>(s.ColumnCount - 1));
+		__m128 maxV = _mm_set1_ps(static_cast<float>(s.RowCount - 1));
+		__m128 lastCol = _mm_set1_ps(static_cast<float>(s.ColumnCount - 2));
+		__m128 lastRow = _mm_set1_ps(static_cast<float>(s.RowCount - 2));
+
+		for (UINT k = 0; k < count; k += 4)
+		{
+			__m128 u = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(probes.X + k), x0), invStep);
+			__m128 v = _mm_mul_ps(_mm_sub_ps(z0, _mm_loadu_ps(probes.Z + k)), invStep);
+			// min and max return the second operand for NaN, so a NaN lane clamps to 0.
+			u = _mm_min_ps(_mm_max_ps(u, zero), maxU);
+			v = _mm_min_ps(_mm_max_ps(v, zero), maxV);
+
+			__m128i col = _mm_cvttps_epi32(_mm_min_ps(u, lastCol));
+			__m128i row = _mm_cvttps_epi32(_mm_min_ps(v, lastRow));
+			__m128 fu = _mm_sub_ps(u, _mm_cvtepi32_ps(col));
+			__m128 fv = _mm_sub_ps(v, _mm_cvtepi32_ps(row));
+
+			// SSE2 cannot multiply 32-bit integers either.
+			UINT cols[4];
+			UINT rows[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(cols), col);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(rows), row);
+
+			UINT i[4];
+			for (UINT l = 0; l < 4; ++l)
+				i[l] = rows[l] * s.ColumnCount + cols[l];
+
+			_mm_storeu_ps(probes.Heights + k, BilerpSSE(s.Heights, i, s.ColumnCount, fu, fv));
+
+			if (probes.NormalX != nullptr)
+			{
+				__m128 nx = BilerpSSE(s.NormalX, i, s.ColumnCount, fu, fv);
+				__m128 ny = BilerpSSE(s.NormalY, i, s.ColumnCount, fu, fv);
+				__m128 nz = BilerpSSE(s.NormalZ, i, s.ColumnCount, fu, fv);
+
+				__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+				__m128 invLen = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lenSq));
+				_mm_storeu_ps(probes.NormalX + k, _mm_mul_ps(nx, invLen));
+				_mm_storeu_ps(probes.NormalY + k, _mm_mul_ps(ny, invLen));
+				_mm_storeu_ps(probes.NormalZ + k, _mm_mul_ps(nz, invLen));
+			}
+		}
+
+		if (count < probes.Count)
+			SampleSurfaceScalar(s, OffsetProbes(probes, count));
+	}
+
+	const WaveKernels gSSE2Kernels =
+	{
+		StepHeightsSSE2,
+		ComputeNormalsSSE2,
+		PackVerticesSSE2,
+		PackCompactVerticesSSE2,
+		FftRadix2SSE2,
+		FftRadix4SSE2,
+		SolveTridiagonalSSE2,
+		SampleSurfaceSSE2,
+		"SSE2"
+	};
+
+#elif defined(_M_ARM) || defined(_M_ARM64)
+
+	//
+	// NEON: two 4-wide vectors per iteration.
+	//
+
+	inline float32x4_t StepNEON(const float* p, const float* c, const float* above, const float* below,
+		float32x4_t k1, float32x4_t k2, float32x4_t k3)
+	{
+		float32x4_t sum = vaddq_f32(vld1q_f32(below), vld1q_f32(above));
+		sum = vaddq_f32(sum, vld1q_f32(c + 1));
+		sum = vaddq_f32(sum, vld1q_f32(c - 1));
+
+		float32x4_t r = vmulq_f32(k1, vld1q_f32(p));
+		r = vaddq_f32(r, vmulq_f32(k2, vld1q_f32(c)));
+		return vaddq_f32(r, vmulq_f32(k3, sum));
+	}
+
+	void StepHeightsNEON(float* prev, const float* curr, UINT pitch,
+		UINT row0, UINT row1, UINT col0, UINT col1,
+		float k1, float k2, float k3)
+	{
+		float32x4_t vk1 = vdupq_n_f32(k1);
+		float32x4_t vk2 = vdupq_n_f32(k2);
+		float32x4_t vk3 = vdupq_n_f32(k3);
+
+		for (UINT i = row0; i < row1; ++i)
+		{
+			float* p = prev + i * pitch;
+			const float* c = curr + i * pitch;
+			const float* above = c - pitch;
+			const float* below = c + pitch;
+
+			UINT j = col0;
+			for (; j + 8 <= col1; j += 8)
+			{
+				float32x4_t r0 = StepNEON(p + j, c + j, above + j, below + j, vk1, vk2, vk3);
+				float32x4_t r1 = StepNEON(p + j + 4, c + j + 4, above + j + 4, below + j + 4, vk1, vk2, vk3);
+				vst1q_f32(p + j, r0);
+				vst1q_f32(p + j + 4, r1);
+			}
+
+			for (; j < col1; ++j)
+			{
+				p[j] = k1 * p[j] + k2 * c[j] + k3 * (below[j] + above[j] + c[j + 1] + c[j - 1]);
+			}
+		}
+	}
+
+	// The NEON estimate is only good to about 8 bits, so it takes two refinement steps.
+	inline float32x4_t RsqrtNEON(float32x4_t x)
+	{
+		float32x4_t y = vrsqrteq_f32(x);
+		y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+		return vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+	}
+
+	// Normals of the 4 points starting at h, written to index k of the streams.
+	inline void NormalsNEON(const float* h, UINT pitch, UINT k, float32x4_t twoDx, float32x4_t twoDxSq,
+		const WaveNormalStreams& out)
+	{
+		float32x4_t l = vld1q_f32(h - 1);
+		float32x4_t r = vld1q_f32(h + 1);
+		float32x4_t t = vld1q_f32(h - pitch);
+		float32x4_t b = vld1q_f32(h + pitch);
+
+		float32x4_t nx = vsubq_f32(l, r);
+		float32x4_t nz = vsubq_f32(b, t);
+		float32x4_t lenSq = vaddq_f32(vaddq_f32(vmulq_f32(nx, nx), twoDxSq), vmulq_f32(nz, nz));
+		float32x4_t invLen = RsqrtNEON(lenSq);
+		vst1q_f32(out.NormalX + k, vmulq_f32(nx, invLen));
+		vst1q_f32(out.NormalY + k, vmulq_f32(twoDx, invLen));
+		vst1q_f32(out.NormalZ + k, vmulq_f32(nz, invLen));
+
+		float32x4_t ty = vsubq_f32(r, l);
+		invLen = RsqrtNEON(vaddq_f32(twoDxSq, vmulq_f32(ty, ty)));
+		vst1q_f32(out.TangentXx + k, vmulq_f32(twoDx, invLen));
+		vst1q_f32(out.TangentXy + k, vmulq_f32(ty, invLen));
+	}
+
+	void ComputeNormalsNEON(const float* heights, UINT pitch,
+		UINT rowCount, UINT colCount,
+		float spatialStep, const WaveNormalStreams& out)
+	{
+		float twoDx = 2.0f * spatialStep;
+		float32x4_t vTwoDx = vdupq_n_f32(twoDx);
+		float32x4_t vTwoDxSq = vdupq_n_f32(twoDx * twoDx);
+
+		for (UINT i = 0; i < rowCount; ++i)
+		{
+			const float* h = heights + i * pitch;
+			UINT k = i * out.Pitch;
+
+			UINT j = 0;
+			for (; j + 8 <= colCount; j += 8)
+			{
+				NormalsNEON(h + j, pitch, k + j, vTwoDx, vTwoDxSq, out);
+				NormalsNEON(h + j + 4, pitch, k + j + 4, vTwoDx, vTwoDxSq, out);
+			}
+
+			if (j < colCount)
+				ComputeNormalsScalar(h + j, pitch, 1, colCount - j, spatialStep, OffsetStreams(out, k + j));
+		}
+	}
+
+	// 4x4 transpose: on return a, b, c, d hold what were the columns.
+	inline void TransposeNEON(float32x4_t& a, float32x4_t& b, float32x4_t& c, float32x4_t& d)
+	{
+		float32x4x2_t ac = vzipq_f32(a, c);
+		float32x4x2_t bd = vzipq_f32(b, d);
+		float32x4x2_t r01 = vzipq_f32(ac.val[0], bd.val[0]);
+		float32x4x2_t r23 = vzipq_f32(ac.val[1], bd.val[1]);
+		a = r01.val[0];
+		b = r01.val[1];
+		c = r23.val[0];
+		d = r23.val[1];
+	}
+
+	// Same layout as the SSE2 version.
+	void PackVerticesNEON(const WaveVertexRow& row, UINT count, UINT stride, float* out)
+	{
+		bool tex = (stride == 8);
+		float32x4_t z = vdupq_n_f32(row.Z);
+		float32x4_t v = vdupq_n_f32(row.V);
+
+		UINT j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			float32x4_t a[4] = { vld1q_f32(row.X + j), vld1q_f32(row.Heights + j), z, vld1q_f32(row.NormalX + j) };
+			TransposeNEON(a[0], a[1], a[2], a[3]);
+
+			float32x4_t b[4] = { vld1q_f32(row.NormalY + j), vld1q_f32(row.NormalZ + j),
+				tex ? vld1q_f32(row.U + j) : vdupq_n_f32(0.0f), v };
+			TransposeNEON(b[0], b[1], b[2], b[3]);
+
+			float* o = out + j * stride;
+			for (UINT k = 0; k < 4; ++k)
+			{
+				vst1q_f32(o + k * stride, a[k]);
+				if (tex)
+					vst1q_f32(o + k * stride + 4, b[k]);
+				else
+					vst1_f32(o + k * stride + 4, vget_low_f32(b[k]));
+			}
+		}
+
+		if (j < count)
+			PackVerticesScalar(OffsetRow(row, j), count - j, stride, out + j * stride);
+	}
+
+	// FloatToHalf() for 4 values, same steps as the SSE2 version.  vcvt_f16_f32 is
+	// not used because 32-bit ARM flushes denormal results to zero.
+	inline uint32x4_t FloatToHalfNEON(float32x4_t f)
+	{
+		const uint32x4_t f16Max = vdupq_n_u32((127 + 16) << 23);
+		const uint32x4_t minNormal = vdupq_n_u32(113 << 23);
+		const uint32x4_t denormMagic = vdupq_n_u32(((127 - 15) + (23 - 10) + 1) << 23);
+		const uint32x4_t normalBias = vdupq_n_u32(0xfff - ((127 - 15) << 23));
+
+		uint32x4_t bits = vreinterpretq_u32_f32(f);
+		uint32x4_t sign = vandq_u32(bits, vdupq_n_u32(0x80000000u));
+		uint32x4_t absBits = veorq_u32(bits, sign);
+		float32x4_t absF = vreinterpretq_f32_u32(absBits);
+
+		// Inf or NaN.
+		uint32x4_t isNaN = vmvnq_u32(vceqq_f32(absF, absF));
+		uint32x4_t special = vorrq_u32(vandq_u32(isNaN, vdupq_n_u32(0x200)), vdupq_n_u32(0x7c00));
+
+		// Denormal or zero.
+		uint32x4_t denorm = vsubq_u32(vreinterpretq_u32_f32(vaddq_f32(absF, vreinterpretq_f32_u32(denormMagic))), denormMagic);
+
+		// Normal, rounded to nearest even.
+		uint32x4_t mantOdd = vandq_u32(vshrq_n_u32(absBits, 13), vdupq_n_u32(1));
+		uint32x4_t normal = vshrq_n_u32(vaddq_u32(vaddq_u32(absBits, normalBias), mantOdd), 13);
+
+		uint32x4_t h = vbslq_u32(vcltq_u32(absBits, minNormal), denorm, normal);
+		h = vbslq_u32(vcltq_u32(absBits, f16Max), h, special);
+
+		return vorrq_u32(h, vshrq_n_u32(sign, 16));
+	}
+
+	// PackUnorm10() for 4 values.
+	inline uint32x4_t PackUnorm10NEON(float32x4_t v)
+	{
+		v = vaddq_f32(vmulq_f32(v, vdupq_n_f32(0.5f)), vdupq_n_f32(0.5f));
+		v = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+		return vcvtq_u32_f32(vaddq_f32(vmulq_f32(v, vdupq_n_f32(1023.0f)), vdupq_n_f32(0.5f)));
+	}
+
+	void PackCompactVerticesNEON(const float* heights, const float* normalX, const float* normalY,
+		const float* normalZ, UINT count, UINT* out)
+	{
+		UINT j = 0;
+		for (; j + 4 <= count; j += 4)
+		{
+			uint32x4x2_t v;
+			v.val[0] = FloatToHalfNEON(vld1q_f32(heights + j));
+			v.val[1] = PackUnorm10NEON(vld1q_f32(normalX + j));
+			v.val[1] = vorrq_u32(v.val[1], vshlq_n_u32(PackUnorm10NEON(vld1q_f32(normalY + j)), 10));
+			v.val[1] = vorrq_u32(v.val[1], vshlq_n_u32(PackUnorm10NEON(vld1q_f32(normalZ + j)), 20));
+
+			// Interleaves the two words of each vertex.
+			vst2q_u32(reinterpret_cast<uint32_t*>(out + 2 * j), v);
+		}
+
+		if (j < count)
+			PackCompactVerticesScalar(heights + j, normalX + j, normalY + j, normalZ + j, count - j, out + 2 * j);
+	}
+
+	// (tr + i ti) * (wr + i wi), stored to rows yr and yi.
+	inline void StoreComplexMulNEON(float* yr, float* yi, float32x4_t tr, float32x4_t ti, float32x4_t wr, float32x4_t wi)
+	{
+		vst1q_f32(yr, vsubq_f32(vmulq_f32(tr, wr), vmulq_f32(ti, wi)));
+		vst1q_f32(yi, vaddq_f32(vmulq_f32(tr, wi), vmulq_f32(ti, wr)));
+	}
+
+	void FftRadix2NEON(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 2;
+		UINT s = st.Stride;
+		UINT count = st.Count & ~3u;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			float32x4_t wr = vdupq_n_f32(st.TwiddleRe[p * st.TwiddleStep]);
+			float32x4_t wi = vdupq_n_f32(st.TwiddleIm[p * st.TwiddleStep]);
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 2 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 2 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < count; j += 4)
+				{
+					float32x4_t ar = vld1q_f32(xr + j);
+					float32x4_t ai = vld1q_f32(xi + j);
+					float32x4_t br = vld1q_f32(xr + j + in);
+					float32x4_t bi = vld1q_f32(xi + j + in);
+
+					vst1q_f32(yr + j, vaddq_f32(ar, br));
+					vst1q_f32(yi + j, vaddq_f32(ai, bi));
+					StoreComplexMulNEON(yr + j + out, yi + j + out, vsubq_f32(ar, br), vsubq_f32(ai, bi), wr, wi);
+				}
+			}
+		}
+
+		// Columns are independent, so the last few can be done afterwards.
+		if (count < st.Count)
+			FftRadix2Scalar(OffsetStage(st, count));
+	}
+
+	void FftRadix4NEON(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 4;
+		UINT s = st.Stride;
+		UINT count = st.Count & ~3u;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			float32x4_t w1r = vdupq_n_f32(st.TwiddleRe[p * st.TwiddleStep]);
+			float32x4_t w1i = vdupq_n_f32(st.TwiddleIm[p * st.TwiddleStep]);
+			float32x4_t w2r = vdupq_n_f32(st.TwiddleRe[2 * p * st.TwiddleStep]);
+			float32x4_t w2i = vdupq_n_f32(st.TwiddleIm[2 * p * st.TwiddleStep]);
+			float32x4_t w3r = vdupq_n_f32(st.TwiddleRe[3 * p * st.TwiddleStep]);
+			float32x4_t w3i = vdupq_n_f32(st.TwiddleIm[3 * p * st.TwiddleStep]);
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 4 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 4 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < count; j += 4)
+				{
+					float32x4_t ar = vld1q_f32(xr + j);
+					float32x4_t ai = vld1q_f32(xi + j);
+					float32x4_t br = vld1q_f32(xr + j + in);
+					float32x4_t bi = vld1q_f32(xi + j + in);
+					float32x4_t cr = vld1q_f32(xr + j + 2 * in);
+					float32x4_t ci = vld1q_f32(xi + j + 2 * in);
+					float32x4_t dr = vld1q_f32(xr + j + 3 * in);
+					float32x4_t di = vld1q_f32(xi + j + 3 * in);
+
+					float32x4_t apcR = vaddq_f32(ar, cr);
+					float32x4_t apcI = vaddq_f32(ai, ci);
+					float32x4_t amcR = vsubq_f32(ar, cr);
+					float32x4_t amcI = vsubq_f32(ai, ci);
+					float32x4_t bpdR = vaddq_f32(br, dr);
+					float32x4_t bpdI = vaddq_f32(bi, di);
+					float32x4_t bmdR = vsubq_f32(br, dr);
+					float32x4_t bmdI = vsubq_f32(bi, di);
+
+					vst1q_f32(yr + j, vaddq_f32(apcR, bpdR));
+					vst1q_f32(yi + j, vaddq_f32(apcI, bpdI));
+					StoreComplexMulNEON(yr + j + out, yi + j + out, vaddq_f32(amcR, bmdI), vsubq_f32(amcI, bmdR), w1r, w1i);
+					StoreComplexMulNEON(yr + j + 2 * out, yi + j + 2 * out, vsubq_f32(apcR, bpdR), vsubq_f32(apcI, bpdI), w2r, w2i);
+					StoreComplexMulNEON(yr + j + 3 * out, yi + j + 3 * out, vsubq_f32(amcR, bmdI), vaddq_f32(amcI, bmdR), w3r, w3i);
+				}
+			}
+		}
+
+		if (count < st.Count)
+			FftRadix4Scalar(OffsetStage(st, count));
+	}
+
+	void SolveTridiagonalNEON(const WaveTridiagonal& sys)
+	{
+		UINT count = sys.Count & ~3u;
+		float32x4_t beta = vdupq_n_f32(sys.Beta);
+
+		// Same order as the scalar version: a whole row of the block at a time.
+		float* row = sys.Data;
+		float32x4_t scale = vdupq_n_f32(sys.Scale[0]);
+		for (UINT j = 0; j < count; j += 4)
+			vst1q_f32(row + j, vmulq_f32(vld1q_f32(row + j), scale));
+
+		for (UINT r = 1; r < sys.Length; ++r)
+		{
+			const float* above = row;
+			row += sys.Pitch;
+			scale = vdupq_n_f32(sys.Scale[r]);
+			for (UINT j = 0; j < count; j += 4)
+			{
+				float32x4_t d = vaddq_f32(vld1q_f32(row + j), vmulq_f32(beta, vld1q_f32(above + j)));
+				vst1q_f32(row + j, vmulq_f32(d, scale));
+			}
+		}
+
+		for (UINT r = sys.Length - 1; r-- > 0; )
+		{
+			const float* below = row;
+			row -= sys.Pitch;
+			float32x4_t coupling = vdupq_n_f32(sys.Coupling[r]);
+			for (UINT j = 0; j < count; j += 4)
+			{
+				float32x4_t x = vmulq_f32(coupling, vld1q_f32(below + j));
+				vst1q_f32(row + j, vaddq_f32(vld1q_f32(row + j), x));
+			}
+		}
+
+		if (count < sys.Count)
+			SolveTridiagonalScalar(OffsetSystem(sys, count));
+	}
+
+	inline float32x4_t BilerpNEON(const float* f, const UINT* k, UINT pitch, float32x4_t fu, float32x4_t fv)
+	{
+		float a[4], b[4], c[4], d[4];
+		for (UINT l = 0; l < 4; ++l)
+		{
+			a[l] = f[k[l]];
+			b[l] = f[k[l] + 1];
+			c[l] = f[k[l] + pitch];
+			d[l] = f[k[l] + pitch + 1];
+		}
+
+		float32x4_t va = vld1q_f32(a);
+		float32x4_t vc = vld1q_f32(c);
+		float32x4_t top = vaddq_f32(va, vmulq_f32(vsubq_f32(vld1q_f32(b), va), fu));
+		float32x4_t bottom = vaddq_f32(vc, vmulq_f32(vsubq_f32(vld1q_f32(d), vc), fu));
+		return vaddq_f32(top, vmulq_f32(vsubq_f32(bottom, top), fv));
+	}
+
+	void SampleSurfaceNEON(const WaveSurface& s, const WaveProbes& probes)
+	{
+		UINT count = probes.Count & ~3u;
+
+		float32x4_t invStep = vdupq_n_f32(1.0f / s.SpatialStep);
+		float32x4_t x0 = vdupq_n_f32(s.X0);
+		float32x4_t z0 = vdupq_n_f32(s.Z0);
+		float32x4_t zero = vdupq_n_f32(0.0f);
+		float32x4_t maxU = vdupq_n_f32(static_cast<float>(s.ColumnCount - 1));
+		float32x4_t maxV = vdupq_n_f32(static_cast<float>(s.RowCount - 1));
+		float32x4_t lastCol = vdupq_n_f32(static_cast<float>(s.ColumnCount - 2));
+		float32x4_t lastRow = vdupq_n_f32(static_cast<float>(s.RowCount - 2));
+
+		for (UINT k = 0; k < count; k += 4)
+		{
+			float32x4_t u = vmulq_f32(vsubq_f32(vld1q_f32(probes.X + k), x0), invStep);
+			float32x4_t v = vmulq_f32(vsubq_f32(z0, vld1q_f32(probes.Z + k)), invStep);
+			u = vminq_f32(vmaxq_f32(u, zero), maxU);
+			v = vminq_f32(vmaxq_f32(v, zero), maxV);
+
+			uint32x4_t col = vcvtq_u32_f32(vminq_f32(u, lastCol));
+			uint32x4_t row = vcvtq_u32_f32(vminq_f32(v, lastRow));
+			float32x4_t fu = vsubq_f32(u, vcvtq_f32_u32(col));
+			float32x4_t fv = vsubq_f32(v, vcvtq_f32_u32(row));
+
+			UINT i[4];
+			vst1q_u32(i, vmlaq_n_u32(col, row, s.ColumnCount));
+
+			vst1q_f32(probes.Heights + k, BilerpNEON(s.Heights, i, s.ColumnCount, fu, fv));
+
+			if (probes.NormalX != nullptr)
+			{
+				float nx[4], ny[4], nz[4];
+				vst1q_f32(nx, BilerpNEON(s.NormalX, i, s.ColumnCount, fu, fv));
+				vst1q_f32(ny, BilerpNEON(s.NormalY, i, s.ColumnCount, fu, fv));
+				vst1q_f32(nz, BilerpNEON(s.NormalZ, i, s.ColumnCount, fu, fv));
+
+				// ARMv7 NEON has no divide or square root, and an estimate would not
+				// match the other versions.
+				for (UINT l = 0; l < 4; ++l)
+				{
+					float invLen = 1.0f / sqrtf(nx[l] * nx[l] + ny[l] * ny[l] + nz[l] * nz[l]);
+					probes.NormalX[k + l] = nx[l] * invLen;
+					probes.NormalY[k + l] = ny[l] * invLen;
+					probes.NormalZ[k + l] = nz[l] * invLen;
+				}
+			}
+		}
+
+		if (count < probes.Count)
+			SampleSurfaceScalar(s, OffsetProbes(probes, count));
+	}
+
+	const WaveKernels gNEONKernels =
+	{
+		StepHeightsNEON,
+		ComputeNormalsNEON,
+		PackVerticesNEON,
+		PackCompactVerticesNEON,
+		FftRadix2NEON,
+		FftRadix4NEON,
+		SolveTridiagonalNEON,
+		SampleSurfaceNEON,
+		"NEON"
+	};
+
+#endif
+}
+
+const WaveKernels& ScalarWaveKernels()
+{
+	return gScalarKernels;
+}
+
+const WaveKernels& SelectWaveKernels()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	const WaveKernels* avx2 = AVX2WaveKernels();
+	if (avx2 != nullptr && CpuFeatures::HasAVX2() && CpuFeatures::HasF16C())
+		return *avx2;
+
+	if (CpuFeatures::HasSSE2())
+		return gSSE2Kernels;
+#elif defined(_M_ARM) || defined(_M_ARM64)
+	if (CpuFeatures::HasNEON())
+		return gNEONKernels;
+#endif
+
+	return gScalarKernels;
+}
@@ -0,0 +1,189 @@
+//***************************************************************************************
+// WaveKernels.h
+//
+// Inner loops of the wave simulation.  Each kernel works on a rectangle of a height
+// field with 'pitch' floats per row, so the same kernels serve the whole grid, row
+// bands, tiles and scratch copies of tiles.  The caller keeps the rectangle inside the
+// interior of the grid; the kernels read one point beyond it.
+//
+// The FFT stages serve OceanFFT.  They transform down the columns of a block, so each
+// butterfly combines whole rows and the SIMD lanes run across neighboring columns.
+// The tridiagonal solver of the implicit integrator works the same way.
+//
+// There is a scalar reference implementation plus SSE2, AVX2 and NEON versions that
+// process 8 (SSE2/NEON) or 16 (AVX2) grid points per iteration.  SelectWaveKernels()
+// picks the widest one the CPU supports; the AVX2 version also needs F16C.
+//
+// Accuracy of the SIMD versions relative to the scalar reference:
+//   StepHeights    - bit-identical.  The SIMD code does the same multiplies and adds in
+//                    the same order and never contracts them into FMAs, so the
+//                    simulation does not drift apart between instruction sets.
+//                    Columns left over from the vectors go to the scalar kernel,
+//                    not to a scalar loop in the AVX2 file, which /arch:AVX2 would
+//                    be free to build with FMAs.
+//   ComputeNormals - within 1e-6 per component.  The reciprocal square root is an
+//                    estimate refined by one Newton-Raphson step rather than a divide.
+//   PackVertices   - bit-identical; it only moves data.
+//   PackCompactVertices
+//                  - bit-identical for finite heights.  Halves are rounded to nearest
+//                    even like F16C does, denormals included, and normals are
+//                    quantized with the same multiply, add and truncation everywhere.
+//   FftRadix2/4    - bit-identical; same operations in the same order, no FMAs.
+//   SolveTridiagonal
+//                  - bit-identical, for the same reason.
+//   SampleSurface  - bit-identical.  Square roots and divides are exact in every
+//                    instruction set, and gathers only move data.
+//***************************************************************************************
+
+#ifndef WAVEKERNELS_H
+#define WAVEKERNELS_H
+
+#include <Windows.h>
+
+// Destination streams written by ComputeNormals.  The pointers address the first
+// point of the output rectangle and rows are Pitch floats apart.
+struct WaveNormalStreams
+{
+	float* NormalX;
+	float* NormalY;
+	float* NormalZ;
+	float* TangentXx;
+	float* TangentXy;
+	UINT Pitch;
+};
+
+// Sources of one grid row for PackVertices.  Positions are (X[j], Heights[j], Z) and
+// texture coordinates (U[j], V); the X and U tables are shared by all rows.
+struct WaveVertexRow
+{
+	const float* X;
+	const float* Heights;
+	const float* NormalX;
+	const float* NormalY;
+	const float* NormalZ;
+	const float* U;
+	float Z;
+	float V;
+};
+
+// One stage of a Stockham FFT run down the columns of a block of Count columns.  Row r
+// of the source starts at SrcRe/SrcIm + r * SrcPitch, likewise for the destination,
+// and holds Count independent complex values.  The stage takes Stride interleaved
+// sub-transforms of Length rows and writes Length / radix times as many for the next
+// stage, in order, so no bit reversal is needed.  The twiddle tables hold
+// exp(-2 pi i k / N) for k < N, N the full transform length, and the stage reads every
+// TwiddleStep = N / Length th entry.  Source and destination must not overlap.
+struct WaveFftStage
+{
+	const float* SrcRe;
+	const float* SrcIm;
+	UINT SrcPitch;
+	float* DstRe;
+	float* DstIm;
+	UINT DstPitch;
+	UINT Count;
+	UINT Length;
+	UINT Stride;
+	const float* TwiddleRe;
+	const float* TwiddleIm;
+	UINT TwiddleStep;
+};
+
+// Count independent tridiagonal systems
+//   -Beta x[r-1] + (1 + 2 Beta) x[r] - Beta x[r+1] = d[r],  0 <= r < Length, Length > 0,
+// with x[-1] = x[Length] = 0, solved in place down the columns of a block: row r
+// starts at Data + r * Pitch and holds element r of each system.  Scale and Coupling
+// hold the Thomas factors
+//   Scale[r] = 1 / (1 + 2 Beta - Beta * Coupling[r-1]),  Coupling[r] = Beta * Scale[r],
+// which only depend on Beta, so one table serves every system of that length or less.
+struct WaveTridiagonal
+{
+	float* Data;
+	UINT Pitch;
+	UINT Count;
+	UINT Length;
+	float Beta;
+	const float* Scale;
+	const float* Coupling;
+};
+
+// Read-only view of a solution for SampleSurface.  The streams hold RowCount x
+// ColumnCount points, both at least 2, and grid point (i, j) lies at
+// x = X0 + j * SpatialStep, z = Z0 - i * SpatialStep.  The normal streams may be null
+// when only heights are sampled.
+struct WaveSurface
+{
+	const float* Heights;
+	const float* NormalX;
+	const float* NormalY;
+	const float* NormalZ;
+	UINT RowCount;
+	UINT ColumnCount;
+	float X0;
+	float Z0;
+	float SpatialStep;
+};
+
+// Count positions (X[k], Z[k]) to sample and the streams the results go to.  Leave
+// the normal streams null to sample heights only.
+struct WaveProbes
+{
+	const float* X;
+	const float* Z;
+	UINT Count;
+	float* Heights;
+	float* NormalX;
+	float* NormalY;
+	float* NormalZ;
+};
+
+struct WaveKernels
+{
+	// Advances rows [row0, row1) and columns [col0, col1) one time step.  prev is
+	// overwritten with the new solution:
+	//   prev = k1*prev + k2*curr + k3*(below + above + right + left)
+	void (*StepHeights)(float* prev, const float* curr, UINT pitch,
+		UINT row0, UINT row1, UINT col0, UINT col1,
+		float k1, float k2, float k3);
+
+	// Finite difference normals and x-tangents of a rowCount x colCount rectangle.
+	// heights addresses the first point of the rectangle; the height field and the
+	// output streams may have different pitches.
+	void (*ComputeNormals)(const float* heights, UINT pitch,
+		UINT rowCount, UINT colCount,
+		float spatialStep, const WaveNormalStreams& out);
+
+	// Interleaves count points of a row into vertices of 'stride' floats: position,
+	// normal and, for a stride of 8, texture coordinates.  A stride of 6 leaves out the
+	// texture coordinates and does not read U.
+	void (*PackVertices)(const WaveVertexRow& row, UINT count, UINT stride, float* out);
+
+	// Packs count points into compact vertices of two 32-bit words: the height as a
+	// half float in the low 16 bits of the first word and the normal as
+	// R10G10B10A2_UNORM, each component mapped from [-1, 1], in the second.
+	void (*PackCompactVertices)(const float* heights, const float* normalX, const float* normalY,
+		const float* normalZ, UINT count, UINT* out);
+
+	// Radix-2 and radix-4 forward FFT stages.  The inverse transform is the forward one
+	// with the real and imaginary arrays swapped on the way in and out.
+	void (*FftRadix2)(const WaveFftStage& stage);
+	void (*FftRadix4)(const WaveFftStage& stage);
+
+	// Solves the tridiagonal systems of a block; see WaveTridiagonal.
+	void (*SolveTridiagonal)(const WaveTridiagonal& system);
+
+	// Bilinearly interpolated heights and unit normals at arbitrary positions.
+	// Positions off the grid are clamped to its edge.
+	void (*SampleSurface)(const WaveSurface& surface, const WaveProbes& probes);
+
+	// Name of the instruction set, for diagnostics.
+	const char* Name;
+};
+
+// Always available; the reference the SIMD versions are checked against.
+const WaveKernels& ScalarWaveKernels();
+
+// The widest implementation supported by the CPU we are running on.
+const WaveKernels& SelectWaveKernels();
+
+#endif // WAVEKERNELS_H
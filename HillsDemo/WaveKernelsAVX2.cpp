@@ -0,0 +1,491 @@
+//***************************************************************************************
+// WaveKernelsAVX2.cpp
+//
+// AVX2 wave kernels: two 8-wide vectors, 16 grid points per iteration.  This file is
+// compiled with /arch:AVX2 and is only entered after CpuFeatures::HasAVX2() and
+// HasF16C() succeed.
+//***************************************************************************************
+
+#include "WaveKernels.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+#include <immintrin.h>
+
+namespace
+{
+	inline __m256 StepAVX(const float* p, const float* c, const float* above, const float* below,
+		__m256 k1, __m256 k2, __m256 k3)
+	{
+		// No FMA here; see the accuracy notes in WaveKernels.h.
+		__m256 sum = _mm256_add_ps(_mm256_loadu_ps(below), _mm256_loadu_ps(above));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(c + 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(c - 1));
+
+		__m256 r = _mm256_mul_ps(k1, _mm256_loadu_ps(p));
+		r = _mm256_add_ps(r, _mm256_mul_ps(k2, _mm256_loadu_ps(c)));
+		return _mm256_add_ps(r, _mm256_mul_ps(k3, sum));
+	}
+
+	void StepHeightsAVX2(float* prev, const float* curr, UINT pitch,
+		UINT row0, UINT row1, UINT col0, UINT col1,
+		float k1, float k2, float k3)
+	{
+		__m256 vk1 = _mm256_set1_ps(k1);
+		__m256 vk2 = _mm256_set1_ps(k2);
+		__m256 vk3 = _mm256_set1_ps(k3);
+
+		// Whole vectors only; the columns left over go to the scalar kernel, which is not
+		// built with /arch:AVX2 and so cannot have its multiplies and adds contracted into
+		// FMAs the way a scalar loop in this file could.
+		UINT vectorEnd = col0 + (col1 - col0) / 16 * 16;
+		for (UINT i = row0; i < row1; ++i)
+		{
+			float* p = prev + i * pitch;
+			const float* c = curr + i * pitch;
+			const float* above = c - pitch;
+			const float* below = c + pitch;
+
+			for (UINT j = col0; j < vectorEnd; j += 16)
+			{
+				__m256 r0 = StepAVX(p + j, c + j, above + j, below + j, vk1, vk2, vk3);
+				__m256 r1 = StepAVX(p + j + 8, c + j + 8, above + j + 8, below + j + 8, vk1, vk2, vk3);
+				_mm256_storeu_ps(p + j, r0);
+				_mm256_storeu_ps(p + j + 8, r1);
+			}
+		}
+
+		if (vectorEnd < col1)
+			ScalarWaveKernels().StepHeights(prev, curr, pitch, row0, row1, vectorEnd, col1, k1, k2, k3);
+	}
+
+	// 1/sqrt(x) estimate refined by one Newton-Raphson step.
+	inline __m256 RsqrtAVX(__m256 x)
+	{
+		__m256 y = _mm256_rsqrt_ps(x);
+		__m256 yyx = _mm256_mul_ps(_mm256_mul_ps(y, y), x);
+		return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y), _mm256_sub_ps(_mm256_set1_ps(3.0f), yyx));
+	}
+
+	// Normals of the 8 points starting at h, written to index k of the streams.
+	inline void NormalsAVX(const float* h, UINT pitch, UINT k, __m256 twoDx, __m256 twoDxSq,
+		const WaveNormalStreams& out)
+	{
+		__m256 l = _mm256_loadu_ps(h - 1);
+		__m256 r = _mm256_loadu_ps(h + 1);
+		__m256 t = _mm256_loadu_ps(h - pitch);
+		__m256 b = _mm256_loadu_ps(h + pitch);
+
+		__m256 nx = _mm256_sub_ps(l, r);
+		__m256 nz = _mm256_sub_ps(b, t);
+		__m256 lenSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), twoDxSq), _mm256_mul_ps(nz, nz));
+		__m256 invLen = RsqrtAVX(lenSq);
+		_mm256_storeu_ps(out.NormalX + k, _mm256_mul_ps(nx, invLen));
+		_mm256_storeu_ps(out.NormalY + k, _mm256_mul_ps(twoDx, invLen));
+		_mm256_storeu_ps(out.NormalZ + k, _mm256_mul_ps(nz, invLen));
+
+		__m256 ty = _mm256_sub_ps(r, l);
+		invLen = RsqrtAVX(_mm256_add_ps(twoDxSq, _mm256_mul_ps(ty, ty)));
+		_mm256_storeu_ps(out.TangentXx + k, _mm256_mul_ps(twoDx, invLen));
+		_mm256_storeu_ps(out.TangentXy + k, _mm256_mul_ps(ty, invLen));
+	}
+
+	void ComputeNormalsAVX2(const float* heights, UINT pitch,
+		UINT rowCount, UINT colCount,
+		float spatialStep, const WaveNormalStreams& out)
+	{
+		float twoDx = 2.0f * spatialStep;
+		__m256 vTwoDx = _mm256_set1_ps(twoDx);
+		__m256 vTwoDxSq = _mm256_set1_ps(twoDx * twoDx);
+
+		for (UINT i = 0; i < rowCount; ++i)
+		{
+			const float* h = heights + i * pitch;
+			UINT k = i * out.Pitch;
+
+			UINT j = 0;
+			for (; j + 16 <= colCount; j += 16)
+			{
+				NormalsAVX(h + j, pitch, k + j, vTwoDx, vTwoDxSq, out);
+				NormalsAVX(h + j + 8, pitch, k + j + 8, vTwoDx, vTwoDxSq, out);
+			}
+
+			// Finish the row with the scalar reference.
+			if (j < colCount)
+			{
+				WaveNormalStreams tail = { out.NormalX + k + j, out.NormalY + k + j, out.NormalZ + k + j,
+					out.TangentXx + k + j, out.TangentXy + k + j, out.Pitch };
+				ScalarWaveKernels().ComputeNormals(h + j, pitch, 1, colCount - j, spatialStep, tail);
+			}
+		}
+	}
+
+	// Transposes 8 points of the row into 8 vertices of 8 floats with in-lane unpacks
+	// and shuffles; the last step swaps 128-bit halves so vertex k and k + 4 each get
+	// their own register.
+	void PackVerticesAVX2(const WaveVertexRow& row, UINT count, UINT stride, float* out)
+	{
+		bool tex = (stride == 8);
+		__m256 z = _mm256_set1_ps(row.Z);
+		__m256 v = _mm256_set1_ps(row.V);
+
+		UINT j = 0;
+		for (; j + 8 <= count; j += 8)
+		{
+			__m256 x = _mm256_loadu_ps(row.X + j);
+			__m256 y = _mm256_loadu_ps(row.Heights + j);
+			__m256 nx = _mm256_loadu_ps(row.NormalX + j);
+			__m256 ny = _mm256_loadu_ps(row.NormalY + j);
+			__m256 nz = _mm256_loadu_ps(row.NormalZ + j);
+			__m256 u = tex ? _mm256_loadu_ps(row.U + j) : _mm256_setzero_ps();
+
+			__m256 t0 = _mm256_unpacklo_ps(x, y);
+			__m256 t1 = _mm256_unpackhi_ps(x, y);
+			__m256 t2 = _mm256_unpacklo_ps(z, nx);
+			__m256 t3 = _mm256_unpackhi_ps(z, nx);
+			__m256 t4 = _mm256_unpacklo_ps(ny, nz);
+			__m256 t5 = _mm256_unpackhi_ps(ny, nz);
+			__m256 t6 = _mm256_unpacklo_ps(u, v);
+			__m256 t7 = _mm256_unpackhi_ps(u, v);
+
+			// s[k] holds the first half of vertices k and k + 4, s[k + 4] the second.
+			__m256 s[8];
+			s[0] = _mm256_shuffle_ps(t0, t2, 0x44);
+			s[1] = _mm256_shuffle_ps(t0, t2, 0xEE);
+			s[2] = _mm256_shuffle_ps(t1, t3, 0x44);
+			s[3] = _mm256_shuffle_ps(t1, t3, 0xEE);
+			s[4] = _mm256_shuffle_ps(t4, t6, 0x44);
+			s[5] = _mm256_shuffle_ps(t4, t6, 0xEE);
+			s[6] = _mm256_shuffle_ps(t5, t7, 0x44);
+			s[7] = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+			float* o = out + j * stride;
+			for (UINT k = 0; k < 4; ++k)
+			{
+				if (tex)
+				{
+					_mm256_storeu_ps(o + k * 8, _mm256_permute2f128_ps(s[k], s[k + 4], 0x20));
+					_mm256_storeu_ps(o + (k + 4) * 8, _mm256_permute2f128_ps(s[k], s[k + 4], 0x31));
+				}
+				else
+				{
+					_mm_storeu_ps(o + k * 6, _mm256_castps256_ps128(s[k]));
+					_mm_storel_pi(reinterpret_cast<__m64*>(o + k * 6 + 4), _mm256_castps256_ps128(s[k + 4]));
+					_mm_storeu_ps(o + (k + 4) * 6, _mm256_extractf128_ps(s[k], 1));
+					_mm_storel_pi(reinterpret_cast<__m64*>(o + (k + 4) * 6 + 4), _mm256_extractf128_ps(s[k + 4], 1));
+				}
+			}
+		}
+
+		// Finish the row with the scalar reference.
+		if (j < count)
+		{
+			WaveVertexRow tail = { row.X + j, row.Heights + j, row.NormalX + j, row.NormalY + j,
+				row.NormalZ + j, tex ? row.U + j : nullptr, row.Z, row.V };
+			ScalarWaveKernels().PackVertices(tail, count - j, stride, out + j * stride);
+		}
+	}
+
+	// [-1, 1] to 10-bit unorm; the same steps as the scalar version.
+	inline __m256i PackUnorm10AVX(__m256 v)
+	{
+		v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f));
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(1023.0f)), _mm256_set1_ps(0.5f)));
+	}
+
+	// Halves come from F16C, which rounds to nearest even like the scalar version.
+	void PackCompactVerticesAVX2(const float* heights, const float* normalX, const float* normalY,
+		const float* normalZ, UINT count, UINT* out)
+	{
+		UINT j = 0;
+		for (; j + 8 <= count; j += 8)
+		{
+			__m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(heights + j), _MM_FROUND_TO_NEAREST_INT);
+			__m256i h = _mm256_cvtepu16_epi32(halves);
+
+			__m256i n = PackUnorm10AVX(_mm256_loadu_ps(normalX + j));
+			n = _mm256_or_si256(n, _mm256_slli_epi32(PackUnorm10AVX(_mm256_loadu_ps(normalY + j)), 10));
+			n = _mm256_or_si256(n, _mm256_slli_epi32(PackUnorm10AVX(_mm256_loadu_ps(normalZ + j)), 20));
+
+			// Unpacking works within 128-bit lanes: lo holds vertices 0, 1, 4, 5 and
+			// hi holds 2, 3, 6, 7.
+			__m256i lo = _mm256_unpacklo_epi32(h, n);
+			__m256i hi = _mm256_unpackhi_epi32(h, n);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * j), _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * j + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+
+		// Finish the row with the scalar reference.
+		if (j < count)
+		{
+			ScalarWaveKernels().PackCompactVertices(heights + j, normalX + j, normalY + j, normalZ + j,
+				count - j, out + 2 * j);
+		}
+	}
+
+	// Stage advanced by j columns.
+	inline WaveFftStage OffsetStage(const WaveFftStage& st, UINT j)
+	{
+		WaveFftStage r = st;
+		r.SrcRe += j;
+		r.SrcIm += j;
+		r.DstRe += j;
+		r.DstIm += j;
+		r.Count -= j;
+		return r;
+	}
+
+	// (tr + i ti) * (wr + i wi), stored to rows yr and yi.
+	inline void StoreComplexMulAVX(float* yr, float* yi, __m256 tr, __m256 ti, __m256 wr, __m256 wi)
+	{
+		_mm256_storeu_ps(yr, _mm256_sub_ps(_mm256_mul_ps(tr, wr), _mm256_mul_ps(ti, wi)));
+		_mm256_storeu_ps(yi, _mm256_add_ps(_mm256_mul_ps(tr, wi), _mm256_mul_ps(ti, wr)));
+	}
+
+	void FftRadix2AVX2(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 2;
+		UINT s = st.Stride;
+		UINT count = st.Count & ~7u;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			__m256 wr = _mm256_set1_ps(st.TwiddleRe[p * st.TwiddleStep]);
+			__m256 wi = _mm256_set1_ps(st.TwiddleIm[p * st.TwiddleStep]);
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 2 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 2 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < count; j += 8)
+				{
+					__m256 ar = _mm256_loadu_ps(xr + j);
+					__m256 ai = _mm256_loadu_ps(xi + j);
+					__m256 br = _mm256_loadu_ps(xr + j + in);
+					__m256 bi = _mm256_loadu_ps(xi + j + in);
+
+					_mm256_storeu_ps(yr + j, _mm256_add_ps(ar, br));
+					_mm256_storeu_ps(yi + j, _mm256_add_ps(ai, bi));
+					StoreComplexMulAVX(yr + j + out, yi + j + out, _mm256_sub_ps(ar, br), _mm256_sub_ps(ai, bi), wr, wi);
+				}
+			}
+		}
+
+		// Columns are independent, so the scalar reference can finish the last few.
+		if (count < st.Count)
+			ScalarWaveKernels().FftRadix2(OffsetStage(st, count));
+	}
+
+	void FftRadix4AVX2(const WaveFftStage& st)
+	{
+		UINT m = st.Length / 4;
+		UINT s = st.Stride;
+		UINT count = st.Count & ~7u;
+
+		for (UINT p = 0; p < m; ++p)
+		{
+			__m256 w1r = _mm256_set1_ps(st.TwiddleRe[p * st.TwiddleStep]);
+			__m256 w1i = _mm256_set1_ps(st.TwiddleIm[p * st.TwiddleStep]);
+			__m256 w2r = _mm256_set1_ps(st.TwiddleRe[2 * p * st.TwiddleStep]);
+			__m256 w2i = _mm256_set1_ps(st.TwiddleIm[2 * p * st.TwiddleStep]);
+			__m256 w3r = _mm256_set1_ps(st.TwiddleRe[3 * p * st.TwiddleStep]);
+			__m256 w3i = _mm256_set1_ps(st.TwiddleIm[3 * p * st.TwiddleStep]);
+
+			for (UINT q = 0; q < s; ++q)
+			{
+				UINT in = m * s * st.SrcPitch;
+				UINT out = s * st.DstPitch;
+				const float* xr = st.SrcRe + (q + s * p) * st.SrcPitch;
+				const float* xi = st.SrcIm + (q + s * p) * st.SrcPitch;
+				float* yr = st.DstRe + (q + s * 4 * p) * st.DstPitch;
+				float* yi = st.DstIm + (q + s * 4 * p) * st.DstPitch;
+
+				for (UINT j = 0; j < count; j += 8)
+				{
+					__m256 ar = _mm256_loadu_ps(xr + j);
+					__m256 ai = _mm256_loadu_ps(xi + j);
+					__m256 br = _mm256_loadu_ps(xr + j + in);
+					__m256 bi = _mm256_loadu_ps(xi + j + in);
+					__m256 cr = _mm256_loadu_ps(xr + j + 2 * in);
+					__m256 ci = _mm256_loadu_ps(xi + j + 2 * in);
+					__m256 dr = _mm256_loadu_ps(xr + j + 3 * in);
+					__m256 di = _mm256_loadu_ps(xi + j + 3 * in);
+
+					__m256 apcR = _mm256_add_ps(ar, cr);
+					__m256 apcI = _mm256_add_ps(ai, ci);
+					__m256 amcR = _mm256_sub_ps(ar, cr);
+					__m256 amcI = _mm256_sub_ps(ai, ci);
+					__m256 bpdR = _mm256_add_ps(br, dr);
+					__m256 bpdI = _mm256_add_ps(bi, di);
+					__m256 bmdR = _mm256_sub_ps(br, dr);
+					__m256 bmdI = _mm256_sub_ps(bi, di);
+
+					_mm256_storeu_ps(yr + j, _mm256_add_ps(apcR, bpdR));
+					_mm256_storeu_ps(yi + j, _mm256_add_ps(apcI, bpdI));
+					StoreComplexMulAVX(yr + j + out, yi + j + out, _mm256_add_ps(amcR, bmdI), _mm256_sub_ps(amcI, bmdR), w1r, w1i);
+					StoreComplexMulAVX(yr + j + 2 * out, yi + j + 2 * out, _mm256_sub_ps(apcR, bpdR), _mm256_sub_ps(apcI, bpdI), w2r, w2i);
+					StoreComplexMulAVX(yr + j + 3 * out, yi + j + 3 * out, _mm256_sub_ps(amcR, bmdI), _mm256_add_ps(amcI, bmdR), w3r, w3i);
+				}
+			}
+		}
+
+		if (count < st.Count)
+			ScalarWaveKernels().FftRadix4(OffsetStage(st, count));
+	}
+
+	void SolveTridiagonalAVX2(const WaveTridiagonal& sys)
+	{
+		UINT count = sys.Count & ~7u;
+		__m256 beta = _mm256_set1_ps(sys.Beta);
+
+		// Same order as the scalar version: a whole row of the block at a time.
+		float* row = sys.Data;
+		__m256 scale = _mm256_set1_ps(sys.Scale[0]);
+		for (UINT j = 0; j < count; j += 8)
+			_mm256_storeu_ps(row + j, _mm256_mul_ps(_mm256_loadu_ps(row + j), scale));
+
+		for (UINT r = 1; r < sys.Length; ++r)
+		{
+			const float* above = row;
+			row += sys.Pitch;
+			scale = _mm256_set1_ps(sys.Scale[r]);
+			for (UINT j = 0; j < count; j += 8)
+			{
+				__m256 d = _mm256_add_ps(_mm256_loadu_ps(row + j), _mm256_mul_ps(beta, _mm256_loadu_ps(above + j)));
+				_mm256_storeu_ps(row + j, _mm256_mul_ps(d, scale));
+			}
+		}
+
+		for (UINT r = sys.Length - 1; r-- > 0; )
+		{
+			const float* below = row;
+			row -= sys.Pitch;
+			__m256 coupling = _mm256_set1_ps(sys.Coupling[r]);
+			for (UINT j = 0; j < count; j += 8)
+			{
+				__m256 x = _mm256_mul_ps(coupling, _mm256_loadu_ps(below + j));
+				_mm256_storeu_ps(row + j, _mm256_add_ps(_mm256_loadu_ps(row + j), x));
+			}
+		}
+
+		// Systems are independent, so the scalar reference can finish the last few.
+		if (count < sys.Count)
+		{
+			WaveTridiagonal rest = sys;
+			rest.Data += count;
+			rest.Count -= count;
+			ScalarWaveKernels().SolveTridiagonal(rest);
+		}
+	}
+
+	// f at eight points given the index of their top left grid point.
+	inline __m256 BilerpAVX(const float* f, __m256i k, UINT pitch, __m256 fu, __m256 fv)
+	{
+		__m256i one = _mm256_set1_epi32(1);
+		__m256i below = _mm256_add_epi32(k, _mm256_set1_epi32(static_cast<int>(pitch)));
+
+		__m256 a = _mm256_i32gather_ps(f, k, 4);
+		__m256 b = _mm256_i32gather_ps(f, _mm256_add_epi32(k, one), 4);
+		__m256 c = _mm256_i32gather_ps(f, below, 4);
+		__m256 d = _mm256_i32gather_ps(f, _mm256_add_epi32(below, one), 4);
+
+		__m256 top = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fu));
+		__m256 bottom = _mm256_add_ps(c, _mm256_mul_ps(_mm256_sub_ps(d, c), fu));
+		return _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fv));
+	}
+
+	void SampleSurfaceAVX2(const WaveSurface& s, const WaveProbes& probes)
+	{
+		UINT count = probes.Count & ~7u;
+
+		__m256 invStep = _mm256_set1_ps(1.0f / s.SpatialStep);
+		__m256 x0 = _mm256_set1_ps(s.X0);
+		__m256 z0 = _mm256_set1_ps(s.Z0);
+		__m256 zero = _mm256_setzero_ps();
+		__m256 maxU = _mm256_set1_ps(static_cast<float>(s.ColumnCount - 1));
+		__m256 maxV = _mm256_set1_ps(static_cast<float>(s.RowCount - 1));
+		__m256 lastCol = _mm256_set1_ps(static_cast<float>(s.ColumnCount - 2));
+		__m256 lastRow = _mm256_set1_ps(static_cast<float>(s.RowCount - 2));
+		__m256i pitch = _mm256_set1_epi32(static_cast<int>(s.ColumnCount));
+
+		for (UINT k = 0; k < count; k += 8)
+		{
+			__m256 u = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(probes.X + k), x0), invStep);
+			__m256 v = _mm256_mul_ps(_mm256_sub_ps(z0, _mm256_loadu_ps(probes.Z + k)), invStep);
+			// min and max return the second operand for NaN, so a NaN lane clamps to 0.
+			u = _mm256_min_ps(_mm256_max_ps(u, zero), maxU);
+			v = _mm256_min_ps(_mm256_max_ps(v, zero), maxV);
+
+			__m256i col = _mm256_cvttps_epi32(_mm256_min_ps(u, lastCol));
+			__m256i row = _mm256_cvttps_epi32(_mm256_min_ps(v, lastRow));
+			__m256 fu = _mm256_sub_ps(u, _mm256_cvtepi32_ps(col));
+			__m256 fv = _mm256_sub_ps(v, _mm256_cvtepi32_ps(row));
+			__m256i i = _mm256_add_epi32(_mm256_mullo_epi32(row, pitch), col);
+
+			_mm256_storeu_ps(probes.Heights + k, BilerpAVX(s.Heights, i, s.ColumnCount, fu, fv));
+
+			if (probes.NormalX != nullptr)
+			{
+				__m256 nx = BilerpAVX(s.NormalX, i, s.ColumnCount, fu, fv);
+				__m256 ny = BilerpAVX(s.NormalY, i, s.ColumnCount, fu, fv);
+				__m256 nz = BilerpAVX(s.NormalZ, i, s.ColumnCount, fu, fv);
+
+				__m256 lenSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)),
+					_mm256_mul_ps(nz, nz));
+				__m256 invLen = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lenSq));
+				_mm256_storeu_ps(probes.NormalX + k, _mm256_mul_ps(nx, invLen));
+				_mm256_storeu_ps(probes.NormalY + k, _mm256_mul_ps(ny, invLen));
+				_mm256_storeu_ps(probes.NormalZ + k, _mm256_mul_ps(nz, invLen));
+			}
+		}
+
+		if (count < probes.Count)
+		{
+			WaveProbes rest = probes;
+			rest.X += count;
+			rest.Z += count;
+			rest.Count -= count;
+			rest.Heights += count;
+			if (rest.NormalX != nullptr)
+			{
+				rest.NormalX += count;
+				rest.NormalY += count;
+				rest.NormalZ += count;
+			}
+			ScalarWaveKernels().SampleSurface(s, rest);
+		}
+	}
+
+	const WaveKernels gAVX2Kernels =
+	{
+		StepHeightsAVX2,
+		ComputeNormalsAVX2,
+		PackVerticesAVX2,
+		PackCompactVerticesAVX2,
+		FftRadix2AVX2,
+		FftRadix4AVX2,
+		SolveTridiagonalAVX2,
+		SampleSurfaceAVX2,
+		"AVX2"
+	};
+}
+
+const WaveKernels* AVX2WaveKernels()
+{
+	return &gAVX2Kernels;
+}
+
+#else
+
+const WaveKernels* AVX2WaveKernels()
+{
+	return nullptr;
+}
+
+#endif
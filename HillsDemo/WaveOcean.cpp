@@ -0,0 +1,556 @@
+//***************************************************************************************
+// WaveOcean.cpp
+//***************************************************************************************
+
+#include "WaveOcean.h"
+#include "Vertex.h"
+
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+
+using namespace DirectX;
+
+WaveOcean::Tile::Tile()
+	: Level(0),
+	  Frozen(false),
+	  Revision(0)
+{
+}
+
+WaveOcean::WaveOcean()
+	: mTimeAccumulator(0.0f),
+	  mMaxStepsPerUpdate(8),
+	  mSimulatedPointCount(0),
+	  mThreadPool(nullptr)
+{
+	ZeroMemory(&mDesc, sizeof(mDesc));
+}
+
+WaveOcean::~WaveOcean()
+{
+}
+
+void WaveOcean::Init(const WaveOceanDesc& desc)
+{
+	assert(desc.TileCountX > 0 && desc.TileCountZ > 0);
+	assert(desc.LevelCount > 0 && (desc.TileCells >> (desc.LevelCount - 1)) >= 4);
+	assert((desc.TileCells & (desc.TileCells - 1)) == 0);
+
+	mDesc = desc;
+	mTimeAccumulator = 0.0f;
+	mSimulatedPointCount = 0;
+
+	// Everything starts out flat and frozen at the coarsest level; the first Update()
+	// picks the levels for the camera.
+	mTiles.clear();
+	mTiles.resize(desc.TileCountX * desc.TileCountZ);
+	for (UINT t = 0; t < TileCount(); ++t)
+	{
+		mTiles[t].Level = desc.LevelCount - 1;
+		mTiles[t].Frozen = true;
+		BuildTileGrid(t);
+	}
+}
+
+void WaveOcean::SetMaxStepsPerUpdate(UINT maxSteps)
+{
+	mMaxStepsPerUpdate = std::max(maxSteps, 1u);
+}
+
+XMFLOAT2 WaveOcean::TileCenter(UINT tile)const
+{
+	UINT tx = tile % mDesc.TileCountX;
+	UINT tz = tile / mDesc.TileCountX;
+
+	return XMFLOAT2((tx + 0.5f - 0.5f * mDesc.TileCountX) * mDesc.TileSize,
+		(0.5f * mDesc.TileCountZ - tz - 0.5f) * mDesc.TileSize);
+}
+
+int WaveOcean::Neighbor(UINT tile, Side side)const
+{
+	UINT tx = tile % mDesc.TileCountX;
+	UINT tz = tile / mDesc.TileCountX;
+
+	switch (side)
+	{
+	case SideNorth: return tz > 0 ? static_cast<int>(tile - mDesc.TileCountX) : -1;
+	case SideSouth: return tz + 1 < mDesc.TileCountZ ? static_cast<int>(tile + mDesc.TileCountX) : -1;
+	case SideWest:  return tx > 0 ? static_cast<int>(tile - 1) : -1;
+	case SideEast:  return tx + 1 < mDesc.TileCountX ? static_cast<int>(tile + 1) : -1;
+	}
+
+	return -1;
+}
+
+UINT WaveOcean::LevelForDistance(float distance)const
+{
+	UINT level = 0;
+	float limit = mDesc.LevelDistance;
+	while (level + 1 < mDesc.LevelCount && distance >= limit)
+	{
+		++level;
+		limit *= 2.0f;
+	}
+
+	return level;
+}
+
+void WaveOcean::UpdateLevels(const XMFLOAT3& eyePos)
+{
+	UINT tileCount = TileCount();
+	std::vector<UINT> levels(tileCount);
+
+	for (UINT t = 0; t < tileCount; ++t)
+	{
+		// Distance from the camera to the nearest point of the tile.
+		XMFLOAT2 center = TileCenter(t);
+		float half = 0.5f * mDesc.TileSize;
+		float dx = std::max(fabsf(eyePos.x - center.x) - half, 0.0f);
+		float dz = std::max(fabsf(eyePos.z - center.y) - half, 0.0f);
+		float distance = sqrtf(dx * dx + dz * dz + eyePos.y * eyePos.y);
+
+		Tile& tile = mTiles[t];
+
+		levels[t] = LevelForDistance(distance);
+		if (levels[t] > tile.Level)
+			levels[t] = std::max(tile.Level, LevelForDistance(distance / 1.1f));
+
+		tile.Frozen = tile.Frozen ? distance > mDesc.FreezeDistance : distance > 1.1f * mDesc.FreezeDistance;
+	}
+
+	// Refining a tile may force its neighbors to refine in turn, but never more than
+	// LevelCount times over.
+	bool refined = true;
+	while (refined)
+	{
+		refined = false;
+		for (UINT t = 0; t < tileCount; ++t)
+		{
+			for (UINT s = 0; s < 4; ++s)
+			{
+				int nb = Neighbor(t, static_cast<Side>(s));
+				if (nb >= 0 && levels[t] > levels[nb] + 1)
+				{
+					levels[t] = levels[nb] + 1;
+					refined = true;
+				}
+			}
+		}
+	}
+
+	for (UINT t = 0; t < tileCount; ++t)
+	{
+		if (levels[t] != mTiles[t].Level)
+		{
+			mTiles[t].Level = levels[t];
+			BuildTileGrid(t);
+			TouchNeighborhood(t);
+		}
+	}
+}
+
+void WaveOcean::BuildTileGrid(UINT tile)
+{
+	Tile& t = mTiles[tile];
+
+	// The grid has a ghost point beyond each side of the tile, so points 1 to cells + 1
+	// span the tile from edge to edge.
+	UINT cells = LevelCells(t.Level);
+	UINT n = cells + 3;
+	float dx = mDesc.TileSize / cells;
+
+	std::unique_ptr<Waves> grid(new Waves());
+	grid->Init(n, n, dx, mDesc.TimeStep, mDesc.Speed, mDesc.Damping);
+
+	if (t.Grid)
+	{
+		// Both grids are centered on the tile, so the old one is sampled at the local
+		// positions of the new points.
+		std::vector<float> x(n * n), z(n * n), prev(n * n), curr(n * n);
+		for (UINT i = 0; i < n; ++i)
+		{
+			for (UINT j = 0; j < n; ++j)
+			{
+				x[i * n + j] = grid->GridX(j);
+				z[i * n + j] = grid->GridZ(i);
+			}
+		}
+
+		WaveProbes probes = { &x[0], &z[0], n * n, &curr[0], nullptr, nullptr, nullptr };
+		t.Grid->Sample(probes);
+
+		WaveSurface surface = t.Grid->Surface();
+		surface.Heights = t.Grid->PreviousHeights();
+		surface.NormalX = surface.NormalY = surface.NormalZ = nullptr;
+		probes.Heights = &prev[0];
+		t.Grid->Kernels().SampleSurface(surface, probes);
+
+		grid->SetSolution(&prev[0], &curr[0]);
+	}
+
+	t.Grid.swap(grid);
+}
+
+void WaveOcean::Update(float dt, const XMFLOAT3& eyePos)
+{
+	UpdateLevels(eyePos);
+
+	mTimeAccumulator += std::max(dt, 0.0f);
+
+	// Capped before converting, as in Waves::Update().
+	float stepsOwed = mTimeAccumulator / mDesc.TimeStep;
+	UINT numSteps;
+	if (!(stepsOwed < mMaxStepsPerUpdate + 1.0f))
+	{
+		numSteps = mMaxStepsPerUpdate;
+		mTimeAccumulator = 0.0f;
+	}
+	else
+	{
+		numSteps = static_cast<UINT>(stepsOwed);
+		mTimeAccumulator -= numSteps * mDesc.TimeStep;
+		mTimeAccumulator = std::min(std::max(mTimeAccumulator, 0.0f), mDesc.TimeStep);
+	}
+
+	std::vector<UINT> steppedTiles;
+	for (UINT t = 0; t < TileCount(); ++t)
+	{
+		if (!mTiles[t].Frozen)
+			steppedTiles.push_back(t);
+	}
+
+	mSimulatedPointCount = 0;
+	if (numSteps == 0 || steppedTiles.empty())
+		return;
+
+	for (UINT k = 0; k < steppedTiles.size(); ++k)
+		mSimulatedPointCount += mTiles[steppedTiles[k]].Grid->VertexCount();
+
+	// Every tile exchanges its ghost points at once, and then steps at once; a tile
+	// only writes its own grid in either.
+	for (UINT s = 0; s < numSteps; ++s)
+	{
+		ExchangeBoundaries(steppedTiles);
+
+		ThreadPool::Run(mThreadPool, static_cast<UINT>(steppedTiles.size()), [this, &steppedTiles](UINT k, UINT)
+		{
+			mTiles[steppedTiles[k]].Grid->Step(1);
+		});
+	}
+
+	for (UINT k = 0; k < steppedTiles.size(); ++k)
+		TouchNeighborhood(steppedTiles[k]);
+}
+
+void WaveOcean::TouchNeighborhood(UINT tile)
+{
+	int tx = static_cast<int>(tile % mDesc.TileCountX);
+	int tz = static_cast<int>(tile / mDesc.TileCountX);
+	int maxX = static_cast<int>(mDesc.TileCountX) - 1;
+	int maxZ = static_cast<int>(mDesc.TileCountZ) - 1;
+
+	for (int z = std::max(tz - 1, 0); z <= std::min(tz + 1, maxZ); ++z)
+	{
+		for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, maxX); ++x)
+			++mTiles[z * mDesc.TileCountX + x].Revision;
+	}
+}
+
+void WaveOcean::ExchangeBoundaries(const std::vector<UINT>& steppedTiles)
+{
+	mScratch.resize(mThreadPool != nullptr ? mThreadPool->ThreadCount() : 1);
+	if (mGhosts.size() < steppedTiles.size())
+		mGhosts.resize(steppedTiles.size());
+
+	// Every tile samples its ghosts from its neighbors first, and only once all have
+	// sampled do they set them.  The ghost corners lie in the diagonal tiles and come
+	// out clamped onto the neighbors' own ghost points, which must not be written
+	// while they are read.
+	ThreadPool::Run(mThreadPool, static_cast<UINT>(steppedTiles.size()), [this, &steppedTiles](UINT k, UINT thread)
+	{
+		UINT tile = steppedTiles[k];
+		const Waves& grid = *mTiles[tile].Grid;
+		UINT n = grid.ColumnCount();
+		XMFLOAT2 center = TileCenter(tile);
+
+		std::vector<float>& scratch = mScratch[thread];
+		scratch.resize(2 * n);
+		float* x = &scratch[0];
+		float* z = x + n;
+
+		mGhosts[k].resize(4 * n);
+		for (UINT s = 0; s < 4; ++s)
+		{
+			int nb = Neighbor(tile, static_cast<Side>(s));
+			if (nb < 0)
+				continue;
+
+			// Ghost points in the local space of the neighbor; the simulation never
+			// reads the corners.
+			XMFLOAT2 nbCenter = TileCenter(nb);
+			for (UINT p = 0; p < n; ++p)
+			{
+				UINT i = s == SideNorth ? 0 : s == SideSouth ? n - 1 : p;
+				UINT j = s == SideWest ? 0 : s == SideEast ? n - 1 : p;
+				x[p] = center.x + grid.GridX(j) - nbCenter.x;
+				z[p] = center.y + grid.GridZ(i) - nbCenter.y;
+			}
+
+			WaveProbes probes = { x, z, n, &mGhosts[k][s * n], nullptr, nullptr, nullptr };
+			mTiles[nb].Grid->Sample(probes);
+		}
+	});
+
+	ThreadPool::Run(mThreadPool, static_cast<UINT>(steppedTiles.size()), [this, &steppedTiles](UINT k, UINT)
+	{
+		UINT tile = steppedTiles[k];
+		Waves& grid = *mTiles[tile].Grid;
+		UINT n = grid.ColumnCount();
+
+		const float* sides[4] = { nullptr, nullptr, nullptr, nullptr };
+		for (UINT s = 0; s < 4; ++s)
+		{
+			if (Neighbor(tile, static_cast<Side>(s)) >= 0)
+				sides[s] = &mGhosts[k][s * n];
+		}
+
+		grid.SetBoundaryHeights(sides[SideNorth], sides[SideSouth], sides[SideWest], sides[SideEast]);
+	});
+}
+
+bool WaveOcean::Disturb(float x, float z, float magnitude, float radius, WaveFootprint footprint)
+{
+	float u = x / mDesc.TileSize + 0.5f * mDesc.TileCountX;
+	float v = 0.5f * mDesc.TileCountZ - z / mDesc.TileSize;
+	if (u < 0.0f || v < 0.0f || u >= mDesc.TileCountX || v >= mDesc.TileCountZ)
+		return false;
+
+	UINT tile = static_cast<UINT>(v) * mDesc.TileCountX + static_cast<UINT>(u);
+	if (mTiles[tile].Frozen)
+		return false;
+
+	const Waves& grid = *mTiles[tile].Grid;
+	XMFLOAT2 center = TileCenter(tile);
+	float dx = mDesc.TileSize / LevelCells(mTiles[tile].Level);
+
+	WaveImpulse impulse;
+	impulse.Row = (grid.GridZ(0) - (z - center.y)) / dx;
+	impulse.Col = ((x - center.x) - grid.GridX(0)) / dx;
+	impulse.Magnitude = magnitude;
+	impulse.Radius = radius / dx;
+	impulse.Footprint = footprint;
+
+	return mTiles[tile].Grid->DisturbBatch(&impulse, 1) == 1;
+}
+
+UINT WaveOcean::TileVertexCount(UINT tile)const
+{
+	UINT cells = LevelCells(mTiles[tile].Level);
+	return (cells + 1) * (cells + 1);
+}
+
+void WaveOcean::EmitTileGridVertices(UINT tile, Vertex::WaveGrid* v)const
+{
+	// Positions are computed the same way in every tile, so the vertices on a shared
+	// edge land on exactly the same spot whatever the levels of the tiles.
+	UINT cells = LevelCells(mTiles[tile].Level);
+	XMFLOAT2 center = TileCenter(tile);
+	float x0 = center.x - 0.5f * mDesc.TileSize;
+	float z0 = center.y + 0.5f * mDesc.TileSize;
+
+	for (UINT i = 0; i <= cells; ++i)
+	{
+		float z = z0 - mDesc.TileSize * (static_cast<float>(i) / cells);
+		for (UINT j = 0; j <= cells; ++j)
+		{
+			float x = x0 + mDesc.TileSize * (static_cast<float>(j) / cells);
+			v[i * (cells + 1) + j].PosXZ = XMFLOAT2(x, z);
+			v[i * (cells + 1) + j].Tex = XMFLOAT2(x / mDesc.TileSize, -z / mDesc.TileSize);
+		}
+	}
+}
+
+UINT WaveOcean::CornerOwner(UINT ci, UINT cj)const
+{
+	// Corner (ci, cj) of the lattice touches up to four tiles; the coarsest one, and of
+	// those the first, owns it.
+	UINT owner = UINT_MAX;
+	for (UINT tz = ci > 0 ? ci - 1 : 0; tz <= std::min(ci, mDesc.TileCountZ - 1); ++tz)
+	{
+		for (UINT tx = cj > 0 ? cj - 1 : 0; tx <= std::min(cj, mDesc.TileCountX - 1); ++tx)
+		{
+			UINT t = tz * mDesc.TileCountX + tx;
+			if (owner == UINT_MAX || mTiles[t].Level > mTiles[owner].Level)
+				owner = t;
+		}
+	}
+
+	return owner;
+}
+
+bool WaveOcean::OwnsEdge(UINT tile, Side side)const
+{
+	int nb = Neighbor(tile, side);
+	if (nb < 0)
+		return true;
+
+	UINT level = mTiles[tile].Level;
+	UINT nbLevel = mTiles[nb].Level;
+	if (level != nbLevel)
+		return level > nbLevel;
+
+	return side == SideSouth || side == SideEast;
+}
+
+void WaveOcean::GetTileVertex(UINT tile, UINT r, UINT c, float& h, float& nx, float& ny, float& nz)const
+{
+	const Waves& grid = *mTiles[tile].Grid;
+	UINT k = (r + 1) * grid.ColumnCount() + c + 1;
+
+	h = grid.Heights()[k];
+	nx = grid.NormalsX()[k];
+	ny = grid.NormalsY()[k];
+	nz = grid.NormalsZ()[k];
+}
+
+void WaveOcean::EmitTileVertices(UINT tile, Vertex::WaveCompact* v)
+{
+	UINT cells = LevelCells(mTiles[tile].Level);
+	UINT count = (cells + 1) * (cells + 1);
+
+	mScratch.resize(std::max<size_t>(mScratch.size(), 1));
+	std::vector<float>& scratch = mScratch[0];
+	scratch.resize(4 * count);
+	float* h = &scratch[0];
+	float* nx = h + count;
+	float* ny = nx + count;
+	float* nz = ny + count;
+
+	for (UINT r = 0; r <= cells; ++r)
+	{
+		for (UINT c = 0; c <= cells; ++c)
+		{
+			UINT k = r * (cells + 1) + c;
+			GetTileVertex(tile, r, c, h[k], nx[k], ny[k], nz[k]);
+		}
+	}
+
+	// Edges owned by a neighbor take its vertices.  The neighbor has the same level or
+	// is one coarser; in the latter case only the even vertices have a counterpart,
+	// and the odd ones are skipped by the stitched index list anyway.
+	for (UINT s = 0; s < 4; ++s)
+	{
+		Side side = static_cast<Side>(s);
+		if (OwnsEdge(tile, side))
+			continue;
+
+		UINT nb = static_cast<UINT>(Neighbor(tile, side));
+		UINT nbCells = LevelCells(mTiles[nb].Level);
+		for (UINT p = 1; p < cells; ++p)
+		{
+			if ((p * nbCells) % cells != 0)
+				continue;
+
+			UINT q = p * nbCells / cells;
+			UINT r = side == SideNorth ? 0 : side == SideSouth ? cells : p;
+			UINT c = side == SideWest ? 0 : side == SideEast ? cells : p;
+			UINT nbR = side == SideNorth ? nbCells : side == SideSouth ? 0 : q;
+			UINT nbC = side == SideWest ? nbCells : side == SideEast ? 0 : q;
+
+			UINT k = r * (cells + 1) + c;
+			GetTileVertex(nb, nbR, nbC, h[k], nx[k], ny[k], nz[k]);
+		}
+	}
+
+	// Corners come from whichever tile owns them.
+	UINT tx = tile % mDesc.TileCountX;
+	UINT tz = tile / mDesc.TileCountX;
+	for (UINT corner = 0; corner < 4; ++corner)
+	{
+		UINT ci = tz + corner / 2;
+		UINT cj = tx + corner % 2;
+		UINT owner = CornerOwner(ci, cj);
+		UINT ownerCells = LevelCells(mTiles[owner].Level);
+		UINT ownerR = ci == owner / mDesc.TileCountX ? 0 : ownerCells;
+		UINT ownerC = cj == owner % mDesc.TileCountX ? 0 : ownerCells;
+
+		UINT k = (corner / 2) * cells * (cells + 1) + (corner % 2) * cells;
+		GetTileVertex(owner, ownerR, ownerC, h[k], nx[k], ny[k], nz[k]);
+	}
+
+	mTiles[tile].Grid->Kernels().PackCompactVertices(h, nx, ny, nz, count, reinterpret_cast<UINT*>(v));
+}
+
+UINT WaveOcean::TileStitchMask(UINT tile)const
+{
+	static const UINT bits[4] = { StitchNorth, StitchSouth, StitchWest, StitchEast };
+
+	UINT mask = 0;
+	for (UINT s = 0; s < 4; ++s)
+	{
+		int nb = Neighbor(tile, static_cast<Side>(s));
+		if (nb >= 0 && mTiles[nb].Level > mTiles[tile].Level)
+			mask |= bits[s];
+	}
+
+	return mask;
+}
+
+void WaveOcean::GetTileIndices(UINT level, UINT stitchMask, std::vector<UINT>& indices)const
+{
+	UINT cells = LevelCells(level);
+	UINT n = cells + 1;
+
+	// Odd vertices on a stitched edge move onto the even vertex before them, which
+	// collapses half the triangles along the edge and stretches the rest over two
+	// edge segments.
+	auto index = [=](UINT i, UINT j) -> UINT
+	{
+		if ((i == 0 && (stitchMask & StitchNorth)) || (i == cells && (stitchMask & StitchSouth)))
+			j &= ~1u;
+		if ((j == 0 && (stitchMask & StitchWest)) || (j == cells && (stitchMask & StitchEast)))
+			i &= ~1u;
+		return i * n + j;
+	};
+
+	auto addTriangle = [&indices](UINT a, UINT b, UINT c)
+	{
+		if (a != b && b != c && a != c)
+		{
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+	};
+
+	indices.clear();
+	indices.reserve(cells * cells * 6);
+
+	for (UINT i = 0; i < cells; ++i)
+	{
+		for (UINT j = 0; j < cells; ++j)
+		{
+			addTriangle(index(i, j), index(i, j + 1), index(i + 1, j));
+			addTriangle(index(i + 1, j), index(i, j + 1), index(i + 1, j + 1));
+		}
+	}
+}
+
+UINT WaveOcean::SimulatedPointCount()const
+{
+	return mSimulatedPointCount;
+}
+
+UINT WaveOcean::AllocatedPointCount()const
+{
+	UINT count = 0;
+	for (UINT t = 0; t < TileCount(); ++t)
+		count += mTiles[t].Grid->VertexCount();
+
+	return count;
+}
+
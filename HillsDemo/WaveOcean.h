@@ -0,0 +1,204 @@
+//***************************************************************************************
+// WaveOcean.h
+//
+// A large body of water made of square tiles, each simulated by a Waves grid of its
+// own whose resolution depends on how far the tile is from the camera: the finest
+// level near it, half the resolution per level further out, and beyond the freeze
+// distance not stepped at all.  Memory and time per step follow the tiles around the
+// camera rather than the area of the ocean.
+//
+// Each tile grid has a ring of ghost points one grid spacing outside the tile, which
+// the simulation treats as its fixed boundary.  Before every step the ghosts are
+// sampled from the neighboring tiles, so waves run from tile to tile; along the edge
+// of the ocean they stay flat and reflect the waves.  The points on the tile edges are
+// simulated by both tiles sharing them.
+//
+// Neighboring tiles differ by at most one level.  A tile draws with an index list
+// that skips every other vertex along the edges it shares with a coarser tile, and
+// the vertices on every shared edge are taken from one of the tiles, so the surface
+// has neither T-junctions nor cracks.
+//
+// Tiles are stepped in parallel on the thread pool, one task per tile.
+//***************************************************************************************
+
+#ifndef WAVEOCEAN_H
+#define WAVEOCEAN_H
+
+#include <Windows.h>
+#include <DirectXMath.h>
+
+#include <memory>
+#include <vector>
+
+#include "Waves.h"
+
+class ThreadPool;
+
+struct WaveOceanDesc
+{
+	// Tiles along x and z, and the side of a tile in meters.  The ocean is centered
+	// on the origin.
+	UINT TileCountX;
+	UINT TileCountZ;
+	float TileSize;
+
+	// Grid cells along the side of a tile at the finest level, a power of two.  Level
+	// l has TileCells >> l of them; the coarsest level must keep at least 4.
+	UINT TileCells;
+	UINT LevelCount;
+
+	// Tiles closer to the camera than LevelDistance are at level 0, those closer than
+	// twice that at level 1, four times that at level 2 and so on.  Tiles further away
+	// than FreezeDistance keep the waves they have but are no longer stepped.
+	float LevelDistance;
+	float FreezeDistance;
+
+	// Waves::Init() parameters shared by every tile.  The time step must be stable on
+	// the finest grid.
+	float TimeStep;
+	float Speed;
+	float Damping;
+};
+
+class WaveOcean
+{
+public:
+	WaveOcean();
+	~WaveOcean();
+
+	void Init(const WaveOceanDesc& desc);
+
+	// Picks the level of every tile for the given camera position, then runs the time
+	// steps dt owes, like Waves::Update().
+	void Update(float dt, const DirectX::XMFLOAT3& eyePos);
+
+	// Same as Waves::SetMaxStepsPerUpdate().
+	void SetMaxStepsPerUpdate(UINT maxSteps);
+
+	// Queues a disturbance at world position (x, z) with a radius in meters for the
+	// tile under it; see Waves::DisturbBatch().  Disturbances of frozen tiles and off
+	// the ocean are dropped.  From the thread calling Update() only.
+	bool Disturb(float x, float z, float magnitude, float radius, WaveFootprint footprint);
+
+	// Runs the tiles on the given pool, null runs them on the calling thread.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+	UINT TileCount()const { return static_cast<UINT>(mTiles.size()); }
+	UINT TileCountX()const { return mDesc.TileCountX; }
+	UINT TileCountZ()const { return mDesc.TileCountZ; }
+	UINT LevelCount()const { return mDesc.LevelCount; }
+
+	// Tiles are numbered row by row, starting in the north-west (-x, +z) corner.
+	UINT TileLevel(UINT tile)const { return mTiles[tile].Level; }
+	bool IsTileFrozen(UINT tile)const { return mTiles[tile].Frozen; }
+	DirectX::XMFLOAT2 TileCenter(UINT tile)const;
+
+	// Incremented whenever the vertices of the tile change, which includes a change
+	// of its level or of the edges it takes from its neighbors.
+	UINT TileRevision(UINT tile)const { return mTiles[tile].Revision; }
+
+	// Vertices of a tile: (cells + 1)^2 of them for the cells of its level, row by row
+	// from north to south.  The grid vertices hold world positions and texture
+	// coordinates of one repeat per tile; they only change with the level.
+	UINT TileVertexCount(UINT tile)const;
+	void EmitTileGridVertices(UINT tile, Vertex::WaveGrid* v)const;
+	void EmitTileVertices(UINT tile, Vertex::WaveCompact* v);
+
+	// Which edges of the tile have a coarser neighbor, as StitchNorth | StitchSouth |
+	// StitchWest | StitchEast.
+	enum StitchEdge
+	{
+		StitchNorth = 1,
+		StitchSouth = 2,
+		StitchWest = 4,
+		StitchEast = 8
+	};
+	UINT TileStitchMask(UINT tile)const;
+
+	// Triangle list for a tile at the given level whose stitched edges skip every other
+	// vertex.  There are LevelCount() * 16 different lists, so they can all be built
+	// once up front.
+	void GetTileIndices(UINT level, UINT stitchMask, std::vector<UINT>& indices)const;
+
+	// Grid points the last Update() stepped, and grid points held in memory.
+	UINT SimulatedPointCount()const;
+	UINT AllocatedPointCount()const;
+
+private:
+	WaveOcean(const WaveOcean& rhs);
+	WaveOcean& operator=(const WaveOcean& rhs);
+
+	enum Side
+	{
+		SideNorth = 0,
+		SideSouth = 1,
+		SideWest = 2,
+		SideEast = 3
+	};
+
+	struct Tile
+	{
+		Tile();
+
+		std::unique_ptr<Waves> Grid;
+		UINT Level;
+		bool Frozen;
+		UINT Revision;
+	};
+
+	// Cells along the side of a tile at the given level.
+	UINT LevelCells(UINT level)const { return mDesc.TileCells >> level; }
+
+	// Level of a tile at the given distance from the camera; see WaveOceanDesc.
+	UINT LevelForDistance(float distance)const;
+
+	// Picks the level and frozen state of every tile and rebuilds the grids whose
+	// level changed.  A tile only coarsens or freezes once the camera is 10% further
+	// away than the distance at which it would, so tiles near a threshold do not
+	// switch back and forth.  Tiles are then refined until no two neighbors differ by
+	// more than one level.
+	void UpdateLevels(const DirectX::XMFLOAT3& eyePos);
+
+	// (Re)creates the grid of a tile at its level, carrying the waves over from the
+	// grid it had.
+	void BuildTileGrid(UINT tile);
+
+	// Neighbor of a tile on the given side, or -1 off the ocean.
+	int Neighbor(UINT tile, Side side)const;
+
+	// Bumps the revision of the tile and of the eight around it, which take edges or
+	// corners from it.
+	void TouchNeighborhood(UINT tile);
+
+	// Samples the ghost points of every stepped tile from its neighbors.
+	void ExchangeBoundaries(const std::vector<UINT>& steppedTiles);
+
+	// The tile whose vertex is used at corner (ci, cj) of the tile lattice, and for the
+	// edge a tile shares with its neighbor on the given side: the coarser one, and on
+	// a tie the northern or western one.
+	UINT CornerOwner(UINT ci, UINT cj)const;
+	bool OwnsEdge(UINT tile, Side side)const;
+
+	// Height and normal of vertex (r, c) of the (cells + 1)^2 vertices of a tile.
+	void GetTileVertex(UINT tile, UINT r, UINT c, float& h, float& nx, float& ny, float& nz)const;
+
+
+private:
+	WaveOceanDesc mDesc;
+	std::vector<Tile> mTiles;
+
+	float mTimeAccumulator;
+	UINT mMaxStepsPerUpdate;
+	UINT mSimulatedPointCount;
+
+	ThreadPool* mThreadPool;
+
+	// Probe positions, or the vertices of a tile being emitted, per thread.
+	std::vector<std::vector<float>> mScratch;
+
+	// Ghost heights sampled for each stepped tile, its north, south, west and east
+	// sides one after the other.
+	std::vector<std::vector<float>> mGhosts;
+};
+
+#endif // WAVEOCEAN_H
@@ -7,13 +7,26 @@
 //=======================================================================================
 
 #include "Waves.h"
+#include "Vertex.h"
+
+#include <CpuFeatures.h>
+#include <ThreadPool.h>
 
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstring>
 
 using namespace DirectX;
 
+// PackVertices writes 8 (Basic32) or 6 (PosNormal) tightly packed floats per vertex.
+static_assert(sizeof(Vertex::Basic32) == 8 * sizeof(float), "unexpected Vertex::Basic32 layout");
+static_assert(sizeof(Vertex::PosNormal) == 6 * sizeof(float), "unexpected Vertex::PosNormal layout");
+
+// PackCompactVertices writes two 32-bit words per vertex.
+static_assert(sizeof(Vertex::WaveCompact) == 2 * sizeof(UINT), "unexpected Vertex::WaveCompact layout");
+
 Waves::Waves()
 	: mNumRows(0),
 	  mNumCols(0),
@@ -22,21 +35,82 @@ Waves::Waves()
 	  mK1(0.0f),
 	  mK2(0.0f),
 	  mK3(0.0f),
+	  mIntegrator(WaveIntegratorExplicit),
+	  mImplicitK1(0.0f),
+	  mImplicitK2(0.0f),
+	  mImplicitK3(0.0f),
+	  mImplicitBeta(0.0f),
+	  mThomasScale(nullptr),
+	  mThomasCoupling(nullptr),
 	  mTimeStep(0.0f),
 	  mSpatialStep(0.0f),
-	  mPrevSolution(nullptr),
-	  mCurrSolution(nullptr),
-	  mNormals(nullptr),
-	  mTangentX(nullptr)
+	  mTimeAccumulator(0.0f),
+	  mMaxStepsPerUpdate(8),
+	  mHalfWidth(0.0f),
+	  mHalfDepth(0.0f),
+	  mPrevHeights(nullptr),
+	  mCurrHeights(nullptr),
+	  mNormalX(nullptr),
+	  mNormalY(nullptr),
+	  mNormalZ(nullptr),
+	  mTangentXx(nullptr),
+	  mTangentXy(nullptr),
+	  mColumnX(nullptr),
+	  mColumnU(nullptr),
+	  mRowV(nullptr),
+	  mRevision(0),
+	  mKernels(&SelectWaveKernels()),
+	  mThreadPool(nullptr),
+	  mTemporalBlockDepth(4),
+	  mNextPrevHeights(nullptr),
+	  mNextCurrHeights(nullptr),
+	  mImplicitWork(nullptr),
+	  mTrackActivity(false),
+	  mSleepThreshold(1e-3f),
+	  mTileRowCount(0),
+	  mTileColCount(0),
+	  mImpulseQueue(ImpulseQueueCapacity)
 {
 }
 
 Waves::~Waves()
 {
-	delete[] mPrevSolution;
-	delete[] mCurrSolution;
-	delete[] mNormals;
-	delete[] mTangentX;
+	Release();
+}
+
+void Waves::Release()
+{
+	delete[] mPrevHeights;
+	delete[] mCurrHeights;
+	delete[] mNormalX;
+	delete[] mNormalY;
+	delete[] mNormalZ;
+	delete[] mTangentXx;
+	delete[] mTangentXy;
+	delete[] mColumnX;
+	delete[] mColumnU;
+	delete[] mRowV;
+	delete[] mNextPrevHeights;
+	delete[] mNextCurrHeights;
+	delete[] mThomasScale;
+	delete[] mThomasCoupling;
+	delete[] mImplicitWork;
+
+	mPrevHeights = nullptr;
+	mCurrHeights = nullptr;
+	mNormalX = nullptr;
+	mNormalY = nullptr;
+	mNormalZ = nullptr;
+	mTangentXx = nullptr;
+	mTangentXy = nullptr;
+	mColumnX = nullptr;
+	mColumnU = nullptr;
+	mRowV = nullptr;
+	mNextPrevHeights = nullptr;
+	mNextCurrHeights = nullptr;
+	mThomasScale = nullptr;
+	mThomasCoupling = nullptr;
+	mImplicitWork = nullptr;
 }
 
 UINT Waves::RowCount()const
@@ -79,6 +153,7 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 
 	mTimeStep = dt;
 	mSpatialStep = dx;
+	mTimeAccumulator = 0.0f;
 
 	float d = damping * dt + 2.0f;
 	float e = (speed * speed) * (dt * dt) / (dx * dx);
@@ -86,115 +161,1023 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 	mK2 = (4.0f - 8.0f * e) / d;
 	mK3 = (2.0f * e) / d;
 
+	// The implicit step solves for w = next - 2 curr + prev:
+	//   (1 + damping dt / 2 - e/4 L) w = e L curr - damping dt (curr - prev)
+	// with L the five point Laplacian on a unit grid, and factors the left side into
+	// (1 - beta Lx)(1 - beta Lz) times 1 + damping dt / 2.
+	float a = 1.0f + 0.5f * damping * dt;
+	mImplicitK1 = damping * dt / a;
+	mImplicitK2 = -4.0f * e / a - mImplicitK1;
+	mImplicitK3 = e / a;
+	mImplicitBeta = 0.25f * e / a;
+
 	// In case Init() called again.
-	delete[] mPrevSolution;
-	delete[] mCurrSolution;
-	delete[] mNormals;
-	delete[] mTangentX;
+	Release();
+
+	UINT length = std::max(m, n) - 2;
+	mThomasScale = new float[length];
+	mThomasCoupling = new float[length];
+
+	double coupling = 0.0;
+	for (UINT r = 0; r < length; ++r)
+	{
+		double scale = 1.0 / (1.0 + 2.0 * mImplicitBeta - mImplicitBeta * coupling);
+		coupling = mImplicitBeta * scale;
+		mThomasScale[r] = static_cast<float>(scale);
+		mThomasCoupling[r] = static_cast<float>(coupling);
+	}
+
+	mPrevHeights = new float[m * n];
+	mCurrHeights = new float[m * n];
+	mNormalX = new float[m * n];
+	mNormalY = new float[m * n];
+	mNormalZ = new float[m * n];
+	mTangentXx = new float[m * n];
+	mTangentXy = new float[m * n];
+	mColumnX = new float[n];
+	mColumnU = new float[n];
+	mRowV = new float[m];
+
+	// The grid x/z coordinates are not stored; GridX() and GridZ() derive them.
+	mHalfWidth = (n - 1) * dx * 0.5f;
+	mHalfDepth = (m - 1) * dx * 0.5f;
 
-	mPrevSolution = new XMFLOAT3[m * n];
-	mCurrSolution = new XMFLOAT3[m * n];
-	mNormals = new XMFLOAT3[m * n];
-	mTangentX = new XMFLOAT3[m * n];
+	std::fill(mPrevHeights, mPrevHeights + m * n, 0.0f);
+	std::fill(mCurrHeights, mCurrHeights + m * n, 0.0f);
+	std::fill(mNormalX, mNormalX + m * n, 0.0f);
+	std::fill(mNormalY, mNormalY + m * n, 1.0f);
+	std::fill(mNormalZ, mNormalZ + m * n, 0.0f);
+	std::fill(mTangentXx, mTangentXx + m * n, 1.0f);
+	std::fill(mTangentXy, mTangentXy + m * n, 0.0f);
 
-	// Generate grid vertices in system memory.
+	// Derive tex-coords in [0,1] from position.
+	for (UINT j = 0; j < n; ++j)
+	{
+		mColumnX[j] = GridX(j);
+		mColumnU[j] = 0.5f + mColumnX[j] / Width();
+	}
 
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
 	for (UINT i = 0; i < m; ++i)
+		mRowV[i] = 0.5f - GridZ(i) / Depth();
+
+	++mRevision;
+
+	// Everything is flat, so no tile is active yet.
+	mTileRowCount = (m + ActivityTileSize - 1) / ActivityTileSize;
+	mTileColCount = (n + ActivityTileSize - 1) / ActivityTileSize;
+	mTileState.assign(mTileRowCount * mTileColCount, 0);
+	mTileRevision.assign(mTileRowCount * mTileColCount, mRevision);
+	mAwakeTiles.clear();
+}
+
+void Waves::SetTemporalBlocking(UINT maxStepsPerTile)
+{
+	mTemporalBlockDepth = std::max(maxStepsPerTile, 1u);
+}
+
+void Waves::SetIntegrator(WaveIntegrator integrator)
+{
+	// The implicit integrator ignored the activity tiles.
+	if (integrator == WaveIntegratorExplicit && mIntegrator != WaveIntegratorExplicit && mTrackActivity)
+		WakeAllTiles();
+
+	mIntegrator = integrator;
+}
+
+void Waves::SetMaxStepsPerUpdate(UINT maxSteps)
+{
+	mMaxStepsPerUpdate = std::max(maxSteps, 1u);
+}
+
+void Waves::Update(float dt)
+{
+	// Accumulate time; time does not run backwards.
+	mTimeAccumulator += std::max(dt, 0.0f);
+
+	// Run as many whole time steps as fit into the accumulated time, up to the cap.
+	// The steps owed are capped before they are converted, as a long frame can owe
+	// more than a UINT holds, and a dt that is not a number owes the cap.
+	float stepsOwed = mTimeAccumulator / mTimeStep;
+	UINT numSteps;
+	if (!(stepsOwed < mMaxStepsPerUpdate + 1.0f))
+	{
+		numSteps = mMaxStepsPerUpdate;
+		mTimeAccumulator = 0.0f;
+	}
+	else
+	{
+		numSteps = static_cast<UINT>(stepsOwed);
+		if (numSteps == 0)
+			return;
+
+		// Keep the remainder; rounding must not push it out of [0, mTimeStep).
+		mTimeAccumulator -= numSteps * mTimeStep;
+		mTimeAccumulator = std::min(std::max(mTimeAccumulator, 0.0f), mTimeStep);
+	}
+
+	Step(numSteps);
+}
+
+void Waves::Step(UINT numSteps)
+{
+	if (numSteps == 0)
+		return;
+
+	++mRevision;
+
+	ApplyImpulses();
+
+	// Temporal blocking amortizes the sweep over several steps, so hand it as many
+	// of them as it takes at once.  It works on the whole grid, so it is not used
+	// when only active tiles are stepped.
+	while (numSteps > 0)
+	{
+		if (mIntegrator == WaveIntegratorImplicit)
+		{
+			StepImplicit();
+			--numSteps;
+		}
+		else if (mTrackActivity)
+		{
+			StepActiveTiles();
+			--numSteps;
+		}
+		else if (numSteps > 1 && mTemporalBlockDepth > 1)
+		{
+			UINT depth = std::min(numSteps, mTemporalBlockDepth);
+			StepTemporalBlocked(depth);
+			numSteps -= depth;
+		}
+		else
+		{
+			StepFused();
+			--numSteps;
+		}
+	}
+
+	if (!mTrackActivity || mIntegrator == WaveIntegratorImplicit)
+		MarkAllTilesChanged();
+}
+
+void Waves::StepFused()
+{
+	// Only update interior points; we use zero boundary conditions.
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k).  The new solution
+	// is written over the previous one, see WaveKernels.h.
+	//
+	// Each band only writes its own rows of the previous buffer and reads the
+	// current buffer, including one halo row above and below the band that
+	// belongs to its neighbors.  The current buffer is not written until the
+	// swap below, after every band has finished, so the bands can run in any
+	// order on any thread.
+	//
+	// The normals of a row need the new heights of the rows above and below it,
+	// so inside a band they trail the height update by one row.  The first and
+	// last row of a band depend on the neighboring bands and are done once all
+	// bands have finished.
+	ThreadPool::Run(mThreadPool, BandCount(), [this](UINT b, UINT)
+	{
+		UINT row0, row1;
+		GetBandRows(b, row0, row1);
+
+		for (UINT i = row0; i < row1; ++i)
+		{
+			mKernels->StepHeights(mPrevHeights, mCurrHeights, mNumCols,
+				i, i + 1, 1, mNumCols - 1, mK1, mK2, mK3);
+
+			if (i >= row0 + 2)
+				ComputeRowNormals(mPrevHeights, i - 1);
+		}
+	});
+
+	ThreadPool::Run(mThreadPool, BandCount(), [this](UINT b, UINT)
+	{
+		UINT row0, row1;
+		GetBandRows(b, row0, row1);
+
+		ComputeRowNormals(mPrevHeights, row0);
+		if (row1 - 1 > row0)
+			ComputeRowNormals(mPrevHeights, row1 - 1);
+	});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevHeights, mCurrHeights);
+}
+
+void Waves::StepImplicit()
+{
+	UINT m = mNumRows;
+	UINT n = mNumCols;
+
+	if (mImplicitWork == nullptr)
+	{
+		// The boundary is never written; w stays zero there like the heights.
+		mImplicitWork = new float[m * n];
+		std::fill(mImplicitWork, mImplicitWork + m * n, 0.0f);
+	}
+
+	mTileScratch.resize(ThreadCount());
+	for (size_t i = 0; i < mTileScratch.size(); ++i)
+	{
+		if (mTileScratch[i].size() < SolveRows * (n - 2))
+			mTileScratch[i].resize(SolveRows * (n - 2));
+	}
+
+	// Unlike explicit waves, the implicit solution reaches every point of the grid at
+	// once and fades towards zero far from the waves, so every task runs with
+	// denormals flushed.
+	//
+	// Right-hand side, which has the same form as an explicit step from prev.
+	ThreadPool::Run(mThreadPool, BandCount(), [this, n](UINT b, UINT)
+	{
+		ScopedFlushDenormals flush;
+
+		UINT row0, row1;
+		GetBandRows(b, row0, row1);
+
+		memcpy(mImplicitWork + row0 * n, mPrevHeights + row0 * n, (row1 - row0) * n * sizeof(float));
+		mKernels->StepHeights(mImplicitWork, mCurrHeights, n, row0, row1, 1, n - 1,
+			mImplicitK1, mImplicitK2, mImplicitK3);
+	});
+
+	// Solve down the columns of the interior, a block of columns per task.
+	ThreadPool::Run(mThreadPool, (n - 2 + SolveColumns - 1) / SolveColumns, [this, m, n](UINT t, UINT)
 	{
-		float z = halfDepth - i * dx;
-		for (UINT j = 0; j < n; ++j)
+		ScopedFlushDenormals flush;
+
+		UINT col0 = 1 + t * SolveColumns;
+		WaveTridiagonal sys = { mImplicitWork + n + col0, n, std::min(SolveColumns, n - 1 - col0), m - 2,
+			mImplicitBeta, mThomasScale, mThomasCoupling };
+		mKernels->SolveTridiagonal(sys);
+	});
+
+	// Solve along the rows.  Each block of rows is transposed into scratch so the
+	// same column solver applies, and on the way back w becomes the new solution,
+	// written over the previous one.
+	ThreadPool::Run(mThreadPool, (m - 2 + SolveRows - 1) / SolveRows, [this, m, n](UINT t, UINT thread)
+	{
+		ScopedFlushDenormals flush;
+
+		UINT row0 = 1 + t * SolveRows;
+		UINT rowCount = std::min(SolveRows, m - 1 - row0);
+		float* block = &mTileScratch[thread][0];
+
+		for (UINT r = 0; r < rowCount; ++r)
 		{
-			float x = -halfWidth + j * dx;
+			const float* w = mImplicitWork + (row0 + r) * n + 1;
+			for (UINT j = 0; j < n - 2; ++j)
+				block[j * SolveRows + r] = w[j];
+		}
 
-			mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		WaveTridiagonal sys = { block, SolveRows, rowCount, n - 2,
+			mImplicitBeta, mThomasScale, mThomasCoupling };
+		mKernels->SolveTridiagonal(sys);
+
+		for (UINT r = 0; r < rowCount; ++r)
+		{
+			UINT k = (row0 + r) * n + 1;
+			float* prev = mPrevHeights + k;
+			const float* curr = mCurrHeights + k;
+			for (UINT j = 0; j < n - 2; ++j)
+				prev[j] = block[j * SolveRows + r] + 2.0f * curr[j] - prev[j];
 		}
+	});
+
+	ThreadPool::Run(mThreadPool, BandCount(), [this](UINT b, UINT)
+	{
+		ScopedFlushDenormals flush;
+
+		UINT row0, row1;
+		GetBandRows(b, row0, row1);
+
+		for (UINT i = row0; i < row1; ++i)
+			ComputeRowNormals(mPrevHeights, i);
+	});
+
+	std::swap(mPrevHeights, mCurrHeights);
+}
+
+void Waves::StepTemporalBlocked(UINT depth)
+{
+	UINT m = mNumRows;
+	UINT n = mNumCols;
+
+	// A tile advanced depth steps needs depth rings of halo for the heights, plus
+	// one more so its normals can be computed from the final heights.
+	UINT halo = depth + 1;
+	UINT maxWindowSize = (TileRows + 2 * halo) * (TileCols + 2 * halo);
+
+	if (mNextPrevHeights == nullptr)
+	{
+		// The boundary is never written, so it must start out as the solution's; the
+		// interiors are overwritten below.
+		mNextPrevHeights = new float[m * n];
+		mNextCurrHeights = new float[m * n];
+		std::copy(mPrevHeights, mPrevHeights + m * n, mNextPrevHeights);
+		std::copy(mCurrHeights, mCurrHeights + m * n, mNextCurrHeights);
+	}
+
+	mTileScratch.resize(ThreadCount());
+	for (size_t i = 0; i < mTileScratch.size(); ++i)
+	{
+		if (mTileScratch[i].size() < 2 * maxWindowSize)
+			mTileScratch[i].resize(2 * maxWindowSize);
 	}
+
+	UINT tilesX = (n - 2 + TileCols - 1) / TileCols;
+	UINT tilesY = (m - 2 + TileRows - 1) / TileRows;
+
+	ThreadPool::Run(mThreadPool, tilesX * tilesY, [&](UINT tile, UINT thread)
+	{
+		// Interior rectangle owned by this tile.
+		UINT tr0 = 1 + (tile / tilesX) * TileRows;
+		UINT tc0 = 1 + (tile % tilesX) * TileCols;
+		UINT tr1 = std::min(tr0 + TileRows, m - 1);
+		UINT tc1 = std::min(tc0 + TileCols, n - 1);
+
+		// The tile plus its halo, clipped to the grid.
+		UINT wr0 = tr0 > halo ? tr0 - halo : 0;
+		UINT wc0 = tc0 > halo ? tc0 - halo : 0;
+		UINT wr1 = std::min(tr1 + halo, m);
+		UINT wc1 = std::min(tc1 + halo, n);
+		UINT pitch = wc1 - wc0;
+		UINT windowSize = (wr1 - wr0) * pitch;
+
+		float* prev = &mTileScratch[thread][0];
+		float* curr = prev + windowSize;
+
+		for (UINT i = wr0; i < wr1; ++i)
+		{
+			std::copy(mPrevHeights + i * n + wc0, mPrevHeights + i * n + wc1, prev + (i - wr0) * pitch);
+			std::copy(mCurrHeights + i * n + wc0, mCurrHeights + i * n + wc1, curr + (i - wr0) * pitch);
+		}
+
+		// Every step the region with a valid solution shrinks by one point on each
+		// side that is not clipped by the grid.  Along the grid boundary the zero
+		// boundary condition keeps it valid.
+		for (UINT s = 1; s <= depth; ++s)
+		{
+			UINT r0 = wr0 == 0 ? 1 : s;
+			UINT c0 = wc0 == 0 ? 1 : s;
+			UINT r1 = wr1 == m ? wr1 - wr0 - 1 : wr1 - wr0 - s;
+			UINT c1 = wc1 == n ? pitch - 1 : pitch - s;
+
+			mKernels->StepHeights(prev, curr, pitch, r0, r1, c0, c1, mK1, mK2, mK3);
+			std::swap(prev, curr);
+		}
+
+		for (UINT i = tr0; i < tr1; ++i)
+		{
+			const float* srcPrev = prev + (i - wr0) * pitch + (tc0 - wc0);
+			const float* srcCurr = curr + (i - wr0) * pitch + (tc0 - wc0);
+			std::copy(srcPrev, srcPrev + (tc1 - tc0), mNextPrevHeights + i * n + tc0);
+			std::copy(srcCurr, srcCurr + (tc1 - tc0), mNextCurrHeights + i * n + tc0);
+		}
+
+		// The final heights are valid one point beyond the tile, which is all the
+		// normals need.
+		UINT k = tr0 * n + tc0;
+		WaveNormalStreams normals = { mNormalX + k, mNormalY + k, mNormalZ + k,
+			mTangentXx + k, mTangentXy + k, n };
+		mKernels->ComputeNormals(curr + (tr0 - wr0) * pitch + (tc0 - wc0), pitch,
+			tr1 - tr0, tc1 - tc0, mSpatialStep, normals);
+	});
+
+	// Nobody wrote the old solution while the tiles read their halos from it; now
+	// the new one takes its place.
+	std::swap(mPrevHeights, mNextPrevHeights);
+	std::swap(mCurrHeights, mNextCurrHeights);
 }
 
-void Waves::Update(float dt)
+void Waves::StepActiveTiles()
 {
-	static float t = 0;
+	// Wake the tiles that are active or next to one.  A tile that falls asleep is
+	// calm and so are its neighbors; flattening it to exactly zero means stepping it
+	// would leave it zero, so it can be skipped until a neighbor wakes it.
+	mAwakeTiles.clear();
+	for (UINT ti = 0; ti < mTileRowCount; ++ti)
+	{
+		for (UINT tj = 0; tj < mTileColCount; ++tj)
+		{
+			UINT t = ti * mTileColCount + tj;
+			if (mTileState[t] & TileLand)
+				continue;
+
+			bool awake = false;
+			for (UINT ni = (ti > 0 ? ti - 1 : 0); ni <= ti + 1 && ni < mTileRowCount; ++ni)
+			{
+				for (UINT nj = (tj > 0 ? tj - 1 : 0); nj <= tj + 1 && nj < mTileColCount; ++nj)
+				{
+					if (mTileState[ni * mTileColCount + nj] & TileActive)
+						awake = true;
+				}
+			}
+
+			if (awake)
+			{
+				mTileState[t] |= TileAwake;
+				mAwakeTiles.push_back(t);
+			}
+			else if (mTileState[t] & TileAwake)
+			{
+				mTileState[t] &= ~TileAwake;
+				FlattenTile(t);
+				mTileRevision[t] = mRevision;
+			}
+		}
+	}
+
+	// Same update as StepFused(), tile by tile.  All heights have to be final before
+	// any normals are computed since neighboring tiles may be skipped.
+	ThreadPool::Run(mThreadPool, static_cast<UINT>(mAwakeTiles.size()), [this](UINT k, UINT)
+	{
+		UINT row0, row1, col0, col1;
+		GetTileRect(mAwakeTiles[k], row0, row1, col0, col1);
 
-	// Accumulate time.
-	t += dt;
+		if (row0 < row1 && col0 < col1)
+			mKernels->StepHeights(mPrevHeights, mCurrHeights, mNumCols, row0, row1, col0, col1, mK1, mK2, mK3);
+	});
 
-	// Only update the simulation at the specified time step.
-	if (t >= mTimeStep)
+	ThreadPool::Run(mThreadPool, static_cast<UINT>(mAwakeTiles.size()), [this](UINT k, UINT)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		for (DWORD i = 1; i < mNumRows - 1; ++i)
+		UINT t = mAwakeTiles[k];
+		UINT row0, row1, col0, col1;
+		GetTileRect(t, row0, row1, col0, col1);
+
+		// Largest height in the old or new solution decides whether the tile stays
+		// active.
+		float energy = 0.0f;
+		if (row0 < row1 && col0 < col1)
 		{
-			for (DWORD j = 1; j < mNumCols - 1; ++j)
+			UINT k0 = row0 * mNumCols + col0;
+			WaveNormalStreams normals = { mNormalX + k0, mNormalY + k0, mNormalZ + k0,
+				mTangentXx + k0, mTangentXy + k0, mNumCols };
+			mKernels->ComputeNormals(mPrevHeights + k0, mNumCols, row1 - row0, col1 - col0, mSpatialStep, normals);
+
+			for (UINT i = row0; i < row1; ++i)
 			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i * mNumCols + j].y =
-					mK1 * mPrevSolution[i * mNumCols + j].y +
-					mK2 * mCurrSolution[i * mNumCols + j].y +
-					mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-						mCurrSolution[(i - 1) * mNumCols + j].y +
-						mCurrSolution[i * mNumCols + j + 1].y +
-						mCurrSolution[i * mNumCols + j - 1].y);
+				for (UINT j = col0; j < col1; ++j)
+				{
+					energy = std::max(energy, fabsf(mPrevHeights[i * mNumCols + j]));
+					energy = std::max(energy, fabsf(mCurrHeights[i * mNumCols + j]));
+				}
 			}
 		}
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+		if (energy >= mSleepThreshold)
+			mTileState[t] |= TileActive;
+		else
+			mTileState[t] &= ~TileActive;
+
+		mTileRevision[t] = mRevision;
+	});
+
+	std::swap(mPrevHeights, mCurrHeights);
+}
+
+void Waves::FlattenTile(UINT t)
+{
+	UINT row0, row1, col0, col1;
+	GetTileRect(t, row0, row1, col0, col1);
+
+	for (UINT i = row0; i < row1; ++i)
+	{
+		UINT k0 = i * mNumCols + col0;
+		UINT k1 = i * mNumCols + col1;
+		std::fill(mPrevHeights + k0, mPrevHeights + k1, 0.0f);
+		std::fill(mCurrHeights + k0, mCurrHeights + k1, 0.0f);
+		std::fill(mNormalX + k0, mNormalX + k1, 0.0f);
+		std::fill(mNormalY + k0, mNormalY + k1, 1.0f);
+		std::fill(mNormalZ + k0, mNormalZ + k1, 0.0f);
+		std::fill(mTangentXx + k0, mTangentXx + k1, 1.0f);
+		std::fill(mTangentXy + k0, mTangentXy + k1, 0.0f);
+	}
+}
+
+void Waves::GetTileRect(UINT t, UINT& row0, UINT& row1, UINT& col0, UINT& col1)const
+{
+	UINT ti = t / mTileColCount;
+	UINT tj = t % mTileColCount;
+
+	row0 = std::max(ti * ActivityTileSize, 1u);
+	row1 = std::min((ti + 1) * ActivityTileSize, mNumRows - 1);
+	col0 = std::max(tj * ActivityTileSize, 1u);
+	col1 = std::min((tj + 1) * ActivityTileSize, mNumCols - 1);
+}
+
+void Waves::MarkAllTilesChanged()
+{
+	std::fill(mTileRevision.begin(), mTileRevision.end(), mRevision);
+}
+
+void Waves::SetActivityTracking(bool enable)
+{
+	// The solution may be anything by now; let the tiles find out for themselves
+	// whether they are calm.
+	if (enable && !mTrackActivity)
+		WakeAllTiles();
+
+	mTrackActivity = enable;
+}
+
+void Waves::WakeAllTiles()
+{
+	for (size_t t = 0; t < mTileState.size(); ++t)
+	{
+		if (!(mTileState[t] & TileLand))
+			mTileState[t] |= TileActive | TileAwake;
+	}
+}
+
+void Waves::SetSleepThreshold(float threshold)
+{
+	mSleepThreshold = threshold;
+}
 
-		t = 0.0f; // reset time
+void Waves::SetLandMask(const std::function<bool(float x, float z)>& isLand)
+{
+	++mRevision;
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		for (UINT i = 1; i < mNumRows - 1; ++i)
+	for (UINT ti = 0; ti < mTileRowCount; ++ti)
+	{
+		for (UINT tj = 0; tj < mTileColCount; ++tj)
 		{
-			for (UINT j = 1; j < mNumCols - 1; ++j)
+			UINT t = ti * mTileColCount + tj;
+			UINT row1 = std::min((ti + 1) * ActivityTileSize, mNumRows);
+			UINT col1 = std::min((tj + 1) * ActivityTileSize, mNumCols);
+
+			bool land = true;
+			for (UINT i = ti * ActivityTileSize; i < row1 && land; ++i)
 			{
-				float l = mCurrSolution[i * mNumCols + j - 1].y;
-				float r = mCurrSolution[i * mNumCols + j + 1].y;
-				float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-				float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-				mNormals[i * mNumCols + j].x = -r + l;
-				mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-				mNormals[i * mNumCols + j].z = b - t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-				XMStoreFloat3(&mNormals[i * mNumCols + j], n);
-
-				mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-				XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
+				for (UINT j = tj * ActivityTileSize; j < col1 && land; ++j)
+					land = isLand(GridX(j), GridZ(i));
+			}
+
+			if (land)
+			{
+				mTileState[t] = TileLand;
+				FlattenTile(t);
+				mTileRevision[t] = mRevision;
+			}
+			else
+			{
+				mTileState[t] &= ~TileLand;
 			}
 		}
 	}
 }
 
+UINT Waves::ActiveTileCount()const
+{
+	UINT count = 0;
+	for (size_t t = 0; t < mTileState.size(); ++t)
+	{
+		if (mTileState[t] & TileActive)
+			++count;
+	}
+
+	return count;
+}
+
+bool Waves::GetRowsChangedSince(UINT revision, UINT& row0, UINT& row1)const
+{
+	row0 = mNumRows;
+	row1 = 0;
+
+	for (UINT ti = 0; ti < mTileRowCount; ++ti)
+	{
+		for (UINT tj = 0; tj < mTileColCount; ++tj)
+		{
+			// Revisions may wrap around.
+			if (static_cast<int>(mTileRevision[ti * mTileColCount + tj] - revision) > 0)
+			{
+				row0 = std::min(row0, ti * ActivityTileSize);
+				row1 = std::max(row1, std::min((ti + 1) * ActivityTileSize, mNumRows));
+				break;
+			}
+		}
+	}
+
+	return row0 < row1;
+}
+
+void Waves::ComputeRowNormals(const float* heights, UINT i)
+{
+	UINT k = i * mNumCols + 1;
+	WaveNormalStreams normals = { mNormalX + k, mNormalY + k, mNormalZ + k,
+		mTangentXx + k, mTangentXy + k, mNumCols };
+	mKernels->ComputeNormals(heights + k, mNumCols, 1, mNumCols - 2, mSpatialStep, normals);
+}
+
+UINT Waves::ThreadCount()const
+{
+	return mThreadPool != nullptr ? mThreadPool->ThreadCount() : 1;
+}
+
+UINT Waves::BandCount()const
+{
+	return (mNumRows - 2 + BandRows - 1) / BandRows;
+}
+
+void Waves::GetBandRows(UINT b, UINT& row0, UINT& row1)const
+{
+	row0 = 1 + b * BandRows;
+	row1 = std::min(row0 + BandRows, mNumRows - 1);
+}
+
 void Waves::Disturb(UINT i, UINT j, float magnitude)
 {
 	// Don't disturb boundaries.
 	assert(i > 1 && i < mNumRows - 2);
 	assert(j > 1 && j < mNumCols - 2);
 
+	// Tiles holding the points disturbed below.
+	UINT ti0 = (i - 1) / ActivityTileSize;
+	UINT ti1 = (i + 1) / ActivityTileSize;
+	UINT tj0 = (j - 1) / ActivityTileSize;
+	UINT tj1 = (j + 1) / ActivityTileSize;
+
+	if (mTrackActivity)
+	{
+		for (UINT ti = ti0; ti <= ti1; ++ti)
+		{
+			for (UINT tj = tj0; tj <= tj1; ++tj)
+			{
+				if (mTileState[ti * mTileColCount + tj] & TileLand)
+					return;
+			}
+		}
+	}
+
 	float halfMag = 0.5f * magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i * mNumCols + j].y += magnitude;
-	mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-	mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-	mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-	mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
+	mCurrHeights[i * mNumCols + j] += magnitude;
+	mCurrHeights[i * mNumCols + j + 1] += halfMag;
+	mCurrHeights[i * mNumCols + j - 1] += halfMag;
+	mCurrHeights[(i + 1) * mNumCols + j] += halfMag;
+	mCurrHeights[(i - 1) * mNumCols + j] += halfMag;
+
+	++mRevision;
+
+	for (UINT ti = ti0; ti <= ti1; ++ti)
+	{
+		for (UINT tj = tj0; tj <= tj1; ++tj)
+		{
+			mTileState[ti * mTileColCount + tj] |= TileActive;
+			mTileRevision[ti * mTileColCount + tj] = mRevision;
+		}
+	}
+}
+
+UINT Waves::DisturbBatch(const WaveImpulse* impulses, UINT count)
+{
+	UINT queued = 0;
+	while (queued < count)
+	{
+		UINT pushed = mImpulseQueue.TryPushRange(impulses + queued, count - queued);
+		if (pushed == 0)
+			break;
+		queued += pushed;
+	}
+
+	return queued;
+}
+
+void Waves::ApplyImpulses()
+{
+	// Take what is queued now; impulses queued from here on wait for the next step.
+	mImpulses.clear();
+
+	WaveImpulse impulse;
+	while (mImpulses.size() < ImpulseQueueCapacity && mImpulseQueue.TryPop(impulse))
+		mImpulses.push_back(impulse);
+
+	if (mImpulses.empty())
+		return;
+
+	// Find what each impulse reaches once, dropping those that reach nothing, and wake
+	// the tiles they reach.  The tiles are done up front because tiles and bands do not
+	// line up, so several bands may touch one tile.
+	mImpulseBounds.resize(mImpulses.size());
+	size_t kept = 0;
+	UINT64 pointCount = 0;
+	for (size_t k = 0; k < mImpulses.size(); ++k)
+	{
+		ImpulseBounds& bounds = mImpulseBounds[kept];
+		if (!GetImpulseBounds(mImpulses[k], bounds))
+			continue;
+
+		mImpulses[kept++] = mImpulses[k];
+		pointCount += (bounds.Row1 - bounds.Row0 + 1) * (bounds.Col1 - bounds.Col0 + 1);
+
+		for (UINT ti = bounds.Row0 / ActivityTileSize; ti <= bounds.Row1 / ActivityTileSize; ++ti)
+		{
+			for (UINT tj = bounds.Col0 / ActivityTileSize; tj <= bounds.Col1 / ActivityTileSize; ++tj)
+			{
+				UINT t = ti * mTileColCount + tj;
+				if (!(mTileState[t] & TileLand))
+				{
+					mTileState[t] |= TileActive;
+					mTileRevision[t] = mRevision;
+				}
+			}
+		}
+	}
+	mImpulses.resize(kept);
+	mImpulseBounds.resize(kept);
+
+	// Few points are cheaper to add here than to sort into bands.
+	if (mThreadPool == nullptr || pointCount < ParallelImpulsePoints)
+	{
+		for (size_t k = 0; k < mImpulses.size(); ++k)
+			ApplyImpulse(mImpulses[k], mImpulseBounds[k], 0, mNumRows);
+		return;
+	}
+
+	// Otherwise sort the impulses into the bands they reach, keeping their order.
+	mBandImpulses.resize(BandCount());
+	for (size_t b = 0; b < mBandImpulses.size(); ++b)
+		mBandImpulses[b].clear();
+
+	for (size_t k = 0; k < mImpulses.size(); ++k)
+	{
+		const ImpulseBounds& bounds = mImpulseBounds[k];
+		for (UINT b = (bounds.Row0 - 1) / BandRows; b <= (bounds.Row1 - 1) / BandRows; ++b)
+			mBandImpulses[b].push_back(static_cast<UINT>(k));
+	}
+
+	// Each band adds the part of its impulses that falls into its rows, in queue
+	// order, so the result does not depend on the threads.
+	ThreadPool::Run(mThreadPool, BandCount(), [this](UINT b, UINT)
+	{
+		UINT row0, row1;
+		GetBandRows(b, row0, row1);
+
+		const std::vector<UINT>& impulses = mBandImpulses[b];
+		for (size_t k = 0; k < impulses.size(); ++k)
+			ApplyImpulse(mImpulses[impulses[k]], mImpulseBounds[impulses[k]], row0, row1);
+	});
+}
+
+bool Waves::GetImpulseBounds(const WaveImpulse& impulse, ImpulseBounds& bounds)const
+{
+	float i0, i1, j0, j1;
+	if (impulse.Footprint == WaveFootprintPoint5)
+	{
+		float ci = floorf(impulse.Row + 0.5f);
+		float cj = floorf(impulse.Col + 0.5f);
+		i0 = ci - 1.0f;
+		i1 = ci + 1.0f;
+		j0 = cj - 1.0f;
+		j1 = cj + 1.0f;
+	}
+	else
+	{
+		float extent = (impulse.Footprint == WaveFootprintGaussian) ? impulse.Radius : impulse.Radius + 1.0f;
+		i0 = ceilf(impulse.Row - extent);
+		i1 = floorf(impulse.Row + extent);
+		j0 = ceilf(impulse.Col - extent);
+		j1 = floorf(impulse.Col + extent);
+	}
+
+	// Clip to the interior; the boundary stays zero.
+	i0 = std::max(i0, 1.0f);
+	j0 = std::max(j0, 1.0f);
+	i1 = std::min(i1, static_cast<float>(mNumRows - 2));
+	j1 = std::min(j1, static_cast<float>(mNumCols - 2));
+
+	if (!(i0 <= i1 && j0 <= j1))
+		return false;
+
+	bounds.Row0 = static_cast<UINT>(i0);
+	bounds.Row1 = static_cast<UINT>(i1);
+	bounds.Col0 = static_cast<UINT>(j0);
+	bounds.Col1 = static_cast<UINT>(j1);
+	return true;
+}
+
+void Waves::ApplyImpulse(const WaveImpulse& impulse, const ImpulseBounds& bounds, UINT row0, UINT row1)
+{
+	if (impulse.Footprint == WaveFootprintPoint5)
+	{
+		// Same stencil as Disturb().
+		float halfMag = 0.5f * impulse.Magnitude;
+
+		// The common case of a stencil that was not clipped, in these rows and with no
+		// land to check, adds straight to the heights.
+		if (bounds.Row1 - bounds.Row0 == 2 && bounds.Col1 - bounds.Col0 == 2 &&
+			bounds.Row0 >= row0 && bounds.Row1 < row1 && !mTrackActivity)
+		{
+			float* h = mCurrHeights + (bounds.Row0 + 1) * mNumCols + bounds.Col0 + 1;
+			h[0] += impulse.Magnitude;
+			h[1] += halfMag;
+			h[-1] += halfMag;
+			h[mNumCols] += halfMag;
+			h[-static_cast<int>(mNumCols)] += halfMag;
+			return;
+		}
+
+		int i = static_cast<int>(floorf(impulse.Row + 0.5f));
+		int j = static_cast<int>(floorf(impulse.Col + 0.5f));
+
+		AddImpulsePoint(i, j, impulse.Magnitude, row0, row1);
+		AddImpulsePoint(i, j + 1, halfMag, row0, row1);
+		AddImpulsePoint(i, j - 1, halfMag, row0, row1);
+		AddImpulsePoint(i + 1, j, halfMag, row0, row1);
+		AddImpulsePoint(i - 1, j, halfMag, row0, row1);
+		return;
+	}
+
+	UINT i0 = std::max(bounds.Row0, row0);
+	UINT i1 = std::min(bounds.Row1, row1 - 1);
+	UINT j0 = bounds.Col0;
+	UINT j1 = bounds.Col1;
+
+	float radius = std::max(impulse.Radius, 1e-6f);
+	float invRadiusSq = 1.0f / (radius * radius);
+
+	for (UINT i = i0; i <= i1; ++i)
+	{
+		for (UINT j = j0; j <= j1; ++j)
+		{
+			if (mTrackActivity && (mTileState[(i / ActivityTileSize) * mTileColCount + j / ActivityTileSize] & TileLand))
+				continue;
+
+			float di = i - impulse.Row;
+			float dj = j - impulse.Col;
+			float distSq = di * di + dj * dj;
+			float weight = 0.0f;
+
+			if (impulse.Footprint == WaveFootprintGaussian)
+			{
+				// exp(-d^2 / (2 sigma^2)) with sigma = radius / 3.
+				if (distSq <= radius * radius)
+					weight = expf(-4.5f * distSq * invRadiusSq);
+			}
+			else
+			{
+				weight = std::max(0.0f, 1.0f - fabsf(sqrtf(distSq) - impulse.Radius));
+			}
+
+			mCurrHeights[i * mNumCols + j] += impulse.Magnitude * weight;
+		}
+	}
+}
+
+void Waves::AddImpulsePoint(int i, int j, float dh, UINT row0, UINT row1)
+{
+	// Clip to the interior and the band.
+	if (i < 1 || j < 1 || i > static_cast<int>(mNumRows) - 2 || j > static_cast<int>(mNumCols) - 2)
+		return;
+
+	if (static_cast<UINT>(i) < row0 || static_cast<UINT>(i) >= row1)
+		return;
+
+	if (mTrackActivity && (mTileState[(i / ActivityTileSize) * mTileColCount + j / ActivityTileSize] & TileLand))
+		return;
+
+	mCurrHeights[i * mNumCols + j] += dh;
+}
+
+void Waves::SetSolution(const float* prevHeights, const float* currHeights)
+{
+	++mRevision;
+
+	memcpy(mPrevHeights, prevHeights, mVertexCount * sizeof(float));
+	memcpy(mCurrHeights, currHeights, mVertexCount * sizeof(float));
+
+	// The temporal blocking buffers share the boundary; see SetBoundaryHeights().
+	if (mNextPrevHeights != nullptr)
+	{
+		memcpy(mNextPrevHeights, prevHeights, mVertexCount * sizeof(float));
+		memcpy(mNextCurrHeights, currHeights, mVertexCount * sizeof(float));
+	}
+
+	ThreadPool::Run(mThreadPool, BandCount(), [this](UINT b, UINT)
+	{
+		UINT row0, row1;
+		GetBandRows(b, row0, row1);
+
+		for (UINT i = row0; i < row1; ++i)
+			ComputeRowNormals(mCurrHeights, i);
+	});
+
+	if (mTrackActivity)
+		WakeAllTiles();
+
+	MarkAllTilesChanged();
+}
+
+void Waves::SetBoundaryHeights(const float* north, const float* south, const float* west, const float* east)
+{
+	++mRevision;
+
+	UINT m = mNumRows;
+	UINT n = mNumCols;
+
+	// Every height buffer gets the boundary.  The steps swap the buffers around and
+	// only write interiors, so this way the boundary is the same whichever buffer
+	// ends up holding the current solution, and the normals of the new heights
+	// see it too.
+	float* buffers[4] = { mPrevHeights, mCurrHeights, mNextPrevHeights, mNextCurrHeights };
+	for (UINT b = 0; b < 4; ++b)
+	{
+		float* heights = buffers[b];
+		if (heights == nullptr)
+			continue;
+
+		if (north != nullptr)
+			memcpy(heights, north, n * sizeof(float));
+
+		if (south != nullptr)
+			memcpy(heights + (m - 1) * n, south, n * sizeof(float));
+
+		for (UINT i = 0; i < m; ++i)
+		{
+			if (west != nullptr)
+				heights[i * n] = west[i];
+
+			if (east != nullptr)
+				heights[i * n + n - 1] = east[i];
+		}
+	}
+
+	// Only the tiles along the boundary changed.
+	for (UINT ti = 0; ti < mTileRowCount; ++ti)
+	{
+		for (UINT tj = 0; tj < mTileColCount; ++tj)
+		{
+			if (ti == 0 || tj == 0 || ti == mTileRowCount - 1 || tj == mTileColCount - 1)
+				mTileRevision[ti * mTileColCount + tj] = mRevision;
+		}
+	}
+}
+
+WaveSurface Waves::Surface()const
+{
+	WaveSurface surface = { mCurrHeights, mNormalX, mNormalY, mNormalZ, mNumRows, mNumCols,
+		GridX(0), GridZ(0), mSpatialStep };
+	return surface;
+}
+
+void Waves::Sample(const WaveProbes& probes)const
+{
+	mKernels->SampleSurface(Surface(), probes);
+}
+
+void Waves::EmitVertices(Vertex::Basic32* v, UINT row0, UINT row1)const
+{
+	EmitRows(reinterpret_cast<float*>(v), 8, row0, row1);
+}
+
+void Waves::EmitVertices(Vertex::PosNormal* v, UINT row0, UINT row1)const
+{
+	EmitRows(reinterpret_cast<float*>(v), 6, row0, row1);
+}
+
+void Waves::EmitTexCoords(XMFLOAT2* tex)const
+{
+	for (UINT i = 0; i < mNumRows; ++i)
+	{
+		for (UINT j = 0; j < mNumCols; ++j)
+			tex[i * mNumCols + j] = XMFLOAT2(mColumnU[j], mRowV[i]);
+	}
+}
+
+void Waves::EmitGridVertices(Vertex::WaveGrid* v)const
+{
+	for (UINT i = 0; i < mNumRows; ++i)
+	{
+		for (UINT j = 0; j < mNumCols; ++j)
+		{
+			v[i * mNumCols + j].PosXZ = XMFLOAT2(mColumnX[j], GridZ(i));
+			v[i * mNumCols + j].Tex = XMFLOAT2(mColumnU[j], mRowV[i]);
+		}
+	}
+}
+
+void Waves::EmitCompactVertices(Vertex::WaveCompact* v, UINT row0, UINT row1)const
+{
+	assert(row0 <= row1 && row1 <= mNumRows);
+
+	// The rows are contiguous in every stream, so they are packed in one go.
+	UINT k = row0 * mNumCols;
+	mKernels->PackCompactVertices(mCurrHeights + k, mNormalX + k, mNormalY + k, mNormalZ + k,
+		(row1 - row0) * mNumCols, reinterpret_cast<UINT*>(v + k));
+}
+
+void Waves::EmitRows(float* out, UINT stride, UINT row0, UINT row1)const
+{
+	assert(row0 <= row1 && row1 <= mNumRows);
+
+	for (UINT i = row0; i < row1; ++i)
+	{
+		UINT k = i * mNumCols;
+		WaveVertexRow row = { mColumnX, mCurrHeights + k, mNormalX + k, mNormalY + k,
+			mNormalZ + k, mColumnU, GridZ(i), mRowV[i] };
+		mKernels->PackVertices(row, mNumCols, stride, out + k * stride);
+	}
 }
@@ -4,6 +4,30 @@
 // Performs the calculations for the wave simulation.  After the simulation has been
 // updated, the client must copy the current solution into vertex buffers for rendering.
 // This class only does the calculations, it does not do any drawing.
+//
+// The solution is stored as a structure of arrays: the simulation only ever changes
+// the height of a grid point, so the x/z coordinates are derived from the grid and
+// the heights, normals and tangents each live in their own tightly packed stream.
+//
+// A step is a single fused sweep: each band of rows computes the normals of a row as
+// soon as the heights around it are final, while they are still in cache.  When more
+// than one step is due, tiles are advanced several steps at a time in per-thread
+// scratch memory (temporal blocking), so the grid is streamed through memory once
+// per block of steps instead of twice per step.
+//
+// EmitVertices() packs the solution straight into a caller's vertex buffer.  The x/z
+// coordinates and texture coordinates only depend on the grid, so they come from
+// per-column and per-row tables built once in Init().
+//
+// The implicit integrator trades the single sweep of a step for a right-hand side
+// sweep, a batch of tridiagonal solves down the columns and one along the rows (ADI),
+// in exchange for a time step no longer limited by stability.
+//
+// With activity tracking on, the grid is split into ActivityTileSize^2 tiles and only
+// tiles that are active, or next to an active tile, are stepped.  A tile becomes
+// active when it is disturbed and stays active while its heights exceed the sleep
+// threshold.  When neither it nor its neighbors are active any more it is flattened
+// to exactly zero, so skipping it does not change the solution around it.
 //***************************************************************************************
 
 #ifndef WAVES_H
@@ -12,6 +36,63 @@
 #include <Windows.h>
 #include <DirectXMath.h>
 
+#include <functional>
+#include <vector>
+
+#include <MpscQueue.h>
+
+#include "WaveKernels.h"
+
+class ThreadPool;
+
+// Shape of the height change a WaveImpulse makes around its grid point.
+enum WaveFootprint
+{
+	// The point gets the full magnitude, its four neighbors half; what Disturb() does.
+	WaveFootprintPoint5 = 0,
+
+	// Gaussian bump with a standard deviation of Radius / 3, cut off at Radius.
+	WaveFootprintGaussian = 1,
+
+	// Ring of the given Radius, falling off linearly to zero one grid spacing inside
+	// and outside it.
+	WaveFootprintRing = 2
+};
+
+// How Waves advances the solution in time.
+enum WaveIntegrator
+{
+	// The explicit scheme: one cheap sweep per step, but only stable while
+	// speed * dt / dx stays below 1 / sqrt(2).
+	WaveIntegratorExplicit = 0,
+
+	// Alternating direction implicit: the same equation with the Laplacian averaged
+	// over three time levels (weights 1/4, 1/2, 1/4) and factored into an x and a z
+	// solve.  Stable for any time step and without numerical damping, at about twice
+	// the cost of an explicit step.  Large steps still slow down the shortest waves,
+	// so take as large a step as the look of the water allows.
+	WaveIntegratorImplicit = 1
+};
+
+// A disturbance for Waves::DisturbBatch().  Row and Col are grid coordinates and may
+// lie between grid points; Radius is in grid spacings.
+struct WaveImpulse
+{
+	float Row;
+	float Col;
+	float Magnitude;
+	float Radius;
+	WaveFootprint Footprint;
+};
+
+namespace Vertex
+{
+	struct Basic32;
+	struct PosNormal;
+	struct WaveGrid;
+	struct WaveCompact;
+}
+
 class Waves
 {
 public:
@@ -26,18 +107,227 @@ class Waves
 	float Depth()const;
 
 	// Returns the solution at the ith grid point.
-	const DirectX::XMFLOAT3& operator[](int i)const { return mCurrSolution[i]; }
+	DirectX::XMFLOAT3 operator[](int i)const
+	{
+		return DirectX::XMFLOAT3(GridX(i % mNumCols), mCurrHeights[i], GridZ(i / mNumCols));
+	}
 
 	// Returns the solution normal at the ith grid point.
-	const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+	DirectX::XMFLOAT3 Normal(int i)const
+	{
+		return DirectX::XMFLOAT3(mNormalX[i], mNormalY[i], mNormalZ[i]);
+	}
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+	DirectX::XMFLOAT3 TangentX(int i)const
+	{
+		return DirectX::XMFLOAT3(mTangentXx[i], mTangentXy[i], 0.0f);
+	}
+
+	// Returns the x-coordinate of grid column j and the z-coordinate of grid row i.
+	float GridX(UINT j)const { return -mHalfWidth + j * mSpatialStep; }
+	float GridZ(UINT i)const { return mHalfDepth - i * mSpatialStep; }
+
+	// Direct read access to the height stream of the current solution (m*n floats).
+	const float* Heights()const { return mCurrHeights; }
+
+	// Direct read access to the height stream of the previous solution (m*n floats).
+	const float* PreviousHeights()const { return mPrevHeights; }
+
+	// Direct read access to the normal component streams (m*n floats each).
+	const float* NormalsX()const { return mNormalX; }
+	const float* NormalsY()const { return mNormalY; }
+	const float* NormalsZ()const { return mNormalZ; }
+
+	// Replaces the previous and current solution (m*n heights each) and recomputes the
+	// normals, e.g. to carry the waves over to a grid of another resolution.
+	void SetSolution(const float* prevHeights, const float* currHeights);
+
+	// Sets the heights of the boundary rows and columns: north is row 0, south row
+	// m-1, west column 0 and east column n-1, n, m, m and n values.  A null side is
+	// left alone.  The boundary is set in the previous and current solution alike and
+	// holds for every step, of any count and integrator, until it is set again.  This
+	// lets a grid take its boundary from the grid next to it.
+	void SetBoundaryHeights(const float* north, const float* south, const float* west, const float* east);
+
+	// View of the current solution for WaveKernels::SampleSurface(); valid until the
+	// next step.
+	WaveSurface Surface()const;
+
+	// Bilinearly interpolated heights and, unless the normal streams are null, unit
+	// normals of the current solution at probes.Count positions (x, z) in the local
+	// space of the grid.  Positions off the grid take the values at its edge.  Not
+	// while the waves are being stepped; sample a WaveSnapshot for that.
+	void Sample(const WaveProbes& probes)const;
+
+	// Simulated seconds per step, and the dt the next Update() needs to run one.
+	float TimeStep()const { return mTimeStep; }
+	float TimeUntilNextStep()const { return mTimeStep - mTimeAccumulator; }
 
 	void Init(UINT m, UINT n, float dx, float dt, float speed, float damping);
+
+	// Adds dt to the time accumulator and runs every whole time step it owes, at most
+	// SetMaxStepsPerUpdate() of them; the fraction of a step left over carries into
+	// the next call.
 	void Update(float dt);
+
+	// Runs numSteps time steps as one batch, independently of the accumulator.
+	void Step(UINT numSteps);
+
+	// Picks the integrator for the following steps; explicit by default.  The implicit
+	// one always steps the whole grid, so activity tracking and the land mask only
+	// apply to the explicit one.
+	void SetIntegrator(WaveIntegrator integrator);
+	WaveIntegrator Integrator()const { return mIntegrator; }
+
+	// Caps the steps one Update() runs so a long frame cannot make the next one longer
+	// still.  Time beyond the cap is dropped and the simulation runs slow instead.
+	void SetMaxStepsPerUpdate(UINT maxSteps);
+
+	// With activity tracking on, a disturbance that touches a land tile is ignored.
 	void Disturb(UINT i, UINT j, float magnitude);
 
+	// Queues impulses to be applied, in the order they were queued, at the start of
+	// the next step.  May be called from any number of threads, also while the
+	// simulation is stepping.  Footprints are clipped to the interior of the grid and,
+	// with activity tracking on, land tiles.  Returns the number of impulses queued;
+	// the rest are dropped once ImpulseQueueCapacity impulses are waiting.
+	UINT DisturbBatch(const WaveImpulse* impulses, UINT count);
+	static const UINT ImpulseQueueCapacity = 16384;
+
+	// Incremented whenever the solution changes, by a step or a disturbance.  Clients
+	// compare it with the revision they last emitted and skip the upload when nothing
+	// happened since.
+	UINT Revision()const { return mRevision; }
+
+	// Writes position, normal and texture coordinates of the grid points in rows
+	// [row0, row1).  v addresses the vertex of grid point 0, so it can be a mapped
+	// vertex buffer of VertexCount() vertices of which only those rows are touched.
+	void EmitVertices(Vertex::Basic32* v, UINT row0, UINT row1)const;
+	void EmitVertices(Vertex::Basic32* v)const { EmitVertices(v, 0, mNumRows); }
+
+	// Same for a position/normal stream, to be paired with a static texture
+	// coordinate stream that EmitTexCoords() fills once.
+	void EmitVertices(Vertex::PosNormal* v, UINT row0, UINT row1)const;
+	void EmitTexCoords(DirectX::XMFLOAT2* tex)const;
+
+	// Compact output: a quarter of the bytes of Vertex::Basic32.  The static grid
+	// stream is written once; the compact stream holds the height as a half float and
+	// the normal as R10G10B10A2, about 3 significant decimal digits each.  The
+	// simulation itself stays in 32-bit floats, which it needs to remain stable.
+	void EmitGridVertices(Vertex::WaveGrid* v)const;
+	void EmitCompactVertices(Vertex::WaveCompact* v, UINT row0, UINT row1)const;
+
+	// Only steps the tiles around disturbances; see the top of this file.  Off by
+	// default.  The solution differs from the untracked one by no more than the sleep
+	// threshold, the height below which a tile counts as calm.
+	void SetActivityTracking(bool enable);
+	void SetSleepThreshold(float threshold);
+
+	// Excludes every tile whose grid points all satisfy isLand(x, z) from the
+	// simulation; it stays flat and reflects waves like the grid boundary does.  Only
+	// used with activity tracking.  Init() clears the mask.
+	void SetLandMask(const std::function<bool(float x, float z)>& isLand);
+
+	// Tiles of ActivityTileSize x ActivityTileSize grid points, with the Revision()
+	// at which the vertices of each last changed.
+	static const UINT ActivityTileSize = 16;
+	UINT TileRowCount()const { return mTileRowCount; }
+	UINT TileColumnCount()const { return mTileColCount; }
+	UINT TileRevision(UINT ti, UINT tj)const { return mTileRevision[ti * mTileColCount + tj]; }
+	UINT ActiveTileCount()const;
+
+	// Smallest range of rows [row0, row1) that holds every vertex changed after the
+	// given revision, for a partial vertex upload.  Returns false if nothing changed.
+	bool GetRowsChangedSince(UINT revision, UINT& row0, UINT& row1)const;
+
+	// Overrides the kernels picked by SelectWaveKernels(), e.g. to compare against
+	// ScalarWaveKernels().
+	void SetKernels(const WaveKernels& kernels) { mKernels = &kernels; }
+	const WaveKernels& Kernels()const { return *mKernels; }
+
+	// Runs the update on the given pool, null runs it on the calling thread.  The
+	// pool must outlive its use here.  The solution does not depend on the number of
+	// threads in the pool.
+	void SetThreadPool(ThreadPool* pool) { mThreadPool = pool; }
+
+	// Maximum number of steps a tile is advanced at once when several steps are due;
+	// 1 disables temporal blocking.  Heights are bit-identical either way; normals
+	// agree within the kernel tolerance given in WaveKernels.h.
+	void SetTemporalBlocking(UINT maxStepsPerTile);
+
+private:
+	void Release();
+
+	void EmitRows(float* out, UINT stride, UINT row0, UINT row1)const;
+
+	// One step as a single sweep over the grid, normals included.
+	void StepFused();
+
+	// depth steps, tile by tile; normals only for the last one.
+	void StepTemporalBlocked(UINT depth);
+
+	// One step of the implicit integrator, normals included.
+	void StepImplicit();
+
+	// Grid points [Row0, Row1] x [Col0, Col1] an impulse may change, clipped to the
+	// interior.
+	struct ImpulseBounds
+	{
+		UINT Row0;
+		UINT Row1;
+		UINT Col0;
+		UINT Col1;
+	};
+
+	// Applies the queued impulses to the current solution.  ApplyImpulse() and
+	// AddImpulsePoint() only change rows [row0, row1).
+	void ApplyImpulses();
+	void ApplyImpulse(const WaveImpulse& impulse, const ImpulseBounds& bounds, UINT row0, UINT row1);
+	void AddImpulsePoint(int i, int j, float dh, UINT row0, UINT row1);
+
+	// False if the impulse changes no grid point.
+	bool GetImpulseBounds(const WaveImpulse& impulse, ImpulseBounds& bounds)const;
+
+	// One step of the active tiles and their neighbors.
+	void StepActiveTiles();
+
+	// Zeroes the heights of tile t in both solutions and resets its normals.
+	void FlattenTile(UINT t);
+
+	// Interior rows [row0, row1) and columns [col0, col1) of tile t; may be empty.
+	void GetTileRect(UINT t, UINT& row0, UINT& row1, UINT& col0, UINT& col1)const;
+
+	// Stamps every tile with the current revision.
+	void MarkAllTilesChanged();
+
+	// Marks every tile that is not land active, to find out whether it is calm.
+	void WakeAllTiles();
+
+	// Normals of interior row i computed from the given height field.
+	void ComputeRowNormals(const float* heights, UINT i);
+
+	UINT ThreadCount()const;
+
+	// Interior rows [row0, row1) of band b.
+	UINT BandCount()const;
+	void GetBandRows(UINT b, UINT& row0, UINT& row1)const;
+
+	// Interior rows per band and the size of temporally blocked tiles.  Fixed so that
+	// the partition of the grid does not depend on the thread count.
+	static const UINT BandRows = 32;
+	static const UINT TileRows = 32;
+	static const UINT TileCols = 256;
+
+	// Columns per block of the implicit solve down the columns, and rows per block of
+	// the solve along the rows.
+	static const UINT SolveColumns = 64;
+	static const UINT SolveRows = 16;
+
+	// Impulses of a step reaching fewer grid points than this between them are added
+	// on the calling thread, as sorting them into bands would cost more than it saves.
+	static const UINT ParallelImpulsePoints = 65536;
+
 private:
 	UINT mNumRows;
 	UINT mNumCols;
@@ -50,13 +340,85 @@ class Waves
 	float mK2;
 	float mK3;
 
+	// Right-hand side of the implicit step, for StepHeights(), the off-diagonal of its
+	// tridiagonal systems and their Thomas factors (see WaveTridiagonal), for systems
+	// as long as the longer side of the interior.
+	WaveIntegrator mIntegrator;
+	float mImplicitK1;
+	float mImplicitK2;
+	float mImplicitK3;
+	float mImplicitBeta;
+	float* mThomasScale;
+	float* mThomasCoupling;
+
 	float mTimeStep;
 	float mSpatialStep;
 
-	DirectX::XMFLOAT3* mPrevSolution;
-	DirectX::XMFLOAT3* mCurrSolution;
-	DirectX::XMFLOAT3* mNormals;
-	DirectX::XMFLOAT3* mTangentX;
+	// Simulated time owed to Update(), less than one time step between calls.
+	float mTimeAccumulator;
+	UINT mMaxStepsPerUpdate;
+
+	float mHalfWidth;
+	float mHalfDepth;
+
+	// Heights of the previous and current solution.
+	float* mPrevHeights;
+	float* mCurrHeights;
+
+	// Normal components, one stream each.
+	float* mNormalX;
+	float* mNormalY;
+	float* mNormalZ;
+
+	// Tangent components.  The tangent along the x-axis has no z component.
+	float* mTangentXx;
+	float* mTangentXy;
+
+	// x-coordinate and texture u of each column, texture v of each row.
+	float* mColumnX;
+	float* mColumnU;
+	float* mRowV;
+
+	UINT mRevision;
+
+	const WaveKernels* mKernels;
+	ThreadPool* mThreadPool;
+
+	// Temporal blocking reads the old solution and writes the new one to these, then
+	// swaps them with mPrevHeights/mCurrHeights.  Allocated on first use.
+	UINT mTemporalBlockDepth;
+	float* mNextPrevHeights;
+	float* mNextCurrHeights;
+
+	// Work buffer of the implicit step, allocated on first use.
+	float* mImplicitWork;
+
+	// Per-thread copies of a tile and its halo, or of a block of rows transposed for
+	// the implicit solve along the rows.
+	std::vector<std::vector<float>> mTileScratch;
+
+	// Activity tiles.  mTileState holds TileState flags.
+	enum TileState
+	{
+		TileLand = 1,
+		TileActive = 2,
+		TileAwake = 4	// stepped in the last step
+	};
+
+	bool mTrackActivity;
+	float mSleepThreshold;
+	UINT mTileRowCount;
+	UINT mTileColCount;
+	std::vector<BYTE> mTileState;
+	std::vector<UINT> mTileRevision;
+	std::vector<UINT> mAwakeTiles;
+
+	// Impulses from DisturbBatch(), those taken out of the queue for this step with
+	// what each reaches, and the indices of the latter that reach each band.
+	MpscQueue<WaveImpulse> mImpulseQueue;
+	std::vector<WaveImpulse> mImpulses;
+	std::vector<ImpulseBounds> mImpulseBounds;
+	std::vector<std::vector<UINT>> mBandImpulses;
 };
 
 #endif // WAVES_H
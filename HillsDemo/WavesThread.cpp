@@ -0,0 +1,195 @@
+//***************************************************************************************
+// WavesThread.cpp
+//***************************************************************************************
+
+#include "WavesThread.h"
+#include "Waves.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+WaveSnapshot::WaveSnapshot()
+	: RowCount(0),
+	  ColumnCount(0),
+	  Revision(0),
+	  TileColumnCount(0),
+	  X0(0.0f),
+	  Z0(0.0f),
+	  SpatialStep(0.0f)
+{
+}
+
+bool WaveSnapshot::GetRowsChangedSince(UINT revision, UINT& row0, UINT& row1)const
+{
+	row0 = RowCount;
+	row1 = 0;
+
+	UINT tileRowCount = TileColumnCount > 0 ? static_cast<UINT>(TileRevisions.size()) / TileColumnCount : 0;
+	for (UINT ti = 0; ti < tileRowCount; ++ti)
+	{
+		for (UINT tj = 0; tj < TileColumnCount; ++tj)
+		{
+			// Revisions may wrap around.
+			if (static_cast<int>(TileRevisions[ti * TileColumnCount + tj] - revision) > 0)
+			{
+				row0 = std::min(row0, ti * Waves::ActivityTileSize);
+				row1 = std::max(row1, std::min((ti + 1) * Waves::ActivityTileSize, RowCount));
+				break;
+			}
+		}
+	}
+
+	return row0 < row1;
+}
+
+WaveSurface WaveSnapshot::Surface()const
+{
+	WaveSurface surface = { &Heights[0], &NormalX[0], &NormalY[0], &NormalZ[0], RowCount, ColumnCount,
+		X0, Z0, SpatialStep };
+	return surface;
+}
+
+void WaveSnapshot::Sample(const WaveProbes& probes)const
+{
+	SelectWaveKernels().SampleSurface(Surface(), probes);
+}
+
+WavesThread::WavesThread()
+	: mWaves(nullptr),
+	  mQuit(false)
+{
+}
+
+WavesThread::~WavesThread()
+{
+	Stop();
+}
+
+void WavesThread::Start(Waves& waves)
+{
+	Stop();
+
+	UINT m = waves.RowCount();
+	UINT n = waves.ColumnCount();
+
+	// Every buffer starts out holding the current solution, all of it.
+	for (UINT b = 0; b < 3; ++b)
+	{
+		WaveSnapshot& snapshot = mSnapshots[b];
+		snapshot.RowCount = m;
+		snapshot.ColumnCount = n;
+		snapshot.Heights.resize(m * n);
+		snapshot.NormalX.resize(m * n);
+		snapshot.NormalY.resize(m * n);
+		snapshot.NormalZ.resize(m * n);
+		snapshot.Vertices.resize(m * n);
+		snapshot.TileColumnCount = waves.TileColumnCount();
+		snapshot.TileRevisions.resize(waves.TileRowCount() * waves.TileColumnCount());
+
+		WaveSurface surface = waves.Surface();
+		snapshot.X0 = surface.X0;
+		snapshot.Z0 = surface.Z0;
+		snapshot.SpatialStep = surface.SpatialStep;
+
+		CopyRows(waves, snapshot, 0, m);
+	}
+
+	mQuit = false;
+	mWaves = &waves;
+	mThread = std::thread(&WavesThread::ThreadMain, this);
+}
+
+void WavesThread::Stop()
+{
+	if (mWaves == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeCV.notify_all();
+
+	mThread.join();
+	mWaves = nullptr;
+}
+
+bool WavesThread::AcquireSnapshot()
+{
+	return mSnapshots.Acquire();
+}
+
+void WavesThread::ThreadMain()
+{
+	__int64 countsPerSec;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+	double secondsPerCount = 1.0 / (double)countsPerSec;
+
+	__int64 prevTime;
+	QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
+
+	UINT publishedRevision = mWaves->Revision();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mQuit)
+	{
+		lock.unlock();
+
+		__int64 currTime;
+		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+		mWaves->Update(static_cast<float>((currTime - prevTime) * secondsPerCount));
+		prevTime = currTime;
+
+		if (mWaves->Revision() != publishedRevision)
+		{
+			UpdateSnapshot(*mWaves, mSnapshots.Back());
+			mSnapshots.Publish();
+			publishedRevision = mWaves->Revision();
+		}
+
+		// Sleep until the next step is due, less the time this one took.
+		__int64 now;
+		QueryPerformanceCounter((LARGE_INTEGER*)&now);
+		double wait = mWaves->TimeUntilNextStep() - (now - currTime) * secondsPerCount;
+
+		lock.lock();
+		if (wait > 0.0)
+		{
+			mWakeCV.wait_for(lock, std::chrono::microseconds(static_cast<long long>(wait * 1.0e6)),
+				[this]{ return mQuit; });
+		}
+	}
+}
+
+void WavesThread::UpdateSnapshot(const Waves& waves, WaveSnapshot& snapshot)
+{
+	UINT row0, row1;
+	if (waves.GetRowsChangedSince(snapshot.Revision, row0, row1))
+		CopyRows(waves, snapshot, row0, row1);
+	else
+		CopyRows(waves, snapshot, 0, 0);
+}
+
+void WavesThread::CopyRows(const Waves& waves, WaveSnapshot& snapshot, UINT row0, UINT row1)
+{
+	assert(snapshot.RowCount == waves.RowCount() && snapshot.ColumnCount == waves.ColumnCount());
+	assert(row0 <= row1 && row1 <= snapshot.RowCount);
+
+	UINT k = row0 * snapshot.ColumnCount;
+	size_t bytes = (row1 - row0) * snapshot.ColumnCount * sizeof(float);
+	memcpy(&snapshot.Heights[k], waves.Heights() + k, bytes);
+	memcpy(&snapshot.NormalX[k], waves.NormalsX() + k, bytes);
+	memcpy(&snapshot.NormalY[k], waves.NormalsY() + k, bytes);
+	memcpy(&snapshot.NormalZ[k], waves.NormalsZ() + k, bytes);
+	waves.EmitCompactVertices(&snapshot.Vertices[0], row0, row1);
+
+	for (UINT ti = 0; ti < waves.TileRowCount(); ++ti)
+	{
+		for (UINT tj = 0; tj < waves.TileColumnCount(); ++tj)
+			snapshot.TileRevisions[ti * snapshot.TileColumnCount + tj] = waves.TileRevision(ti, tj);
+	}
+
+	snapshot.Revision = waves.Revision();
+}
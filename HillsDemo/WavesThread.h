@@ -0,0 +1,125 @@
+//***************************************************************************************
+// WavesThread.h
+//
+// Runs a Waves simulation on a thread of its own, at its fixed time step and in real
+// time, so that the cost of a step never lands on the frame that happens to be due
+// for it.
+//
+// After every Update() that changed the solution the simulation thread copies it into
+// a WaveSnapshot, compact vertices included, and publishes it through a TripleBuffer.
+// The frame thread picks up the newest snapshot with AcquireSnapshot() and reads it
+// for as long as it likes; neither thread ever waits for the other.  Only the rows
+// that changed since a snapshot buffer was last filled are copied into it.
+//
+// Disturbances go the other way through Waves::DisturbBatch(), whose queue may be
+// fed from any thread while the simulation is stepping.
+//***************************************************************************************
+
+#ifndef WAVESTHREAD_H
+#define WAVESTHREAD_H
+
+#include <Windows.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <TripleBuffer.h>
+
+#include "Vertex.h"
+#include "WaveKernels.h"
+
+class Waves;
+
+// A consistent copy of the solution of a Waves at one revision.
+struct WaveSnapshot
+{
+	WaveSnapshot();
+
+	UINT RowCount;
+	UINT ColumnCount;
+
+	// Waves::Revision() of the solution held here.
+	UINT Revision;
+
+	// Heights and normal components, RowCount x ColumnCount each, and the vertices
+	// Waves::EmitCompactVertices() writes for them.
+	std::vector<float> Heights;
+	std::vector<float> NormalX;
+	std::vector<float> NormalY;
+	std::vector<float> NormalZ;
+	std::vector<Vertex::WaveCompact> Vertices;
+
+	// Waves::TileRevision() of every activity tile, row by row.
+	UINT TileColumnCount;
+	std::vector<UINT> TileRevisions;
+
+	// Grid geometry, as in WaveSurface.
+	float X0;
+	float Z0;
+	float SpatialStep;
+
+	// Same as Waves::GetRowsChangedSince().
+	bool GetRowsChangedSince(UINT revision, UINT& row0, UINT& row1)const;
+
+	// Same as Waves::Surface() and Waves::Sample().  A snapshot does not change while
+	// the simulation thread steps, so these are safe at any time, also from several
+	// threads at once, as long as the snapshot stays acquired.
+	WaveSurface Surface()const;
+	void Sample(const WaveProbes& probes)const;
+};
+
+class WavesThread
+{
+public:
+	WavesThread();
+	~WavesThread();
+
+	// Starts stepping waves, which must have been initialized, on the simulation
+	// thread.  Until Stop() the caller may only use the accessors of waves that do not
+	// depend on the solution, and DisturbBatch(); Disturb() is not safe.  If waves
+	// has a thread pool, nobody else may use the pool either.
+	void Start(Waves& waves);
+
+	// Waits for the step in progress and ends the simulation thread.  Afterwards the
+	// waves are the caller's again.
+	void Stop();
+
+	bool IsRunning()const { return mWaves != nullptr; }
+
+	// Makes the newest published snapshot the one Snapshot() returns.  Returns false
+	// if nothing was published since the last call.
+	bool AcquireSnapshot();
+
+	// The snapshot taken by the last AcquireSnapshot(); it does not change until the
+	// next one.  Start() publishes the solution the waves have when it is called.
+	const WaveSnapshot& Snapshot()const { return mSnapshots.Front(); }
+
+private:
+	WavesThread(const WavesThread& rhs);
+	WavesThread& operator=(const WavesThread& rhs);
+
+	void ThreadMain();
+
+	// Brings snapshot up to the current revision of waves, copying only the rows
+	// that changed since the revision it holds.
+	static void UpdateSnapshot(const Waves& waves, WaveSnapshot& snapshot);
+
+	// Copies rows [row0, row1) of the solution and every tile revision into snapshot
+	// and stamps it with the current revision.
+	static void CopyRows(const Waves& waves, WaveSnapshot& snapshot, UINT row0, UINT row1);
+
+private:
+	Waves* mWaves;
+	std::thread mThread;
+
+	// Lets Stop() cut the wait for the next step short.
+	std::mutex mMutex;
+	std::condition_variable mWakeCV;
+	bool mQuit;
+
+	TripleBuffer<WaveSnapshot> mSnapshots;
+};
+
+#endif // WAVESTHREAD_H
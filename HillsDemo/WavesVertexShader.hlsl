@@ -0,0 +1,47 @@
+//=============================================================================
+// WavesVertexShader.hlsl
+//
+// Textured vertex shader for the compact wave vertices.  The grid position and
+// texture coordinates come from a static stream; the height (half float) and
+// normal (R10G10B10A2) from the stream Waves updates every step.
+//=============================================================================
+
+#include "Textured.hlsli"
+
+struct VertexIn
+{
+	float2 PosXZ        : POSITION;
+	float2 Tex          : TEXCOORD;
+	float  Height       : HEIGHT;
+	float4 PackedNormal : NORMAL;
+};
+
+
+cbuffer cbPerObject
+{
+	float4x4 gWorld;
+	float4x4 gWorldInvTranspose;
+	float4x4 gWorldViewProj;
+	float4x4 gTexTransform;
+};
+
+VertexOut main(VertexIn vin)
+{
+	VertexOut vout;
+
+	// Unpack the position and map the normal from [0,1] back to [-1,1].
+	float3 posL = float3(vin.PosXZ.x, vin.Height, vin.PosXZ.y);
+	float3 normalL = vin.PackedNormal.xyz * 2.0f - 1.0f;
+
+	// Transform to world space space.
+	vout.PosW = mul(float4(posL, 1.0f), gWorld).xyz;
+	vout.NormalW = mul(normalL, (float3x3)gWorldInvTranspose);
+
+	// Transform to homogeneous clip space.
+	vout.PosH = mul(float4(posL, 1.0f), gWorldViewProj);
+
+	// Output vertex attributes for interpolation across triangle.
+	vout.Tex = mul(float4(vin.Tex, 0.0f, 1.0f), gTexTransform).xy;
+
+	return vout;
+}
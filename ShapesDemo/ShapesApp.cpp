@@ -16,6 +16,9 @@
 #include <DDSTextureLoader.h>
 
 #include <GeometryGenerator.h>
+#include <MeshOptimizer.h>
+#include <MeshletBuilder.h>
+#include <Trace.h>
 #include "Vertex.h"
 #include "Effects.h"
 
@@ -91,6 +94,10 @@ class ShapesApp : public D3DApp
 
 	UINT mSkullIndexCount;
 
+	// Meshlets of the skull, and the ranges of them left to draw each frame.
+	std::vector<MeshletBuilder::Meshlet> mSkullMeshlets;
+	std::vector<MeshletBuilder::DrawRange> mSkullDrawRanges;
+
 	UINT mLightCount;
 
 	XMFLOAT3 mEyePosW;
@@ -303,7 +310,7 @@ void ShapesApp::DrawScene()
 	UINT stride = sizeof(Vertex::Basic32);
 	UINT offset = 0;
 	md3dImmediateContext->IASetVertexBuffers(0, 1, &mShapesVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mShapesIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(mShapesIB, DXGI_FORMAT_R16_UINT, 0);
 
 	// Set constants
 	XMMATRIX view = XMLoadFloat4x4(&mView);
@@ -358,13 +365,23 @@ void ShapesApp::DrawScene()
 
 	// Draw the skull.
 	md3dImmediateContext->IASetVertexBuffers(0, 1, &mSkullVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mSkullIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(mSkullIB, DXGI_FORMAT_R16_UINT, 0);
 
 	world = XMLoadFloat4x4(&mSkullWorld);
 	worldInvTranspose = MathHelper::InverseTranspose(world);
 	Effects::BasicFX->SetConstantBufferPerObjectVertexShader(md3dImmediateContext, world*viewProj, world, worldInvTranspose);
 	Effects::BasicFX->SetConstantBufferPerObjectPixelShader(md3dImmediateContext, mSkullMat);
-	md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
+
+	// Only the meshlets in view and facing the camera, which is moved into the space of
+	// the skull to test them.
+	XMFLOAT4X4 skullWorldViewProj;
+	XMStoreFloat4x4(&skullWorldViewProj, world*viewProj);
+	XMVECTOR det = XMMatrixDeterminant(world);
+	XMFLOAT3 skullEyePos;
+	XMStoreFloat3(&skullEyePos, XMVector3TransformCoord(XMLoadFloat3(&mEyePosW), XMMatrixInverse(&det, world)));
+	MeshletBuilder::Cull(mSkullMeshlets, skullWorldViewProj, skullEyePos, mSkullDrawRanges);
+	for (size_t i = 0; i < mSkullDrawRanges.size(); ++i)
+		md3dImmediateContext->DrawIndexed(mSkullDrawRanges[i].IndexCount, mSkullDrawRanges[i].FirstIndex, 0);
 
 	HR(mSwapChain->Present(0, 0));
 }
@@ -416,10 +433,10 @@ void ShapesApp::OnMouseMove(WPARAM btnState, int x, int y)
 
 void ShapesApp::BuildShapeGeometryBuffers()
 {
-	GeometryGenerator::MeshData box;
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator::MeshData sphere;
-	GeometryGenerator::MeshData cylinder;
+	GeometryGenerator::MeshData16 box;
+	GeometryGenerator::MeshData16 grid;
+	GeometryGenerator::MeshData16 sphere;
+	GeometryGenerator::MeshData16 cylinder;
 
 	GeometryGenerator geoGen;
 	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
@@ -428,6 +445,11 @@ void ShapesApp::BuildShapeGeometryBuffers()
 	geoGen.CreateGeosphere(0.5f, 2, sphere);
 	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
 
+	MeshOptimizer::Optimize(box);
+	MeshOptimizer::Optimize(grid);
+	MeshOptimizer::Optimize(sphere);
+	MeshOptimizer::Optimize(cylinder);
+
 	// Cache the vertex offsets to each object in the concatenated vertex buffer.
 	mBoxVertexOffset = 0;
 	mGridVertexOffset = mBoxVertexOffset + box.Vertices.size();
@@ -509,7 +531,7 @@ void ShapesApp::BuildShapeGeometryBuffers()
 	// Pack the indices of all the meshes into one index buffer.
 	//
 
-	std::vector<UINT> indices;
+	std::vector<USHORT> indices;
 	indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
 	indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
 	indices.insert(indices.end(), sphere.Indices.begin(), sphere.Indices.end());
@@ -517,7 +539,7 @@ void ShapesApp::BuildShapeGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * totalIndexCount;
+	ibd.ByteWidth = sizeof(USHORT) * totalIndexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -556,8 +578,10 @@ void ShapesApp::BuildSkullGeometryBuffers()
 	fin >> ignore;
 	fin >> ignore;
 
+	// The skull has few enough vertices for 16-bit indices.
+	assert(GeometryGenerator::IndicesFit<USHORT>(vcount));
 	mSkullIndexCount = 3 * tcount;
-	std::vector<UINT> indices(mSkullIndexCount);
+	std::vector<USHORT> indices(mSkullIndexCount);
 	for (UINT i = 0; i < tcount; i++)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -565,6 +589,19 @@ void ShapesApp::BuildSkullGeometryBuffers()
 
 	fin.close();
 
+	// Reorder the triangles for the vertex cache and overdraw, and the vertices for
+	// fetching them.
+	MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&indices[0], mSkullIndexCount, vcount);
+	vcount = MeshOptimizer::Optimize(&vertices[0], vcount, sizeof(Vertex::Basic32), offsetof(Vertex::Basic32, Pos),
+		&indices[0], mSkullIndexCount);
+	MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&indices[0], mSkullIndexCount, vcount);
+	TRACE(TEXT("skull.txt: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n"), before.Acmr, after.Acmr, before.Atvr, after.Atvr);
+
+	// Group the triangles into meshlets that can be culled whole, then put the vertices
+	// back in the order the regrouped triangles use them.
+	MeshletBuilder::Build(&indices[0], mSkullIndexCount, &vertices[0], vcount, sizeof(Vertex::Basic32),
+		offsetof(Vertex::Basic32, Pos), mSkullMeshlets);
+	vcount = MeshOptimizer::OptimizeVertexFetch(&vertices[0], vcount, sizeof(Vertex::Basic32), &indices[0], mSkullIndexCount);
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -583,7 +620,7 @@ void ShapesApp::BuildSkullGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * mSkullIndexCount;
+	ibd.ByteWidth = sizeof(USHORT) * mSkullIndexCount;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -15,6 +15,11 @@
 #include <ShaderHelper.h>
 
 #include <GeometryGenerator.h>
+#include <MeshOptimizer.h>
+#include <MeshletBuilder.h>
+#include <MeshSimplifier.h>
+#include <MeshWelder.h>
+#include <Trace.h>
 
 #include "cbPerObject.h"
 
@@ -72,6 +77,18 @@ class SkullApp : public D3DApp
 
 	UINT mSkullIndexCount;
 
+	// Meshlets of the skull, and the ranges of them left to draw each frame.
+	std::vector<MeshletBuilder::Meshlet> mSkullMeshlets;
+	std::vector<MeshletBuilder::DrawRange> mSkullDrawRanges;
+
+	// Levels of detail of the skull after the full one in the index buffer, and the
+	// bounds to pick one by.
+	std::vector<MeshSimplifier::Lod> mSkullLods;
+	XMFLOAT3 mSkullCenter;
+	float mSkullSize;
+
+	XMFLOAT3 mEyePosW;
+
 	float mTheta;
 	float mPhi;
 	float mRadius;
@@ -104,6 +121,9 @@ SkullApp::SkullApp(HINSTANCE hInstance)
 	mWireframeRS(nullptr),
 	mInputLayout(nullptr),
 	mSkullIndexCount(0),
+	mSkullCenter(0.0f, 0.0f, 0.0f),
+	mSkullSize(0.0f),
+	mEyePosW(0.0f, 0.0f, 0.0f),
 	mTheta(1.5f*MathHelper::Pi),
 	mPhi(0.1f*MathHelper::Pi),
 	mRadius(20.0f)
@@ -159,6 +179,8 @@ void SkullApp::UpdateScene(float dt)
 	float z = mRadius*sinf(mPhi)*sinf(mTheta);
 	float y = mRadius*cosf(mPhi);
 
+	mEyePosW = XMFLOAT3(x, y, z);
+
 	// Build the view matrix.
 	XMVECTOR pos = XMVectorSet(x, y, z, 1.0f);
 	XMVECTOR target = XMVectorZero();
@@ -196,7 +218,7 @@ void SkullApp::DrawScene()
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 	md3dImmediateContext->IASetVertexBuffers(0, 1, &mVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mIB, DXGI_FORMAT_R32_UINT, 0);
+	md3dImmediateContext->IASetIndexBuffer(mIB, DXGI_FORMAT_R16_UINT, 0);
 
 	// Set constants
 	XMMATRIX view = XMLoadFloat4x4(&mView);
@@ -205,7 +227,33 @@ void SkullApp::DrawScene()
 	XMMATRIX worldViewProj = world*view*proj;
 
 	ApplyWorldViewProj(worldViewProj);
-	md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
+
+	// The coarsest level of detail that is off the full skull by less than a pixel.
+	XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&mSkullCenter), world);
+	float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&mEyePosW) - center));
+	float pixelsPerUnit = 0.5f*mClientHeight / (distance*tanf(0.125f*MathHelper::Pi));
+
+	UINT lod = 0;
+	while (lod + 1 < mSkullLods.size() && mSkullLods[lod + 1].Error*mSkullSize*pixelsPerUnit < 1.0f)
+		++lod;
+
+	if (lod > 0)
+	{
+		md3dImmediateContext->DrawIndexed(mSkullLods[lod].IndexCount, mSkullLods[lod].FirstIndex, 0);
+	}
+	else
+	{
+		// Only the meshlets in view and facing the camera, which is moved into the
+		// space of the skull to test them.
+		XMFLOAT4X4 skullWorldViewProj;
+		XMStoreFloat4x4(&skullWorldViewProj, worldViewProj);
+		XMVECTOR det = XMMatrixDeterminant(world);
+		XMFLOAT3 skullEyePos;
+		XMStoreFloat3(&skullEyePos, XMVector3TransformCoord(XMLoadFloat3(&mEyePosW), XMMatrixInverse(&det, world)));
+		MeshletBuilder::Cull(mSkullMeshlets, skullWorldViewProj, skullEyePos, mSkullDrawRanges);
+		for (size_t i = 0; i < mSkullDrawRanges.size(); ++i)
+			md3dImmediateContext->DrawIndexed(mSkullDrawRanges[i].IndexCount, mSkullDrawRanges[i].FirstIndex, 0);
+	}
 
 	HR(mSwapChain->Present(0, 0));
 }
@@ -273,33 +321,84 @@ void SkullApp::BuildGeometryBuffers()
 	fin >> ignore >> tcount;
 	fin >> ignore >> ignore >> ignore >> ignore;
 
-	float nx, ny, nz;
-	XMFLOAT4 black(0.0f, 0.0f, 0.0f, 1.0f);
-
-	std::vector<Vertex> vertices(vcount);
+	GeometryGenerator::MeshData skull;
+	skull.Vertices.resize(vcount, GeometryGenerator::Vertex(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f));
 	for (UINT i = 0; i < vcount; i++)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-
-		vertices[i].Color = black;
-
-		// Normal not used in this demo.
-		fin >> nx >> ny >> nz;
+		XMFLOAT3& p = skull.Vertices[i].Position;
+		XMFLOAT3& n = skull.Vertices[i].Normal;
+		fin >> p.x >> p.y >> p.z >> n.x >> n.y >> n.z;
 	}
 
 	fin >> ignore;
 	fin >> ignore;
 	fin >> ignore;
 
-	mSkullIndexCount = 3 * tcount;
-	std::vector<UINT> indices(mSkullIndexCount);
+	skull.Indices.resize(3 * tcount);
 	for (UINT i = 0; i < tcount; i++)
 	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+		fin >> skull.Indices[i * 3 + 0] >> skull.Indices[i * 3 + 1] >> skull.Indices[i * 3 + 2];
 	}
 
 	fin.close();
 
+	// Normals are not used in this demo, so vertices at the same position merge
+	// whatever their normals.
+	MeshWelder welder;
+	MeshWelder::WeldStats welded = welder.Weld(skull, MeshWelder::Tolerance(1e-5f, 2.0f, 0.0f));
+	TRACE(TEXT("skull.txt: welded %u -> %u vertices, %u bytes saved\n"), welded.VertexCountBefore,
+		welded.VertexCountAfter, static_cast<UINT>((welded.VertexCountBefore - welded.VertexCountAfter)*sizeof(Vertex)));
+
+	XMFLOAT4 black(0.0f, 0.0f, 0.0f, 1.0f);
+
+	vcount = welded.VertexCountAfter;
+	std::vector<Vertex> vertices(vcount);
+	for (UINT i = 0; i < vcount; i++)
+	{
+		vertices[i].Pos = skull.Vertices[i].Position;
+		vertices[i].Color = black;
+	}
+
+	// Welded, the skull has few enough vertices for 16-bit indices.
+	assert(GeometryGenerator::IndicesFit<USHORT>(vcount));
+	mSkullIndexCount = static_cast<UINT>(skull.Indices.size());
+	std::vector<USHORT> indices(mSkullIndexCount);
+	for (UINT i = 0; i < mSkullIndexCount; ++i)
+		indices[i] = static_cast<USHORT>(skull.Indices[i]);
+
+	// Reorder the triangles for the vertex cache and overdraw, and the vertices for
+	// fetching them.
+	MeshOptimizer::VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&indices[0], mSkullIndexCount, vcount);
+	vcount = MeshOptimizer::Optimize(&vertices[0], vcount, sizeof(Vertex), offsetof(Vertex, Pos),
+		&indices[0], mSkullIndexCount);
+	MeshOptimizer::VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&indices[0], mSkullIndexCount, vcount);
+	TRACE(TEXT("skull.txt: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n"), before.Acmr, after.Acmr, before.Atvr, after.Atvr);
+
+	// Group the triangles into meshlets that can be culled whole, then put the vertices
+	// back in the order the regrouped triangles use them.
+	MeshletBuilder::Build(&indices[0], mSkullIndexCount, &vertices[0], vcount, sizeof(Vertex), offsetof(Vertex, Pos),
+		mSkullMeshlets);
+	vcount = MeshOptimizer::OptimizeVertexFetch(&vertices[0], vcount, sizeof(Vertex), &indices[0], mSkullIndexCount);
+
+	// Coarser levels of detail after the full skull in the same buffers, each ordered
+	// for the vertex cache on its own.
+	const float lodRatios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+	MeshSimplifier simplifier;
+	simplifier.BuildLodChain(indices, &vertices[0], vcount, sizeof(Vertex), offsetof(Vertex, Pos),
+		lodRatios, sizeof(lodRatios) / sizeof(lodRatios[0]), mSkullLods);
+	for (size_t i = 1; i < mSkullLods.size(); ++i)
+		MeshOptimizer::OptimizeVertexCache(&indices[mSkullLods[i].FirstIndex], mSkullLods[i].IndexCount, vcount);
+
+	XMFLOAT3 vMin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+	XMFLOAT3 vMax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	for (UINT i = 0; i < vcount; ++i)
+	{
+		const XMFLOAT3& p = vertices[i].Pos;
+		vMin = XMFLOAT3(MathHelper::Min(vMin.x, p.x), MathHelper::Min(vMin.y, p.y), MathHelper::Min(vMin.z, p.z));
+		vMax = XMFLOAT3(MathHelper::Max(vMax.x, p.x), MathHelper::Max(vMax.y, p.y), MathHelper::Max(vMax.z, p.z));
+	}
+	mSkullCenter = XMFLOAT3(0.5f*(vMin.x + vMax.x), 0.5f*(vMin.y + vMax.y), 0.5f*(vMin.z + vMax.z));
+	mSkullSize = MathHelper::Max(vMax.x - vMin.x, MathHelper::Max(vMax.y - vMin.y, vMax.z - vMin.z));
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -318,7 +417,7 @@ void SkullApp::BuildGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * mSkullIndexCount;
+	ibd.ByteWidth = sizeof(USHORT) * static_cast<UINT>(indices.size());
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;